@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+# Released under MIT License.
+# Copyright (c) 2022 Ladislav Bartos
+
+"""
+Benchmark of posdist on synthetic systems.
+
+Generates a synthetic system (see generate.c), runs every type of calculation
+with and without option -t and reports frames/s, distances/s, output MB/s and peak RSS
+of every run. The results are written as JSON and compared with a stored baseline.
+
+Usage:
+    bench.py [--atoms N] [--frames N] [--repeat N] [--threads N] [--save-baseline] [--tolerance FRACTION]
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import time
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+POSDIST = os.path.join(BENCH_DIR, "..", "posdist")
+GENERATE = os.path.join(BENCH_DIR, "generate")
+WORK_DIR = os.path.join(BENCH_DIR, "work")
+BASELINE = os.path.join(BENCH_DIR, "baseline.json")
+RESULTS = os.path.join(WORK_DIR, "results.json")
+
+# name, posdist arguments, number of distances calculated per frame (None = no distances)
+MODES = [
+    ("positions",               ["-s", "Large"],                         lambda n: None),
+    ("positions -t",            ["-s", "Large", "-t"],                   lambda n: None),
+    ("center",                  ["-s", "Large", "-w"],                   lambda n: None),
+    ("center -t",               ["-s", "Large", "-w", "-t"],             lambda n: None),
+    ("centers distance",        ["-a", "Large", "-b", "Tail", "-w"],       lambda n: 1),
+    ("centers distance -t",     ["-a", "Large", "-b", "Tail", "-w", "-t"], lambda n: 1),
+    ("reference",               ["-a", "Large", "-b", "Small", "-r"],       lambda n: n["Large"]),
+    ("reference -t",            ["-a", "Large", "-b", "Small", "-r", "-t"], lambda n: n["Large"]),
+    ("all pairs",               ["-a", "Small", "-b", "Medium"],         lambda n: n["Small"] * n["Medium"]),
+    ("all pairs -t",            ["-a", "Small", "-b", "Medium", "-t"],   lambda n: n["Small"] * n["Medium"]),
+    ("all pairs identical",     ["-a", "Medium", "-b", "Medium"],        lambda n: n["Medium"] * (n["Medium"] - 1) // 2),
+    ("all pairs identical -t",  ["-a", "Small", "-b", "Small", "-t"],    lambda n: n["Small"] * (n["Small"] - 1) // 2),
+    ("all pairs tiled",         ["-a", "Medium", "-b", "Medium", "--memory", "4M"], lambda n: n["Medium"] * (n["Medium"] - 1) // 2),
+    ("residue centers -t",      ["-s", "Large", "--group", "resid", "-t"], lambda n: None),
+    ("residue pairs",           ["-a", "Large", "-b", "Large", "--group", "resid"],
+                                lambda n: (n["Large"] + 2) // 3 * ((n["Large"] + 2) // 3 - 1) // 2),
+]
+
+
+def group_sizes(n_atoms):
+    """Returns sizes of the ndx groups written by the generator."""
+    return {"Small": 100, "Medium": min(n_atoms, 1000), "Large": n_atoms // 10, "Tail": n_atoms // 10}
+
+
+def generate(n_atoms, n_frames):
+    """Generates the synthetic system, unless it already exists. Returns the stem of the files."""
+    stem = os.path.join(WORK_DIR, f"system_{n_atoms}_{n_frames}")
+    if not all(os.path.exists(f"{stem}.{ext}") for ext in ("gro", "xtc", "ndx")):
+        print(f"Generating system with {n_atoms} atoms and {n_frames} frames...", file=sys.stderr)
+        subprocess.run([GENERATE, stem, str(n_atoms), str(n_frames)], check=True)
+    return stem
+
+
+def run_once(command):
+    """Runs the command. Returns wall time in seconds and peak RSS in MB."""
+    start = time.perf_counter()
+    process = subprocess.Popen(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    _, status, usage = os.wait4(process.pid, 0)
+    wall = time.perf_counter() - start
+    process.returncode = os.waitstatus_to_exitcode(status)
+    error = process.stderr.read().decode(errors="replace")
+    process.stderr.close()
+
+    if process.returncode != 0:
+        raise RuntimeError(f"command failed ({process.returncode}): {' '.join(command)}\n{error}")
+
+    # ru_maxrss is in kilobytes on Linux
+    return wall, usage.ru_maxrss / 1024.0
+
+
+def run_mode(name, arguments, distances, stem, n_atoms, n_frames, repeat, threads):
+    """Runs a single mode 'repeat' times and returns the metrics of the fastest run."""
+    output = os.path.join(WORK_DIR, "output.dat")
+    command = [POSDIST, "-c", f"{stem}.gro", "-f", f"{stem}.xtc", "-n", f"{stem}.ndx",
+               "-o", output, "-j", str(threads)] + arguments
+
+    runs = [run_once(command) for _ in range(repeat)]
+    wall = min(run[0] for run in runs)
+    rss = max(run[1] for run in runs)
+    output_mb = os.path.getsize(output) / 1e6 if os.path.exists(output) else 0.0
+    if os.path.exists(output):
+        os.remove(output)
+
+    return {
+        "mode": name,
+        "arguments": " ".join(arguments),
+        "atoms": n_atoms,
+        "frames": n_frames,
+        "threads": threads,
+        "wall_s": round(wall, 4),
+        "frames_per_s": round(n_frames / wall, 2),
+        "distances_per_s": round(distances * n_frames / wall, 1) if distances is not None else None,
+        "output_mb": round(output_mb, 3),
+        "output_mb_per_s": round(output_mb / wall, 2),
+        "peak_rss_mb": round(rss, 2),
+    }
+
+
+def compare(results, baseline, tolerance):
+    """Prints comparison of the results with the baseline. Returns number of modes slower than the tolerance."""
+    previous = {(r["mode"], r["atoms"], r["frames"], r["threads"]): r for r in baseline}
+    n_slower = 0
+
+    print(f"\n{'mode':<26}{'frames/s':>12}{'baseline':>12}{'ratio':>8}{'rss MB':>10}{'baseline':>10}")
+    for result in results:
+        key = (result["mode"], result["atoms"], result["frames"], result["threads"])
+        if key not in previous:
+            print(f"{result['mode']:<26}{result['frames_per_s']:>12.1f}{'-':>12}{'-':>8}{result['peak_rss_mb']:>10.1f}{'-':>10}")
+            continue
+
+        old = previous[key]
+        ratio = result["frames_per_s"] / old["frames_per_s"]
+        flag = ""
+        if ratio < 1.0 - tolerance:
+            flag = "  SLOWER"
+            n_slower += 1
+        elif ratio > 1.0 + tolerance:
+            flag = "  faster"
+        print(f"{result['mode']:<26}{result['frames_per_s']:>12.1f}{old['frames_per_s']:>12.1f}{ratio:>8.2f}"
+              f"{result['peak_rss_mb']:>10.1f}{old['peak_rss_mb']:>10.1f}{flag}")
+
+    return n_slower
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark posdist on a synthetic system.")
+    parser.add_argument("--atoms", type=int, default=100000, help="number of atoms of the system (default: 100000)")
+    parser.add_argument("--frames", type=int, default=100, help="number of frames of the trajectory (default: 100)")
+    parser.add_argument("--repeat", type=int, default=3, help="number of runs of every mode, the fastest is reported (default: 3)")
+    parser.add_argument("--threads", type=int, default=1, help="number of threads used by posdist (default: 1)")
+    parser.add_argument("--mode", action="append", help="only run modes containing this string (can be repeated)")
+    parser.add_argument("--save-baseline", action="store_true", help="store the results as the new baseline")
+    parser.add_argument("--tolerance", type=float, default=0.1,
+                        help="relative slowdown reported as a regression (default: 0.1)")
+    args = parser.parse_args()
+
+    if args.atoms < 1000:
+        parser.error("the system must contain at least 1000 atoms")
+
+    os.makedirs(WORK_DIR, exist_ok=True)
+    stem = generate(args.atoms, args.frames)
+    sizes = group_sizes(args.atoms)
+
+    results = []
+    for name, arguments, distances in MODES:
+        if args.mode and not any(selected in name for selected in args.mode):
+            continue
+        result = run_mode(name, arguments, distances(sizes), stem, args.atoms, args.frames, args.repeat, args.threads)
+        results.append(result)
+        print(json.dumps(result))
+
+    with open(RESULTS, "w") as file:
+        json.dump(results, file, indent=2)
+
+    if args.save_baseline:
+        with open(BASELINE, "w") as file:
+            json.dump(results, file, indent=2)
+        print(f"\nBaseline written to {BASELINE}.", file=sys.stderr)
+        return 0
+
+    if not os.path.exists(BASELINE):
+        print("\nNo baseline found. Run 'make bench-baseline' to store one.", file=sys.stderr)
+        return 0
+
+    with open(BASELINE) as file:
+        n_slower = compare(results, json.load(file), args.tolerance)
+
+    if n_slower > 0:
+        print(f"\n{n_slower} mode(s) slower than the baseline by more than {args.tolerance * 100:.0f} %.", file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
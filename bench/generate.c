@@ -0,0 +1,169 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+/*
+ * Generator of synthetic systems for benchmarking posdist.
+ *
+ * Writes STEM.gro, STEM.xtc and STEM.ndx containing a box of three-atom residues
+ * with the density of liquid water. The residues are placed randomly and the atoms perform
+ * a random walk in the following frames, so the xtc file compresses like a real trajectory.
+ *
+ * Groups of the ndx file:
+ *   System   all atoms
+ *   Small    the first 100 atoms
+ *   Medium   the first 1000 atoms
+ *   Large    the first 10 % of the atoms
+ *   Tail     the last 10 % of the atoms
+ *
+ * Usage: generate STEM N_ATOMS N_FRAMES [SEED]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <groan.h>
+
+// number of atoms per nm^3 (liquid water)
+static const double DENSITY = 100.0;
+
+// largest distance of a hydrogen from its oxygen in each dimension in nm
+static const float BOND = 0.06f;
+
+// largest displacement of an atom between two frames in nm
+static const float STEP = 0.02f;
+
+// time between two frames in ps
+static const float DT = 10.0f;
+
+// precision of the xtc file
+static const float PRECISION = 1000.0f;
+
+static const char *ATOM_NAMES[3] = { "OW", "HW1", "HW2" };
+
+/*! @brief Returns pseudo-random number from [0, 1) (xorshift64*). */
+static double random_uniform(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return (double) ((*state * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+/*! @brief Writes ndx group containing atoms 'first' to 'last' (one-based, inclusive). */
+static void write_group(FILE *ndx, const char *name, const size_t first, const size_t last)
+{
+    fprintf(ndx, "[ %s ]\n", name);
+    for (size_t i = first; i <= last; ++i) {
+        fprintf(ndx, "%zu%c", i, (i - first) % 15 == 14 || i == last ? '\n' : ' ');
+    }
+}
+
+/*! @brief Opens file STEM.EXTENSION. Returns NULL, if the file could not be opened. */
+static FILE *open_file(const char *stem, const char *extension, char *filename, const size_t size)
+{
+    snprintf(filename, size, "%s.%s", stem, extension);
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) fprintf(stderr, "File %s could not be written.\n", filename);
+    return file;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 4 || argc > 5) {
+        fprintf(stderr, "Usage: %s STEM N_ATOMS N_FRAMES [SEED]\n", argv[0]);
+        return 1;
+    }
+
+    const char *stem = argv[1];
+    long n_atoms = strtol(argv[2], NULL, 10);
+    long n_frames = strtol(argv[3], NULL, 10);
+    uint64_t state = argc == 5 ? strtoull(argv[4], NULL, 10) : 42;
+    if (state == 0) state = 42;
+
+    if (n_atoms < 10 || n_atoms > 99999999 || n_frames < 1) {
+        fprintf(stderr, "Number of atoms must be between 10 and 99999999 and number of frames must be positive.\n");
+        return 1;
+    }
+
+    float box = (float) cbrt(n_atoms / DENSITY);
+    rvec *positions = malloc(n_atoms * sizeof(rvec));
+    if (positions == NULL) {
+        fprintf(stderr, "Could not allocate memory.\n");
+        return 1;
+    }
+
+    // hydrogens are placed next to the oxygen of their residue
+    for (long i = 0; i < n_atoms; ++i) {
+        for (int d = 0; d < 3; ++d) {
+            if (i % 3 == 0) {
+                positions[i][d] = (float) (random_uniform(&state) * box);
+            } else {
+                float position = positions[i - i % 3][d] + (float) ((2.0 * random_uniform(&state) - 1.0) * BOND);
+                positions[i][d] = position - box * floorf(position / box);
+            }
+        }
+    }
+
+    char filename[4096];
+
+    // gro file; atom and residue numbers wrap around as in gromacs
+    FILE *gro = open_file(stem, "gro", filename, sizeof(filename));
+    if (gro == NULL) {
+        free(positions);
+        return 1;
+    }
+    fprintf(gro, "Synthetic system for benchmarking posdist\n%ld\n", n_atoms);
+    for (long i = 0; i < n_atoms; ++i) {
+        fprintf(gro, "%5ld%-5s%5s%5ld%8.3f%8.3f%8.3f\n", (i / 3 + 1) % 100000, "SOL", ATOM_NAMES[i % 3], (i + 1) % 100000,
+                positions[i][0], positions[i][1], positions[i][2]);
+    }
+    fprintf(gro, "%10.5f%10.5f%10.5f\n", box, box, box);
+    fclose(gro);
+
+    // ndx file
+    FILE *ndx = open_file(stem, "ndx", filename, sizeof(filename));
+    if (ndx == NULL) {
+        free(positions);
+        return 1;
+    }
+    write_group(ndx, "System", 1, n_atoms);
+    write_group(ndx, "Small", 1, 100);
+    write_group(ndx, "Medium", 1, n_atoms < 1000 ? n_atoms : 1000);
+    write_group(ndx, "Large", 1, n_atoms / 10);
+    write_group(ndx, "Tail", n_atoms - n_atoms / 10 + 1, n_atoms);
+    fclose(ndx);
+
+    // xtc file
+    snprintf(filename, sizeof(filename), "%s.xtc", stem);
+    XDRFILE *xtc = xdrfile_open(filename, "w");
+    if (xtc == NULL) {
+        fprintf(stderr, "File %s could not be written.\n", filename);
+        free(positions);
+        return 1;
+    }
+
+    matrix box_matrix = {{box, 0.0f, 0.0f}, {0.0f, box, 0.0f}, {0.0f, 0.0f, box}};
+    int status = 0;
+    for (long frame = 0; frame < n_frames && status == 0; ++frame) {
+        if (frame > 0) {
+            for (long i = 0; i < n_atoms; ++i) {
+                for (int d = 0; d < 3; ++d) {
+                    float position = positions[i][d] + (float) ((2.0 * random_uniform(&state) - 1.0) * STEP);
+                    positions[i][d] = position - box * floorf(position / box);
+                }
+            }
+        }
+
+        status = write_xtc(xtc, (int) n_atoms, (int) frame * 5000, frame * DT, box_matrix, positions, PRECISION);
+    }
+    xdrfile_close(xtc);
+    free(positions);
+
+    if (status != 0) {
+        fprintf(stderr, "File %s could not be written.\n", filename);
+        return 1;
+    }
+
+    return 0;
+}
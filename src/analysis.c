@@ -0,0 +1,2220 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <sys/stat.h>
+#include "analysis.h"
+#include "compress.h"
+#include "hash.h"
+
+// initial number of pairs that can be stored for a single frame
+static const size_t INITIAL_PAIRS = 1024;
+
+// size of the stdio buffer of the text output file
+static const size_t OUTPUT_BUFFER_SIZE = 1 << 20;
+
+int unpack_dimensionality(const dimensionality_t dim, int *x, int *y, int *z)
+{
+    switch (dim) {
+    case dimensionality_xyz:
+        *x = 1; *y = 1; *z = 1;
+        break;
+    case dimensionality_xy:
+        *x = 1; *y = 1;
+        break;
+    case dimensionality_xz:
+        *x = 1; *z = 1;
+        break;
+    case dimensionality_yz:
+        *y = 1; *z = 1;
+        break;
+    case dimensionality_x:
+        *x = 1;
+        break;
+    case dimensionality_y:
+        *y = 1;
+        break;
+    case dimensionality_z:
+        *z = 1;
+        break;
+    default:
+        fprintf(stderr, "Internal unpack_dimensionality() error. Unknown dimensionality. This should never happen.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+int unpack_dimensionality_string(const dimensionality_t dim, char *string)
+{
+    switch (dim) {
+    case dimensionality_xyz:
+        strncpy(string, "xyz", 4);
+        break;
+    case dimensionality_xy:
+        strncpy(string, "xy", 3);
+        break;
+    case dimensionality_xz:
+        strncpy(string, "xz", 3);
+        break;
+    case dimensionality_yz:
+        strncpy(string, "yz", 3);
+        break;
+    case dimensionality_x:
+        strncpy(string, "x", 2);
+        break;
+    case dimensionality_y:
+        strncpy(string, "y", 2);
+        break;
+    case dimensionality_z:
+        strncpy(string, "z", 2);
+        break;
+    default:
+        fprintf(stderr, "Internal unpack_dimensionality_string() error. Unknown dimensionality. This should never happen.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/*! @brief Returns 1, if the values are binned into histograms. Else returns 0. */
+static int analysis_has_histogram(const analysis_t *analysis)
+{
+    return analysis->options.hist_width > 0.0f;
+}
+
+/*! @brief Returns 1, if the analysis writes an output file. Else returns 0. */
+static int analysis_has_output(const analysis_t *analysis)
+{
+    if (analysis->binary || analysis_has_histogram(analysis)) return 1;
+
+    switch (analysis->type) {
+    case analysis_center:
+    case analysis_centers_distance:
+    case analysis_min_distance:
+    case analysis_contacts:
+        return analysis->timewise;
+    default:
+        return 1;
+    }
+}
+
+/*! @brief Returns 1, if the analysis only considers pairs of atoms within the cutoff. Else returns 0. */
+static int analysis_has_cutoff(const analysis_t *analysis)
+{
+    return analysis->type == analysis_atoms_distance && analysis->options.cutoff > 0.0f;
+}
+
+/*! @brief Returns radius of the neighbour search performed by the analysis or zero, if no search is performed. */
+static float analysis_search_radius(const analysis_t *analysis)
+{
+    switch (analysis->type) {
+    case analysis_atoms_distance:
+    case analysis_min_distance:
+        return analysis->options.cutoff;
+    case analysis_contacts:
+        return analysis->options.contacts;
+    default:
+        return 0.0f;
+    }
+}
+
+/*! @brief Returns 1, if atoms of selection 1 are selected in every frame. Else returns 0. */
+static int analysis_is_dynamic(const analysis_t *analysis)
+{
+    return analysis->options.dynamic.type != dynamic_none;
+}
+
+/*! @brief Returns 1, if only the closest averaged pairs are written out. Else returns 0. */
+static int analysis_has_top(const analysis_t *analysis)
+{
+    return analysis->type == analysis_atoms_distance && !analysis->timewise && analysis->options.top > 0;
+}
+
+int analysis_writes_text(const analysis_t *analysis)
+{
+    return analysis->timewise && !analysis->binary && analysis->output_file != NULL;
+}
+
+int analysis_flush(analysis_t *analysis)
+{
+    // averaged results are only written once the analysis is finished
+    if (!analysis->timewise) return 0;
+
+    int status = 0;
+    if (analysis->output != NULL && fflush(analysis->output) != 0) status = 1;
+    if (analysis->data != NULL && npy_flush(analysis->data) != 0) status = 1;
+    if (analysis->times != NULL && npy_flush(analysis->times) != 0) status = 1;
+
+    return status;
+}
+
+/*! @brief Returns 1, if the values of the analysis contain all three coordinates which are filtered by the dimensionality. */
+static int analysis_has_coordinates(const analysis_t *analysis)
+{
+    return analysis->type == analysis_positions || analysis->type == analysis_center;
+}
+
+/*! @brief Returns description of the analysed items of selection 1 ('atoms', unless grouped). */
+static const char *analysis_items(const analysis_t *analysis)
+{
+    return groups_items(analysis->groups1 != NULL ? analysis->groups1->by : group_none);
+}
+
+/*! @brief Returns labels of the atoms (or groups) of selection 1 or, if 'second' is non-zero, of selection 2. */
+static inline const text_labels_t *analysis_labels(const analysis_t *analysis, const int second)
+{
+    const groups_t *groups = second ? analysis->groups2 : analysis->groups1;
+    if (groups != NULL) return &groups->labels;
+    return second ? &analysis->labels2 : &analysis->labels1;
+}
+
+/*
+ * Writes label of item 'i' of selection 1 or, if 'second' is non-zero, of selection 2,
+ * followed by a colon, if 'colon' is non-zero.
+ */
+static void write_label(FILE *output, const analysis_t *analysis, const int second, const size_t i, const int colon)
+{
+    const groups_t *groups = second ? analysis->groups2 : analysis->groups1;
+    if (groups != NULL) {
+        const text_labels_t *labels = &groups->labels;
+        // group labels end with a colon
+        fwrite(labels->data + labels->offsets[i], 1, labels->offsets[i + 1] - labels->offsets[i] - !colon, output);
+        return;
+    }
+
+    const atom_t *atom = (second ? analysis->selection2 : analysis->selection1)->atoms[i];
+    fprintf(output, "Atom %s (id: %d) of residue %s (resid: %d)%s", atom->atom_name, atom->atom_number,
+            atom->residue_name, atom->residue_number, colon ? ":" : "");
+}
+
+/*! @brief Returns 1, if the selections contain the same atoms in the same order. Else returns 0. */
+static int selections_identical(const atom_selection_t *selection1, const atom_selection_t *selection2)
+{
+    if (selection1 == NULL || selection2 == NULL || selection1->n_atoms != selection2->n_atoms) return 0;
+
+    for (size_t i = 0; i < selection1->n_atoms; ++i) {
+        if (selection1->atoms[i] != selection2->atoms[i]) return 0;
+    }
+
+    return 1;
+}
+
+/*! @brief Returns number of atoms forming atom 'i' of selection 1 (second = 0) or 2 (second = 1); a group with grouping. */
+static size_t unit_size(const analysis_t *analysis, const int second, const size_t i)
+{
+    const groups_t *groups = second ? analysis->groups2 : analysis->groups1;
+    return groups == NULL ? 1 : groups->start[i + 1] - groups->start[i];
+}
+
+/*! @brief Returns atom 'k' read from the trajectory that forms atom 'i' of selection 1 (second = 0) or 2 (second = 1). */
+static const atom_t *unit_atom(const analysis_t *analysis, const int second, const size_t i, const size_t k)
+{
+    const groups_t *groups = second ? analysis->groups2 : analysis->groups1;
+    const atom_selection_t *source = second ? analysis->source2 : analysis->source1;
+    return groups == NULL ? source->atoms[i] : source->atoms[groups->members[groups->start[i] + k]];
+}
+
+/*! @brief Returns 1, if atom 'i' of selection 1 and atom 'j' of selection 2 are formed by the same atoms. Else returns 0. */
+static int units_identical(const analysis_t *analysis, const size_t i, const size_t j)
+{
+    size_t n_atoms = unit_size(analysis, 0, i);
+    if (n_atoms != unit_size(analysis, 1, j)) return 0;
+
+    for (size_t k = 0; k < n_atoms; ++k) {
+        if (unit_atom(analysis, 0, i, k) != unit_atom(analysis, 1, j, k)) return 0;
+    }
+
+    return 1;
+}
+
+/*! @brief First atom of an atom (or group) of selection 2 used to find the atoms shared with selection 1. */
+typedef struct unit_key {
+    uintptr_t atom;
+    size_t index;
+} unit_key_t;
+
+/*! @brief Compares two keys by their first atom and by their index. */
+static int compare_unit_keys(const void *a, const void *b)
+{
+    const unit_key_t *key1 = a, *key2 = b;
+    if (key1->atom != key2->atom) return (key1->atom > key2->atom) - (key1->atom < key2->atom);
+    return (key1->index > key2->index) - (key1->index < key2->index);
+}
+
+/*
+ * Finds the atoms (or groups) of selection 1 that are also contained in selection 2 and stores
+ * their indices in selection 2 in 'shared'. Returns zero, if successful. Else returns non-zero.
+ */
+static int find_shared(analysis_t *analysis)
+{
+    const size_t n_atoms1 = analysis->selection1->n_atoms;
+    const size_t n_atoms2 = analysis->selection2->n_atoms;
+
+    analysis->shared = malloc(n_atoms1 * sizeof(size_t));
+    if (analysis->shared == NULL) return 1;
+
+    if (analysis->self) {
+        for (size_t i = 0; i < n_atoms1; ++i) analysis->shared[i] = i;
+        return 0;
+    }
+
+    unit_key_t *keys = malloc(n_atoms2 * sizeof(unit_key_t));
+    if (keys == NULL) return 1;
+
+    for (size_t j = 0; j < n_atoms2; ++j) {
+        keys[j].atom = (uintptr_t) unit_atom(analysis, 1, j, 0);
+        keys[j].index = j;
+    }
+    qsort(keys, n_atoms2, sizeof(unit_key_t), compare_unit_keys);
+
+    for (size_t i = 0; i < n_atoms1; ++i) {
+        uintptr_t atom = (uintptr_t) unit_atom(analysis, 0, i, 0);
+        analysis->shared[i] = SIZE_MAX;
+
+        // first key with the same atom
+        size_t low = 0, high = n_atoms2;
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            if (keys[mid].atom < atom) low = mid + 1;
+            else high = mid;
+        }
+
+        for (size_t k = low; k < n_atoms2 && keys[k].atom == atom; ++k) {
+            if (units_identical(analysis, i, keys[k].index)) {
+                analysis->shared[i] = keys[k].index;
+                break;
+            }
+        }
+    }
+
+    free(keys);
+    return 0;
+}
+
+/*! @brief Returns 1, if atom 'i' of selection 1 and atom 'j' of selection 2 are the same atom (or group) of a reduction. Else returns 0. */
+static int pair_shared(const analysis_t *analysis, const size_t i, const size_t j)
+{
+    return analysis->shared != NULL && analysis->shared[i] == j;
+}
+
+/*! @brief Returns index of pair i < j in the upper triangle of a matrix of 'n' x 'n' pairs. */
+static size_t triangle_index(const size_t n, const size_t i, const size_t j)
+{
+    return i * (2 * n - i - 1) / 2 + (j - i - 1);
+}
+
+/*! @brief Returns 1, if the pair (i, j) is written out. Else returns 0. */
+static int pair_written(const analysis_t *analysis, const size_t i, const size_t j)
+{
+    return !analysis->self || !analysis->options.triangle || i < j;
+}
+
+/*
+ * Finds index of the value of the pair of atoms (i, j) of an all-pairs analysis.
+ * For identical selections, only the upper triangle is stored and the other pairs are mirrored;
+ * 'mirrored' is set, if the stored oriented distance has the opposite sign.
+ * Returns 0 for the distance of an atom from itself, which is not stored. Else returns 1.
+ */
+static int pair_index(const analysis_t *analysis, const size_t i, const size_t j, size_t *index, int *mirrored)
+{
+    const size_t n_atoms2 = analysis->selection2->n_atoms;
+    *mirrored = 0;
+
+    if (!analysis->self) {
+        *index = i * n_atoms2 + j;
+        return 1;
+    }
+
+    if (i == j) return 0;
+    if (i < j) {
+        *index = triangle_index(n_atoms2, i, j);
+        return 1;
+    }
+
+    *index = triangle_index(n_atoms2, j, i);
+    *mirrored = analysis->x + analysis->y + analysis->z == 1;
+    return 1;
+}
+
+/*! @brief Returns value of the pair of atoms (i, j) from 'values' of an all-pairs analysis. */
+static float pair_value(const analysis_t *analysis, const float *values, const size_t i, const size_t j)
+{
+    size_t index = 0;
+    int mirrored = 0;
+    if (!pair_index(analysis, i, j, &index, &mirrored)) return 0.0f;
+
+    // oriented distance changes its sign; unlike negation, subtraction from zero never produces negative zero
+    return mirrored ? 0.0f - values[index] : values[index];
+}
+
+/*! @brief Returns average of 'n' values accumulated in 'sum', rounded to float in the same way as the averages of tiles. */
+static float sum_average(const double sum, const size_t n)
+{
+    return (float) (sum / n);
+}
+
+/*! @brief Returns average value of the pair of atoms (i, j) of an averaged all-pairs analysis. */
+static float pair_average(const analysis_t *analysis, const size_t i, const size_t j)
+{
+    if (analysis->tiles != NULL) return pair_value(analysis, analysis->tiles->averages, i, j);
+
+    size_t index = 0;
+    int mirrored = 0;
+    if (!pair_index(analysis, i, j, &index, &mirrored)) return 0.0f;
+
+    float average = sum_average(analysis->sum[index], analysis->n_steps);
+    return mirrored ? 0.0f - average : average;
+}
+
+/*! @brief Returns statistic 'column' of the value with 'index', optionally mirrored (see pair_index). */
+static float value_stat(const analysis_t *analysis, const int column, const size_t index, const int mirrored)
+{
+    const stats_t *stats = analysis->stats;
+
+    switch (column) {
+    case stats_std:
+        return (float) stats_deviation(stats, index);
+    case stats_min:
+        return mirrored ? 0.0f - stats->max[index] : stats->min[index];
+    case stats_max:
+        return mirrored ? 0.0f - stats->min[index] : stats->max[index];
+    default:
+        return (float) stats_error(stats, index);
+    }
+}
+
+/*! @brief Statistics in the order in which they are written out. */
+static const int STATS_COLUMNS[] = { stats_std, stats_min, stats_max, stats_err };
+static const char *STATS_NAMES[] = { "std", "min", "max", "err" };
+static const size_t N_STATS_COLUMNS = 4;
+
+/*
+ * Writes the requested statistics of the value with 'index' (see value_stat).
+ * If 'stored' is zero, the value is not stored and all its statistics are zero.
+ */
+static void write_stats(FILE *output, const analysis_t *analysis, const int stored, const size_t index, const int mirrored)
+{
+    if (analysis->stats == NULL) return;
+
+    const char *separator = " [";
+    for (size_t c = 0; c < N_STATS_COLUMNS; ++c) {
+        if (!(analysis->options.stats & STATS_COLUMNS[c])) continue;
+
+        fprintf(output, "%s%s = %.3f", separator, STATS_NAMES[c], stored ? value_stat(analysis, STATS_COLUMNS[c], index, mirrored) : 0.0f);
+        separator = ", ";
+    }
+    fprintf(output, "]");
+}
+
+/*! @brief Writes the requested statistics of the pair of atoms (i, j) of an all-pairs analysis. */
+static void write_pair_stats(FILE *output, const analysis_t *analysis, const size_t i, const size_t j)
+{
+    size_t index = 0;
+    int mirrored = 0;
+    int stored = pair_index(analysis, i, j, &index, &mirrored);
+    write_stats(output, analysis, stored, index, mirrored);
+}
+
+/*! @brief Copies values that are written out into 'columns'. */
+static void select_columns(const analysis_t *analysis, const float *values, float *columns)
+{
+    if (analysis->self && analysis->type == analysis_atoms_distance && !analysis->options.triangle) {
+        const size_t n_atoms = analysis->selection1->n_atoms;
+        for (size_t i = 0; i < n_atoms; ++i) {
+            for (size_t j = 0; j < n_atoms; ++j) columns[i * n_atoms + j] = pair_value(analysis, values, i, j);
+        }
+        return;
+    }
+
+    if (!analysis_has_coordinates(analysis)) {
+        memcpy(columns, values, analysis->n_values * sizeof(float));
+        return;
+    }
+
+    const int use[3] = { analysis->x, analysis->y, analysis->z };
+    size_t n = 0;
+    for (size_t i = 0; i < analysis->n_values; ++i) {
+        if (use[i % 3]) columns[n++] = values[i];
+    }
+}
+
+/*! @brief Copies statistic 'column' of the values that are written out into 'columns'. */
+static void select_stat_columns(const analysis_t *analysis, const int column, float *columns)
+{
+    if (analysis->self && analysis->type == analysis_atoms_distance && !analysis->options.triangle) {
+        const size_t n_atoms = analysis->selection1->n_atoms;
+        for (size_t i = 0; i < n_atoms; ++i) {
+            for (size_t j = 0; j < n_atoms; ++j) {
+                size_t index = 0;
+                int mirrored = 0;
+                int stored = pair_index(analysis, i, j, &index, &mirrored);
+                columns[i * n_atoms + j] = stored ? value_stat(analysis, column, index, mirrored) : 0.0f;
+            }
+        }
+        return;
+    }
+
+    const int use[3] = { analysis->x, analysis->y, analysis->z };
+    size_t n = 0;
+    for (size_t i = 0; i < analysis->n_values; ++i) {
+        if (analysis_has_coordinates(analysis) && !use[i % 3]) continue;
+        columns[n++] = value_stat(analysis, column, i, 0);
+    }
+}
+
+/*! @brief Writes description of the columns of the binary output. Returns zero, if successful, else returns non-zero. */
+static int write_column_description(const analysis_t *analysis)
+{
+    char *filename = npy_companion(analysis->output_file, "columns");
+    if (filename == NULL) return 1;
+
+    npy_file_t *npy = npy_open(filename, npy_int32, 3);
+    if (npy == NULL) {
+        fprintf(stderr, "Could not open output file '%s'\n", filename);
+        free(filename);
+        return 1;
+    }
+    free(filename);
+
+    const int use[3] = { analysis->x, analysis->y, analysis->z };
+    const int32_t mask = analysis->x | (analysis->y << 1) | (analysis->z << 2);
+    int32_t column[3] = {0};
+    int status = 0;
+
+    switch (analysis->type) {
+    case analysis_positions:
+    case analysis_center:
+        for (size_t i = 0; i < analysis->n_values; ++i) {
+            if (!use[i % 3]) continue;
+            column[0] = analysis->type == analysis_positions ? analysis->selection1->atoms[i / 3]->atom_number : 0;
+            column[2] = 1 << (i % 3);
+            status |= npy_write(npy, column, 3);
+        }
+        break;
+    case analysis_centers_distance:
+    case analysis_min_distance:
+    case analysis_contacts:
+        column[2] = mask;
+        status |= npy_write(npy, column, 3);
+        break;
+    case analysis_reference_distance:
+        column[2] = mask;
+        for (size_t i = 0; i < analysis->selection1->n_atoms; ++i) {
+            column[0] = analysis->selection1->atoms[i]->atom_number;
+            status |= npy_write(npy, column, 3);
+        }
+        break;
+    case analysis_atoms_distance:
+        column[2] = mask;
+        for (size_t i = 0; i < analysis->selection1->n_atoms; ++i) {
+            column[0] = analysis->selection1->atoms[i]->atom_number;
+            for (size_t j = 0; j < analysis->selection2->n_atoms; ++j) {
+                if (!pair_written(analysis, i, j)) continue;
+                column[1] = analysis->selection2->atoms[j]->atom_number;
+                status |= npy_write(npy, column, 3);
+            }
+        }
+        break;
+    }
+
+    if (npy_close(npy) != 0) status = 1;
+    if (status != 0) fprintf(stderr, "Could not write the description of the columns of output file '%s'\n", analysis->output_file);
+    return status;
+}
+
+/*! @brief Opens binary output of the analysis. Returns zero, if successful, else returns non-zero. */
+static int open_binary_output(analysis_t *analysis)
+{
+    // averages of tiled analyses are written out one atom of selection 1 at a time
+    size_t n_columns = analysis->tiles != NULL ? analysis->selection2->n_atoms : analysis->n_columns;
+    analysis->columns = malloc(n_columns * sizeof(float));
+    if (analysis->columns == NULL) {
+        fprintf(stderr, "Could not allocate memory for the analysis.\n");
+        return 1;
+    }
+
+    int rows = analysis->timewise || analysis->stats != NULL;
+    analysis->data = npy_open(analysis->output_file, npy_float32, rows ? analysis->n_columns : 0);
+    if (analysis->data == NULL) {
+        fprintf(stderr, "Could not open output file '%s'\n", analysis->output_file);
+        return 1;
+    }
+
+    if (analysis->timewise) {
+        char *filename = npy_companion(analysis->output_file, "times");
+        if (filename == NULL) return 1;
+
+        analysis->times = npy_open(filename, npy_float32, 0);
+        if (analysis->times == NULL) {
+            fprintf(stderr, "Could not open output file '%s'\n", filename);
+            free(filename);
+            return 1;
+        }
+        free(filename);
+    }
+
+    return write_column_description(analysis);
+}
+
+/*! @brief Formats labels of the atoms written out by the timewise analysis. Returns zero, if successful, else returns non-zero. */
+static int create_labels(analysis_t *analysis)
+{
+    // groups have their own labels
+    switch (analysis->type) {
+    case analysis_atoms_distance:
+        if (analysis->groups2 == NULL && text_labels_create(&analysis->labels2, analysis->selection2) != 0) return 1;
+        // fall through
+    case analysis_positions:
+    case analysis_reference_distance:
+        if (analysis->groups1 != NULL) return 0;
+        return text_labels_create(&analysis->labels1, analysis->selection1);
+    default:
+        return 0;
+    }
+}
+
+/*! @brief Writes description of the histogram into the output file. */
+static void write_histogram_header(const analysis_t *analysis)
+{
+    FILE *output = analysis->output;
+    const char *query1 = analysis->selection1_query, *query2 = analysis->selection2_query;
+    const char *dimensions = analysis->dimensions;
+    const char *items = analysis_items(analysis);
+
+    switch (analysis->type) {
+    case analysis_positions:
+        fprintf(output, "Histogram of positions of %s of selection '%s'.\n", items, query1);
+        break;
+    case analysis_center:
+        fprintf(output, "Histogram of center of geometry of selection '%s'.\n", query1);
+        break;
+    case analysis_centers_distance:
+        fprintf(output, "Histogram of %s-distances between the centers of selections '%s' and '%s'.\n", dimensions, query1, query2);
+        break;
+    case analysis_reference_distance:
+        fprintf(output, "Histogram of %s-distances between the %s of selection '%s' and center of selection '%s'.\n", dimensions, items, query1, query2);
+        break;
+    case analysis_atoms_distance:
+        if (analysis_has_cutoff(analysis)) {
+            fprintf(output, "Histogram of %s-distances between the %s of selections '%s' and '%s' within %.3f nm.\n",
+                    dimensions, items, query1, query2, analysis->options.cutoff);
+        } else {
+            fprintf(output, "Histogram of %s-distances between the %s of selections '%s' and '%s'.\n", dimensions, items, query1, query2);
+        }
+        break;
+    case analysis_min_distance:
+        fprintf(output, "Histogram of minimum %s-distance between the %s of selections '%s' and '%s'.\n", dimensions, items, query1, query2);
+        break;
+    case analysis_contacts:
+        fprintf(output, "Histogram of number of contacts (%s-distance <= %.3f nm) between the %s of selections '%s' and '%s'.\n",
+                dimensions, analysis->options.contacts, items, query1, query2);
+        break;
+    }
+}
+
+/*
+ * Divides the selections of the analysis into groups and replaces the selections with the descriptions of the groups.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+static int create_groups(analysis_t *analysis)
+{
+    const analysis_options_t *options = &analysis->options;
+
+    if (analysis->type == analysis_center || analysis->type == analysis_centers_distance) {
+        fprintf(stderr, "Centers of groups cannot be combined with the center of the whole selection.\n");
+        return 1;
+    }
+
+    if (options->group == group_ndx && options->ndx == NULL) {
+        fprintf(stderr, "Internal create_groups() error. Groups of the ndx file are not available. This should never happen.\n");
+        return 1;
+    }
+
+    analysis->groups1 = groups_create(analysis->source1, options->group, options->ndx);
+    if (analysis->groups1 == NULL) {
+        fprintf(stderr, "Could not allocate memory for the groups.\n");
+        return 1;
+    }
+
+    if (analysis->groups1->n_groups == 0) {
+        fprintf(stderr, "No group of the ndx file contains atoms of selection '%s'.\n", analysis->selection1_query);
+        return 1;
+    }
+    analysis->selection1 = analysis->groups1->description;
+
+    // the reference selection is never grouped
+    if (analysis->source2 == NULL || analysis->type == analysis_reference_distance) return 0;
+
+    if (selections_identical(analysis->source1, analysis->source2)) {
+        analysis->groups2 = analysis->groups1;
+    } else {
+        analysis->groups2 = groups_create(analysis->source2, options->group, options->ndx);
+        if (analysis->groups2 == NULL) {
+            fprintf(stderr, "Could not allocate memory for the groups.\n");
+            return 1;
+        }
+
+        if (analysis->groups2->n_groups == 0) {
+            fprintf(stderr, "No group of the ndx file contains atoms of selection '%s'.\n", analysis->selection2_query);
+            return 1;
+        }
+    }
+    analysis->selection2 = analysis->groups2->description;
+
+    return 0;
+}
+
+/*! @brief Performs analysis_init. Memory allocated by the analysis is not released on failure. */
+static int analysis_setup(
+        analysis_t *analysis,
+        const analysis_type_t type,
+        const atom_selection_t *selection1,
+        const atom_selection_t *selection2,
+        const char *selection1_query,
+        const char *selection2_query,
+        const int timewise,
+        const dimensionality_t dim,
+        const char *output_file,
+        const analysis_options_t *options)
+{
+    analysis->type = type;
+    analysis->selection1 = selection1;
+    analysis->selection2 = selection2;
+    analysis->source1 = selection1;
+    analysis->source2 = selection2;
+    analysis->selection1_query = selection1_query;
+    analysis->selection2_query = selection2_query;
+    analysis->timewise = timewise;
+    analysis->dim = dim;
+    analysis->output_file = output_file;
+    analysis->binary = output_file != NULL && npy_is_npy(output_file);
+    analysis->options = options != NULL ? *options : ANALYSIS_OPTIONS_DEFAULT;
+
+    if (analysis->options.group != group_none) {
+        if (create_groups(analysis) != 0) return 1;
+
+        // the rest of the analysis only works with the centers of the groups
+        selection1 = analysis->selection1;
+        selection2 = analysis->selection2;
+    }
+
+    analysis->self = selections_identical(selection1, selection2) && selection1->n_atoms > 1;
+
+    if (analysis->options.triangle && !analysis->self) {
+        fprintf(stderr, "Pairs i < j can only be selected for two identical selections containing more than one atom.\n");
+        return 1;
+    }
+
+    if (analysis_has_cutoff(analysis) && analysis->binary) {
+        fprintf(stderr, "Binary output is not supported for distances calculated with a cutoff.\n");
+        return 1;
+    }
+
+    if (analysis_has_top(analysis) && analysis->binary) {
+        fprintf(stderr, "Binary output is not supported for the closest pairs of atoms.\n");
+        return 1;
+    }
+
+    if (analysis->options.stats && (analysis_has_cutoff(analysis) || analysis_has_top(analysis))) {
+        fprintf(stderr, "Statistics are not supported for distances calculated with a cutoff or for the closest pairs of atoms.\n");
+        return 1;
+    }
+
+    if (analysis_has_histogram(analysis) && (timewise || analysis->binary || analysis_has_top(analysis) || analysis->options.stats)) {
+        fprintf(stderr, "Histograms cannot be combined with timewise or binary output, the closest pairs of atoms or statistics.\n");
+        return 1;
+    }
+
+    if (analysis->options.memory > 0 && (type != analysis_atoms_distance || timewise || analysis_has_cutoff(analysis) ||
+        analysis_has_histogram(analysis) || analysis->options.stats)) {
+        fprintf(stderr, "Memory budget can only be used for distances between all pairs of atoms averaged without a cutoff, statistics or histogram.\n");
+        return 1;
+    }
+
+    if (analysis->options.partial && (timewise || analysis->options.memory > 0)) {
+        fprintf(stderr, "Partial results can only be saved for averaged analyses without a memory budget.\n");
+        return 1;
+    }
+
+    if (analysis_is_dynamic(analysis) && type != analysis_positions && type != analysis_center && type != analysis_reference_distance) {
+        fprintf(stderr, "Dynamic selection can only be used for positions, the center of a selection or distances to a reference.\n");
+        return 1;
+    }
+
+    if (analysis_is_dynamic(analysis) && (analysis->options.stats || analysis_has_histogram(analysis) || analysis->options.partial)) {
+        fprintf(stderr, "Dynamic selection cannot be combined with statistics, histograms or partial results.\n");
+        return 1;
+    }
+
+    if (unpack_dimensionality(dim, &analysis->x, &analysis->y, &analysis->z) != 0) return 1;
+    if (unpack_dimensionality_string(dim, analysis->dimensions) != 0) return 1;
+
+    switch (type) {
+    case analysis_positions:
+        analysis->n_values = 3 * selection1->n_atoms;
+        break;
+    case analysis_center:
+        analysis->n_values = 3;
+        break;
+    case analysis_centers_distance:
+    case analysis_min_distance:
+    case analysis_contacts:
+        analysis->n_values = 1;
+        break;
+    case analysis_reference_distance:
+        analysis->n_values = selection1->n_atoms;
+        break;
+    case analysis_atoms_distance:
+        // pairs within the cutoff are not stored as values
+        if (analysis_has_cutoff(analysis)) break;
+        if (analysis->self) analysis->n_values = selection1->n_atoms * (selection1->n_atoms - 1) / 2;
+        else analysis->n_values = selection1->n_atoms * selection2->n_atoms;
+        break;
+    }
+
+    if (analysis_has_histogram(analysis)) {
+        // values are binned instead of being summed up
+        analysis->n_histograms = analysis_has_coordinates(analysis) ? 3 : 1;
+        analysis->histograms = calloc(analysis->n_histograms, sizeof(histogram_t));
+        if (analysis->histograms == NULL) {
+            fprintf(stderr, "Could not allocate memory for the histogram.\n");
+            return 1;
+        }
+
+        for (size_t h = 0; h < analysis->n_histograms; ++h) {
+            if (histogram_init(&analysis->histograms[h], analysis->options.hist_min, analysis->options.hist_max, analysis->options.hist_width) != 0) {
+                fprintf(stderr, "Could not create histogram from %f to %f with bin width %f.\n",
+                        analysis->options.hist_min, analysis->options.hist_max, analysis->options.hist_width);
+                return 1;
+            }
+        }
+    } else if (!timewise && analysis_has_cutoff(analysis)) {
+        analysis->pairs = pair_map_create();
+        if (analysis->pairs == NULL) {
+            fprintf(stderr, "Could not allocate memory for the analysis.\n");
+            return 1;
+        }
+    } else if (!timewise && analysis->options.memory > 0) {
+        // tiles are planned once the number of frame buffers is known (see analysis_plan)
+        analysis->tiles = tiles_create(selection1->n_atoms, selection2->n_atoms, analysis->self);
+        if (analysis->tiles == NULL) {
+            fprintf(stderr, "Could not allocate memory for the analysis.\n");
+            return 1;
+        }
+    } else if (!timewise) {
+        analysis->sum = calloc(analysis->n_values, sizeof(double));
+        if (analysis->sum == NULL) {
+            fprintf(stderr, "Could not allocate memory for the analysis.\n");
+            return 1;
+        }
+    }
+
+    if (analysis_is_dynamic(analysis)) {
+        analysis->selected_min = SIZE_MAX;
+
+        // averages of every atom only include the frames in which the atom was selected
+        if (!timewise) {
+            analysis->selected_frames = calloc(type == analysis_center ? 1 : selection1->n_atoms, sizeof(size_t));
+            if (analysis->selected_frames == NULL) {
+                fprintf(stderr, "Could not allocate memory for the analysis.\n");
+                return 1;
+            }
+        }
+    }
+
+    if (!timewise && analysis->options.stats) {
+        analysis->stats = stats_create(analysis->n_values);
+        if (analysis->stats == NULL) {
+            fprintf(stderr, "Could not allocate memory for the statistics.\n");
+            return 1;
+        }
+    }
+
+    analysis->n_columns = analysis->n_values;
+    if (analysis->self && type == analysis_atoms_distance && !analysis->options.triangle) {
+        analysis->n_columns = selection1->n_atoms * selection1->n_atoms;
+    }
+    if (analysis_has_coordinates(analysis)) {
+        analysis->n_columns = (analysis->n_values / 3) * (analysis->x + analysis->y + analysis->z);
+    }
+
+    // an atom contained in both selections is never paired with itself
+    if (type == analysis_min_distance || type == analysis_contacts || analysis_has_top(analysis)) {
+        if (find_shared(analysis) != 0) {
+            fprintf(stderr, "Could not allocate memory for the analysis.\n");
+            return 1;
+        }
+
+        if (selection1->n_atoms == 1 && selection2->n_atoms == 1 && analysis->shared[0] == 0) {
+            fprintf(stderr, "Selections '%s' and '%s' contain no pair of distinct %s.\n", selection1_query, selection2_query, analysis_items(analysis));
+            return 1;
+        }
+    }
+
+    if (!analysis_has_output(analysis) || analysis->options.partial || output_file == NULL) return 0;
+
+    if (analysis->binary) return open_binary_output(analysis);
+
+    analysis->output = output_open(output_file);
+    if (analysis->output == NULL) return 1;
+
+    FILE *output = analysis->output;
+    const char *items = analysis_items(analysis);
+    setvbuf(output, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+
+    if (analysis_has_histogram(analysis)) {
+        write_histogram_header(analysis);
+        return 0;
+    }
+
+    if (analysis_writes_text(analysis) && create_labels(analysis) != 0) {
+        fprintf(stderr, "Could not allocate memory for the analysis.\n");
+        return 1;
+    }
+
+    switch (type) {
+    case analysis_positions:
+        if (timewise) fprintf(output, "Positions of %s of selection '%s' in time. \n", items, selection1_query);
+        else fprintf(output, "Average positions of %s of selection '%s'. \n", items, selection1_query);
+        break;
+    case analysis_center:
+        fprintf(output, "Center of geometry of selection '%s' in time. \n", selection1_query);
+        break;
+    case analysis_centers_distance:
+        fprintf(output, "%s-distances between the centers of selections '%s' and '%s' in time.\n", analysis->dimensions, selection1_query, selection2_query);
+        break;
+    case analysis_reference_distance:
+        if (timewise) {
+            fprintf(output, "%s-distances between the %s of selection '%s' and center of selection '%s' in time.\n", analysis->dimensions, items, selection1_query, selection2_query);
+        } else {
+            fprintf(output, "Average %s-distances between the %s of selection '%s' and center of selection '%s'.\n", analysis->dimensions, items, selection1_query, selection2_query);
+        }
+        break;
+    case analysis_atoms_distance:
+        if (analysis_has_top(analysis)) {
+            fprintf(output, "%zu closest pairs of %s of selections '%s' and '%s' by average %s-distance", analysis->options.top,
+                    items, selection1_query, selection2_query, analysis->dimensions);
+            if (analysis_has_cutoff(analysis)) fprintf(output, " within %.3f nm", analysis->options.cutoff);
+            fprintf(output, ".\n");
+        } else if (analysis_has_cutoff(analysis) && timewise) {
+            fprintf(output, "%s-distances between the %s of selections '%s' and '%s' within %.3f nm in time.\n",
+                    analysis->dimensions, items, selection1_query, selection2_query, analysis->options.cutoff);
+        } else if (analysis_has_cutoff(analysis)) {
+            fprintf(output, "Average %s-distances between the %s of selections '%s' and '%s' within %.3f nm.\n",
+                    analysis->dimensions, items, selection1_query, selection2_query, analysis->options.cutoff);
+        } else if (timewise) {
+            fprintf(output, "%s-distances between the %s of selections '%s' and '%s' in time.\n", analysis->dimensions, items, selection1_query, selection2_query);
+        } else {
+            fprintf(output, "Average %s-distances between the %s of selections '%s' and '%s'.\n", analysis->dimensions, items, selection1_query, selection2_query);
+        }
+        break;
+    case analysis_min_distance:
+        fprintf(output, "Minimum %s-distance between the %s of selections '%s' and '%s' in time.\n", analysis->dimensions, items, selection1_query, selection2_query);
+        break;
+    case analysis_contacts:
+        fprintf(output, "Number of contacts (%s-distance <= %.3f nm) between the %s of selections '%s' and '%s' in time.\n",
+                analysis->dimensions, analysis->options.contacts, items, selection1_query, selection2_query);
+        break;
+    }
+
+    if (analysis_is_dynamic(analysis)) {
+        char condition[256] = "";
+        dynamic_describe(&analysis->options.dynamic, condition, sizeof(condition));
+        fprintf(output, "Dynamic selection of %s: %s.\n", items, condition);
+    }
+
+    return 0;
+}
+
+int analysis_init(
+        analysis_t *analysis,
+        const analysis_type_t type,
+        const atom_selection_t *selection1,
+        const atom_selection_t *selection2,
+        const char *selection1_query,
+        const char *selection2_query,
+        const int timewise,
+        const dimensionality_t dim,
+        const char *output_file,
+        const analysis_options_t *options)
+{
+    memset(analysis, 0, sizeof(analysis_t));
+
+    if (analysis_setup(analysis, type, selection1, selection2, selection1_query, selection2_query, timewise, dim, output_file, options) != 0) {
+        analysis_destroy(analysis);
+        return 1;
+    }
+
+    return 0;
+}
+
+int analysis_plan(analysis_t *analysis, const size_t n_buffers)
+{
+    tiles_t *tiles = analysis->tiles;
+    if (tiles == NULL) return 0;
+
+    // every value of a tile is summed up in double precision and calculated into a float of every frame buffer
+    const size_t value_size = sizeof(double) + n_buffers * sizeof(float);
+    const size_t row_size = (tiles->row_start[1] - tiles->row_start[0]) * value_size;
+    if (row_size > analysis->options.memory) {
+        fprintf(stderr, "Memory budget of %.3f MB is too small. Distances of a single atom of selection '%s' require %.3f MB.\n",
+                analysis->options.memory / 1048576.0, analysis->selection1_query, row_size / 1048576.0);
+        return 1;
+    }
+
+    if (tiles_plan(tiles, analysis->options.memory, value_size) != 0) {
+        fprintf(stderr, "Could not allocate memory for the analysis.\n");
+        return 1;
+    }
+
+    if (tiles->n_tiles > 1) {
+        const char *items = analysis_items(analysis);
+        printf("Pairs of %s of selections '%s' and '%s' do not fit into the memory budget and are averaged in %zu passes through the trajectory.\n",
+                items, analysis->selection1_query, analysis->selection2_query, tiles->n_tiles);
+    }
+
+    return 0;
+}
+
+int analysis_end_pass(analysis_t *analysis, int *repeat)
+{
+    *repeat = 0;
+    if (analysis->idle) return 0;
+
+    analysis->idle = 1;
+    if (analysis->tiles == NULL) return 0;
+
+    if (tiles_next(analysis->tiles, analysis->n_steps, repeat) != 0) return 1;
+
+    if (*repeat) {
+        // the next tile is accumulated from all frames again
+        analysis->idle = 0;
+        analysis->n_steps = 0;
+    }
+
+    return 0;
+}
+
+/*
+ * Allocates selection of copies of the pseudo-atoms describing the groups, stored in the same block of memory.
+ * Returns NULL, if memory could not be allocated.
+ */
+static atom_selection_t *centers_create(const groups_t *groups)
+{
+    const size_t n_groups = groups->n_groups;
+    // pointers are followed by the atoms, padded to the alignment of double
+    size_t header = sizeof(atom_selection_t) + n_groups * sizeof(atom_t *);
+    header = (header + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+
+    atom_selection_t *centers = malloc(header + n_groups * sizeof(atom_t));
+    if (centers == NULL) return NULL;
+
+    atom_t *atoms = (atom_t *) ((char *) centers + header);
+    memcpy(atoms, groups->atoms, n_groups * sizeof(atom_t));
+
+    centers->n_atoms = n_groups;
+    for (size_t g = 0; g < n_groups; ++g) centers->atoms[g] = &atoms[g];
+
+    return centers;
+}
+
+int frame_values_init(frame_values_t *values, const analysis_t *analysis)
+{
+    memset(values, 0, sizeof(frame_values_t));
+    text_init(&values->text);
+    grid_init(&values->grid);
+    coordinates_init(&values->coordinates);
+
+    if (analysis->type == analysis_min_distance) {
+        values->row = malloc(analysis->selection2->n_atoms * sizeof(float));
+        if (values->row == NULL) return 1;
+    }
+
+    // centers of the groups are calculated into private copies of the pseudo-atoms
+    if (analysis->groups1 != NULL) {
+        int shared = analysis->groups2 == NULL || analysis->groups2 == analysis->groups1;
+        values->centers1 = centers_create(analysis->groups1);
+        values->centers2 = shared ? NULL : centers_create(analysis->groups2);
+        if (values->centers1 == NULL || (!shared && values->centers2 == NULL)) return 1;
+        if (analysis->groups2 != NULL && shared) values->centers2 = values->centers1;
+    }
+
+    if (analysis_is_dynamic(analysis) && dynamic_frame_init(&values->dynamic, &analysis->options.dynamic, analysis->selection1->n_atoms) != 0) return 1;
+
+    // tiled analyses only calculate values of the current tile
+    size_t n_values = analysis->tiles != NULL ? analysis->tiles->max_values : analysis->n_values;
+    if (n_values > 0) {
+        values->values = malloc(n_values * sizeof(float));
+        if (values->values == NULL) return 1;
+    }
+
+    if (analysis_search_radius(analysis) > 0.0f) {
+        values->pairs = malloc(INITIAL_PAIRS * sizeof(pair_distance_t));
+        if (values->pairs == NULL) return 1;
+        values->capacity = INITIAL_PAIRS;
+    }
+
+    return 0;
+}
+
+void frame_values_destroy(frame_values_t *values)
+{
+    if (values->centers2 != values->centers1) free(values->centers2);
+    free(values->centers1);
+    free(values->values);
+    free(values->pairs);
+    free(values->row);
+    dynamic_frame_destroy(&values->dynamic);
+    text_destroy(&values->text);
+    grid_destroy(&values->grid);
+    coordinates_destroy(&values->coordinates);
+    memset(values, 0, sizeof(frame_values_t));
+}
+
+/*! @brief Returns non-zero and reports an error, if the text of the frame could not be stored. */
+static int text_failed(const text_buffer_t *output)
+{
+    if (output == NULL || !output->failed) return 0;
+
+    fprintf(stderr, "Could not allocate memory for the output.\n");
+    return 1;
+}
+
+/*! @brief Writes 't = TIME' followed by 'suffix'. */
+static inline void write_time(text_buffer_t *output, const float time, const char *suffix)
+{
+    text_append(output, "t = ", 4);
+    text_append_fixed(output, time, 6);
+    text_append_string(output, suffix);
+}
+
+/*! @brief Writes 't = TIME    d = DISTANCE' line. */
+static inline void write_time_distance(text_buffer_t *output, const float time, const float distance)
+{
+    write_time(output, time, "    d = ");
+    text_append_fixed(output, distance, 6);
+    text_append(output, "\n", 1);
+}
+
+/*! @brief Writes 't = TIME' followed by the size of the dynamic selection ('dynamic' may be NULL) and a newline. */
+static inline void write_selection_time(text_buffer_t *output, const float time, const dynamic_frame_t *dynamic)
+{
+    if (dynamic == NULL) {
+        write_time(output, time, "\n");
+        return;
+    }
+
+    write_time(output, time, "    n = ");
+    text_append_size(output, dynamic->n_selected);
+    text_append(output, "\n", 1);
+}
+
+/*
+ * Returns 1, if item 'i' is selected in the frame, else returns 0. Items must be queried in ascending order,
+ * 'next' is the position of the following selected item and starts at zero.
+ */
+static inline int dynamic_selected(const dynamic_frame_t *dynamic, const size_t i, size_t *next)
+{
+    if (*next >= dynamic->n_selected || dynamic->selected[*next] != i) return 0;
+
+    ++*next;
+    return 1;
+}
+
+/*! @brief Writes the used coordinates of the position followed by a newline. */
+static inline void write_coordinates(text_buffer_t *output, const analysis_t *analysis, const vec_t position)
+{
+    if (analysis->x) { text_append(output, "x = ", 4); text_append_fixed(output, position[0], 3); text_append(output, "    ", 4); }
+    if (analysis->y) { text_append(output, "y = ", 4); text_append_fixed(output, position[1], 3); text_append(output, "    ", 4); }
+    if (analysis->z) { text_append(output, "z = ", 4); text_append_fixed(output, position[2], 3); text_append(output, "    ", 4); }
+    text_append(output, "\n", 1);
+}
+
+/*! @brief Writes line introducing the distances of atom 'i' of selection 1. */
+static inline void write_atom_line(text_buffer_t *output, const analysis_t *analysis, const size_t i)
+{
+    text_append_label(output, analysis_labels(analysis, 0), i);
+    text_append(output, "\n", 1);
+}
+
+/*! @brief Writes distance of atom 'j' of selection 2. */
+static inline void write_pair_line(text_buffer_t *output, const analysis_t *analysis, const size_t j, const float distance)
+{
+    text_append(output, ">>> ", 4);
+    text_append_label(output, analysis_labels(analysis, 1), j);
+    text_append(output, "   ", 3);
+    text_append_fixed(output, distance, 3);
+    text_append(output, "\n", 1);
+}
+
+/*! @brief Compares two pairs by their index. */
+static int compare_pair_distances(const void *a, const void *b)
+{
+    size_t pair1 = ((const pair_distance_t *) a)->pair;
+    size_t pair2 = ((const pair_distance_t *) b)->pair;
+    return (pair1 > pair2) - (pair1 < pair2);
+}
+
+/*
+ * Finds all pairs of atoms of the two selections that are within 'radius' and stores them in 'values'.
+ * Atoms of selection 2 are sorted into a cell grid and for every atom of selection 1,
+ * only atoms in the neighbouring cells are checked.
+ * If 'output' is not NULL, the pairs are written into it as text.
+ * If 'sorted' is non-zero (or the pairs are written out), the pairs are sorted by their index.
+ * For identical selections, only pairs i < j are searched, if these are the only pairs written out
+ * or if the pairs are only counted. Atoms shared by the selections of a reduction are not paired with themselves.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+static int find_pairs(
+        const analysis_t *analysis,
+        const atom_selection_t *selection1,
+        const atom_selection_t *selection2,
+        system_t *frame,
+        const float radius,
+        const int sorted,
+        text_buffer_t *output,
+        frame_values_t *values)
+{
+    const int use[3] = { analysis->x, analysis->y, analysis->z };
+    const size_t n_atoms2 = selection2->n_atoms;
+    const int upper = analysis->self && (analysis->options.triangle || analysis->type == analysis_contacts);
+
+    values->n_pairs = 0;
+    if (grid_build(&values->grid, selection2, frame->box, radius, use) != 0) {
+        fprintf(stderr, "Could not allocate memory for the cell grid.\n");
+        return 1;
+    }
+
+    const cell_grid_t *grid = &values->grid;
+    size_t cells[27] = {0};
+    for (size_t i = 0; i < selection1->n_atoms; ++i) {
+        atom_t *atom1 = selection1->atoms[i];
+        size_t first = values->n_pairs;
+
+        size_t n_cells = grid_neighbor_cells(grid, atom1->position, cells);
+        for (size_t c = 0; c < n_cells; ++c) {
+            for (size_t k = grid->cell_start[cells[c]]; k < grid->cell_start[cells[c] + 1]; ++k) {
+                size_t j = grid->atoms[k];
+                if ((upper && j <= i) || pair_shared(analysis, i, j)) continue;
+
+                float distance = calc_distance_dim(atom1->position, selection2->atoms[j]->position, analysis->dim, frame->box, 1);
+                if (fabsf(distance) > radius) continue;
+
+                if (values->n_pairs >= values->capacity) {
+                    pair_distance_t *pairs = realloc(values->pairs, 2 * values->capacity * sizeof(pair_distance_t));
+                    if (pairs == NULL) {
+                        fprintf(stderr, "Could not allocate memory for the pairs within the cutoff.\n");
+                        return 1;
+                    }
+                    values->pairs = pairs;
+                    values->capacity *= 2;
+                }
+
+                values->pairs[values->n_pairs].pair = i * n_atoms2 + j;
+                values->pairs[values->n_pairs].distance = distance;
+                ++values->n_pairs;
+            }
+        }
+
+        if (values->n_pairs == first || (!sorted && output == NULL)) continue;
+
+        // cells are not visited in the order of atoms
+        qsort(&values->pairs[first], values->n_pairs - first, sizeof(pair_distance_t), compare_pair_distances);
+
+        if (output != NULL) {
+            write_atom_line(output, analysis, i);
+            for (size_t p = first; p < values->n_pairs; ++p) {
+                write_pair_line(output, analysis, values->pairs[p].pair - i * n_atoms2, values->pairs[p].distance);
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Calculates the minimum distance between the atoms of the two selections.
+ * If a cutoff is set, the pairs within the cutoff are searched first and all pairs
+ * are only checked, if there is no such pair.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+static int min_distance(
+        const analysis_t *analysis,
+        const atom_selection_t *selection1,
+        const atom_selection_t *selection2,
+        system_t *frame,
+        frame_values_t *values,
+        float *minimum)
+{
+    *minimum = INFINITY;
+
+    if (analysis->options.cutoff > 0.0f) {
+        if (find_pairs(analysis, selection1, selection2, frame, analysis->options.cutoff, 0, NULL, values) != 0) return 1;
+
+        for (size_t p = 0; p < values->n_pairs; ++p) {
+            if (fabsf(values->pairs[p].distance) < *minimum) *minimum = fabsf(values->pairs[p].distance);
+        }
+
+        if (values->n_pairs > 0) return 0;
+    }
+
+    if (coordinates_gather(&values->coordinates, selection2) != 0) {
+        fprintf(stderr, "Could not allocate memory for the coordinates.\n");
+        return 1;
+    }
+
+    for (size_t i = 0; i < selection1->n_atoms; ++i) {
+        coordinates_t atoms2 = values->coordinates;
+        if (analysis->self) {
+            // only atoms following atom i
+            atoms2.n_atoms -= i + 1;
+            atoms2.x += i + 1;
+            atoms2.y += i + 1;
+            atoms2.z += i + 1;
+        }
+
+        distance_row(selection1->atoms[i]->position, &atoms2, analysis->dim, frame->box, 0, values->row);
+
+        for (size_t j = 0; j < atoms2.n_atoms; ++j) {
+            if (!analysis->self && pair_shared(analysis, i, j)) continue;
+            if (fabsf(values->row[j]) < *minimum) *minimum = fabsf(values->row[j]);
+        }
+    }
+
+    return 0;
+}
+
+int analysis_frame(
+        const analysis_t *analysis,
+        const atom_selection_t *selection1,
+        const atom_selection_t *selection2,
+        system_t *frame,
+        text_buffer_t *output,
+        frame_values_t *frame_values)
+{
+    if (analysis->idle) return 0;
+
+    // groups are analysed as atoms placed at their centers
+    if (analysis->groups1 != NULL) {
+        groups_centers(analysis->groups1, selection1, frame->box, frame_values->centers1);
+        if (analysis->groups2 != NULL && analysis->groups2 != analysis->groups1) {
+            groups_centers(analysis->groups2, selection2, frame->box, frame_values->centers2);
+        }
+
+        selection1 = frame_values->centers1;
+        if (analysis->groups2 != NULL) selection2 = frame_values->centers2;
+    }
+
+    switch (analysis->type) {
+    case analysis_atoms_distance:
+        if (!analysis_has_cutoff(analysis)) break;
+        if (output != NULL) write_time(output, frame->time, "\n");
+        return find_pairs(analysis, selection1, selection2, frame, analysis->options.cutoff, 1, output, frame_values);
+
+    case analysis_min_distance:
+        if (min_distance(analysis, selection1, selection2, frame, frame_values, &frame_values->values[0]) != 0) return 1;
+        if (output != NULL) write_time_distance(output, frame->time, frame_values->values[0]);
+        return 0;
+
+    case analysis_contacts:
+        if (find_pairs(analysis, selection1, selection2, frame, analysis->options.contacts, 0, NULL, frame_values) != 0) return 1;
+
+        frame_values->n_contacts = frame_values->n_pairs;
+        // pairs j < i are mirrored
+        if (analysis->self && !analysis->options.triangle) frame_values->n_contacts = 2 * frame_values->n_pairs;
+
+        frame_values->values[0] = (float) frame_values->n_contacts;
+        if (output != NULL) {
+            write_time(output, frame->time, "    n = ");
+            text_append_size(output, frame_values->n_contacts);
+            text_append(output, "\n", 1);
+        }
+        return 0;
+
+    default:
+        break;
+    }
+
+    float *values = frame_values->values;
+    const int text = output != NULL;
+
+    // atoms of selection 1 are selected in the current frame
+    const dynamic_frame_t *dynamic = NULL;
+    size_t next = 0;
+    if (analysis_is_dynamic(analysis)) {
+        if (dynamic_select(&analysis->options.dynamic, selection1, frame, &frame_values->dynamic) != 0) return 1;
+        dynamic = &frame_values->dynamic;
+    }
+
+    switch (analysis->type) {
+    case analysis_positions:
+        if (text) write_selection_time(output, frame->time, dynamic);
+
+        for (size_t i = 0; i < selection1->n_atoms; ++i) {
+            atom_t *atom = selection1->atoms[i];
+            if (dynamic != NULL && !dynamic_selected(dynamic, i, &next)) {
+                values[3 * i] = values[3 * i + 1] = values[3 * i + 2] = NAN;
+                continue;
+            }
+
+            memcpy(&values[3 * i], atom->position, 3 * sizeof(float));
+
+            if (text) {
+                text_append_label(output, analysis_labels(analysis, 0), i);
+                text_append(output, "    ", 4);
+                write_coordinates(output, analysis, atom->position);
+            }
+        }
+        break;
+
+    case analysis_center: {
+        if (dynamic != NULL) {
+            if (text) {
+                write_time(output, frame->time, "    n = ");
+                text_append_size(output, dynamic->n_selected);
+                text_append(output, "    ", 4);
+            }
+
+            // the center of an empty selection is not defined
+            if (dynamic->n_selected == 0) {
+                values[0] = values[1] = values[2] = NAN;
+                if (text) text_append(output, "\n", 1);
+                break;
+            }
+
+            selection1 = dynamic->subset;
+        }
+
+        vec_t center = {0.0};
+        center_of_geometry(selection1, center, frame->box);
+        memcpy(values, center, 3 * sizeof(float));
+
+        if (text) {
+            if (dynamic == NULL) write_time(output, frame->time, "    ");
+            write_coordinates(output, analysis, center);
+        }
+        break;
+    }
+
+    case analysis_centers_distance: {
+        vec_t center1 = {0.0};
+        vec_t center2 = {0.0};
+
+        center_of_geometry(selection1, center1, frame->box);
+        center_of_geometry(selection2, center2, frame->box);
+
+        values[0] = calc_distance_dim(center1, center2, analysis->dim, frame->box, 1);
+
+        if (text) write_time_distance(output, frame->time, values[0]);
+        break;
+    }
+
+    case analysis_reference_distance: {
+        if (text) write_selection_time(output, frame->time, dynamic);
+
+        vec_t center2 = {0.0};
+        center_of_geometry(selection2, center2, frame->box);
+
+        if (coordinates_gather(&frame_values->coordinates, selection1) != 0) {
+            fprintf(stderr, "Could not allocate memory for the coordinates.\n");
+            return 1;
+        }
+        distance_row(center2, &frame_values->coordinates, analysis->dim, frame->box, 1, values);
+
+        for (size_t i = 0; i < selection1->n_atoms && (text || dynamic != NULL); ++i) {
+            if (dynamic != NULL && !dynamic_selected(dynamic, i, &next)) {
+                values[i] = NAN;
+                continue;
+            }
+
+            if (!text) continue;
+            text_append_label(output, analysis_labels(analysis, 0), i);
+            text_append(output, "    ", 4);
+            text_append_fixed(output, values[i], 3);
+            text_append(output, "\n", 1);
+        }
+        break;
+    }
+
+    case analysis_atoms_distance: {
+        if (text) write_time(output, frame->time, "\n");
+
+        if (coordinates_gather(&frame_values->coordinates, selection2) != 0) {
+            fprintf(stderr, "Could not allocate memory for the coordinates.\n");
+            return 1;
+        }
+
+        // tiled analyses only calculate distances of the atoms of the current tile
+        size_t first = 0, end = selection1->n_atoms, offset = 0;
+        if (analysis->tiles != NULL) {
+            first = tiles_first_row(analysis->tiles);
+            end = tiles_end_row(analysis->tiles);
+            offset = tiles_offset(analysis->tiles);
+        }
+
+        for (size_t i = first; i < end; ++i) {
+            atom_t *atom1 = selection1->atoms[i];
+
+            if (analysis->self) {
+                // only atoms following atom i
+                coordinates_t following = frame_values->coordinates;
+                following.n_atoms -= i + 1;
+                following.x += i + 1;
+                following.y += i + 1;
+                following.z += i + 1;
+                if (following.n_atoms > 0) {
+                    distance_row(atom1->position, &following, analysis->dim, frame->box, 0,
+                            &values[triangle_index(selection2->n_atoms, i, i + 1) - offset]);
+                }
+            } else {
+                distance_row(atom1->position, &frame_values->coordinates, analysis->dim, frame->box, 0, &values[i * selection2->n_atoms - offset]);
+            }
+
+            if (!text || !pair_written(analysis, i, selection2->n_atoms - 1)) continue;
+
+            write_atom_line(output, analysis, i);
+            for (size_t j = 0; j < selection2->n_atoms; ++j) {
+                if (pair_written(analysis, i, j)) write_pair_line(output, analysis, j, pair_value(analysis, values, i, j));
+            }
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    return text_failed(output);
+}
+
+/*! @brief Adds values calculated for a single frame to the histograms. */
+static void collect_histogram(analysis_t *analysis, const frame_values_t *frame_values)
+{
+    const float *values = frame_values->values;
+    histogram_t *histogram = analysis->histograms;
+
+    if (analysis_has_coordinates(analysis)) {
+        const int use[3] = { analysis->x, analysis->y, analysis->z };
+        for (size_t i = 0; i < analysis->n_values; ++i) {
+            if (use[i % 3]) histogram_add(&histogram[i % 3], values[i]);
+        }
+        return;
+    }
+
+    if (analysis_has_cutoff(analysis)) {
+        for (size_t p = 0; p < frame_values->n_pairs; ++p) histogram_add(histogram, frame_values->pairs[p].distance);
+        return;
+    }
+
+    if (analysis->self && analysis->type == analysis_atoms_distance && !analysis->options.triangle) {
+        // all pairs are binned as if the whole matrix of distances had been calculated (see pair_value)
+        const int oriented = analysis->x + analysis->y + analysis->z == 1;
+        for (size_t i = 0; i < analysis->n_values; ++i) {
+            histogram_add(histogram, values[i]);
+            histogram_add(histogram, oriented ? 0.0f - values[i] : values[i]);
+        }
+        for (size_t i = 0; i < analysis->selection1->n_atoms; ++i) histogram_add(histogram, 0.0f);
+        return;
+    }
+
+    for (size_t i = 0; i < analysis->n_values; ++i) histogram_add(histogram, values[i]);
+}
+
+/*! @brief Adds values of the atoms selected in a single frame to the sums of the dynamic analysis. */
+static void collect_dynamic(analysis_t *analysis, const frame_values_t *frame_values)
+{
+    const dynamic_frame_t *dynamic = &frame_values->dynamic;
+    const float *values = frame_values->values;
+
+    if (analysis->type == analysis_center) {
+        if (dynamic->n_selected == 0) return;
+
+        for (size_t d = 0; d < 3; ++d) analysis->sum[d] += values[d];
+        ++analysis->selected_frames[0];
+        return;
+    }
+
+    const size_t width = analysis->type == analysis_positions ? 3 : 1;
+    for (size_t s = 0; s < dynamic->n_selected; ++s) {
+        size_t i = dynamic->selected[s];
+        for (size_t d = 0; d < width; ++d) analysis->sum[width * i + d] += values[width * i + d];
+        ++analysis->selected_frames[i];
+    }
+}
+
+int analysis_collect(analysis_t *analysis, const system_t *frame, const frame_values_t *frame_values)
+{
+    if (analysis->idle) return 0;
+
+    const float *values = frame_values->values;
+
+    if (analysis_is_dynamic(analysis)) {
+        const size_t n_selected = frame_values->dynamic.n_selected;
+        analysis->selected_total += n_selected;
+        if (n_selected < analysis->selected_min) analysis->selected_min = n_selected;
+        if (n_selected > analysis->selected_max) analysis->selected_max = n_selected;
+    }
+
+    if (analysis->histograms != NULL) {
+        collect_histogram(analysis, frame_values);
+    } else if (!analysis->timewise && analysis->pairs != NULL) {
+        for (size_t p = 0; p < frame_values->n_pairs; ++p) {
+            if (pair_map_add(analysis->pairs, frame_values->pairs[p].pair, frame_values->pairs[p].distance) != 0) {
+                fprintf(stderr, "Could not allocate memory for the pairs within the cutoff.\n");
+                return 1;
+            }
+        }
+    } else if (!analysis->timewise && analysis->type == analysis_contacts) {
+        analysis->contacts += frame_values->n_contacts;
+    } else if (analysis->tiles != NULL) {
+        tiles_add(analysis->tiles, values);
+    } else if (analysis->selected_frames != NULL) {
+        collect_dynamic(analysis, frame_values);
+    } else if (!analysis->timewise) {
+        for (size_t i = 0; i < analysis->n_values; ++i) {
+            analysis->sum[i] += values[i];
+        }
+    } else if (analysis->binary) {
+        select_columns(analysis, values, analysis->columns);
+        if (npy_write(analysis->data, analysis->columns, analysis->n_columns) != 0 || npy_write(analysis->times, &frame->time, 1) != 0) {
+            fprintf(stderr, "Could not write output file '%s'\n", analysis->output_file);
+            return 1;
+        }
+    }
+
+    if (analysis->stats != NULL && stats_add(analysis->stats, values) != 0) {
+        fprintf(stderr, "Could not allocate memory for the statistics.\n");
+        return 1;
+    }
+
+    ++analysis->n_steps;
+    return 0;
+}
+
+/*
+ * Writes averages of the tiled analysis into the binary output, one atom of selection 1 at a time.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+static int finish_binary_tiles(analysis_t *analysis)
+{
+    int status = 0;
+    for (size_t i = 0; i < analysis->selection1->n_atoms && status == 0; ++i) {
+        size_t n = 0;
+        for (size_t j = 0; j < analysis->selection2->n_atoms; ++j) {
+            if (pair_written(analysis, i, j)) analysis->columns[n++] = pair_average(analysis, i, j);
+        }
+        status = npy_write(analysis->data, analysis->columns, n);
+    }
+
+    return status;
+}
+
+/*! @brief Writes averages of the analysis into the binary output. Returns zero, if successful, else returns non-zero. */
+static int finish_binary(analysis_t *analysis)
+{
+    if (analysis->tiles != NULL) return finish_binary_tiles(analysis);
+
+    float *averages = malloc(analysis->n_values * sizeof(float));
+    if (averages == NULL) {
+        fprintf(stderr, "Could not allocate memory for the averages.\n");
+        return 1;
+    }
+
+    for (size_t i = 0; i < analysis->n_values; ++i) {
+        averages[i] = sum_average(analysis->sum[i], analysis->n_steps);
+    }
+
+    // atoms of a dynamic selection are averaged over the frames in which they were selected
+    for (size_t i = 0; i < analysis->n_values && analysis->selected_frames != NULL; ++i) {
+        size_t n_frames = analysis->selected_frames[analysis->type == analysis_positions ? i / 3 : (analysis->type == analysis_center ? 0 : i)];
+        averages[i] = n_frames > 0 ? sum_average(analysis->sum[i], n_frames) : NAN;
+    }
+
+    if (analysis->type == analysis_contacts) averages[0] = (double) analysis->contacts / analysis->n_steps;
+
+    select_columns(analysis, averages, analysis->columns);
+    int status = npy_write(analysis->data, analysis->columns, analysis->n_columns);
+
+    for (size_t c = 0; analysis->stats != NULL && c < N_STATS_COLUMNS && status == 0; ++c) {
+        if (!(analysis->options.stats & STATS_COLUMNS[c])) continue;
+
+        select_stat_columns(analysis, STATS_COLUMNS[c], analysis->columns);
+        status = npy_write(analysis->data, analysis->columns, analysis->n_columns);
+    }
+
+    free(averages);
+    return status;
+}
+
+/*
+ * Writes averages of the pairs that were found within the cutoff, together with
+ * the number of frames in which the pair was within the cutoff.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+static int finish_cutoff(analysis_t *analysis)
+{
+    const pair_map_t *map = analysis->pairs;
+    const size_t n_atoms2 = analysis->selection2->n_atoms;
+    FILE *output = analysis->output;
+
+    size_t *pairs = pair_map_pairs(map);
+    if (pairs == NULL) {
+        fprintf(stderr, "Could not allocate memory for the pairs within the cutoff.\n");
+        return 1;
+    }
+
+    size_t previous = (size_t) -1;
+    for (size_t p = 0; p < map->n_pairs; ++p) {
+        size_t i = pairs[p] / n_atoms2;
+        size_t bucket = pair_map_find(map, pairs[p]);
+
+        if (i != previous) {
+            write_label(output, analysis, 0, i, 1);
+            fprintf(output, "\n");
+            previous = i;
+        }
+
+        fprintf(output, ">>> ");
+        write_label(output, analysis, 1, pairs[p] % n_atoms2, 1);
+        fprintf(output, "   %.3f    (frames: %zu/%zu)\n", sum_average(map->sums[bucket], map->counts[bucket]), map->counts[bucket], analysis->n_steps);
+    }
+
+    free(pairs);
+    return 0;
+}
+
+/*! @brief Pair of atoms with its average distance. */
+typedef struct pair_average {
+    size_t pair;
+    float average;
+    size_t count;               // number of frames the average was calculated from
+} pair_average_t;
+
+/*! @brief Returns 1, if pair 'a' is closer than pair 'b'. Pairs with identical distances are ordered by their index. */
+static int pair_closer(const pair_average_t *a, const pair_average_t *b)
+{
+    float distance_a = fabsf(a->average), distance_b = fabsf(b->average);
+    if (distance_a != distance_b) return distance_a < distance_b;
+    return a->pair < b->pair;
+}
+
+/*! @brief Compares two pairs by their distance. */
+static int compare_pair_averages(const void *a, const void *b)
+{
+    return pair_closer(b, a) - pair_closer(a, b);
+}
+
+/*
+ * Offers pair to a bounded max-heap holding the 'capacity' closest pairs.
+ * The farthest of the held pairs is at the top of the heap.
+ */
+static void heap_offer(pair_average_t *heap, size_t *n_items, const size_t capacity, const pair_average_t *item)
+{
+    size_t i = 0;
+
+    if (*n_items < capacity) {
+        // sift up
+        i = (*n_items)++;
+        while (i > 0 && pair_closer(&heap[(i - 1) / 2], item)) {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap[i] = *item;
+        return;
+    }
+
+    if (!pair_closer(item, &heap[0])) return;
+
+    // replace the farthest pair and sift down
+    while (2 * i + 1 < *n_items) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < *n_items && pair_closer(&heap[child], &heap[child + 1])) ++child;
+        if (!pair_closer(item, &heap[child])) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = *item;
+}
+
+/*! @brief Writes the 'top' pairs of atoms with the shortest average distance. Returns zero, if successful, else returns non-zero. */
+static int finish_top(analysis_t *analysis)
+{
+    const size_t n_atoms2 = analysis->selection2->n_atoms;
+    const size_t capacity = analysis->options.top;
+    FILE *output = analysis->output;
+
+    pair_average_t *heap = malloc(capacity * sizeof(pair_average_t));
+    if (heap == NULL) {
+        fprintf(stderr, "Could not allocate memory for the closest pairs.\n");
+        return 1;
+    }
+
+    size_t n_items = 0;
+    pair_average_t item = {0};
+    if (analysis->pairs != NULL) {
+        const pair_map_t *map = analysis->pairs;
+        for (size_t b = 0; b < map->capacity; ++b) {
+            if (map->keys[b] == 0) continue;
+            item.pair = map->keys[b] - 1;
+            item.average = sum_average(map->sums[b], map->counts[b]);
+            item.count = map->counts[b];
+            heap_offer(heap, &n_items, capacity, &item);
+        }
+    } else {
+        for (size_t p = 0; p < analysis->selection1->n_atoms * n_atoms2; ++p) {
+            if (!pair_written(analysis, p / n_atoms2, p % n_atoms2) || pair_shared(analysis, p / n_atoms2, p % n_atoms2)) continue;
+
+            item.pair = p;
+            item.average = pair_average(analysis, p / n_atoms2, p % n_atoms2);
+            item.count = analysis->n_steps;
+            heap_offer(heap, &n_items, capacity, &item);
+        }
+    }
+
+    qsort(heap, n_items, sizeof(pair_average_t), compare_pair_averages);
+
+    for (size_t p = 0; p < n_items; ++p) {
+        write_label(output, analysis, 0, heap[p].pair / n_atoms2, 0);
+        fprintf(output, " - ");
+        write_label(output, analysis, 1, heap[p].pair % n_atoms2, 1);
+        fprintf(output, "   %.3f", heap[p].average);
+        if (analysis->pairs != NULL) fprintf(output, "    (frames: %zu/%zu)", heap[p].count, analysis->n_steps);
+        fprintf(output, "\n");
+    }
+
+    free(heap);
+    return 0;
+}
+
+/*! @brief Closes all output files of the analysis. Returns zero, if all outputs were completely written, else returns non-zero. */
+static int analysis_destroy_outputs(analysis_t *analysis)
+{
+    int status = 0;
+    if (analysis->output != NULL) {
+        if (ferror(analysis->output)) status = 1;
+        if (fclose(analysis->output) != 0) status = 1;
+        analysis->output = NULL;
+    }
+
+    if (npy_close(analysis->data) != 0) status = 1;
+    if (npy_close(analysis->times) != 0) status = 1;
+    analysis->data = NULL;
+    analysis->times = NULL;
+
+    return status;
+}
+
+/*
+ * Writes the histograms as a table with the centers of the bins in the first column.
+ * Densities are normalized by the number of all values, including the values outside the histogram.
+ */
+static void finish_histogram(analysis_t *analysis)
+{
+    FILE *output = analysis->output;
+    const int density = analysis->options.hist_density;
+    const histogram_t *first = &analysis->histograms[0];
+
+    const int use[3] = { analysis->x, analysis->y, analysis->z };
+    const int coordinates = analysis_has_coordinates(analysis);
+
+    fprintf(output, "Range: %.3f to %.3f, bin width: %.3f, bins: %zu, frames: %zu.\n", first->min,
+            first->min + first->n_bins * first->width, first->width, first->n_bins, analysis->n_steps);
+
+    fprintf(output, "Values outside of the range (below / above):");
+    for (size_t h = 0; h < analysis->n_histograms; ++h) {
+        if (coordinates && !use[h]) continue;
+        if (coordinates) fprintf(output, "    %c = %zu / %zu", (int) ('x' + h), analysis->histograms[h].below, analysis->histograms[h].above);
+        else fprintf(output, "    %zu / %zu", analysis->histograms[h].below, analysis->histograms[h].above);
+    }
+    fprintf(output, "\n");
+
+    fprintf(output, "# %-8s", "bin");
+    for (size_t h = 0; h < analysis->n_histograms; ++h) {
+        if (coordinates && !use[h]) continue;
+        char name[16] = "";
+        if (coordinates) snprintf(name, sizeof(name), "%c", (int) ('x' + h));
+        else snprintf(name, sizeof(name), "%s", density ? "density" : "count");
+        fprintf(output, "    %12s", name);
+    }
+    fprintf(output, "\n");
+
+    double norms[3] = { 0.0 };
+    for (size_t h = 0; h < analysis->n_histograms; ++h) {
+        size_t total = histogram_total(&analysis->histograms[h]);
+        norms[h] = total > 0 ? 1.0 / (total * analysis->histograms[h].width) : 0.0;
+    }
+
+    for (size_t b = 0; b < first->n_bins; ++b) {
+        fprintf(output, "%10.4f", histogram_center(first, b));
+        for (size_t h = 0; h < analysis->n_histograms; ++h) {
+            if (coordinates && !use[h]) continue;
+            if (density) fprintf(output, "    %12.6f", analysis->histograms[h].counts[b] * norms[h]);
+            else fprintf(output, "    %12zu", analysis->histograms[h].counts[b]);
+        }
+        fprintf(output, "\n");
+    }
+}
+
+/*! @brief Returns the size of the file in bytes or zero, if the file does not exist. */
+static size_t file_size(const char *filename)
+{
+    struct stat info;
+    if (filename == NULL || stat(filename, &info) != 0) return 0;
+    return (size_t) info.st_size;
+}
+
+size_t analysis_output_size(const analysis_t *analysis)
+{
+    if (!analysis_has_output(analysis) || analysis->options.partial) return 0;
+
+    size_t size = file_size(analysis->output_file);
+    if (analysis->binary) {
+        const char *suffixes[2] = { "times", "columns" };
+        for (int i = 0; i < 2; ++i) {
+            char *companion = npy_companion(analysis->output_file, suffixes[i]);
+            size += file_size(companion);
+            free(companion);
+        }
+    }
+
+    return size;
+}
+
+/*! @brief Contents of the saved accumulators (see analysis_save). */
+enum { saved_sum = 1, saved_pairs = 2, saved_stats = 4 };
+
+/*! @brief Returns bit mask of the accumulators of the analysis that are saved. */
+static uint64_t saved_contents(const analysis_t *analysis)
+{
+    return (analysis->sum != NULL ? saved_sum : 0) | (analysis->pairs != NULL ? saved_pairs : 0) | (analysis->stats != NULL ? saved_stats : 0);
+}
+
+/*! @brief Writes counts as uint64 values. Returns zero, if successful, else returns non-zero. */
+static int write_counts(FILE *file, const size_t *counts, const size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t count = counts[i];
+        if (fwrite(&count, sizeof(uint64_t), 1, file) != 1) return 1;
+    }
+
+    return 0;
+}
+
+/*! @brief Reads uint64 value into 'count'. Returns zero, if successful, else returns non-zero. */
+static int read_count(FILE *file, size_t *count)
+{
+    uint64_t value = 0;
+    if (fread(&value, sizeof(uint64_t), 1, file) != 1) return 1;
+    *count = (size_t) value;
+    return 0;
+}
+
+int analysis_save(const analysis_t *analysis, FILE *file)
+{
+    const uint64_t header[6] = { analysis->type, analysis->n_values, analysis->n_steps, analysis->contacts,
+                                 analysis->n_histograms, saved_contents(analysis) };
+    if (fwrite(header, sizeof(uint64_t), 6, file) != 6) return 1;
+
+    if (analysis->sum != NULL && fwrite(analysis->sum, sizeof(double), analysis->n_values, file) != analysis->n_values) return 1;
+
+    if (analysis->pairs != NULL) {
+        const pair_map_t *map = analysis->pairs;
+        if (write_counts(file, &map->n_pairs, 1) != 0) return 1;
+
+        for (size_t i = 0; i < map->capacity; ++i) {
+            if (map->keys[i] == 0) continue;
+
+            size_t pair = map->keys[i] - 1;
+            if (write_counts(file, &pair, 1) != 0 || fwrite(&map->sums[i], sizeof(double), 1, file) != 1 ||
+                write_counts(file, &map->counts[i], 1) != 0) return 1;
+        }
+    }
+
+    for (size_t h = 0; h < analysis->n_histograms; ++h) {
+        const histogram_t *histogram = &analysis->histograms[h];
+        if (write_counts(file, &histogram->n_bins, 1) != 0 || write_counts(file, &histogram->below, 1) != 0 ||
+            write_counts(file, &histogram->above, 1) != 0 || write_counts(file, histogram->counts, histogram->n_bins) != 0) return 1;
+    }
+
+    if (analysis->stats != NULL && stats_write(analysis->stats, file) != 0) return 1;
+
+    return 0;
+}
+
+/*
+ * Reads saved statistics. If 'restore' is set, they replace the (empty) statistics of the analysis,
+ * else they are merged into them. Returns zero, if successful, else returns non-zero.
+ */
+static int load_stats(analysis_t *analysis, FILE *file, const int restore)
+{
+    stats_t *saved = stats_read(file, analysis->n_values);
+    if (saved == NULL) return 1;
+
+    if (restore) {
+        stats_destroy(analysis->stats);
+        analysis->stats = saved;
+        return 0;
+    }
+
+    int status = stats_merge(analysis->stats, saved);
+    stats_destroy(saved);
+    return status;
+}
+
+/*! @brief Adds saved accumulators to the analysis, see analysis_merge and analysis_restore. */
+static int analysis_load(analysis_t *analysis, FILE *file, const int restore)
+{
+    uint64_t header[6] = {0};
+    if (fread(header, sizeof(uint64_t), 6, file) != 6) return 1;
+
+    if (header[0] != (uint64_t) analysis->type || header[1] != analysis->n_values ||
+        header[4] != analysis->n_histograms || header[5] != saved_contents(analysis)) return 1;
+
+    analysis->n_steps += (size_t) header[2];
+    analysis->contacts += (size_t) header[3];
+
+    if (analysis->sum != NULL) {
+        double value = 0.0;
+        for (size_t i = 0; i < analysis->n_values; ++i) {
+            if (fread(&value, sizeof(double), 1, file) != 1) return 1;
+            analysis->sum[i] += value;
+        }
+    }
+
+    if (analysis->pairs != NULL) {
+        size_t n_pairs = 0;
+        if (read_count(file, &n_pairs) != 0) return 1;
+
+        for (size_t p = 0; p < n_pairs; ++p) {
+            size_t pair = 0, count = 0;
+            double sum = 0.0;
+            if (read_count(file, &pair) != 0 || fread(&sum, sizeof(double), 1, file) != 1 || read_count(file, &count) != 0) return 1;
+
+            if (pair_map_merge(analysis->pairs, pair, sum, count) != 0) {
+                fprintf(stderr, "Could not allocate memory for the pairs within the cutoff.\n");
+                return 1;
+            }
+        }
+    }
+
+    for (size_t h = 0; h < analysis->n_histograms; ++h) {
+        histogram_t *histogram = &analysis->histograms[h];
+        size_t n_bins = 0, below = 0, above = 0;
+        if (read_count(file, &n_bins) != 0 || n_bins != histogram->n_bins ||
+            read_count(file, &below) != 0 || read_count(file, &above) != 0) return 1;
+
+        histogram->below += below;
+        histogram->above += above;
+        for (size_t i = 0; i < n_bins; ++i) {
+            size_t count = 0;
+            if (read_count(file, &count) != 0) return 1;
+            histogram->counts[i] += count;
+        }
+    }
+
+    if (analysis->stats != NULL && load_stats(analysis, file, restore) != 0) return 1;
+
+    return 0;
+}
+
+int analysis_merge(analysis_t *analysis, FILE *file)
+{
+    return analysis_load(analysis, file, 0);
+}
+
+int analysis_restore(analysis_t *analysis, FILE *file)
+{
+    if (analysis->n_steps > 0) return 1;
+    return analysis_load(analysis, file, 1);
+}
+
+/*! @brief Adds indices of the atoms of the selection to the hash. */
+static uint64_t hash_selection(uint64_t hash, const atom_selection_t *selection, const system_t *system)
+{
+    if (selection == NULL) return hash_bytes(hash, "-", 1);
+
+    hash = hash_bytes(hash, &selection->n_atoms, sizeof(size_t));
+    for (size_t i = 0; i < selection->n_atoms; ++i) {
+        uint64_t index = (uint64_t) (selection->atoms[i] - system->atoms);
+        hash = hash_bytes(hash, &index, sizeof(uint64_t));
+    }
+
+    return hash;
+}
+
+uint64_t analysis_fingerprint(const analysis_t *analysis, const system_t *system)
+{
+    const analysis_options_t *options = &analysis->options;
+    const int settings[7] = { (int) analysis->type, analysis->timewise, (int) analysis->dim, options->minimum,
+                              options->triangle, options->stats, (int) options->group };
+    const float ranges[5] = { options->cutoff, options->contacts, options->hist_min, options->hist_max, options->hist_width };
+
+    uint64_t hash = hash_bytes(HASH_INIT, settings, sizeof(settings));
+    hash = hash_bytes(hash, ranges, sizeof(ranges));
+    hash = hash_bytes(hash, &analysis->n_values, sizeof(size_t));
+    hash = hash_selection(hash, analysis->source1, system);
+    return hash_selection(hash, analysis->source2, system);
+}
+
+int analysis_finish(analysis_t *analysis)
+{
+    int status = 0;
+    if (analysis->binary && !analysis->timewise) status = finish_binary(analysis);
+
+    if (analysis->histograms != NULL) {
+        finish_histogram(analysis);
+    } else if (!analysis->timewise) {
+        const int x = analysis->x, y = analysis->y, z = analysis->z;
+        const size_t n_steps = analysis->n_steps;
+        const double *sum = analysis->sum;
+        FILE *output = analysis->output;
+        const char *items = analysis_items(analysis);
+        const int selected = analysis->selected_frames != NULL;
+
+        switch (analysis->type) {
+        case analysis_positions:
+            if (analysis->binary) break;
+            for (size_t i = 0; i < analysis->selection1->n_atoms; ++i) {
+                // atoms of a dynamic selection are averaged over the frames in which they were selected
+                const size_t n_frames = selected ? analysis->selected_frames[i] : n_steps;
+                if (n_frames == 0) continue;
+
+                write_label(output, analysis, 0, i, 1);
+                fprintf(output, "    ");
+                const int use[3] = { x, y, z };
+                for (size_t d = 0; d < 3; ++d) {
+                    if (!use[d]) continue;
+                    fprintf(output, "%c = %.3f", (int) ('x' + d), sum_average(sum[3 * i + d], n_frames));
+                    write_stats(output, analysis, 1, 3 * i + d, 0);
+                    fprintf(output, "    ");
+                }
+                if (selected) fprintf(output, "(frames: %zu/%zu)", n_frames, n_steps);
+                fprintf(output, "\n");
+            }
+            break;
+
+        case analysis_center: {
+            const size_t n_frames = selected ? analysis->selected_frames[0] : n_steps;
+            printf("\nAverage center of geometry of selection '%s': ", analysis->selection1_query);
+            const int use[3] = { x, y, z };
+            for (size_t d = 0; d < 3; ++d) {
+                if (!use[d]) continue;
+                printf("%c = %.3f", (int) ('x' + d), sum_average(sum[d], n_frames));
+                write_stats(stdout, analysis, 1, d, 0);
+                printf("    ");
+            }
+            if (selected) printf("(frames: %zu/%zu)", n_frames, n_steps);
+            printf("\n");
+            break;
+        }
+
+        case analysis_centers_distance:
+            printf("Average %s-distance between the centers of selections '%s' and '%s': %.3f", analysis->dimensions,
+                    analysis->selection1_query, analysis->selection2_query, sum_average(sum[0], n_steps));
+            write_stats(stdout, analysis, 1, 0, 0);
+            printf("\n");
+            break;
+
+        case analysis_reference_distance:
+            if (analysis->binary) break;
+            for (size_t i = 0; i < analysis->selection1->n_atoms; ++i) {
+                const size_t n_frames = selected ? analysis->selected_frames[i] : n_steps;
+                if (n_frames == 0) continue;
+
+                write_label(output, analysis, 0, i, 1);
+                fprintf(output, "    %.3f", sum_average(sum[i], n_frames));
+                write_stats(output, analysis, 1, i, 0);
+                if (selected) fprintf(output, "    (frames: %zu/%zu)", n_frames, n_steps);
+                fprintf(output, "\n");
+            }
+            break;
+
+        case analysis_min_distance:
+            printf("Average minimum %s-distance between the %s of selections '%s' and '%s': %.3f", analysis->dimensions,
+                    items, analysis->selection1_query, analysis->selection2_query, sum_average(sum[0], n_steps));
+            write_stats(stdout, analysis, 1, 0, 0);
+            printf("\n");
+            break;
+
+        case analysis_contacts:
+            printf("Average number of contacts (%s-distance <= %.3f nm) between the %s of selections '%s' and '%s': %.3f",
+                    analysis->dimensions, analysis->options.contacts, items, analysis->selection1_query, analysis->selection2_query,
+                    (double) analysis->contacts / n_steps);
+            write_stats(stdout, analysis, 1, 0, 0);
+            printf("\n");
+            break;
+
+        case analysis_atoms_distance:
+            if (analysis->binary) break;
+            if (analysis_has_top(analysis)) {
+                status = finish_top(analysis);
+                break;
+            }
+            if (analysis->pairs != NULL) {
+                status = finish_cutoff(analysis);
+                break;
+            }
+            for (size_t i = 0; i < analysis->selection1->n_atoms; ++i) {
+                if (!pair_written(analysis, i, analysis->selection2->n_atoms - 1)) continue;
+
+                write_label(output, analysis, 0, i, 1);
+                fprintf(output, "\n");
+
+                for (size_t j = 0; j < analysis->selection2->n_atoms; ++j) {
+                    if (!pair_written(analysis, i, j)) continue;
+
+                    fprintf(output, ">>> ");
+                    write_label(output, analysis, 1, j, 1);
+                    fprintf(output, "   %.3f", pair_average(analysis, i, j));
+                    write_pair_stats(output, analysis, i, j);
+                    fprintf(output, "\n");
+                }
+            }
+            break;
+        }
+    }
+
+    if (analysis_is_dynamic(analysis) && analysis->n_steps > 0) {
+        printf("\nDynamic selection '%s' contained %.3f %s per frame on average (min: %zu, max: %zu).\n", analysis->selection1_query,
+                (double) analysis->selected_total / analysis->n_steps, analysis_items(analysis), analysis->selected_min, analysis->selected_max);
+    }
+
+    if (analysis_destroy_outputs(analysis) != 0) status = 1;
+
+    if (status != 0) fprintf(stderr, "Could not write output file '%s'\n", analysis->output_file);
+    return status;
+}
+
+void analysis_destroy(analysis_t *analysis)
+{
+    analysis_destroy_outputs(analysis);
+
+    free(analysis->sum);
+    free(analysis->selected_frames);
+    free(analysis->shared);
+    free(analysis->columns);
+    pair_map_destroy(analysis->pairs);
+    tiles_destroy(analysis->tiles);
+    stats_destroy(analysis->stats);
+    for (size_t h = 0; h < analysis->n_histograms && analysis->histograms != NULL; ++h) histogram_destroy(&analysis->histograms[h]);
+    free(analysis->histograms);
+    text_labels_destroy(&analysis->labels1);
+    text_labels_destroy(&analysis->labels2);
+    if (analysis->groups2 != analysis->groups1) groups_destroy(analysis->groups2);
+    groups_destroy(analysis->groups1);
+    analysis->groups1 = NULL;
+    analysis->groups2 = NULL;
+    analysis->histograms = NULL;
+    analysis->n_histograms = 0;
+    analysis->stats = NULL;
+    analysis->sum = NULL;
+    analysis->selected_frames = NULL;
+    analysis->shared = NULL;
+    analysis->pairs = NULL;
+    analysis->tiles = NULL;
+    analysis->columns = NULL;
+}
@@ -0,0 +1,290 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <groan.h>
+#include "npy.h"
+#include "grid.h"
+#include "distance.h"
+#include "pair_map.h"
+#include "stats.h"
+#include "histogram.h"
+#include "text.h"
+#include "tiles.h"
+#include "groups.h"
+#include "dynamic.h"
+
+/*! @brief Type of property that is calculated for every trajectory frame. */
+typedef enum analysis_type {
+    analysis_positions,             // positions of individual atoms
+    analysis_center,                // position of the center of geometry of a selection
+    analysis_centers_distance,      // distance between the centers of two selections
+    analysis_reference_distance,    // distances between atoms of a selection and the center of a reference selection
+    analysis_atoms_distance,        // distances between all pairs of atoms of two selections
+    analysis_min_distance,          // minimum distance between the atoms of two selections
+    analysis_contacts               // number of pairs of atoms of two selections closer than the contact radius
+} analysis_type_t;
+
+/*! @brief Optional settings of an analysis. */
+typedef struct analysis_options {
+    float cutoff;               // only consider pairs of atoms closer than cutoff (nm); zero = all pairs
+    int minimum;                // calculate the minimum distance between the selections (analysis_min_distance)
+    float contacts;             // contact radius (nm) for counting contacts (analysis_contacts)
+    size_t top;                 // only write this number of the closest averaged pairs; zero = all pairs
+    int triangle;               // only consider pairs i < j of two identical selections
+    int stats;                  // statistics written next to the averages (bit mask of stats_column_t)
+    float hist_min;             // lower edge of the histogram of the values
+    float hist_max;             // upper edge of the histogram of the values
+    float hist_width;           // bin width of the histogram of the values; zero = no histogram
+    int hist_density;           // write the histogram as a probability density instead of counts
+    size_t memory;              // memory budget (bytes) of the averaged distances between all pairs of atoms; zero = unlimited
+    group_by_t group;           // analyse centers of groups of atoms instead of individual atoms
+    const ndx_index_t *ndx;     // groups of atoms used with group_ndx (only needed by analysis_init)
+    int partial;                // only accumulate the values without writing any output (see analysis_save)
+    dynamic_t dynamic;          // condition selecting atoms of selection 1 in every frame (environment owned by the caller)
+} analysis_options_t;
+
+/*! @brief Default settings of an analysis. */
+#define ANALYSIS_OPTIONS_DEFAULT ((analysis_options_t) { .cutoff = 0.0f, .minimum = 0, .contacts = 0.0f, .top = 0, .triangle = 0, .stats = 0, \
+        .hist_min = 0.0f, .hist_max = 0.0f, .hist_width = 0.0f, .hist_density = 0, .memory = 0, \
+        .group = group_none, .ndx = NULL, .partial = 0, .dynamic = DYNAMIC_NONE })
+
+/*
+ * Single analysis performed on a trajectory.
+ * Every frame, the analysis calculates 'n_values' floats which are either
+ * written out (timewise analysis) or added to the running sums (averaged analysis).
+ * The sums are accumulated in double precision and the averages are rounded to float.
+ *
+ * Distances between atoms calculated with a cutoff are sparse: every frame, the analysis
+ * finds the pairs of atoms within the cutoff using a cell grid and only these pairs are
+ * written out or added to the per-pair sums.
+ *
+ * If both selections are identical, distances between atoms are only calculated and stored
+ * for pairs i < j. Unless the 'triangle' option is set, the remaining pairs are written out
+ * by mirroring, so the output is the same as if all pairs were calculated.
+ *
+ * Reductions (minimum distance, number of contacts) calculate a single value per frame.
+ * Averaged distances between atoms can be reduced to the 'top' closest pairs when the analysis is finished.
+ * Reductions never consider the distance of an atom (or group) contained in both selections from itself (see 'shared').
+ *
+ * With a memory budget ('memory' option), averaged distances between all pairs of atoms are accumulated
+ * in tiles of consecutive atoms of selection 1 (see tiles_t and analysis_plan). If the tiles do not fit
+ * into the budget at once, every tile requires a separate pass through the trajectory (see analysis_end_pass).
+ *
+ * With grouping ('group' option), the atoms of the selections are divided into groups (see groups_t)
+ * and the analysis treats the center of every group as a single atom: 'selection1' and 'selection2' then
+ * describe the groups, while 'source1' and 'source2' are the selected atoms read from the trajectory.
+ * Selection 2 of a reference distance is never grouped.
+ *
+ * With a dynamic selection ('dynamic' option), the atoms (or groups) of selection 1 are selected again in every frame
+ * (see dynamic_t). Values of the atoms that are not selected are set to NaN and are not written out as text;
+ * averages of every atom only include the frames in which the atom was selected (see 'selected_frames').
+ *
+ * Instead of averaging, the values of all frames can be binned into a histogram ('hist_width' option),
+ * which is written out when the analysis is finished. Positions are binned separately for each dimension.
+ *
+ * If the output file has the '.npy' extension, the results are written as a binary
+ * float32 array with one column per written value (see analysis_init).
+ */
+typedef struct analysis {
+    analysis_type_t type;
+    const atom_selection_t *selection1;
+    const atom_selection_t *selection2;
+    const atom_selection_t *source1;    // atoms of selection 1 read from the trajectory (same as 'selection1', unless grouped)
+    const atom_selection_t *source2;    // atoms of selection 2 read from the trajectory (same as 'selection2', unless grouped)
+    groups_t *groups1;          // groups of atoms of selection 1 (only with grouping)
+    groups_t *groups2;          // groups of atoms of selection 2 (only with grouping; same as 'groups1' for identical selections)
+    const char *selection1_query;
+    const char *selection2_query;
+    int timewise;
+    dimensionality_t dim;
+    analysis_options_t options;
+    int self;                   // the selections are identical, only pairs i < j are calculated
+    size_t *shared;             // index of the same atom (or group) in selection 2 for every atom of selection 1, SIZE_MAX if none (reductions only)
+    int x, y, z;
+    char dimensions[4];
+    const char *output_file;
+    FILE *output;
+    int binary;
+    npy_file_t *data;           // binary output: values
+    npy_file_t *times;          // binary output: times of the frames
+    size_t n_columns;           // number of written values per frame
+    float *columns;
+    size_t n_values;
+    double *sum;                // running sums of the averaged values (double precision, see analysis_merge)
+    pair_map_t *pairs;          // per-pair sums of averaged analyses with a cutoff
+    size_t contacts;            // total number of contacts in all frames (analysis_contacts)
+    stats_t *stats;             // statistics of the averaged values (only if requested)
+    histogram_t *histograms;    // histograms of the values (one per dimension for positions; only if requested)
+    size_t n_histograms;
+    text_labels_t labels1;      // labels of the atoms of selection 1 written out as text (timewise text output only)
+    text_labels_t labels2;      // labels of the atoms of selection 2 written out as text (timewise text output only)
+    tiles_t *tiles;             // memory-bounded sums of the averaged distances between all pairs of atoms (only with a memory budget)
+    size_t *selected_frames;    // number of frames in which each atom (or the non-empty selection for the center) was selected (dynamic averaged analyses)
+    size_t selected_total;      // sum of the sizes of the dynamic selection over all frames
+    size_t selected_min;
+    size_t selected_max;
+    int idle;                   // all passes through the trajectory are finished, further frames are ignored
+    size_t n_steps;
+} analysis_t;
+
+/*! @brief Pair of atoms found within the cutoff. */
+typedef struct pair_distance {
+    size_t pair;                // index of the pair (i * n_atoms2 + j)
+    float distance;
+} pair_distance_t;
+
+/*! @brief Values calculated by an analysis for a single frame. */
+typedef struct frame_values {
+    float *values;              // 'n_values' values of the analysis
+    pair_distance_t *pairs;     // pairs within the cutoff or contact radius (sorted by their index for analysis_atoms_distance)
+    size_t n_pairs;
+    size_t capacity;
+    size_t n_contacts;          // number of contacts (analysis_contacts)
+    cell_grid_t grid;           // cell grid used to search for the pairs
+    coordinates_t coordinates;  // gathered coordinates of the selection processed by the distance kernel
+    float *row;                 // distances between one atom and all atoms of selection 2 (analysis_min_distance)
+    atom_selection_t *centers1; // centers of the groups of selection 1 (only with grouping)
+    atom_selection_t *centers2; // centers of the groups of selection 2 (same as 'centers1' for identical selections)
+    dynamic_frame_t dynamic;    // atoms of selection 1 selected in the frame (only with a dynamic selection)
+    text_buffer_t text;         // text output of the frame (see analysis_frame)
+} frame_values_t;
+
+/*
+ * Prepares analysis for running. Opens the output file, if the analysis writes one, and writes its header.
+ *
+ * Binary output consists of three .npy files:
+ *   OUTPUT.npy         float32 array with shape (frames, columns) for timewise analyses or (columns,) for averaged analyses;
+ *                      if statistics are requested, averaged analyses write shape (1 + statistics, columns),
+ *                      the first row being the averages followed by the statistics in the order std, min, max, err
+ *   OUTPUT.times.npy   float32 array with times of the frames in ps (timewise analyses only)
+ *   OUTPUT.columns.npy int32 array with shape (columns, 3) describing the columns:
+ *                      [atom id in selection 1, atom id in selection 2, dimensions]
+ *                      atom id 0 denotes center of the selection or no atom; with grouping, the atom id is the number of the group,
+ *                      dimensions is a bit mask of the used dimensions (x = 1, y = 2, z = 4)
+ *
+ * If 'output_file' is NULL, the analysis writes no output; the values of the frames are only calculated by analysis_frame.
+ *
+ * Returns zero, if successful. Else returns non-zero.
+ * If 'options' is NULL, default settings are used.
+ */
+int analysis_init(
+        analysis_t *analysis,
+        const analysis_type_t type,
+        const atom_selection_t *selection1,
+        const atom_selection_t *selection2,
+        const char *selection1_query,
+        const char *selection2_query,
+        const int timewise,
+        const dimensionality_t dim,
+        const char *output_file,
+        const analysis_options_t *options);
+
+/*
+ * Prepares the analysis for reading the trajectory into 'n_buffers' frame buffers (see frame_values_init).
+ * Analyses with a memory budget split the pairs of atoms into tiles, so that the sums of a tile
+ * together with the frame buffers fit into the budget. Must be called before frame_values_init.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int analysis_plan(analysis_t *analysis, const size_t n_buffers);
+
+/*
+ * Finishes a pass through the trajectory. Sets 'repeat' to 1, if the analysis needs another pass
+ * (the next tile of pairs is accumulated from the following frames). Else sets 'repeat' to 0
+ * and the analysis ignores all following frames.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int analysis_end_pass(analysis_t *analysis, int *repeat);
+
+/*! @brief Allocates buffers for values of a single frame. Returns zero, if successful, else returns non-zero. */
+int frame_values_init(frame_values_t *values, const analysis_t *analysis);
+
+/*! @brief Releases memory allocated for the values of a single frame. */
+void frame_values_destroy(frame_values_t *values);
+
+/*
+ * Calculates values of the analysis for a single trajectory frame and stores them in 'values'.
+ * If 'output' is not NULL, the values are also appended to it as text (see analysis_writes_text);
+ * the caller writes the text into the output file in the order of the frames.
+ *
+ * Selections are supplied explicitly, so that they can point to any copy of the system;
+ * they must correspond to 'source1' and 'source2' of the analysis.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int analysis_frame(
+        const analysis_t *analysis,
+        const atom_selection_t *selection1,
+        const atom_selection_t *selection2,
+        system_t *frame,
+        text_buffer_t *output,
+        frame_values_t *values);
+
+/*
+ * Processes values calculated for a single frame, in the order of the frames.
+ * Averaged analyses add the values to the running sums, binary timewise analyses write them out.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int analysis_collect(analysis_t *analysis, const system_t *frame, const frame_values_t *values);
+
+/*! @brief Returns 1, if analysis_frame should write the output as text. Else returns 0. */
+int analysis_writes_text(const analysis_t *analysis);
+
+/*
+ * Flushes the timewise output written so far into the output files, so that it can be read
+ * while the analysis is still running (binary output is readable with the current number of frames).
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int analysis_flush(analysis_t *analysis);
+
+/*
+ * Saves the accumulated values of the averaged analysis (sums, pairs within the cutoff, number of contacts,
+ * histograms, statistics and the number of frames) into a binary file, so that partial results of several
+ * runs analyzing different frames can be merged (see analysis_merge).
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int analysis_save(const analysis_t *analysis, FILE *file);
+
+/*
+ * Adds the accumulated values saved by analysis_save into the analysis.
+ * The saved analysis must be the same analysis of the same selections; merged results are then written using analysis_finish.
+ * Sums are merged in the order of the calls, i.e. in the order of the frames, if the partial results are merged in the order of the shards.
+ * Since the sums are accumulated in double precision, the merged averages match the averages of the serial calculation.
+ * Returns zero, if successful. Returns non-zero, if the file could not be read or was saved by a different analysis.
+ */
+int analysis_merge(analysis_t *analysis, FILE *file);
+
+/*
+ * Restores the accumulated values saved by analysis_save into a newly initialized analysis, so that the analysis
+ * continues exactly as if it had analyzed the saved frames itself (including the block averages of the statistics).
+ * Returns zero, if successful. Returns non-zero, if the file could not be read or was saved by a different analysis.
+ */
+int analysis_restore(analysis_t *analysis, FILE *file);
+
+/*
+ * Returns hash identifying the settings of the analysis that determine its accumulated values:
+ * the type, dimensions and options of the analysis and the atoms of the selections read from the trajectory.
+ * The atoms are identified by their indices in the system.
+ */
+uint64_t analysis_fingerprint(const analysis_t *analysis, const system_t *system);
+
+/*
+ * Writes out the results of the averaged analysis and closes the output files.
+ * Returns zero, if successful. Returns non-zero, if any output could not be completely written.
+ */
+int analysis_finish(analysis_t *analysis);
+
+/*! @brief Returns total size of the files written by the analysis in bytes. */
+size_t analysis_output_size(const analysis_t *analysis);
+
+/*! @brief Releases memory and closes files owned by the analysis. Safe to call after analysis_finish. */
+void analysis_destroy(analysis_t *analysis);
+
+/*! @brief Unpacks dimensionality. Returns 0, if successful, else returns 1. */
+int unpack_dimensionality(const dimensionality_t dim, int *x, int *y, int *z);
+
+/*! @brief Unpacks dimensionality. Returns 0, if successful, else returns 1. */
+int unpack_dimensionality_string(const dimensionality_t dim, char *string);
+
+#endif /* ANALYSIS_H */
@@ -0,0 +1,627 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <string.h>
+#include "calc.h"
+#include "compress.h"
+#include "snapshot.h"
+#include "selection_cache.h"
+
+system_t *load_system(const char *gro_file, const char *ndx_file, ndx_index_t **ndx)
+{
+    *ndx = NULL;
+    if (!snapshot_detect(gro_file)) return load_gro(gro_file);
+
+    system_t *system = snapshot_load(gro_file, ndx);
+
+    // groups of an explicitly supplied ndx file replace the groups of the snapshot
+    if (system != NULL && ndx_file != NULL) {
+        ndx_index_destroy(*ndx);
+        *ndx = NULL;
+    }
+
+    return system;
+}
+
+dict_t *load_ndx_groups(const char *ndx_file, const system_t *system, const ndx_index_t *snapshot_ndx)
+{
+    if (snapshot_ndx != NULL) return ndx_index_dict(snapshot_ndx);
+    return read_ndx(ndx_file, system);
+}
+
+/*! @brief Closes the text output. Returns zero, if the whole output has been written, else returns non-zero. */
+static int close_output(FILE *output, const char *output_file)
+{
+    int status = ferror(output) != 0;
+    if (fclose(output) != 0) status = 1;
+
+    if (status != 0) fprintf(stderr, "Could not write output file '%s'\n", output_file);
+    return status;
+}
+
+int calc_structure(
+        system_t *system,
+        const analysis_type_t type,
+        const atom_selection_t *selection1,
+        const atom_selection_t *selection2,
+        const char *selection1_query,
+        const char *selection2_query,
+        const int timewise,
+        const dimensionality_t dim,
+        const char *output_file,
+        const analysis_options_t *options)
+{
+    analysis_t analysis;
+    if (analysis_init(&analysis, type, selection1, selection2, selection1_query, selection2_query, timewise, dim, output_file, options) != 0) return 1;
+    if (analysis_plan(&analysis, 1) != 0) {
+        analysis_destroy(&analysis);
+        return 1;
+    }
+
+    frame_values_t values;
+    if (frame_values_init(&values, &analysis) != 0) {
+        fprintf(stderr, "Could not allocate memory for the analysis.\n");
+        frame_values_destroy(&values);
+        analysis_destroy(&analysis);
+        return 1;
+    }
+
+    // tiled analyses need one pass per tile
+    int status = 0, repeat = 1;
+    while (status == 0 && repeat) {
+        text_buffer_t *text = analysis_writes_text(&analysis) ? &values.text : NULL;
+        status = analysis_frame(&analysis, selection1, selection2, system, text, &values);
+        if (status == 0 && text != NULL) text_flush(text, analysis.output);
+        if (status == 0) status = analysis_collect(&analysis, system, &values);
+        if (status == 0) status = analysis_end_pass(&analysis, &repeat);
+    }
+
+    if (status != 0) {
+        frame_values_destroy(&values);
+        analysis_destroy(&analysis);
+        return 1;
+    }
+
+    if (!timewise && type == analysis_min_distance && options->hist_width <= 0) {
+        printf("Minimum %s-distance between the %s of selections '%s' and '%s': %.3f\n", analysis.dimensions,
+                groups_items(options->group), selection1_query, selection2_query, values.values[0]);
+    } else if (!timewise && type == analysis_contacts && options->hist_width <= 0) {
+        printf("Number of contacts (%s-distance <= %.3f nm) between the %s of selections '%s' and '%s': %zu\n",
+                analysis.dimensions, options->contacts, groups_items(options->group), selection1_query, selection2_query, values.n_contacts);
+    } else {
+        status = analysis_finish(&analysis);
+        if (status == 0) printf("Output file '%s' has been written.\n", output_file);
+    }
+
+    analysis_destroy(&analysis);
+    frame_values_destroy(&values);
+    return status;
+}
+
+analysis_type_t distance_type(const int whole, const int reference, const analysis_options_t *options)
+{
+    if (whole) return analysis_centers_distance;
+    if (reference) return analysis_reference_distance;
+    if (options->minimum) return analysis_min_distance;
+    if (options->contacts > 0) return analysis_contacts;
+    return analysis_atoms_distance;
+}
+
+int finish_analysis(analysis_t *analysis, profile_t *profile)
+{
+    double start = profile != NULL ? profile_now() : 0.0;
+    int status = analysis_finish(analysis);
+
+    if (profile != NULL) {
+        profile->finish += profile_now() - start;
+        profile->bytes_written += analysis_output_size(analysis);
+    }
+
+    return status;
+}
+
+/*
+ * Writes out the results of the analysis or, if only a shard of the trajectory was analyzed,
+ * saves its partial results into OUTPUT.part-I-of-N.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+static int finish_shard(
+        analysis_t *analysis,
+        const char *xtc_file,
+        const char *output_file,
+        const frame_window_t *window,
+        const sharding_t *sharding,
+        profile_t *profile)
+{
+    if (window->shard == 0) return finish_analysis(analysis, profile);
+
+    char *partial_file = shard_filename(output_file, window);
+    if (partial_file == NULL) {
+        fprintf(stderr, "Could not allocate memory for the name of the partial file.\n");
+        return 1;
+    }
+
+    int status = shard_write(partial_file, xtc_file, window, sharding, analysis);
+    if (status == 0) printf("Partial results of %s %d/%d (%zu frames) written into '%s'.\n",
+            window->parts ? "part" : "shard", window->shard, window->n_shards, analysis->n_steps, partial_file);
+
+    free(partial_file);
+    return status;
+}
+
+int calc_position(
+        system_t *system, 
+        const char *xtc_file, 
+        const atom_selection_t *selection, 
+        const char *selection_query, 
+        const int timewise, 
+        const int whole, 
+        const dimensionality_t dim,
+        const char *output_file,
+        const int n_threads,
+        const frame_window_t *window,
+        const analysis_options_t *options,
+        profile_t *profile,
+        const sharding_t *sharding,
+        checkpoint_t *checkpoint)
+{
+    int x = 0, y = 0, z = 0;
+    if (unpack_dimensionality(dim, &x, &y, &z) != 0) return 1;
+
+    // if no xtc file is supplied, analyze the current state of the system
+    if (xtc_file == NULL) {
+        if (npy_is_npy(output_file) || options->hist_width > 0 || options->group != group_none || options->dynamic.type != dynamic_none) {
+            return calc_structure(system, whole ? analysis_center : analysis_positions, selection, NULL, selection_query, NULL,
+                    options->hist_width <= 0, dim, output_file, options);
+        }
+
+        if (whole) {
+            vec_t center = {0.0};
+            center_of_geometry(selection, center, system->box);
+
+            printf("Center of geometry of selection '%s': ", selection_query);
+            if (x) printf("x = %.3f    ", center[0]);
+            if (y) printf("y = %.3f    ", center[1]);
+            if (z) printf("z = %.3f    ", center[2]);
+            printf("\n");
+        }
+
+        else {
+            // open output file
+            FILE *output = output_open(output_file);
+            if (output == NULL) return 1;
+
+            fprintf(output, "Positions of atoms of selection '%s'.\n", selection_query);
+            for (size_t i = 0; i < selection->n_atoms; ++i) {
+                atom_t *atom = selection->atoms[i];
+                fprintf(output, "Atom %s (id: %d) of residue %s (resid: %d):    ", atom->atom_name, atom->atom_number, atom->residue_name, atom->residue_number);
+                if (x) fprintf(output, "x = %.3f    ", atom->position[0]);
+                if (y) fprintf(output, "y = %.3f    ", atom->position[1]);
+                if (z) fprintf(output, "z = %.3f    ", atom->position[2]);
+                fprintf(output, "\n");
+            }
+
+            if (close_output(output, output_file) != 0) return 1;
+            printf("Output file '%s' has been written.\n", output_file);
+        }
+    // if the trajectory was analyzed in shards, merge their partial results
+    } else if (sharding != NULL && sharding->partials != NULL) {
+        analysis_t analysis;
+        if (analysis_init(&analysis, whole ? analysis_center : analysis_positions, selection, NULL,
+                    selection_query, NULL, timewise, dim, output_file, options) != 0) return 1;
+
+        if (partials_merge(sharding->partials, sharding->n_partials, &analysis) != 0) {
+            analysis_destroy(&analysis);
+            return 1;
+        }
+
+        int status = finish_analysis(&analysis, profile);
+        analysis_destroy(&analysis);
+        if (status != 0) return 1;
+    // if an xtc file is provided
+    } else {
+        // open and validate an xtc file
+        trajectory_t *trajectory = trajectory_open(xtc_file, system, window);
+        if (trajectory == NULL) return 1;
+        trajectory->checkpoint = checkpoint;
+
+        analysis_t analysis;
+        if (analysis_init(&analysis, whole ? analysis_center : analysis_positions, selection, NULL, 
+                    selection_query, NULL, timewise, dim, output_file, options) != 0) {
+            trajectory_close(trajectory);
+            return 1;
+        }
+
+        if (trajectory_run(trajectory, system, &analysis, 1, n_threads, profile) != 0) {
+            analysis_destroy(&analysis);
+            trajectory_close(trajectory);
+            return 1;
+        }
+
+        int status = finish_shard(&analysis, xtc_file, output_file, window, sharding, profile);
+        analysis_destroy(&analysis);
+
+        trajectory_close(trajectory);
+        if (status != 0) return 1;
+    }
+    
+    return 0;
+}
+
+int calc_distance(
+        system_t *system,
+        const char *xtc_file,
+        const atom_selection_t *selection1,
+        const atom_selection_t *selection2,
+        const char *selection1_query,
+        const char *selection2_query,
+        const int timewise,
+        const int whole,
+        const int reference,
+        const dimensionality_t dim,
+        const char *output_file,
+        const int n_threads,
+        const frame_window_t *window,
+        const analysis_options_t *options,
+        profile_t *profile,
+        const sharding_t *sharding,
+        checkpoint_t *checkpoint)
+{
+    char dimensions[4] = "";
+    if (unpack_dimensionality_string(dim, dimensions) != 0) return 1;
+
+    analysis_type_t type = distance_type(whole, reference, options);
+
+    // if no xtc file is supplied, analyze the current state of the system
+    if (xtc_file == NULL) {
+        if (npy_is_npy(output_file) || type == analysis_min_distance || type == analysis_contacts || options->hist_width > 0 ||
+            options->cutoff > 0 || options->top > 0 || options->triangle || options->group != group_none || options->dynamic.type != dynamic_none) {
+            // binary output, sparse or triangular distances, centers of groups and dynamic selections are written as a trajectory consisting of a single frame
+            int single_frame = npy_is_npy(output_file) || options->dynamic.type != dynamic_none ||
+                    (type == analysis_atoms_distance && options->top == 0 && options->hist_width <= 0);
+            return calc_structure(system, type, selection1, selection2, selection1_query, selection2_query, single_frame, dim, output_file, options);
+        }
+
+        if (whole) {
+            vec_t center1 = {0.0};
+            vec_t center2 = {0.0};
+            center_of_geometry(selection1, center1, system->box);
+            center_of_geometry(selection2, center2, system->box);
+            
+            printf("%s-distance between the centers of selections '%s' and '%s': %.3f\n", dimensions, selection1_query, selection2_query, 
+                    calc_distance_dim(center1, center2, dim, system->box, 1));
+        } else {
+            // open output file
+            FILE *output = output_open(output_file);
+            if (output == NULL) return 1;
+
+            if (reference) {
+                vec_t center2 = {0.0};
+                center_of_geometry(selection2, center2, system->box);
+
+                fprintf(output, "%s-distances between the atoms of selection '%s' and center of selection '%s'.\n", dimensions, selection1_query, selection2_query);
+                for (size_t i = 0; i < selection1->n_atoms; ++i) {
+                    atom_t *atom = selection1->atoms[i];
+                    fprintf(output, "Atom %s (id: %d) of residue %s (resid: %d):    %.3f\n", atom->atom_name, atom->atom_number, atom->residue_name, atom->residue_number,
+                            calc_distance_dim(atom->position, center2, dim, system->box, 1));
+                }
+
+            } else {
+
+                fprintf(output, "%s-distances between the atoms of selections '%s' and '%s'.\n", dimensions, selection1_query, selection2_query);
+                for (size_t i = 0; i < selection1->n_atoms; ++i) {
+                    atom_t *atom1 = selection1->atoms[i];
+                    fprintf(output, "Atom %s (id: %d) of residue %s (resid: %d):\n", atom1->atom_name, atom1->atom_number, atom1->residue_name, atom1->residue_number);
+                    for (size_t j = 0; j < selection2->n_atoms; ++j) {
+                        atom_t *atom2 = selection2->atoms[j];
+                        fprintf(output, ">>> Atom %s (id: %d) of residue %s (resid: %d):   %.3f\n", atom2->atom_name, atom2->atom_number, atom2->residue_name, atom2->residue_number,
+                                calc_distance_dim(atom1->position, atom2->position, dim, system->box, 1));
+                    }
+                }
+
+            }
+
+            if (close_output(output, output_file) != 0) return 1;
+        }
+    // if the trajectory was analyzed in shards, merge their partial results
+    } else if (sharding != NULL && sharding->partials != NULL) {
+        analysis_t analysis;
+        if (analysis_init(&analysis, type, selection1, selection2, selection1_query, selection2_query, timewise, dim, output_file, options) != 0) return 1;
+
+        if (partials_merge(sharding->partials, sharding->n_partials, &analysis) != 0) {
+            analysis_destroy(&analysis);
+            return 1;
+        }
+
+        int status = finish_analysis(&analysis, profile);
+        analysis_destroy(&analysis);
+        if (status != 0) return 1;
+     // if an xtc file is provided
+    } else {
+        // open and validate an xtc file
+        trajectory_t *trajectory = trajectory_open(xtc_file, system, window);
+        if (trajectory == NULL) return 1;
+        trajectory->checkpoint = checkpoint;
+
+        analysis_t analysis;
+        if (analysis_init(&analysis, type, selection1, selection2, selection1_query, selection2_query, timewise, dim, output_file, options) != 0) {
+            trajectory_close(trajectory);
+            return 1;
+        }
+
+        if (trajectory_run(trajectory, system, &analysis, 1, n_threads, profile) != 0) {
+            analysis_destroy(&analysis);
+            trajectory_close(trajectory);
+            return 1;
+        }
+
+        int status = finish_shard(&analysis, xtc_file, output_file, window, sharding, profile);
+        analysis_destroy(&analysis);
+
+        trajectory_close(trajectory);
+        if (status != 0) return 1;
+    }
+
+    return 0;
+}
+
+int calc_snapshot(const char *gro_file, const char *ndx_file, const char *snapshot_file)
+{
+    ndx_index_t *ndx = NULL;
+    system_t *system = load_system(gro_file, NULL, &ndx);
+    if (system == NULL) return 1;
+
+    FILE *ndx_test = fopen(ndx_file, "r");
+    if (ndx_test != NULL) {
+        fclose(ndx_test);
+        ndx_index_destroy(ndx);
+
+        ndx = ndx_index_read(ndx_file, system);
+        if (ndx == NULL) {
+            free(system);
+            return 1;
+        }
+    }
+
+    int status = snapshot_write(snapshot_file, system, ndx);
+    if (status == 0) printf("\nSnapshot of %zu atoms and %zu ndx groups written into %s.\n\n", system->n_atoms, ndx != NULL ? ndx->n_groups : 0, snapshot_file);
+
+    ndx_index_destroy(ndx);
+    free(system);
+    return status;
+}
+
+/*! @brief System, ndx groups and selection cache shared by all analyses of a run. */
+typedef struct calc_inputs {
+    system_t *system;
+    ndx_index_t *ndx;               // groups of a snapshot or of the ndx file (only read for grouping by ndx groups)
+    dict_t *ndx_groups;
+    selection_cache_t *cache;       // NULL, if the selections are not cached
+    atom_selection_t *all;
+} calc_inputs_t;
+
+/*
+ * Reads the system and the groups of the ndx file (or of the snapshot) and opens the selection cache, if requested.
+ * Returns zero, if successful. Else returns non-zero. The inputs must be released using inputs_close in both cases.
+ */
+static int inputs_open(calc_inputs_t *inputs, const char *gro_file, const char *ndx_file, const int ndx_specified, const char *cache_dir)
+{
+    memset(inputs, 0, sizeof(calc_inputs_t));
+
+    inputs->system = load_system(gro_file, ndx_specified ? ndx_file : NULL, &inputs->ndx);
+    if (inputs->system == NULL) return 1;
+
+    if (cache_dir != NULL) {
+        inputs->cache = selection_cache_open(cache_dir, gro_file, ndx_file);
+        if (inputs->cache == NULL) return 1;
+    }
+
+    // try reading ndx file (ignore if this fails)
+    inputs->ndx_groups = load_ndx_groups(ndx_file, inputs->system, inputs->ndx);
+    inputs->all = select_system(inputs->system);
+    return 0;
+}
+
+/*! @brief Releases the inputs of the analyses. */
+static void inputs_close(calc_inputs_t *inputs)
+{
+    dict_destroy(inputs->ndx_groups);
+    ndx_index_destroy(inputs->ndx);
+    selection_cache_close(inputs->cache);
+    free(inputs->all);
+    free(inputs->system);
+}
+
+/*
+ * Selects the atoms of the environment of the dynamic selection, if it has one.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+static int resolve_dynamic(dynamic_t *dynamic, calc_inputs_t *inputs)
+{
+    if (dynamic->type != dynamic_within) return 0;
+
+    atom_selection_t *environment = selection_cache_select(inputs->cache, inputs->system, inputs->all, dynamic->query, inputs->ndx_groups);
+    if (environment == NULL || environment->n_atoms == 0) {
+        fprintf(stderr, "No atoms ('%s') found.\n", dynamic->query);
+        free(environment);
+        return 1;
+    }
+
+    int status = dynamic_resolve(dynamic, environment, inputs->system);
+    if (status != 0) fprintf(stderr, "Could not allocate memory for the dynamic selection.\n");
+
+    free(environment);
+    return status;
+}
+
+/*
+ * Selects the atoms of the analysis and of its dynamic selection. For grouping by ndx groups,
+ * the groups of the ndx file are read once and shared by all analyses.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+static int select_analysis(calc_inputs_t *inputs, const char *ndx_file, job_analysis_t *analysis)
+{
+    analysis->selection1 = selection_cache_select(inputs->cache, inputs->system, inputs->all, analysis->selection1_query, inputs->ndx_groups);
+    if (analysis->selection1 == NULL || analysis->selection1->n_atoms == 0) {
+        fprintf(stderr, "No atoms ('%s') found.\n", analysis->selection1_query);
+        return 1;
+    }
+
+    if (analysis->selection2_query != NULL) {
+        analysis->selection2 = selection_cache_select(inputs->cache, inputs->system, inputs->all, analysis->selection2_query, inputs->ndx_groups);
+        if (analysis->selection2 == NULL || analysis->selection2->n_atoms == 0) {
+            fprintf(stderr, "No atoms ('%s') found.\n", analysis->selection2_query);
+            return 1;
+        }
+    }
+
+    if (analysis->options.group == group_ndx) {
+        if (inputs->ndx == NULL) inputs->ndx = ndx_index_read(ndx_file, inputs->system);
+        if (inputs->ndx == NULL) return 1;
+        analysis->options.ndx = inputs->ndx;
+    }
+
+    return resolve_dynamic(&analysis->options.dynamic, inputs);
+}
+
+/*! @brief Releases the selections of the analysis. */
+static void release_analysis(job_analysis_t *analysis)
+{
+    free(analysis->selection1);
+    free(analysis->selection2);
+    analysis->selection1 = NULL;
+    analysis->selection2 = NULL;
+    dynamic_destroy(&analysis->options.dynamic);
+}
+
+/*! @brief Performs the analysis of the selected atoms, see calc_position and calc_distance. */
+static int calc_selected(
+        system_t *system,
+        const char *xtc_file,
+        const job_analysis_t *analysis,
+        const int n_threads,
+        const frame_window_t *window,
+        profile_t *profile,
+        const sharding_t *sharding,
+        checkpoint_t *checkpoint)
+{
+    if (analysis->selection2 == NULL) {
+        return calc_position(system, xtc_file, analysis->selection1, analysis->selection1_query, analysis->timewise, analysis->whole,
+                analysis->dim, analysis->output_file, n_threads, window, &analysis->options, profile, sharding, checkpoint);
+    }
+
+    return calc_distance(system, xtc_file, analysis->selection1, analysis->selection2, analysis->selection1_query, analysis->selection2_query,
+            analysis->timewise, analysis->whole, analysis->reference, analysis->dim, analysis->output_file, n_threads, window,
+            &analysis->options, profile, sharding, checkpoint);
+}
+
+int calc_analysis(
+        const char *gro_file,
+        const char *xtc_file,
+        const char *ndx_file,
+        const int ndx_specified,
+        job_analysis_t *analysis,
+        const int n_threads,
+        const frame_window_t *window,
+        profile_t *profile,
+        const char *cache_dir,
+        const sharding_t *sharding,
+        checkpoint_t *checkpoint)
+{
+    calc_inputs_t inputs;
+    int status = inputs_open(&inputs, gro_file, ndx_file, ndx_specified, cache_dir);
+    if (status == 0) status = select_analysis(&inputs, ndx_file, analysis);
+    if (status == 0) status = calc_selected(inputs.system, xtc_file, analysis, n_threads, window, profile, sharding, checkpoint);
+    if (status == 0) printf("\n");
+
+    release_analysis(analysis);
+    inputs_close(&inputs);
+    return status;
+}
+
+/*
+ * Performs all analyses in a single pass through the trajectory.
+ * Every frame is decoded once and shared by all analyses.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+static int calc_jobs_trajectory(
+        system_t *system,
+        const char *xtc_file,
+        job_analysis_t *jobs,
+        const size_t n_jobs,
+        const int n_threads,
+        const frame_window_t *window,
+        profile_t *profile,
+        checkpoint_t *checkpoint)
+{
+    trajectory_t *trajectory = trajectory_open(xtc_file, system, window);
+    if (trajectory == NULL) return 1;
+    trajectory->checkpoint = checkpoint;
+
+    analysis_t *analyses = calloc(n_jobs, sizeof(analysis_t));
+    if (analyses == NULL) {
+        fprintf(stderr, "Could not allocate memory for the analyses.\n");
+        trajectory_close(trajectory);
+        return 1;
+    }
+
+    int status = 0;
+    size_t n_initialized = 0;
+    for (; n_initialized < n_jobs; ++n_initialized) {
+        job_analysis_t *job = &jobs[n_initialized];
+        analysis_type_t type = job->selection2 == NULL ?
+                (job->whole ? analysis_center : analysis_positions) : distance_type(job->whole, job->reference, &job->options);
+
+        if (analysis_init(&analyses[n_initialized], type, job->selection1, job->selection2, job->selection1_query,
+                    job->selection2_query, job->timewise, job->dim, job->output_file, &job->options) != 0) {
+            status = 1;
+            break;
+        }
+    }
+
+    if (status == 0) status = trajectory_run(trajectory, system, analyses, n_jobs, n_threads, profile);
+
+    // every analysis is finished even if another one could not be written
+    const int run_status = status;
+    for (size_t i = 0; i < n_initialized; ++i) {
+        if (run_status == 0 && finish_analysis(&analyses[i], profile) != 0) status = 1;
+        analysis_destroy(&analyses[i]);
+    }
+
+    free(analyses);
+    trajectory_close(trajectory);
+    return status;
+}
+
+int calc_jobs(
+        const char *gro_file,
+        const char *xtc_file,
+        const char *ndx_file,
+        const int ndx_specified,
+        job_analysis_t *analyses,
+        const size_t n_analyses,
+        const int n_threads,
+        const frame_window_t *window,
+        profile_t *profile,
+        const char *cache_dir,
+        checkpoint_t *checkpoint)
+{
+    calc_inputs_t inputs;
+    int status = inputs_open(&inputs, gro_file, ndx_file, ndx_specified, cache_dir);
+    for (size_t i = 0; i < n_analyses && status == 0; ++i) status = select_analysis(&inputs, ndx_file, &analyses[i]);
+
+    if (status == 0 && xtc_file != NULL) {
+        status = calc_jobs_trajectory(inputs.system, xtc_file, analyses, n_analyses, n_threads, window, profile, checkpoint);
+    } else if (status == 0) {
+        // without a trajectory, there is nothing to share between the analyses
+        for (size_t i = 0; i < n_analyses && status == 0; ++i) {
+            status = calc_selected(inputs.system, NULL, &analyses[i], n_threads, window, profile, NULL, NULL);
+        }
+    }
+
+    if (status == 0) printf("\n");
+
+    for (size_t i = 0; i < n_analyses; ++i) release_analysis(&analyses[i]);
+    inputs_close(&inputs);
+    return status;
+}
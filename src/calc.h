@@ -0,0 +1,163 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef CALC_H
+#define CALC_H
+
+#include <groan.h>
+#include "analysis.h"
+#include "trajectory.h"
+#include "profile.h"
+#include "shard.h"
+#include "checkpoint.h"
+
+/*
+ * Analyses of positions and distances performed by the command line program.
+ * Shared by the program (main.c) and by the library (see posdist.h).
+ * The program only parses the options and prints the parameters; the analyses are driven from here.
+ */
+
+/*! @brief Analysis specified on the command line or by a line of the job file. */
+typedef struct job_analysis {
+    char *output_file;
+    char *selection1_query;
+    char *selection2_query;         // NULL for analyses of positions
+    int timewise;
+    int whole;
+    int reference;
+    dimensionality_t dim;
+    analysis_options_t options;
+    atom_selection_t *selection1;   // selected by calc_analysis and calc_jobs
+    atom_selection_t *selection2;
+} job_analysis_t;
+
+/*
+ * Reads the system from the gro file or from a snapshot written using option --snapshot.
+ * If the snapshot contains ndx groups, they are stored in 'ndx' and replace the default ndx file; else 'ndx' is set to NULL.
+ * 'ndx_file' is the ndx file supplied explicitly (NULL, if none was); its groups are always used instead of the groups of the snapshot.
+ * Returns NULL, if the system could not be read.
+ */
+system_t *load_system(const char *gro_file, const char *ndx_file, ndx_index_t **ndx);
+
+/*! @brief Returns groups of the ndx file or of the snapshot ('snapshot_ndx', if not NULL), as used by smart_select. */
+dict_t *load_ndx_groups(const char *ndx_file, const system_t *system, const ndx_index_t *snapshot_ndx);
+
+/*
+ * Analyzes the current state of the system as a trajectory consisting of a single frame
+ * and writes the result into the output file. Reductions which are not written
+ * into an output file (minimum distance, number of contacts) are printed.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int calc_structure(
+        system_t *system,
+        const analysis_type_t type,
+        const atom_selection_t *selection1,
+        const atom_selection_t *selection2,
+        const char *selection1_query,
+        const char *selection2_query,
+        const int timewise,
+        const dimensionality_t dim,
+        const char *output_file,
+        const analysis_options_t *options);
+
+/*! @brief Returns type of the analysis calculating distances between two selections. */
+analysis_type_t distance_type(const int whole, const int reference, const analysis_options_t *options);
+
+/*
+ * Writes out the results of the analysis. If profiling, records the time spent and the size of the output.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int finish_analysis(analysis_t *analysis, profile_t *profile);
+
+/*
+ * Analyzes positions of the atoms (or of the center, if 'whole' is set) of the selection.
+ * Without an xtc file, the current state of the system is analyzed. If 'sharding' contains partial files,
+ * they are merged instead of reading the trajectory; if only a shard of the trajectory is analyzed,
+ * its partial results are saved (see shard.h). 'sharding' and 'checkpoint' may be NULL.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int calc_position(
+        system_t *system,
+        const char *xtc_file,
+        const atom_selection_t *selection,
+        const char *selection_query,
+        const int timewise,
+        const int whole,
+        const dimensionality_t dim,
+        const char *output_file,
+        const int n_threads,
+        const frame_window_t *window,
+        const analysis_options_t *options,
+        profile_t *profile,
+        const sharding_t *sharding,
+        checkpoint_t *checkpoint);
+
+/*
+ * Analyzes distances between the atoms (or centers) of two selections, see calc_position.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int calc_distance(
+        system_t *system,
+        const char *xtc_file,
+        const atom_selection_t *selection1,
+        const atom_selection_t *selection2,
+        const char *selection1_query,
+        const char *selection2_query,
+        const int timewise,
+        const int whole,
+        const int reference,
+        const dimensionality_t dim,
+        const char *output_file,
+        const int n_threads,
+        const frame_window_t *window,
+        const analysis_options_t *options,
+        profile_t *profile,
+        const sharding_t *sharding,
+        checkpoint_t *checkpoint);
+
+/*
+ * Writes snapshot of the system of the gro file and of the groups of the ndx file.
+ * The ndx file is optional; if it does not exist, groups of a snapshot supplied instead of the gro file are kept.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int calc_snapshot(const char *gro_file, const char *ndx_file, const char *snapshot_file);
+
+/*
+ * Reads the system, selects the atoms of the analysis and performs it (see calc_position and calc_distance).
+ * Groups of the ndx file replace the groups of a snapshot only if the ndx file was supplied explicitly ('ndx_specified').
+ * If 'cache_dir' is not NULL, the selections are loaded from (and stored into) the selection cache in this directory.
+ * The selections are released once the analysis is finished.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int calc_analysis(
+        const char *gro_file,
+        const char *xtc_file,
+        const char *ndx_file,
+        const int ndx_specified,
+        job_analysis_t *analysis,
+        const int n_threads,
+        const frame_window_t *window,
+        profile_t *profile,
+        const char *cache_dir,
+        const sharding_t *sharding,
+        checkpoint_t *checkpoint);
+
+/*
+ * Performs all analyses of a job file, see calc_analysis. The system is read once for all analyses and,
+ * if an xtc file is provided, all analyses are performed in a single pass through the trajectory.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int calc_jobs(
+        const char *gro_file,
+        const char *xtc_file,
+        const char *ndx_file,
+        const int ndx_specified,
+        job_analysis_t *analyses,
+        const size_t n_analyses,
+        const int n_threads,
+        const frame_window_t *window,
+        profile_t *profile,
+        const char *cache_dir,
+        checkpoint_t *checkpoint);
+
+#endif /* CALC_H */
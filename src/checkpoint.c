@@ -0,0 +1,240 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+#include "hash.h"
+#include "profile.h"
+
+// identifies posdist checkpoint files
+static const char CHECKPOINT_MAGIC[4] = {'P', 'D', 'C', 'K'};
+
+// version of the checkpoint file format
+static const int32_t CHECKPOINT_VERSION = 3;
+
+// number of bytes at the start and before the end of the analyzed part of the xtc file that are hashed
+static const off_t XTC_HASH_SPAN = 1 << 20;
+
+/*
+ * Header of the checkpoint file. Followed by:
+ *   fingerprints of all analyses (n_analyses uint64 values, see analysis_fingerprint)
+ *   accumulated values of all analyses (see analysis_save)
+ */
+typedef struct checkpoint_header {
+    char magic[4];
+    int32_t version;
+    uint64_t gro_hash;
+    uint64_t ndx_hash;
+    uint64_t xtc_head;          // hash of the start of the analyzed part of the xtc file
+    uint64_t xtc_tail;          // hash of the end of the analyzed part of the xtc file
+    uint64_t offset;
+    uint64_t n_analyses;
+    double time;
+} checkpoint_header_t;
+
+int checkpoint_init(checkpoint_t *checkpoint, const char *filename, const double interval, const char *gro_file, const char *ndx_file)
+{
+    memset(checkpoint, 0, sizeof(checkpoint_t));
+    checkpoint->filename = filename;
+    checkpoint->interval = interval;
+    checkpoint->last_save = profile_now();
+
+    if (hash_file(gro_file, &checkpoint->gro_hash) != 0) {
+        fprintf(stderr, "Could not read file %s.\n", gro_file);
+        return 1;
+    }
+
+    // the ndx file is optional
+    if (hash_file(ndx_file, &checkpoint->ndx_hash) != 0) checkpoint->ndx_hash = 0;
+
+    return 0;
+}
+
+/*! @brief Calculates hashes of the start and of the end of the first 'offset' bytes of the xtc file. Returns zero, if successful, else returns non-zero. */
+static int hash_xtc(const char *xtc_file, const off_t offset, uint64_t *head, uint64_t *tail)
+{
+    off_t span = offset < XTC_HASH_SPAN ? offset : XTC_HASH_SPAN;
+    return hash_file_range(xtc_file, 0, span, head) != 0 || hash_file_range(xtc_file, offset - span, span, tail) != 0;
+}
+
+/*! @brief Returns fingerprints of all analyses. Must be freed by the caller. Returns NULL, if memory could not be allocated. */
+static uint64_t *fingerprints(const analysis_t *analyses, const size_t n_analyses, const system_t *system)
+{
+    uint64_t *prints = malloc((n_analyses + 1) * sizeof(uint64_t));
+    if (prints == NULL) return NULL;
+
+    for (size_t a = 0; a < n_analyses; ++a) prints[a] = analysis_fingerprint(&analyses[a], system);
+    return prints;
+}
+
+/*! @brief Checks the header of the checkpoint file against the run. Returns zero, if they match, else prints the reason and returns non-zero. */
+static int check_header(const checkpoint_t *checkpoint, const checkpoint_header_t *header, const char *xtc_file, const size_t n_analyses)
+{
+    if (header->version != CHECKPOINT_VERSION) {
+        fprintf(stderr, "Checkpoint %s was written by an incompatible version of posdist.\n", checkpoint->filename);
+        return 1;
+    }
+
+    if (header->gro_hash != checkpoint->gro_hash || header->ndx_hash != checkpoint->ndx_hash) {
+        fprintf(stderr, "Checkpoint %s was written for different gro or ndx file.\n", checkpoint->filename);
+        return 1;
+    }
+
+    if (header->n_analyses != n_analyses) {
+        fprintf(stderr, "Checkpoint %s was written by different analyses.\n", checkpoint->filename);
+        return 1;
+    }
+
+    // the analyzed part of the trajectory must not have changed
+    struct stat info;
+    uint64_t head = 0, tail = 0;
+    if (stat(xtc_file, &info) != 0 || (uint64_t) info.st_size < header->offset ||
+        hash_xtc(xtc_file, (off_t) header->offset, &head, &tail) != 0 || head != header->xtc_head || tail != header->xtc_tail) {
+        fprintf(stderr, "Checkpoint %s was written for different xtc file or the analyzed frames of %s have changed.\n", checkpoint->filename, xtc_file);
+        return 1;
+    }
+
+    return 0;
+}
+
+int checkpoint_restore(
+        checkpoint_t *checkpoint,
+        const char *xtc_file,
+        analysis_t *analyses,
+        const size_t n_analyses,
+        const system_t *system,
+        int *resumed)
+{
+    *resumed = 0;
+
+    FILE *file = fopen(checkpoint->filename, "rb");
+    if (file == NULL) return 0;
+
+    checkpoint_header_t header;
+    if (fread(&header, sizeof(checkpoint_header_t), 1, file) != 1 || memcmp(header.magic, CHECKPOINT_MAGIC, 4) != 0) {
+        fprintf(stderr, "File %s is not a checkpoint of posdist.\n", checkpoint->filename);
+        fclose(file);
+        return 1;
+    }
+
+    if (check_header(checkpoint, &header, xtc_file, n_analyses) != 0) {
+        fprintf(stderr, "Remove the checkpoint to analyze the trajectory from the start.\n");
+        fclose(file);
+        return 1;
+    }
+
+    uint64_t *expected = fingerprints(analyses, n_analyses, system);
+    uint64_t *saved = malloc((n_analyses + 1) * sizeof(uint64_t));
+    if (expected == NULL || saved == NULL) {
+        fprintf(stderr, "Could not allocate memory for the checkpoint.\n");
+        free(expected);
+        free(saved);
+        fclose(file);
+        return 1;
+    }
+
+    int matching = fread(saved, sizeof(uint64_t), n_analyses, file) == n_analyses && memcmp(saved, expected, n_analyses * sizeof(uint64_t)) == 0;
+    free(expected);
+    free(saved);
+
+    if (!matching) {
+        fprintf(stderr, "Checkpoint %s was written by different analyses.\n", checkpoint->filename);
+        fprintf(stderr, "Remove the checkpoint to analyze the trajectory from the start.\n");
+        fclose(file);
+        return 1;
+    }
+
+    int status = 0;
+    for (size_t a = 0; a < n_analyses && status == 0; ++a) status = analysis_restore(&analyses[a], file);
+    if (status == 0) status = fgetc(file) != EOF;
+    fclose(file);
+
+    if (status != 0) {
+        fprintf(stderr, "Could not restore the analyses from checkpoint %s. It is not valid.\n", checkpoint->filename);
+        return 1;
+    }
+
+    checkpoint->offset = (off_t) header.offset;
+    checkpoint->time = header.time;
+    *resumed = 1;
+    return 0;
+}
+
+int checkpoint_frame(
+        checkpoint_t *checkpoint,
+        const off_t offset,
+        const float time,
+        const char *xtc_file,
+        const analysis_t *analyses,
+        const size_t n_analyses,
+        const system_t *system)
+{
+    checkpoint->offset = offset;
+    checkpoint->time = time;
+
+    if (profile_now() - checkpoint->last_save < checkpoint->interval) return 0;
+    return checkpoint_save(checkpoint, xtc_file, analyses, n_analyses, system);
+}
+
+int checkpoint_save(
+        checkpoint_t *checkpoint,
+        const char *xtc_file,
+        const analysis_t *analyses,
+        const size_t n_analyses,
+        const system_t *system)
+{
+    checkpoint->last_save = profile_now();
+
+    checkpoint_header_t header = {0};
+    memcpy(header.magic, CHECKPOINT_MAGIC, 4);
+    header.version = CHECKPOINT_VERSION;
+    header.gro_hash = checkpoint->gro_hash;
+    header.ndx_hash = checkpoint->ndx_hash;
+    header.offset = (uint64_t) checkpoint->offset;
+    header.n_analyses = n_analyses;
+    header.time = checkpoint->time;
+
+    if (hash_xtc(xtc_file, checkpoint->offset, &header.xtc_head, &header.xtc_tail) != 0) {
+        fprintf(stderr, "Could not read file %s.\n", xtc_file);
+        return 1;
+    }
+
+    uint64_t *prints = fingerprints(analyses, n_analyses, system);
+    size_t length = strlen(checkpoint->filename) + 5;
+    char *temporary = malloc(length);
+    if (prints == NULL || temporary == NULL) {
+        fprintf(stderr, "Could not allocate memory for the checkpoint.\n");
+        free(prints);
+        free(temporary);
+        return 1;
+    }
+    snprintf(temporary, length, "%s.tmp", checkpoint->filename);
+
+    FILE *file = fopen(temporary, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open file %s for writing.\n", temporary);
+        free(prints);
+        free(temporary);
+        return 1;
+    }
+
+    int status = fwrite(&header, sizeof(checkpoint_header_t), 1, file) != 1 ||
+                 fwrite(prints, sizeof(uint64_t), n_analyses, file) != n_analyses;
+
+    for (size_t a = 0; a < n_analyses && status == 0; ++a) status = analysis_save(&analyses[a], file);
+
+    if (fclose(file) != 0) status = 1;
+    if (status == 0 && rename(temporary, checkpoint->filename) != 0) status = 1;
+
+    if (status != 0) {
+        fprintf(stderr, "Could not write checkpoint %s.\n", checkpoint->filename);
+        remove(temporary);
+    }
+
+    free(prints);
+    free(temporary);
+    return status;
+}
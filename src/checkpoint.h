@@ -0,0 +1,81 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <groan.h>
+#include "analysis.h"
+
+/*
+ * Checkpoints of the averaged analyses of a trajectory.
+ *
+ * While the trajectory is analyzed, the accumulated values of all analyses are periodically saved
+ * together with the byte offset of the end of the last analyzed frame of the xtc file. A later run
+ * with the same checkpoint continues from this offset: either after an interrupted run or after
+ * new frames have been appended to the trajectory. As the sums are continued in the same order,
+ * the results are identical to the results of a single uninterrupted run.
+ *
+ * Saved values are only used, if the gro and ndx files, the analyses and the analyzed part
+ * of the xtc file are the same as in the run that wrote the checkpoint.
+ */
+
+/*! @brief Checkpoint of the analyses of a trajectory. */
+typedef struct checkpoint {
+    const char *filename;
+    double interval;            // time between saving the checkpoint (s)
+    uint64_t gro_hash;          // content of the gro file (or snapshot)
+    uint64_t ndx_hash;          // content of the ndx file; zero, if the file does not exist
+    off_t offset;               // byte offset of the end of the last analyzed frame
+    double time;                // time of the last analyzed frame (ps)
+    double last_save;           // time at which the checkpoint was saved last (see profile_now)
+} checkpoint_t;
+
+/*
+ * Initializes checkpoint stored in 'filename' and saved every 'interval' seconds.
+ * Calculates hashes of the gro and ndx file. Returns zero, if successful, else returns non-zero.
+ */
+int checkpoint_init(checkpoint_t *checkpoint, const char *filename, const double interval, const char *gro_file, const char *ndx_file);
+
+/*
+ * Restores the analyses from the checkpoint file, if it exists, and sets the offset from which the trajectory continues.
+ * All input fingerprints (gro and ndx files, analyses, the analyzed part of the xtc file) are checked before any value is restored.
+ * Sets 'resumed' to 1, if the analyses were restored. If the file does not exist, nothing is restored and zero is returned.
+ * Returns non-zero, if the checkpoint exists but could not be read or does not match the run.
+ */
+int checkpoint_restore(
+        checkpoint_t *checkpoint,
+        const char *xtc_file,
+        analysis_t *analyses,
+        const size_t n_analyses,
+        const system_t *system,
+        int *resumed);
+
+/*
+ * Records the end of an analyzed frame and saves the checkpoint, if 'interval' has elapsed since the last save.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int checkpoint_frame(
+        checkpoint_t *checkpoint,
+        const off_t offset,
+        const float time,
+        const char *xtc_file,
+        const analysis_t *analyses,
+        const size_t n_analyses,
+        const system_t *system);
+
+/*
+ * Saves the checkpoint. The file is written under a temporary name and then renamed,
+ * so an interrupted save never damages the previous checkpoint.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int checkpoint_save(
+        checkpoint_t *checkpoint,
+        const char *xtc_file,
+        const analysis_t *analyses,
+        const size_t n_analyses,
+        const system_t *system);
+
+#endif /* CHECKPOINT_H */
@@ -0,0 +1,292 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+// fopencookie
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <zlib.h>
+#ifdef POSDIST_ZSTD
+#include <zstd.h>
+#endif
+#include "compress.h"
+
+// size of a single block of the queue
+static const size_t BLOCK_SIZE = 1 << 20;
+
+// number of blocks in the queue
+#define N_BLOCKS 8
+
+// size of the buffer for the compressed data
+static const size_t COMPRESSED_SIZE = 1 << 18;
+
+// compression levels; fast compression is preferred, so that the writer thread keeps up with the analysis
+static const int GZIP_LEVEL = 1;
+static const int ZSTD_LEVEL = 1;
+
+typedef struct block {
+    char *data;
+    size_t length;
+} block_t;
+
+typedef struct compressed_stream {
+    const char *filename;
+    FILE *file;                     // the compressed file
+    compression_t compression;
+    z_stream gzip;
+#ifdef POSDIST_ZSTD
+    ZSTD_CCtx *zstd;
+#endif
+    unsigned char *compressed;      // buffer for the compressed data
+    block_t blocks[N_BLOCKS];       // ring of blocks passed to the writer thread
+    size_t head;                    // index of the next block to compress
+    size_t n_queued;                // number of blocks waiting for compression
+    int closing;                    // no more blocks will be queued
+    int failed;                     // the compressed file could not be written
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t writer;
+} compressed_stream_t;
+
+compression_t compression_from_filename(const char *filename)
+{
+    size_t len = strlen(filename);
+
+    if (len > 3 && strcmp(filename + len - 3, ".gz") == 0) return compression_gzip;
+    if (len > 4 && strcmp(filename + len - 4, ".zst") == 0) return compression_zstd;
+    return compression_none;
+}
+
+int compression_supported(const compression_t compression)
+{
+#ifdef POSDIST_ZSTD
+    (void) compression;
+    return 1;
+#else
+    return compression != compression_zstd;
+#endif
+}
+
+/*! @brief Writes the compressed data from the buffer into the file. Returns zero, if successful, else returns non-zero. */
+static int write_compressed(compressed_stream_t *stream, const size_t length)
+{
+    return length > 0 && fwrite(stream->compressed, 1, length, stream->file) != length;
+}
+
+/*
+ * Compresses the data and writes them into the file. If 'finish' is non-zero, the compressed stream is finished.
+ * Returns zero, if successful, else returns non-zero.
+ */
+static int compress_data(compressed_stream_t *stream, const char *data, const size_t length, const int finish)
+{
+    if (stream->compression == compression_gzip) {
+        z_stream *gzip = &stream->gzip;
+        gzip->next_in = (unsigned char *) data;
+        gzip->avail_in = (uInt) length;
+
+        int result = Z_OK;
+        do {
+            gzip->next_out = stream->compressed;
+            gzip->avail_out = (uInt) COMPRESSED_SIZE;
+            result = deflate(gzip, finish ? Z_FINISH : Z_NO_FLUSH);
+            if (result == Z_STREAM_ERROR) return 1;
+            if (write_compressed(stream, COMPRESSED_SIZE - gzip->avail_out) != 0) return 1;
+        } while (gzip->avail_out == 0 || (finish && result != Z_STREAM_END));
+
+        return 0;
+    }
+
+#ifdef POSDIST_ZSTD
+    ZSTD_inBuffer input = { data, length, 0 };
+    size_t remaining = 0;
+    do {
+        ZSTD_outBuffer output = { stream->compressed, COMPRESSED_SIZE, 0 };
+        remaining = ZSTD_compressStream2(stream->zstd, &output, &input, finish ? ZSTD_e_end : ZSTD_e_continue);
+        if (ZSTD_isError(remaining)) return 1;
+        if (write_compressed(stream, output.pos) != 0) return 1;
+    } while (input.pos < input.size || (finish && remaining != 0));
+#endif
+
+    return 0;
+}
+
+/*! @brief Compresses the queued blocks until the stream is closed. */
+static void *writer_thread(void *arg)
+{
+    compressed_stream_t *stream = arg;
+
+    while (1) {
+        pthread_mutex_lock(&stream->lock);
+        while (stream->n_queued == 0 && !stream->closing) pthread_cond_wait(&stream->changed, &stream->lock);
+        if (stream->n_queued == 0) {
+            pthread_mutex_unlock(&stream->lock);
+            break;
+        }
+        block_t *block = &stream->blocks[stream->head];
+        pthread_mutex_unlock(&stream->lock);
+
+        // after a failure, the blocks are only consumed
+        int failed = stream->failed || compress_data(stream, block->data, block->length, 0) != 0;
+
+        pthread_mutex_lock(&stream->lock);
+        stream->failed = failed;
+        stream->head = (stream->head + 1) % N_BLOCKS;
+        --stream->n_queued;
+        pthread_cond_broadcast(&stream->changed);
+        pthread_mutex_unlock(&stream->lock);
+    }
+
+    if (!stream->failed && compress_data(stream, NULL, 0, 1) != 0) stream->failed = 1;
+    return NULL;
+}
+
+/*! @brief Copies data into the blocks of the queue. Called by stdio when its buffer is flushed. */
+static ssize_t stream_write(void *cookie, const char *data, size_t length)
+{
+    compressed_stream_t *stream = cookie;
+    size_t written = 0;
+
+    pthread_mutex_lock(&stream->lock);
+    while (written < length && !stream->failed) {
+        while (stream->n_queued == N_BLOCKS && !stream->failed) pthread_cond_wait(&stream->changed, &stream->lock);
+        if (stream->failed) break;
+
+        block_t *block = &stream->blocks[(stream->head + stream->n_queued) % N_BLOCKS];
+        pthread_mutex_unlock(&stream->lock);
+
+        block->length = length - written < BLOCK_SIZE ? length - written : BLOCK_SIZE;
+        memcpy(block->data, data + written, block->length);
+        written += block->length;
+
+        pthread_mutex_lock(&stream->lock);
+        ++stream->n_queued;
+        pthread_cond_broadcast(&stream->changed);
+    }
+    int failed = stream->failed;
+    pthread_mutex_unlock(&stream->lock);
+
+    return failed ? -1 : (ssize_t) written;
+}
+
+/*! @brief Releases memory and closes the file owned by the stream. */
+static void stream_destroy(compressed_stream_t *stream)
+{
+    if (stream->compression == compression_gzip) deflateEnd(&stream->gzip);
+#ifdef POSDIST_ZSTD
+    ZSTD_freeCCtx(stream->zstd);
+#endif
+    for (size_t i = 0; i < N_BLOCKS; ++i) free(stream->blocks[i].data);
+    free(stream->compressed);
+    free(stream);
+}
+
+/*! @brief Finishes the compression and closes the file. Called by fclose. */
+static int stream_close(void *cookie)
+{
+    compressed_stream_t *stream = cookie;
+
+    pthread_mutex_lock(&stream->lock);
+    stream->closing = 1;
+    pthread_cond_broadcast(&stream->changed);
+    pthread_mutex_unlock(&stream->lock);
+
+    pthread_join(stream->writer, NULL);
+    pthread_mutex_destroy(&stream->lock);
+    pthread_cond_destroy(&stream->changed);
+
+    int failed = stream->failed;
+    if (fclose(stream->file) != 0) failed = 1;
+    if (failed) fprintf(stderr, "Could not write compressed output file '%s'\n", stream->filename);
+
+    stream_destroy(stream);
+    return failed ? -1 : 0;
+}
+
+/*! @brief Prepares the compressor of the stream. Returns zero, if successful, else returns non-zero. */
+static int compressor_init(compressed_stream_t *stream)
+{
+    if (stream->compression == compression_gzip) {
+        // window bits 15 + 16 = gzip header
+        if (deflateInit2(&stream->gzip, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            stream->compression = compression_none;
+            return 1;
+        }
+        return 0;
+    }
+
+#ifdef POSDIST_ZSTD
+    stream->zstd = ZSTD_createCCtx();
+    if (stream->zstd == NULL) return 1;
+    if (ZSTD_isError(ZSTD_CCtx_setParameter(stream->zstd, ZSTD_c_compressionLevel, ZSTD_LEVEL))) return 1;
+#else
+    (void) ZSTD_LEVEL;
+#endif
+
+    return 0;
+}
+
+FILE *output_open(const char *filename)
+{
+    compression_t compression = compression_from_filename(filename);
+    if (!compression_supported(compression)) {
+        fprintf(stderr, "Could not open output file '%s': posdist was compiled without zstd support (compile using 'make zstd=1').\n", filename);
+        return NULL;
+    }
+
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open output file '%s'\n", filename);
+        return NULL;
+    }
+
+    if (compression == compression_none) return file;
+
+    compressed_stream_t *stream = calloc(1, sizeof(compressed_stream_t));
+    if (stream == NULL) {
+        fprintf(stderr, "Could not allocate memory for the output.\n");
+        fclose(file);
+        return NULL;
+    }
+
+    stream->filename = filename;
+    stream->file = file;
+    stream->compression = compression;
+
+    int status = compressor_init(stream) != 0;
+    stream->compressed = malloc(COMPRESSED_SIZE);
+    if (stream->compressed == NULL) status = 1;
+    for (size_t i = 0; i < N_BLOCKS; ++i) {
+        stream->blocks[i].data = malloc(BLOCK_SIZE);
+        if (stream->blocks[i].data == NULL) status = 1;
+    }
+
+    if (status != 0) {
+        fprintf(stderr, "Could not allocate memory for the output.\n");
+        fclose(file);
+        stream_destroy(stream);
+        return NULL;
+    }
+
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->changed, NULL);
+    if (pthread_create(&stream->writer, NULL, writer_thread, stream) != 0) {
+        fprintf(stderr, "Could not start the thread compressing the output.\n");
+        pthread_mutex_destroy(&stream->lock);
+        pthread_cond_destroy(&stream->changed);
+        fclose(file);
+        stream_destroy(stream);
+        return NULL;
+    }
+
+    cookie_io_functions_t functions = { .read = NULL, .write = stream_write, .seek = NULL, .close = stream_close };
+    FILE *output = fopencookie(stream, "w", functions);
+    if (output == NULL) {
+        fprintf(stderr, "Could not open output file '%s'\n", filename);
+        stream_close(stream);
+        return NULL;
+    }
+
+    return output;
+}
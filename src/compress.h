@@ -0,0 +1,40 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stdio.h>
+
+/*
+ * Compressed text output.
+ *
+ * The output file is compressed if its name ends with '.gz' (gzip, using zlib) or '.zst'
+ * (zstd, only if posdist is compiled with 'make zstd=1'). Compression runs on a dedicated
+ * writer thread: text written into the stream is copied into blocks which are passed to the
+ * writer thread through a bounded queue, so the analysis only waits for the compression
+ * if all blocks of the queue are full.
+ *
+ * The stream is an ordinary FILE, so all stdio functions can be used to write into it.
+ * Closing the stream using fclose finishes the compression and waits for the writer thread.
+ */
+
+typedef enum compression {
+    compression_none,
+    compression_gzip,
+    compression_zstd
+} compression_t;
+
+/*! @brief Returns the type of compression selected by the extension of the file. */
+compression_t compression_from_filename(const char *filename);
+
+/*! @brief Returns 1, if posdist supports the type of compression. Else returns 0. */
+int compression_supported(const compression_t compression);
+
+/*
+ * Opens the file for writing text, compressing it according to its extension.
+ * Returns NULL and reports the error, if the file could not be opened or the compression is not supported.
+ */
+FILE *output_open(const char *filename);
+
+#endif /* COMPRESS_H */
@@ -0,0 +1,263 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "distance.h"
+#include "analysis.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DISTANCE_X86 1
+#include <immintrin.h>
+#endif
+
+// alignment of the coordinate arrays (bytes)
+#define COORDINATES_ALIGNMENT 64
+
+void coordinates_init(coordinates_t *coordinates)
+{
+    memset(coordinates, 0, sizeof(coordinates_t));
+}
+
+/*! @brief Allocates aligned array of 'n' floats. Returns NULL, if unsuccessful. */
+static float *aligned_floats(const size_t n)
+{
+    void *array = NULL;
+    if (posix_memalign(&array, COORDINATES_ALIGNMENT, n * sizeof(float)) != 0) return NULL;
+    return array;
+}
+
+int coordinates_gather(coordinates_t *coordinates, const atom_selection_t *selection)
+{
+    if (selection->n_atoms > coordinates->capacity) {
+        coordinates_destroy(coordinates);
+
+        coordinates->x = aligned_floats(selection->n_atoms);
+        coordinates->y = aligned_floats(selection->n_atoms);
+        coordinates->z = aligned_floats(selection->n_atoms);
+        if (coordinates->x == NULL || coordinates->y == NULL || coordinates->z == NULL) {
+            coordinates_destroy(coordinates);
+            return 1;
+        }
+
+        coordinates->capacity = selection->n_atoms;
+    }
+
+    coordinates->n_atoms = selection->n_atoms;
+    for (size_t i = 0; i < selection->n_atoms; ++i) {
+        const float *position = selection->atoms[i]->position;
+        coordinates->x[i] = position[0];
+        coordinates->y[i] = position[1];
+        coordinates->z[i] = position[2];
+    }
+
+    return 0;
+}
+
+void coordinates_destroy(coordinates_t *coordinates)
+{
+    free(coordinates->x);
+    free(coordinates->y);
+    free(coordinates->z);
+    coordinates_init(coordinates);
+}
+
+/*! @brief Parameters of the distance calculation shared by all kernels. */
+typedef struct kernel_args {
+    const float *point;
+    const float *coordinates[3];
+    const float *box;
+    int use[3];                 // dimensions in which the distance is measured
+    int oriented;               // only one dimension is used, the distance is not squared
+    int reversed;
+    size_t start;               // first atom to process
+    size_t end;                 // atom following the last atom to process
+    float *distances;
+} kernel_args_t;
+
+/*! @brief Applies minimum image convention to a single difference of coordinates. */
+static float wrap(float difference, const float box)
+{
+    while (difference > box / 2) difference -= box;
+    while (difference < -box / 2) difference += box;
+    return difference;
+}
+
+static void kernel_scalar(const kernel_args_t *args)
+{
+    for (size_t i = args->start; i < args->end; ++i) {
+        float sum = 0.0f;
+        int first = 1;
+
+        for (int d = 0; d < 3; ++d) {
+            if (!args->use[d]) continue;
+
+            float difference = args->reversed ? args->coordinates[d][i] - args->point[d] : args->point[d] - args->coordinates[d][i];
+            difference = wrap(difference, args->box[d]);
+
+            if (args->oriented) sum = difference;
+            else if (first) sum = difference * difference;
+            else sum = sum + difference * difference;
+            first = 0;
+        }
+
+        args->distances[i] = args->oriented ? sum : sqrtf(sum);
+    }
+}
+
+#ifdef DISTANCE_X86
+
+__attribute__((target("avx2")))
+static void kernel_avx2(kernel_args_t *args)
+{
+    const size_t n_vectors = (args->end - args->start) / 8;
+
+    for (size_t v = 0; v < n_vectors; ++v) {
+        size_t i = args->start + 8 * v;
+        __m256 sum = _mm256_setzero_ps();
+        int first = 1;
+
+        for (int d = 0; d < 3; ++d) {
+            if (!args->use[d]) continue;
+
+            __m256 point = _mm256_set1_ps(args->point[d]);
+            __m256 coordinate = _mm256_loadu_ps(&args->coordinates[d][i]);
+            __m256 box = _mm256_set1_ps(args->box[d]);
+            __m256 half = _mm256_set1_ps(args->box[d] / 2);
+            __m256 negative_half = _mm256_set1_ps(-(args->box[d] / 2));
+
+            __m256 difference = args->reversed ? _mm256_sub_ps(coordinate, point) : _mm256_sub_ps(point, coordinate);
+
+            // blending (instead of adding masked box) keeps the sign of zero in the untouched lanes
+            __m256 mask;
+            while (_mm256_movemask_ps(mask = _mm256_cmp_ps(difference, half, _CMP_GT_OQ))) {
+                difference = _mm256_blendv_ps(difference, _mm256_sub_ps(difference, box), mask);
+            }
+            while (_mm256_movemask_ps(mask = _mm256_cmp_ps(difference, negative_half, _CMP_LT_OQ))) {
+                difference = _mm256_blendv_ps(difference, _mm256_add_ps(difference, box), mask);
+            }
+
+            if (args->oriented) sum = difference;
+            else if (first) sum = _mm256_mul_ps(difference, difference);
+            else sum = _mm256_add_ps(sum, _mm256_mul_ps(difference, difference));
+            first = 0;
+        }
+
+        if (!args->oriented) sum = _mm256_sqrt_ps(sum);
+        _mm256_storeu_ps(&args->distances[i], sum);
+    }
+
+    // remaining atoms
+    args->start += 8 * n_vectors;
+    kernel_scalar(args);
+}
+
+__attribute__((target("avx512f")))
+static void kernel_avx512(kernel_args_t *args)
+{
+    const size_t n_vectors = (args->end - args->start) / 16;
+
+    for (size_t v = 0; v < n_vectors; ++v) {
+        size_t i = args->start + 16 * v;
+        __m512 sum = _mm512_setzero_ps();
+        int first = 1;
+
+        for (int d = 0; d < 3; ++d) {
+            if (!args->use[d]) continue;
+
+            __m512 point = _mm512_set1_ps(args->point[d]);
+            __m512 coordinate = _mm512_loadu_ps(&args->coordinates[d][i]);
+            __m512 box = _mm512_set1_ps(args->box[d]);
+            __m512 half = _mm512_set1_ps(args->box[d] / 2);
+            __m512 negative_half = _mm512_set1_ps(-(args->box[d] / 2));
+
+            __m512 difference = args->reversed ? _mm512_sub_ps(coordinate, point) : _mm512_sub_ps(point, coordinate);
+
+            __mmask16 mask;
+            while ((mask = _mm512_cmp_ps_mask(difference, half, _CMP_GT_OQ)) != 0) {
+                difference = _mm512_mask_sub_ps(difference, mask, difference, box);
+            }
+            while ((mask = _mm512_cmp_ps_mask(difference, negative_half, _CMP_LT_OQ)) != 0) {
+                difference = _mm512_mask_add_ps(difference, mask, difference, box);
+            }
+
+            if (args->oriented) sum = difference;
+            else if (first) sum = _mm512_mul_ps(difference, difference);
+            else sum = _mm512_add_ps(sum, _mm512_mul_ps(difference, difference));
+            first = 0;
+        }
+
+        if (!args->oriented) sum = _mm512_sqrt_ps(sum);
+        _mm512_storeu_ps(&args->distances[i], sum);
+    }
+
+    // remaining atoms
+    args->start += 16 * n_vectors;
+    kernel_scalar(args);
+}
+
+#endif /* DISTANCE_X86 */
+
+/*! @brief Kernels that can be used on this CPU. */
+typedef enum kernel_type {
+    kernel_type_scalar,
+    kernel_type_avx2,
+    kernel_type_avx512
+} kernel_type_t;
+
+static kernel_type_t select_kernel(void)
+{
+#ifdef DISTANCE_X86
+    if (__builtin_cpu_supports("avx512f")) return kernel_type_avx512;
+    if (__builtin_cpu_supports("avx2")) return kernel_type_avx2;
+#endif
+    return kernel_type_scalar;
+}
+
+const char *distance_kernel_name(void)
+{
+    switch (select_kernel()) {
+    case kernel_type_avx512:
+        return "avx512";
+    case kernel_type_avx2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+void distance_row(
+        const float *point,
+        const coordinates_t *coordinates,
+        const dimensionality_t dim,
+        const float *box,
+        const int reversed,
+        float *distances)
+{
+    kernel_args_t args = {
+        .point = point,
+        .coordinates = { coordinates->x, coordinates->y, coordinates->z },
+        .box = box,
+        .reversed = reversed,
+        .start = 0,
+        .end = coordinates->n_atoms,
+        .distances = distances };
+
+    if (unpack_dimensionality(dim, &args.use[0], &args.use[1], &args.use[2]) != 0) return;
+    args.oriented = args.use[0] + args.use[1] + args.use[2] == 1;
+
+    switch (select_kernel()) {
+#ifdef DISTANCE_X86
+    case kernel_type_avx512:
+        kernel_avx512(&args);
+        break;
+    case kernel_type_avx2:
+        kernel_avx2(&args);
+        break;
+#endif
+    default:
+        kernel_scalar(&args);
+        break;
+    }
+}
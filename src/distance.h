@@ -0,0 +1,52 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef DISTANCE_H
+#define DISTANCE_H
+
+#include <groan.h>
+
+/*
+ * Vectorized distance calculation.
+ *
+ * Coordinates of a selection are gathered once per frame into contiguous arrays,
+ * which are then processed by an AVX-512, AVX2 or scalar kernel, chosen at runtime
+ * based on the features of the CPU. All kernels produce exactly the same results as
+ * calc_distance_dim from groan (minimum image convention, oriented one-dimensional distances).
+ */
+
+/*! @brief Coordinates of atoms of a selection stored as a structure of arrays. */
+typedef struct coordinates {
+    size_t n_atoms;
+    size_t capacity;
+    float *x;
+    float *y;
+    float *z;
+} coordinates_t;
+
+/*! @brief Initializes empty coordinates. */
+void coordinates_init(coordinates_t *coordinates);
+
+/*! @brief Copies positions of the atoms of the selection. Returns zero, if successful, else returns non-zero. */
+int coordinates_gather(coordinates_t *coordinates, const atom_selection_t *selection);
+
+/*! @brief Releases memory allocated for the coordinates. */
+void coordinates_destroy(coordinates_t *coordinates);
+
+/*
+ * Calculates distances between 'point' and every atom of 'coordinates' and writes them into 'distances'.
+ * The i-th distance is identical to calc_distance_dim(point, atom_i, dim, box, 1),
+ * or to calc_distance_dim(atom_i, point, dim, box, 1), if 'reversed' is non-zero.
+ */
+void distance_row(
+        const float *point,
+        const coordinates_t *coordinates,
+        const dimensionality_t dim,
+        const float *box,
+        const int reversed,
+        float *distances);
+
+/*! @brief Returns name of the kernel used by distance_row on this CPU. */
+const char *distance_kernel_name(void);
+
+#endif /* DISTANCE_H */
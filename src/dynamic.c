@@ -0,0 +1,169 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dynamic.h"
+
+int dynamic_parse(char *string, dynamic_t *dynamic)
+{
+    *dynamic = DYNAMIC_NONE;
+
+    float radius = 0.0f;
+    int length = 0;
+    if (sscanf(string, " within %f of %n", &radius, &length) == 1 && length > 0) {
+        if (radius <= 0.0f || string[length] == '\0') return 1;
+
+        dynamic->type = dynamic_within;
+        dynamic->radius = radius;
+        dynamic->query = string + length;
+        return 0;
+    }
+
+    char dimension = 0, comparison = 0;
+    float value = 0.0f;
+    length = 0;
+    if (sscanf(string, " %c %c %f %n", &dimension, &comparison, &value, &length) != 3 || string[length] != '\0') return 1;
+    if (dimension < 'x' || dimension > 'z' || (comparison != '>' && comparison != '<')) return 1;
+
+    dynamic->type = comparison == '>' ? dynamic_above : dynamic_below;
+    dynamic->dimension = dimension - 'x';
+    dynamic->value = value;
+    return 0;
+}
+
+void dynamic_describe(const dynamic_t *dynamic, char *string, const size_t size)
+{
+    switch (dynamic->type) {
+    case dynamic_within:
+        snprintf(string, size, "within %.3f nm of '%s'", dynamic->radius, dynamic->query);
+        break;
+    case dynamic_above:
+    case dynamic_below:
+        snprintf(string, size, "%c %c %.3f nm", 'x' + dynamic->dimension, dynamic->type == dynamic_above ? '>' : '<', dynamic->value);
+        break;
+    default:
+        snprintf(string, size, "static");
+        break;
+    }
+}
+
+int dynamic_resolve(dynamic_t *dynamic, const atom_selection_t *environment, const system_t *system)
+{
+    dynamic->environment = malloc((environment->n_atoms + 1) * sizeof(size_t));
+    if (dynamic->environment == NULL) return 1;
+
+    for (size_t i = 0; i < environment->n_atoms; ++i) dynamic->environment[i] = environment->atoms[i] - system->atoms;
+    dynamic->n_environment = environment->n_atoms;
+    return 0;
+}
+
+void dynamic_destroy(dynamic_t *dynamic)
+{
+    free(dynamic->environment);
+    dynamic->environment = NULL;
+    dynamic->n_environment = 0;
+}
+
+size_t dynamic_extent(const dynamic_t *dynamic)
+{
+    size_t extent = 0;
+    for (size_t i = 0; i < dynamic->n_environment; ++i) {
+        if (dynamic->environment[i] + 1 > extent) extent = dynamic->environment[i] + 1;
+    }
+
+    return extent;
+}
+
+int dynamic_frame_init(dynamic_frame_t *frame_selection, const dynamic_t *dynamic, const size_t n_candidates)
+{
+    memset(frame_selection, 0, sizeof(dynamic_frame_t));
+    grid_init(&frame_selection->grid);
+
+    frame_selection->selected = malloc((n_candidates + 1) * sizeof(size_t));
+    frame_selection->subset = malloc(sizeof(atom_selection_t) + n_candidates * sizeof(atom_t *));
+    if (frame_selection->selected == NULL || frame_selection->subset == NULL) return 1;
+    frame_selection->subset->n_atoms = 0;
+
+    if (dynamic->type == dynamic_within) {
+        frame_selection->environment = malloc(sizeof(atom_selection_t) + dynamic->n_environment * sizeof(atom_t *));
+        if (frame_selection->environment == NULL) return 1;
+        frame_selection->environment->n_atoms = dynamic->n_environment;
+    }
+
+    return 0;
+}
+
+void dynamic_frame_destroy(dynamic_frame_t *frame_selection)
+{
+    free(frame_selection->selected);
+    free(frame_selection->subset);
+    free(frame_selection->environment);
+    grid_destroy(&frame_selection->grid);
+    memset(frame_selection, 0, sizeof(dynamic_frame_t));
+}
+
+/*! @brief Returns 1, if the position is closer than the radius to any atom of the environment sorted into the grid. Else returns 0. */
+static int near_environment(const dynamic_t *dynamic, const dynamic_frame_t *frame_selection, const float *position, box_t box)
+{
+    const cell_grid_t *grid = &frame_selection->grid;
+    const atom_selection_t *environment = frame_selection->environment;
+
+    size_t cells[27] = {0};
+    size_t n_cells = grid_neighbor_cells(grid, position, cells);
+    for (size_t c = 0; c < n_cells; ++c) {
+        for (size_t k = grid->cell_start[cells[c]]; k < grid->cell_start[cells[c] + 1]; ++k) {
+            const atom_t *atom = environment->atoms[grid->atoms[k]];
+            if (calc_distance_dim(position, atom->position, dimensionality_xyz, box, 0) <= dynamic->radius) return 1;
+        }
+    }
+
+    return 0;
+}
+
+int dynamic_select(const dynamic_t *dynamic, const atom_selection_t *candidates, system_t *frame, dynamic_frame_t *frame_selection)
+{
+    if (dynamic->type == dynamic_within) {
+        // the environment is located in the analyzed copy of the system
+        atom_selection_t *environment = frame_selection->environment;
+        for (size_t k = 0; k < dynamic->n_environment; ++k) environment->atoms[k] = &frame->atoms[dynamic->environment[k]];
+
+        const int use[3] = { 1, 1, 1 };
+        if (grid_build(&frame_selection->grid, environment, frame->box, dynamic->radius, use) != 0) {
+            fprintf(stderr, "Could not allocate memory for the cell grid.\n");
+            return 1;
+        }
+    }
+
+    size_t n_selected = 0;
+    for (size_t i = 0; i < candidates->n_atoms; ++i) {
+        const float *position = candidates->atoms[i]->position;
+
+        int selected = 0;
+        switch (dynamic->type) {
+        case dynamic_within:
+            selected = near_environment(dynamic, frame_selection, position, frame->box);
+            break;
+        case dynamic_above:
+            selected = position[dynamic->dimension] > dynamic->value;
+            break;
+        case dynamic_below:
+            selected = position[dynamic->dimension] < dynamic->value;
+            break;
+        default:
+            selected = 1;
+            break;
+        }
+
+        if (!selected) continue;
+
+        frame_selection->selected[n_selected] = i;
+        frame_selection->subset->atoms[n_selected] = candidates->atoms[i];
+        ++n_selected;
+    }
+
+    frame_selection->n_selected = n_selected;
+    frame_selection->subset->n_atoms = n_selected;
+    return 0;
+}
@@ -0,0 +1,82 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef DYNAMIC_H
+#define DYNAMIC_H
+
+#include <groan.h>
+#include "grid.h"
+
+/*! @brief Condition selecting the atoms of a dynamic selection in every frame. */
+typedef enum dynamic_type {
+    dynamic_none,               // the selection is static
+    dynamic_within,             // atoms closer than 'radius' to any atom of the environment
+    dynamic_above,              // atoms with coordinate 'dimension' larger than 'value'
+    dynamic_below               // atoms with coordinate 'dimension' smaller than 'value'
+} dynamic_type_t;
+
+/*
+ * Dynamic selection: atoms of a static selection (the candidates) satisfying a geometric condition,
+ * which is evaluated again in every frame.
+ *
+ * Distances to the environment are calculated in all three dimensions respecting periodic boundary conditions.
+ * The atoms of the environment are sorted into a cell grid, so that every candidate is only compared
+ * with the atoms in the neighbouring cells. Coordinates are compared as they are stored in the trajectory.
+ */
+typedef struct dynamic {
+    dynamic_type_t type;
+    float radius;               // nm (dynamic_within)
+    int dimension;              // 0 = x, 1 = y, 2 = z (dynamic_above, dynamic_below)
+    float value;                // nm (dynamic_above, dynamic_below)
+    char *query;                // query of the environment (dynamic_within)
+    size_t *environment;        // indices of the atoms of the environment in the system (see dynamic_resolve)
+    size_t n_environment;
+} dynamic_t;
+
+/*! @brief Static selection. */
+#define DYNAMIC_NONE ((dynamic_t) { .type = dynamic_none, .radius = 0.0f, .dimension = 0, .value = 0.0f, \
+        .query = NULL, .environment = NULL, .n_environment = 0 })
+
+/*! @brief Atoms of the dynamic selection found in a single frame. */
+typedef struct dynamic_frame {
+    size_t *selected;           // indices of the selected candidates (in ascending order)
+    size_t n_selected;
+    atom_selection_t *subset;   // selected atoms
+    atom_selection_t *environment;  // atoms of the environment in the analyzed copy of the system
+    cell_grid_t grid;
+} dynamic_frame_t;
+
+/*
+ * Parses condition of the dynamic selection: 'within DISTANCE of QUERY', 'D > VALUE' or 'D < VALUE',
+ * where D is x, y or z. The query is not copied. Returns zero, if successful, else returns non-zero.
+ */
+int dynamic_parse(char *string, dynamic_t *dynamic);
+
+/*! @brief Writes description of the condition, e.g. "within 0.500 nm of 'Protein'", into 'string'. */
+void dynamic_describe(const dynamic_t *dynamic, char *string, const size_t size);
+
+/*
+ * Stores indices of the atoms of the environment selected from 'system'.
+ * Returns zero, if successful, else returns non-zero.
+ */
+int dynamic_resolve(dynamic_t *dynamic, const atom_selection_t *environment, const system_t *system);
+
+/*! @brief Releases memory allocated by dynamic_resolve. */
+void dynamic_destroy(dynamic_t *dynamic);
+
+/*! @brief Returns the number of leading atoms of the system containing all atoms of the environment. */
+size_t dynamic_extent(const dynamic_t *dynamic);
+
+/*! @brief Allocates buffers for selecting from 'n_candidates' atoms. Returns zero, if successful, else returns non-zero. */
+int dynamic_frame_init(dynamic_frame_t *frame_selection, const dynamic_t *dynamic, const size_t n_candidates);
+
+/*! @brief Releases memory allocated for the buffers. */
+void dynamic_frame_destroy(dynamic_frame_t *frame_selection);
+
+/*
+ * Selects the candidates satisfying the condition in 'frame'. Positions of the candidates must correspond to 'frame'.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int dynamic_select(const dynamic_t *dynamic, const atom_selection_t *candidates, system_t *frame, dynamic_frame_t *frame_selection);
+
+#endif /* DYNAMIC_H */
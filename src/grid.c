@@ -0,0 +1,123 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "grid.h"
+
+void grid_init(cell_grid_t *grid)
+{
+    memset(grid, 0, sizeof(cell_grid_t));
+}
+
+/*! @brief Returns coordinate of the cell containing 'position' in a single dimension. */
+static int cell_coordinate(const float position, const float box, const int n_cells)
+{
+    if (n_cells == 1) return 0;
+
+    // wrap the position into the box
+    float wrapped = position - box * floorf(position / box);
+    int cell = (int) (wrapped / box * n_cells);
+
+    if (cell >= n_cells) cell = n_cells - 1;
+    if (cell < 0) cell = 0;
+    return cell;
+}
+
+/*! @brief Returns index of the cell containing 'position'. */
+static size_t cell_index(const cell_grid_t *grid, const float *position)
+{
+    int x = cell_coordinate(position[0], grid->box[0], grid->n_cells[0]);
+    int y = cell_coordinate(position[1], grid->box[1], grid->n_cells[1]);
+    int z = cell_coordinate(position[2], grid->box[2], grid->n_cells[2]);
+
+    return ((size_t) x * grid->n_cells[1] + y) * grid->n_cells[2] + z;
+}
+
+int grid_build(cell_grid_t *grid, const atom_selection_t *selection, const float *box, const float cutoff, const int use[3])
+{
+    size_t n_cells = 1;
+    for (int d = 0; d < 3; ++d) {
+        grid->box[d] = box[d];
+        grid->n_cells[d] = 1;
+        if (use[d] && cutoff > 0 && box[d] > cutoff) grid->n_cells[d] = (int) (box[d] / cutoff);
+        n_cells *= grid->n_cells[d];
+    }
+
+    if (n_cells + 1 > grid->cells_capacity) {
+        size_t *cell_start = realloc(grid->cell_start, (n_cells + 1) * sizeof(size_t));
+        if (cell_start == NULL) return 1;
+        grid->cell_start = cell_start;
+        grid->cells_capacity = n_cells + 1;
+    }
+
+    if (selection->n_atoms > grid->atoms_capacity) {
+        size_t *atoms = realloc(grid->atoms, selection->n_atoms * sizeof(size_t));
+        if (atoms == NULL) return 1;
+        grid->atoms = atoms;
+
+        size_t *cell_of = realloc(grid->cell_of, selection->n_atoms * sizeof(size_t));
+        if (cell_of == NULL) return 1;
+        grid->cell_of = cell_of;
+
+        grid->atoms_capacity = selection->n_atoms;
+    }
+
+    // counting sort of atoms into cells
+    memset(grid->cell_start, 0, (n_cells + 1) * sizeof(size_t));
+    for (size_t i = 0; i < selection->n_atoms; ++i) {
+        grid->cell_of[i] = cell_index(grid, selection->atoms[i]->position);
+        ++grid->cell_start[grid->cell_of[i] + 1];
+    }
+
+    for (size_t c = 0; c < n_cells; ++c) grid->cell_start[c + 1] += grid->cell_start[c];
+
+    // after the insertion, cell_start of every cell points to the start of the following cell
+    for (size_t i = 0; i < selection->n_atoms; ++i) {
+        grid->atoms[grid->cell_start[grid->cell_of[i]]++] = i;
+    }
+
+    for (size_t c = n_cells; c > 0; --c) grid->cell_start[c] = grid->cell_start[c - 1];
+    grid->cell_start[0] = 0;
+
+    return 0;
+}
+
+size_t grid_neighbor_cells(const cell_grid_t *grid, const float *position, size_t cells[27])
+{
+    int neighbors[3][3] = {{0}};
+    int n_neighbors[3] = {0};
+
+    for (int d = 0; d < 3; ++d) {
+        int n = grid->n_cells[d];
+        if (n < 3) {
+            // all cells are neighbours; listing them explicitly avoids visiting a cell twice
+            for (int c = 0; c < n; ++c) neighbors[d][n_neighbors[d]++] = c;
+        } else {
+            int c = cell_coordinate(position[d], grid->box[d], n);
+            neighbors[d][n_neighbors[d]++] = (c - 1 + n) % n;
+            neighbors[d][n_neighbors[d]++] = c;
+            neighbors[d][n_neighbors[d]++] = (c + 1) % n;
+        }
+    }
+
+    size_t n_cells = 0;
+    for (int x = 0; x < n_neighbors[0]; ++x) {
+        for (int y = 0; y < n_neighbors[1]; ++y) {
+            for (int z = 0; z < n_neighbors[2]; ++z) {
+                cells[n_cells++] = ((size_t) neighbors[0][x] * grid->n_cells[1] + neighbors[1][y]) * grid->n_cells[2] + neighbors[2][z];
+            }
+        }
+    }
+
+    return n_cells;
+}
+
+void grid_destroy(cell_grid_t *grid)
+{
+    free(grid->cell_start);
+    free(grid->atoms);
+    free(grid->cell_of);
+    grid_init(grid);
+}
@@ -0,0 +1,46 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef GRID_H
+#define GRID_H
+
+#include <groan.h>
+
+/*
+ * Cell grid for searching neighbours in a rectangular periodic box.
+ *
+ * Atoms of a selection are sorted into cells with size of at least 'cutoff',
+ * so that all atoms closer than 'cutoff' to a position are located in the cell
+ * containing the position or in the neighbouring cells (including periodic images).
+ * Dimensions that are not used are not divided into cells.
+ */
+typedef struct cell_grid {
+    int n_cells[3];
+    size_t *cell_start;     // index of the first atom of each cell in 'atoms' (n_cells + 1 items)
+    size_t *atoms;          // indices of atoms (in the selection) sorted by cells
+    size_t *cell_of;        // cell of each atom
+    size_t cells_capacity;
+    size_t atoms_capacity;
+    float box[3];
+} cell_grid_t;
+
+/*! @brief Initializes an empty grid. */
+void grid_init(cell_grid_t *grid);
+
+/*
+ * Sorts atoms of the selection into cells.
+ * 'use' specifies dimensions in which the distances are measured.
+ * Returns zero, if successful, else returns non-zero.
+ */
+int grid_build(cell_grid_t *grid, const atom_selection_t *selection, const float *box, const float cutoff, const int use[3]);
+
+/*
+ * Writes indices of the cells that may contain atoms closer than the cutoff to 'position' into 'cells'.
+ * Returns the number of written cells (at most 27).
+ */
+size_t grid_neighbor_cells(const cell_grid_t *grid, const float *position, size_t cells[27]);
+
+/*! @brief Releases memory allocated for the grid. */
+void grid_destroy(cell_grid_t *grid);
+
+#endif /* GRID_H */
@@ -0,0 +1,434 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "groups.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/*! @brief Removes leading and trailing whitespace. Returns pointer to the first non-whitespace character. */
+static char *strip(char *string)
+{
+    while (*string == ' ' || *string == '\t') ++string;
+
+    size_t length = strlen(string);
+    while (length > 0 && strchr(" \t\r\n", string[length - 1]) != NULL) string[--length] = '\0';
+
+    return string;
+}
+
+/*! @brief Appends atom to the last group of the ndx index. Returns zero, if successful, else returns non-zero. */
+static int ndx_append(ndx_index_t *ndx, atom_t *atom, size_t *capacity)
+{
+    size_t n_atoms = ndx->start[ndx->n_groups];
+    if (n_atoms >= *capacity) {
+        size_t new_capacity = *capacity > 0 ? 2 * *capacity : 1024;
+        atom_t **atoms = realloc(ndx->atoms, new_capacity * sizeof(atom_t *));
+        if (atoms == NULL) return 1;
+        ndx->atoms = atoms;
+        *capacity = new_capacity;
+    }
+
+    ndx->atoms[n_atoms] = atom;
+    ++ndx->start[ndx->n_groups];
+    return 0;
+}
+
+/*! @brief Starts a new group of the ndx index. Returns zero, if successful, else returns non-zero. */
+static int ndx_add_group(ndx_index_t *ndx, const char *name)
+{
+    char **names = realloc(ndx->names, (ndx->n_groups + 1) * sizeof(char *));
+    if (names == NULL) return 1;
+    ndx->names = names;
+
+    size_t *start = realloc(ndx->start, (ndx->n_groups + 2) * sizeof(size_t));
+    if (start == NULL) return 1;
+    ndx->start = start;
+
+    ndx->names[ndx->n_groups] = malloc(strlen(name) + 1);
+    if (ndx->names[ndx->n_groups] == NULL) return 1;
+    strcpy(ndx->names[ndx->n_groups], name);
+
+    ++ndx->n_groups;
+    ndx->start[ndx->n_groups] = ndx->start[ndx->n_groups - 1];
+    return 0;
+}
+
+ndx_index_t *ndx_index_read(const char *filename, system_t *system)
+{
+    FILE *file = fopen(filename, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Could not read ndx file %s.\n", filename);
+        return NULL;
+    }
+
+    ndx_index_t *ndx = calloc(1, sizeof(ndx_index_t));
+    if (ndx != NULL) ndx->start = calloc(1, sizeof(size_t));
+    if (ndx == NULL || ndx->start == NULL) {
+        fprintf(stderr, "Could not allocate memory for the ndx groups.\n");
+        ndx_index_destroy(ndx);
+        fclose(file);
+        return NULL;
+    }
+
+    char *line = NULL;
+    size_t line_size = 0, capacity = 0, n_line = 0;
+    int status = 0;
+    while (status == 0 && getline(&line, &line_size, file) >= 0) {
+        ++n_line;
+        char *text = strip(line);
+        if (text[0] == '\0') continue;
+
+        if (text[0] == '[') {
+            char *end = strchr(text, ']');
+            if (end == NULL) {
+                fprintf(stderr, "Could not understand line %zu of ndx file %s.\n", n_line, filename);
+                status = 1;
+                break;
+            }
+            *end = '\0';
+            if (ndx_add_group(ndx, strip(text + 1)) != 0) {
+                fprintf(stderr, "Could not allocate memory for the ndx groups.\n");
+                status = 1;
+            }
+            continue;
+        }
+
+        if (ndx->n_groups == 0) {
+            fprintf(stderr, "Atoms on line %zu of ndx file %s do not belong to any group.\n", n_line, filename);
+            status = 1;
+            break;
+        }
+
+        char *position = text;
+        while (status == 0 && *position != '\0') {
+            char *end = NULL;
+            long index = strtol(position, &end, 10);
+            if (end == position) {
+                fprintf(stderr, "Could not understand line %zu of ndx file %s.\n", n_line, filename);
+                status = 1;
+                break;
+            }
+            position = end;
+            while (*position == ' ' || *position == '\t') ++position;
+
+            if (index < 1 || (size_t) index > system->n_atoms) {
+                fprintf(stderr, "Atom %ld of group '%s' of ndx file %s does not exist.\n", index, ndx->names[ndx->n_groups - 1], filename);
+                status = 1;
+            } else if (ndx_append(ndx, &system->atoms[index - 1], &capacity) != 0) {
+                fprintf(stderr, "Could not allocate memory for the ndx groups.\n");
+                status = 1;
+            }
+        }
+    }
+
+    free(line);
+    fclose(file);
+
+    if (status != 0) {
+        ndx_index_destroy(ndx);
+        return NULL;
+    }
+
+    return ndx;
+}
+
+void ndx_index_destroy(ndx_index_t *ndx)
+{
+    if (ndx == NULL) return;
+
+    for (size_t g = 0; g < ndx->n_groups; ++g) free(ndx->names[g]);
+    free(ndx->names);
+    free(ndx->start);
+    free(ndx->atoms);
+    free(ndx);
+}
+
+dict_t *ndx_index_dict(const ndx_index_t *ndx)
+{
+    dict_t *dict = dict_create();
+    if (dict == NULL) return NULL;
+
+    for (size_t g = 0; g < ndx->n_groups; ++g) {
+        size_t n_atoms = ndx->start[g + 1] - ndx->start[g];
+        size_t size = sizeof(atom_selection_t) + n_atoms * sizeof(atom_t *);
+
+        atom_selection_t *selection = malloc(size);
+        if (selection == NULL) {
+            dict_destroy(dict);
+            return NULL;
+        }
+
+        selection->n_atoms = n_atoms;
+        memcpy(selection->atoms, &ndx->atoms[ndx->start[g]], n_atoms * sizeof(atom_t *));
+
+        // the dictionary stores a copy of the selection
+        dict_set(dict, ndx->names[g], selection, size);
+        free(selection);
+    }
+
+    return dict;
+}
+
+/*! @brief Atom of a selection identified by its address. */
+typedef struct selected_atom {
+    const atom_t *atom;
+    size_t index;               // index of the atom in the selection
+} selected_atom_t;
+
+/*! @brief Compares two atoms by their address. */
+static int compare_selected_atoms(const void *a, const void *b)
+{
+    const atom_t *atom1 = ((const selected_atom_t *) a)->atom;
+    const atom_t *atom2 = ((const selected_atom_t *) b)->atom;
+    return (atom1 > atom2) - (atom1 < atom2);
+}
+
+/*! @brief Returns 1, if the atoms belong to the same residue. Else returns 0. */
+static int same_residue(const atom_t *atom1, const atom_t *atom2)
+{
+    return atom1->residue_number == atom2->residue_number && strcmp(atom1->residue_name, atom2->residue_name) == 0;
+}
+
+/*! @brief Assigns atoms to groups by residue. Returns the number of groups. */
+static size_t assign_residues(const atom_selection_t *selection, size_t *group)
+{
+    size_t n_groups = 0;
+    for (size_t i = 0; i < selection->n_atoms; ++i) {
+        if (i > 0 && !same_residue(selection->atoms[i - 1], selection->atoms[i])) ++n_groups;
+        group[i] = n_groups;
+    }
+
+    return selection->n_atoms > 0 ? n_groups + 1 : 0;
+}
+
+/*
+ * Assigns atoms to groups by residue name, in the order of the first appearance of the name.
+ * Returns the number of groups or (size_t) -1, if memory could not be allocated.
+ */
+static size_t assign_resnames(const atom_selection_t *selection, size_t *group)
+{
+    size_t n_groups = 0;
+    const char **names = malloc(selection->n_atoms * sizeof(char *));
+    if (names == NULL) return (size_t) -1;
+
+    for (size_t i = 0; i < selection->n_atoms; ++i) {
+        const char *name = selection->atoms[i]->residue_name;
+
+        // atoms of the same residue are usually consecutive
+        if (i > 0 && strcmp(selection->atoms[i - 1]->residue_name, name) == 0) {
+            group[i] = group[i - 1];
+            continue;
+        }
+
+        size_t g = 0;
+        while (g < n_groups && strcmp(names[g], name) != 0) ++g;
+        if (g == n_groups) names[n_groups++] = name;
+        group[i] = g;
+    }
+
+    free(names);
+    return n_groups;
+}
+
+/*! @brief Stores atoms of the selection assigned to 'n_groups' groups into the members of the groups. */
+static int store_partition(groups_t *groups, const size_t n_atoms, const size_t *group, const size_t n_groups)
+{
+    groups->n_groups = n_groups;
+    groups->start = calloc(n_groups + 1, sizeof(size_t));
+    groups->members = malloc((n_atoms > 0 ? n_atoms : 1) * sizeof(size_t));
+    if (groups->start == NULL || groups->members == NULL) return 1;
+
+    // counting sort keeps the atoms of every group in the order of the selection
+    for (size_t i = 0; i < n_atoms; ++i) ++groups->start[group[i] + 1];
+    for (size_t g = 0; g < n_groups; ++g) groups->start[g + 1] += groups->start[g];
+
+    size_t *next = malloc((n_groups > 0 ? n_groups : 1) * sizeof(size_t));
+    if (next == NULL) return 1;
+    memcpy(next, groups->start, n_groups * sizeof(size_t));
+    for (size_t i = 0; i < n_atoms; ++i) groups->members[next[group[i]]++] = i;
+    free(next);
+
+    return 0;
+}
+
+/*! @brief Stores atoms of the selection belonging to the ndx groups into the members of the groups. */
+static int store_ndx(groups_t *groups, const atom_selection_t *selection, const ndx_index_t *ndx, size_t **ndx_groups)
+{
+    selected_atom_t *sorted = malloc((selection->n_atoms > 0 ? selection->n_atoms : 1) * sizeof(selected_atom_t));
+    groups->start = calloc(ndx->n_groups + 1, sizeof(size_t));
+    groups->members = malloc((ndx->start[ndx->n_groups] > 0 ? ndx->start[ndx->n_groups] : 1) * sizeof(size_t));
+    *ndx_groups = malloc((ndx->n_groups > 0 ? ndx->n_groups : 1) * sizeof(size_t));
+    if (sorted == NULL || groups->start == NULL || groups->members == NULL || *ndx_groups == NULL) {
+        free(sorted);
+        return 1;
+    }
+
+    for (size_t i = 0; i < selection->n_atoms; ++i) {
+        sorted[i].atom = selection->atoms[i];
+        sorted[i].index = i;
+    }
+    qsort(sorted, selection->n_atoms, sizeof(selected_atom_t), compare_selected_atoms);
+
+    size_t n_members = 0;
+    for (size_t g = 0; g < ndx->n_groups; ++g) {
+        size_t first = n_members;
+        for (size_t a = ndx->start[g]; a < ndx->start[g + 1]; ++a) {
+            selected_atom_t key = { .atom = ndx->atoms[a], .index = 0 };
+            selected_atom_t *found = bsearch(&key, sorted, selection->n_atoms, sizeof(selected_atom_t), compare_selected_atoms);
+            if (found != NULL) groups->members[n_members++] = found->index;
+        }
+
+        // groups without any atom of the selection are skipped
+        if (n_members == first) continue;
+        (*ndx_groups)[groups->n_groups] = g;
+        groups->start[++groups->n_groups] = n_members;
+    }
+
+    free(sorted);
+    return 0;
+}
+
+/*! @brief Prepares pseudo-atoms and labels describing the groups. Returns zero, if successful, else returns non-zero. */
+static int describe_groups(groups_t *groups, const atom_selection_t *selection, const ndx_index_t *ndx, const size_t *ndx_groups)
+{
+    const size_t n_groups = groups->n_groups;
+    groups->atoms = calloc(n_groups > 0 ? n_groups : 1, sizeof(atom_t));
+    groups->description = malloc(sizeof(atom_selection_t) + n_groups * sizeof(atom_t *));
+    groups->labels.offsets = malloc((n_groups + 1) * sizeof(size_t));
+    if (groups->atoms == NULL || groups->description == NULL || groups->labels.offsets == NULL) return 1;
+
+    text_buffer_t buffer;
+    text_init(&buffer);
+
+    groups->description->n_atoms = n_groups;
+    for (size_t g = 0; g < n_groups; ++g) {
+        atom_t *atom = &groups->atoms[g];
+        *atom = *selection->atoms[groups->members[groups->start[g]]];
+        atom->atom_number = (int) (g + 1);
+        groups->description->atoms[g] = atom;
+
+        char label[512];
+        int length = 0;
+        switch (groups->by) {
+        case group_residue:
+            length = snprintf(label, sizeof(label), "Residue %s (resid: %d):", atom->residue_name, atom->residue_number);
+            break;
+        case group_resname:
+            length = snprintf(label, sizeof(label), "Residues %s:", atom->residue_name);
+            break;
+        default:
+            length = snprintf(label, sizeof(label), "Group %s:", ndx->names[ndx_groups[g]]);
+            break;
+        }
+        if (length < 0 || (size_t) length >= sizeof(label)) length = snprintf(label, sizeof(label), "Group %zu:", g + 1);
+
+        groups->labels.offsets[g] = buffer.length;
+        text_append(&buffer, label, (size_t) length);
+    }
+    groups->labels.offsets[n_groups] = buffer.length;
+    groups->labels.n_labels = n_groups;
+    groups->labels.data = buffer.data;
+
+    return buffer.failed;
+}
+
+groups_t *groups_create(const atom_selection_t *selection, const group_by_t by, const ndx_index_t *ndx)
+{
+    groups_t *groups = calloc(1, sizeof(groups_t));
+    if (groups == NULL) return NULL;
+    groups->by = by;
+
+    int status = 0;
+    size_t *ndx_groups = NULL;
+    if (by == group_ndx) {
+        status = store_ndx(groups, selection, ndx, &ndx_groups);
+    } else {
+        size_t *group = malloc((selection->n_atoms > 0 ? selection->n_atoms : 1) * sizeof(size_t));
+        size_t n_groups = 0;
+        if (group == NULL) status = 1;
+        else if (by == group_residue) n_groups = assign_residues(selection, group);
+        else n_groups = assign_resnames(selection, group);
+
+        if (status == 0 && n_groups == (size_t) -1) status = 1;
+        if (status == 0) status = store_partition(groups, selection->n_atoms, group, n_groups);
+        free(group);
+    }
+
+    if (status == 0) status = describe_groups(groups, selection, ndx, ndx_groups);
+    free(ndx_groups);
+
+    if (status != 0) {
+        groups_destroy(groups);
+        return NULL;
+    }
+
+    return groups;
+}
+
+void groups_centers(const groups_t *groups, const atom_selection_t *selection, const box_t box, atom_selection_t *centers)
+{
+    // every coordinate is mapped onto a circle and the center is the average angle (Bai & Breen, 2008)
+    double scale[3] = { 0.0 };
+    for (int d = 0; d < 3; ++d) scale[d] = 2.0 * M_PI / box[d];
+
+    for (size_t g = 0; g < groups->n_groups; ++g) {
+        double sum_cos[3] = { 0.0 }, sum_sin[3] = { 0.0 };
+        for (size_t m = groups->start[g]; m < groups->start[g + 1]; ++m) {
+            const float *position = selection->atoms[groups->members[m]]->position;
+            for (int d = 0; d < 3; ++d) {
+                double theta = position[d] * scale[d];
+                sum_cos[d] += cos(theta);
+                sum_sin[d] += sin(theta);
+            }
+        }
+
+        const double n_members = (double) (groups->start[g + 1] - groups->start[g]);
+        for (int d = 0; d < 3; ++d) {
+            double theta = atan2(-sum_sin[d] / n_members, -sum_cos[d] / n_members) + M_PI;
+            centers->atoms[g]->position[d] = (float) (theta / scale[d]);
+        }
+    }
+}
+
+void groups_destroy(groups_t *groups)
+{
+    if (groups == NULL) return;
+
+    free(groups->start);
+    free(groups->members);
+    free(groups->atoms);
+    free(groups->description);
+    text_labels_destroy(&groups->labels);
+    free(groups);
+}
+
+static const char *GROUP_NAMES[] = { "none", "resid", "resname", "ndx" };
+
+int groups_parse(const char *string, group_by_t *by)
+{
+    for (int i = group_residue; i <= group_ndx; ++i) {
+        if (strcmp(string, GROUP_NAMES[i]) == 0) {
+            *by = (group_by_t) i;
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+const char *groups_name(const group_by_t by)
+{
+    return GROUP_NAMES[by];
+}
+
+static const char *GROUP_ITEMS[] = { "atoms", "residue centers", "residue name centers", "ndx group centers" };
+
+const char *groups_items(const group_by_t by)
+{
+    return GROUP_ITEMS[by];
+}
@@ -0,0 +1,87 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef GROUPS_H
+#define GROUPS_H
+
+#include <groan.h>
+#include "text.h"
+
+/*! @brief Property by which the atoms of a selection are grouped. */
+typedef enum group_by {
+    group_none,                 // atoms are not grouped
+    group_residue,              // consecutive atoms with the same residue number and name
+    group_resname,              // all atoms with the same residue name
+    group_ndx                   // atoms of every group of the ndx file
+} group_by_t;
+
+/*! @brief Groups of atoms read from an ndx file. */
+typedef struct ndx_index {
+    size_t n_groups;
+    char **names;
+    size_t *start;              // atoms of group g are atoms[start[g]] to atoms[start[g + 1] - 1]
+    atom_t **atoms;
+} ndx_index_t;
+
+/*
+ * Atoms of a selection divided into groups.
+ *
+ * Members of all groups are stored one group after another, so the centers of all groups
+ * are calculated in a single pass through the members (see groups_centers). Groups by residue
+ * or residue name divide the selection; ndx groups may overlap and only contain the atoms of the selection.
+ *
+ * Every group is described by a pseudo-atom of the 'description' selection: the pseudo-atom copies
+ * the names and the residue of the first member of the group and its atom number is the number of the group.
+ */
+typedef struct groups {
+    group_by_t by;
+    size_t n_groups;
+    size_t *start;              // members of group g are members[start[g]] to members[start[g + 1] - 1]
+    size_t *members;            // indices of the atoms in the selection
+    atom_t *atoms;              // pseudo-atoms describing the groups
+    atom_selection_t *description;
+    text_labels_t labels;       // labels of the groups, e.g. 'Residue POPC (resid: 12):'
+} groups_t;
+
+/*
+ * Reads groups of atoms from an ndx file.
+ * Returns NULL, if the file could not be read or refers to atoms that are not in the system.
+ */
+ndx_index_t *ndx_index_read(const char *filename, system_t *system);
+
+/*! @brief Releases memory allocated for the ndx groups. */
+void ndx_index_destroy(ndx_index_t *ndx);
+
+/*
+ * Creates dictionary of the ndx groups with the same content as the dictionary returned by read_ndx,
+ * so it can be supplied to smart_select. Returns NULL, if memory could not be allocated.
+ */
+dict_t *ndx_index_dict(const ndx_index_t *ndx);
+
+/*
+ * Groups atoms of the selection. 'ndx' is only used when grouping by ndx groups;
+ * ndx groups without any atom of the selection are skipped.
+ * Returns NULL, if memory could not be allocated.
+ */
+groups_t *groups_create(const atom_selection_t *selection, const group_by_t by, const ndx_index_t *ndx);
+
+/*
+ * Calculates center of geometry of every group of atoms of 'selection' and stores it
+ * as position of the corresponding atom of 'centers'.
+ * Periodic boundary conditions are handled in the same way as by center_of_geometry.
+ */
+void groups_centers(const groups_t *groups, const atom_selection_t *selection, const box_t box, atom_selection_t *centers);
+
+/*! @brief Releases memory allocated for the groups. */
+void groups_destroy(groups_t *groups);
+
+/*! @brief Parses property of grouping (resid, resname or ndx). Returns zero, if successful, else returns non-zero. */
+int groups_parse(const char *string, group_by_t *by);
+
+/*! @brief Returns name of the grouping, as used on the command line. */
+const char *groups_name(const group_by_t by);
+
+/*! @brief Returns description of the analysed items, e.g. 'residue centers' ('atoms', if not grouped). */
+const char *groups_items(const group_by_t by);
+
+#endif /* GROUPS_H */
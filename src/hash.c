@@ -0,0 +1,64 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "hash.h"
+
+// size of the chunks in which the files are hashed
+static const size_t HASH_CHUNK = 1 << 20;
+
+// prime of the 64-bit FNV-1a hash
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+uint64_t hash_bytes(uint64_t hash, const void *bytes, const size_t length)
+{
+    const unsigned char *data = (const unsigned char *) bytes;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/*! @brief Hashes the file from 'offset' to its end (if 'length' is negative) or 'length' bytes. */
+static int hash_stream(const char *filename, const off_t offset, const off_t length, uint64_t *hash)
+{
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) return 1;
+
+    unsigned char *chunk = malloc(HASH_CHUNK);
+    if (chunk == NULL || fseeko(file, offset, SEEK_SET) != 0) {
+        free(chunk);
+        fclose(file);
+        return 1;
+    }
+
+    *hash = HASH_INIT;
+    off_t remaining = length;
+    size_t n_read = 0;
+    while (remaining != 0) {
+        size_t request = remaining > 0 && (size_t) remaining < HASH_CHUNK ? (size_t) remaining : HASH_CHUNK;
+        if ((n_read = fread(chunk, 1, request, file)) == 0) break;
+
+        *hash = hash_bytes(*hash, chunk, n_read);
+        if (remaining > 0) remaining -= (off_t) n_read;
+    }
+
+    int status = ferror(file) != 0 || remaining > 0;
+    free(chunk);
+    fclose(file);
+    return status;
+}
+
+int hash_file(const char *filename, uint64_t *hash)
+{
+    return hash_stream(filename, 0, -1, hash);
+}
+
+int hash_file_range(const char *filename, const off_t offset, const off_t length, uint64_t *hash)
+{
+    if (offset < 0 || length < 0) return 1;
+    return hash_stream(filename, offset, length, hash);
+}
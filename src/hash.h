@@ -0,0 +1,31 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * 64-bit FNV-1a hashes used to recognize input files and analyses in the files
+ * stored for later runs (selection cache, checkpoints).
+ */
+
+/*! @brief Initial value of the hash. */
+#define HASH_INIT 14695981039346656037ULL
+
+/*! @brief Adds 'length' bytes to the hash and returns the new hash. */
+uint64_t hash_bytes(uint64_t hash, const void *bytes, const size_t length);
+
+/*! @brief Calculates hash of the content of the file. Returns zero, if successful, else returns non-zero. */
+int hash_file(const char *filename, uint64_t *hash);
+
+/*
+ * Calculates hash of 'length' bytes of the file starting at 'offset'.
+ * Returns zero, if successful. Returns non-zero, if the file could not be read or is too short.
+ */
+int hash_file_range(const char *filename, const off_t offset, const off_t length, uint64_t *hash);
+
+#endif /* HASH_H */
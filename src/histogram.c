@@ -0,0 +1,44 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdlib.h>
+#include <math.h>
+#include "histogram.h"
+
+// tolerance for ranges which are a multiple of the bin width up to the rounding errors
+static const double BINS_TOLERANCE = 1e-6;
+
+int histogram_init(histogram_t *histogram, const double min, const double max, const double width)
+{
+    histogram->min = min;
+    histogram->width = width;
+    histogram->below = 0;
+    histogram->above = 0;
+    histogram->counts = NULL;
+
+    if (!(width > 0.0) || !(max > min)) return 1;
+
+    histogram->n_bins = (size_t) ceil((max - min) / width - BINS_TOLERANCE);
+    if (histogram->n_bins == 0) histogram->n_bins = 1;
+
+    histogram->counts = calloc(histogram->n_bins, sizeof(size_t));
+    return histogram->counts == NULL;
+}
+
+size_t histogram_total(const histogram_t *histogram)
+{
+    size_t total = histogram->below + histogram->above;
+    for (size_t i = 0; i < histogram->n_bins; ++i) total += histogram->counts[i];
+    return total;
+}
+
+double histogram_center(const histogram_t *histogram, const size_t bin)
+{
+    return histogram->min + (bin + 0.5) * histogram->width;
+}
+
+void histogram_destroy(histogram_t *histogram)
+{
+    free(histogram->counts);
+    histogram->counts = NULL;
+}
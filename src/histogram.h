@@ -0,0 +1,58 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stddef.h>
+
+/*
+ * Histogram of values with bins of constant width.
+ * The last bin also contains values equal to its upper edge.
+ */
+typedef struct histogram {
+    double min;             // lower edge of the first bin
+    double width;           // width of the bins
+    size_t n_bins;
+    size_t *counts;
+    size_t below;           // number of values smaller than the lower edge of the first bin
+    size_t above;           // number of values larger than the upper edge of the last bin
+} histogram_t;
+
+/*
+ * Prepares histogram covering values from 'min' to 'max' using bins of the given width.
+ * If the range is not a multiple of the width, the last bin extends beyond 'max'.
+ * Returns zero, if successful, else returns non-zero.
+ */
+int histogram_init(histogram_t *histogram, const double min, const double max, const double width);
+
+/*! @brief Adds value to the histogram. */
+static inline void histogram_add(histogram_t *histogram, const float value)
+{
+    double offset = (value - histogram->min) / histogram->width;
+
+    // also catches NaN
+    if (!(offset >= 0.0)) {
+        ++histogram->below;
+        return;
+    }
+
+    if (offset >= (double) histogram->n_bins) {
+        if (offset == (double) histogram->n_bins) ++histogram->counts[histogram->n_bins - 1];
+        else ++histogram->above;
+        return;
+    }
+
+    ++histogram->counts[(size_t) offset];
+}
+
+/*! @brief Returns the total number of values added to the histogram. */
+size_t histogram_total(const histogram_t *histogram);
+
+/*! @brief Returns center of the bin. */
+double histogram_center(const histogram_t *histogram, const size_t bin);
+
+/*! @brief Releases memory allocated for the histogram. */
+void histogram_destroy(histogram_t *histogram);
+
+#endif /* HISTOGRAM_H */
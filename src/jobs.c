@@ -0,0 +1,160 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "jobs.h"
+
+/*! @brief Releases memory owned by the job. */
+static void job_destroy(job_t *job)
+{
+    free(job->text);
+    free(job->argv);
+    free(job->arguments);
+}
+
+/*
+ * Splits the line into arguments. Quotes are removed and comments are skipped.
+ * 'end' is set to the length of the line without the comment.
+ * Returns zero, if successful. Returns non-zero, if a quote is not terminated or memory could not be allocated.
+ */
+static int split_line(const char *line, job_t *job, size_t *end)
+{
+    size_t length = strlen(line);
+
+    // every argument is followed by at least one character in the line (or the terminating null)
+    job->arguments = malloc(length + 1);
+    job->argv = malloc((length / 2 + 1) * sizeof(char *));
+    if (job->arguments == NULL || job->argv == NULL) {
+        fprintf(stderr, "Could not allocate memory for the job file.\n");
+        return 1;
+    }
+
+    char *write = job->arguments;
+    const char *read = line;
+    while (1) {
+        while (isspace((unsigned char) *read)) ++read;
+        if (*read == '\0' || *read == '#') break;
+
+        job->argv[job->argc++] = write;
+        while (*read != '\0' && !isspace((unsigned char) *read)) {
+            if (*read == '"' || *read == '\'') {
+                const char quote = *read++;
+                while (*read != '\0' && *read != quote) *write++ = *read++;
+                if (*read == '\0') {
+                    fprintf(stderr, "Quote is not terminated on line %zu of the job file.\n", job->line);
+                    return 1;
+                }
+            } else {
+                *write++ = *read;
+            }
+            ++read;
+        }
+        *write++ = '\0';
+        *end = read - line;
+    }
+
+    return 0;
+}
+
+/*! @brief Returns copy of the first 'length' characters of the line without leading and trailing whitespace. */
+static char *trim_line(const char *line, size_t length)
+{
+    while (length > 0 && isspace((unsigned char) *line)) {
+        ++line;
+        --length;
+    }
+
+    while (length > 0 && isspace((unsigned char) line[length - 1])) --length;
+
+    char *trimmed = malloc(length + 1);
+    if (trimmed == NULL) return NULL;
+
+    memcpy(trimmed, line, length);
+    trimmed[length] = '\0';
+    return trimmed;
+}
+
+job_list_t *jobs_read(const char *filename)
+{
+    FILE *file = fopen(filename, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Job file %s could not be read.\n", filename);
+        return NULL;
+    }
+
+    job_list_t *jobs = calloc(1, sizeof(job_list_t));
+    if (jobs == NULL) {
+        fclose(file);
+        return NULL;
+    }
+
+    char *line = NULL;
+    size_t line_capacity = 0;
+    size_t capacity = 0;
+    int status = 0;
+    for (size_t number = 1; getline(&line, &line_capacity, file) != -1; ++number) {
+        job_t job = { .line = number };
+        size_t end = 0;
+
+        if (split_line(line, &job, &end) != 0) {
+            job_destroy(&job);
+            status = 1;
+            break;
+        }
+
+        // skip empty lines and comments
+        if (job.argc == 0) {
+            job_destroy(&job);
+            continue;
+        }
+
+        job.text = trim_line(line, end);
+        if (job.text == NULL) {
+            fprintf(stderr, "Could not allocate memory for the job file.\n");
+            job_destroy(&job);
+            status = 1;
+            break;
+        }
+
+        if (jobs->n_jobs == capacity) {
+            capacity = capacity == 0 ? 16 : 2 * capacity;
+            job_t *resized = realloc(jobs->jobs, capacity * sizeof(job_t));
+            if (resized == NULL) {
+                fprintf(stderr, "Could not allocate memory for the job file.\n");
+                job_destroy(&job);
+                status = 1;
+                break;
+            }
+            jobs->jobs = resized;
+        }
+
+        jobs->jobs[jobs->n_jobs++] = job;
+    }
+
+    free(line);
+    fclose(file);
+
+    if (status == 0 && jobs->n_jobs == 0) {
+        fprintf(stderr, "Job file %s contains no analyses.\n", filename);
+        status = 1;
+    }
+
+    if (status != 0) {
+        jobs_destroy(jobs);
+        return NULL;
+    }
+
+    return jobs;
+}
+
+void jobs_destroy(job_list_t *jobs)
+{
+    if (jobs == NULL) return;
+
+    for (size_t i = 0; i < jobs->n_jobs; ++i) job_destroy(&jobs->jobs[i]);
+    free(jobs->jobs);
+    free(jobs);
+}
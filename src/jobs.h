@@ -0,0 +1,36 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stddef.h>
+
+/*! @brief Single analysis specified by a line of the job file. */
+typedef struct job {
+    size_t line;            // number of the line in the job file
+    char *text;             // the line without the comment and leading and trailing whitespace
+    int argc;
+    char **argv;            // command line arguments of the analysis (without the program name)
+    char *arguments;        // storage of the arguments
+} job_t;
+
+/*
+ * Analyses listed in a job file.
+ *
+ * Every non-empty line of the job file specifies a single analysis using the command line options
+ * of posdist, e.g. '-a Protein -b "resname POPC" -w -t -o dist.dat'. Arguments are separated
+ * by whitespace and can be enclosed in single or double quotes. Text following '#' is a comment.
+ */
+typedef struct job_list {
+    size_t n_jobs;
+    job_t *jobs;
+} job_list_t;
+
+/*! @brief Reads and splits the lines of a job file. Returns NULL, if the file could not be read. */
+job_list_t *jobs_read(const char *filename);
+
+/*! @brief Releases memory allocated for the job list. */
+void jobs_destroy(job_list_t *jobs);
+
+#endif /* JOBS_H */
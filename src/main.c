@@ -2,10 +2,15 @@
 // Copyright (c) 2022 Ladislav Bartos
 
 #include <unistd.h>
+#include <string.h>
+#include <getopt.h>
 #include <groan.h>
-
-// frequency of printing during the calculation
-static const int PROGRESS_FREQ = 10000;
+#include "analysis.h"
+#include "trajectory.h"
+#include "jobs.h"
+#include "shard.h"
+#include "checkpoint.h"
+#include "calc.h"
 
 /*
  * Parses command line arguments.
@@ -23,14 +28,59 @@ int get_arguments(
         char **selection2,
         int *timewise,
         int *whole,
-        int *reference)
+        int *reference,
+        int *n_threads,
+        frame_window_t *window,
+        analysis_options_t *options,
+        char **job_file,
+        int *profile,
+        char **profile_json,
+        char **cache_dir,
+        char **snapshot_file,
+        char **checkpoint_file,
+        float *checkpoint_interval)
 {
-    int gro_specified = 0, selection1_specified = 0;
+    int gro_specified = 0, selection1_specified = 0, analysis_specified = 0, interval_specified = 0;
 
     int x = 0, y = 0, z = 0;
 
+    // options without short variants
+    enum { opt_begin = 256, opt_end, opt_dt, opt_stride, opt_follow, opt_mmap, opt_shard, opt_part, opt_checkpoint, opt_checkpoint_interval, opt_cutoff, opt_min, opt_contacts, opt_top, opt_triangle, opt_stats, opt_hist, opt_density, opt_group, opt_dynamic, opt_memory, opt_jobs, opt_profile, opt_profile_json, opt_cache, opt_snapshot };
+    static const struct option long_options[] = {
+        {"begin",  required_argument, NULL, opt_begin},
+        {"end",    required_argument, NULL, opt_end},
+        {"dt",     required_argument, NULL, opt_dt},
+        {"stride", required_argument, NULL, opt_stride},
+        {"follow", required_argument, NULL, opt_follow},
+        {"mmap",   no_argument,       NULL, opt_mmap},
+        {"shard",  required_argument, NULL, opt_shard},
+        {"part",   required_argument, NULL, opt_part},
+        {"checkpoint", required_argument, NULL, opt_checkpoint},
+        {"checkpoint-interval", required_argument, NULL, opt_checkpoint_interval},
+        {"cutoff", required_argument, NULL, opt_cutoff},
+        {"min",    no_argument,       NULL, opt_min},
+        {"contacts", required_argument, NULL, opt_contacts},
+        {"top",    required_argument, NULL, opt_top},
+        {"triangle", no_argument,     NULL, opt_triangle},
+        {"stats",  required_argument, NULL, opt_stats},
+        {"hist",   required_argument, NULL, opt_hist},
+        {"density", no_argument,      NULL, opt_density},
+        {"group",  required_argument, NULL, opt_group},
+        {"dynamic", required_argument, NULL, opt_dynamic},
+        {"memory", required_argument, NULL, opt_memory},
+        {"jobs",   required_argument, NULL, opt_jobs},
+        {"profile", no_argument,      NULL, opt_profile},
+        {"profile-json", required_argument, NULL, opt_profile_json},
+        {"cache",  required_argument, NULL, opt_cache},
+        {"snapshot", required_argument, NULL, opt_snapshot},
+        {NULL, 0, NULL, 0}
+    };
+
     int opt = 0;
-    while((opt = getopt(argc, argv, "c:f:n:o:s:a:b:xyzhtwr")) != -1) {
+    while((opt = getopt_long(argc, argv, "c:f:n:o:s:a:b:j:xyzhtwr", long_options, NULL)) != -1) {
+        // options specifying the analysis (used to reject them together with a job file)
+        if ((opt < 256 && strchr("osabxyztwr", opt) != NULL) || (opt >= opt_cutoff && opt <= opt_memory)) analysis_specified = 1;
+
         switch (opt) {
         // help
         case 'h':
@@ -80,6 +130,171 @@ int get_arguments(
         case 'r':
             *reference = 1;
             break;
+        // number of threads
+        case 'j':
+            if (sscanf(optarg, "%d", n_threads) != 1 || *n_threads < 1) {
+                fprintf(stderr, "Could not understand number of threads '%s'.\n", optarg);
+                return 1;
+            }
+            break;
+        // time of the first frame to analyze
+        case opt_begin:
+            if (sscanf(optarg, "%f", &window->begin) != 1 || window->begin < 0) {
+                fprintf(stderr, "Could not understand time of the first frame '%s'.\n", optarg);
+                return 1;
+            }
+            break;
+        // time of the last frame to analyze
+        case opt_end:
+            if (sscanf(optarg, "%f", &window->end) != 1 || window->end < 0) {
+                fprintf(stderr, "Could not understand time of the last frame '%s'.\n", optarg);
+                return 1;
+            }
+            break;
+        // time between the analyzed frames
+        case opt_dt:
+            if (sscanf(optarg, "%f", &window->dt) != 1 || window->dt <= 0) {
+                fprintf(stderr, "Could not understand time step '%s'.\n", optarg);
+                return 1;
+            }
+            break;
+        // analyze every n-th frame
+        case opt_stride:
+            if (sscanf(optarg, "%d", &window->stride) != 1 || window->stride < 1) {
+                fprintf(stderr, "Could not understand stride '%s'.\n", optarg);
+                return 1;
+            }
+            break;
+        // keep reading frames appended to the trajectory
+        case opt_follow:
+            if (sscanf(optarg, "%f", &window->follow) != 1 || window->follow <= 0) {
+                fprintf(stderr, "Could not understand follow time '%s'.\n", optarg);
+                return 1;
+            }
+            break;
+        // read the trajectory through a memory map
+        case opt_mmap:
+            window->mmap = 1;
+            break;
+        // only analyze a slice of the frames and write partial results
+        case opt_shard:
+        // analyze one of several xtc files of the trajectory and write partial results
+        case opt_part:
+            if (window->shard > 0) {
+                fprintf(stderr, "Only one of the options --shard and --part can be used.\n");
+                return 1;
+            }
+            if (shard_parse(optarg, &window->shard, &window->n_shards) != 0) {
+                fprintf(stderr, "Could not understand shard '%s'. Use I/N with 1 <= I <= N.\n", optarg);
+                return 1;
+            }
+            window->parts = opt == opt_part;
+            break;
+        // save the analyses periodically and continue from the saved state
+        case opt_checkpoint:
+            *checkpoint_file = optarg;
+            break;
+        // time between saving the checkpoint
+        case opt_checkpoint_interval:
+            if (sscanf(optarg, "%f", checkpoint_interval) != 1 || *checkpoint_interval <= 0) {
+                fprintf(stderr, "Could not understand checkpoint interval '%s'.\n", optarg);
+                return 1;
+            }
+            interval_specified = 1;
+            break;
+        // only consider pairs of atoms closer than cutoff
+        case opt_cutoff:
+            if (sscanf(optarg, "%f", &options->cutoff) != 1 || options->cutoff <= 0) {
+                fprintf(stderr, "Could not understand cutoff '%s'.\n", optarg);
+                return 1;
+            }
+            break;
+        // calculate minimum distance between the selections
+        case opt_min:
+            options->minimum = 1;
+            break;
+        // count pairs of atoms closer than the contact radius
+        case opt_contacts:
+            if (sscanf(optarg, "%f", &options->contacts) != 1 || options->contacts <= 0) {
+                fprintf(stderr, "Could not understand contact radius '%s'.\n", optarg);
+                return 1;
+            }
+            break;
+        // only write the closest pairs of atoms
+        case opt_top: {
+            int top = 0;
+            if (sscanf(optarg, "%d", &top) != 1 || top < 1) {
+                fprintf(stderr, "Could not understand number of pairs '%s'.\n", optarg);
+                return 1;
+            }
+            options->top = (size_t) top;
+            break;
+        }
+        // only consider pairs i < j of identical selections
+        case opt_triangle:
+            options->triangle = 1;
+            break;
+        // statistics written next to the averages
+        case opt_stats:
+            if (stats_parse(optarg, &options->stats) != 0) {
+                fprintf(stderr, "Could not understand statistics '%s'. Use a comma-separated list of std, min, max, err or all.\n", optarg);
+                return 1;
+            }
+            break;
+        // histogram of the values
+        case opt_hist:
+            if (sscanf(optarg, "%f,%f,%f", &options->hist_min, &options->hist_max, &options->hist_width) != 3 ||
+                options->hist_width <= 0 || options->hist_max <= options->hist_min) {
+                fprintf(stderr, "Could not understand histogram '%s'. Use MIN,MAX,WIDTH with MIN < MAX and WIDTH > 0.\n", optarg);
+                return 1;
+            }
+            break;
+        // write histogram as a probability density
+        case opt_density:
+            options->hist_density = 1;
+            break;
+        // analyze centers of groups of atoms
+        case opt_group:
+            if (groups_parse(optarg, &options->group) != 0) {
+                fprintf(stderr, "Could not understand grouping '%s'. Use resid, resname or ndx.\n", optarg);
+                return 1;
+            }
+            break;
+        // select atoms of selection 1 in every frame
+        case opt_dynamic:
+            if (dynamic_parse(optarg, &options->dynamic) != 0) {
+                fprintf(stderr, "Could not understand dynamic selection '%s'. Use 'within DISTANCE of QUERY', 'D > VALUE' or 'D < VALUE' with D being x, y or z.\n", optarg);
+                return 1;
+            }
+            break;
+        // memory budget of the averaged distances between all pairs of atoms
+        case opt_memory:
+            if (tiles_parse_size(optarg, &options->memory) != 0) {
+                fprintf(stderr, "Could not understand memory size '%s'. Use e.g. 512M or 4G.\n", optarg);
+                return 1;
+            }
+            break;
+        // file with analyses to perform in a single pass
+        case opt_jobs:
+            *job_file = optarg;
+            break;
+        // report timing of the calculation
+        case opt_profile:
+            *profile = 1;
+            break;
+        // also write the timing report as JSON
+        case opt_profile_json:
+            *profile = 1;
+            *profile_json = optarg;
+            break;
+        // directory with cached selections
+        case opt_cache:
+            *cache_dir = optarg;
+            break;
+        // write snapshot of the system
+        case opt_snapshot:
+            *snapshot_file = optarg;
+            break;
         default:
             //fprintf(stderr, "Unknown command line option: %c.\n", opt);
             return 1;
@@ -95,6 +310,17 @@ int get_arguments(
     else if (y == 1)     *dim = dimensionality_y;
     else                 *dim = dimensionality_z;
 
+    if (*job_file != NULL && analysis_specified) {
+        fprintf(stderr, "Analyses must be specified in the job file (--jobs). Only options -c, -f, -n, -j, --begin, --end, --dt, --stride, --follow, --mmap, --checkpoint, --checkpoint-interval, --profile, --profile-json and --cache can be used on the command line.\n");
+        return 1;
+    }
+
+    if (*snapshot_file != NULL && (analysis_specified || *job_file != NULL || *xtc_file != NULL || *n_threads != 1 ||
+        !frame_window_is_all(window) || window->shard > 0 || window->mmap || *profile || *cache_dir != NULL || *checkpoint_file != NULL)) {
+        fprintf(stderr, "Only options -c and -n can be used together with option --snapshot.\n");
+        return 1;
+    }
+
     if (*selection2 != NULL && *selection1 == NULL) {
         fprintf(stderr, "Selection 2 (-b) cannot be specified, unless selection 1 (-a / -s) is also specified.\n");
         return 1;
@@ -110,7 +336,148 @@ int get_arguments(
         return 1;
     }
 
-    if (!gro_specified || !selection1_specified) {
+    if (window->shard > 0 && *xtc_file == NULL) {
+        fprintf(stderr, "Options --shard and --part require an xtc file.\n");
+        return 1;
+    }
+
+    if (interval_specified && *checkpoint_file == NULL) {
+        fprintf(stderr, "Option --checkpoint-interval can only be used together with option --checkpoint.\n");
+        return 1;
+    }
+
+    if (*checkpoint_file != NULL && *xtc_file == NULL) {
+        fprintf(stderr, "Option --checkpoint requires an xtc file.\n");
+        return 1;
+    }
+
+    if (!frame_window_is_all(window) && *xtc_file == NULL) {
+        fprintf(stderr, "Frames to analyze were specified but no xtc file was supplied.\n");
+        return 1;
+    }
+
+    if (window->follow > 0 && *xtc_file == NULL) {
+        fprintf(stderr, "Option --follow requires an xtc file.\n");
+        return 1;
+    }
+
+    if (window->mmap && *xtc_file == NULL) {
+        fprintf(stderr, "Option --mmap requires an xtc file.\n");
+        return 1;
+    }
+
+    if (window->follow > 0 && !frame_window_is_all(window)) {
+        fprintf(stderr, "Option --follow cannot be combined with --begin, --end, --dt, --stride or --shard.\n");
+        return 1;
+    }
+
+    if (window->end >= 0 && window->end < window->begin) {
+        fprintf(stderr, "Time of the last frame (--end) must not be smaller than the time of the first frame (--begin).\n");
+        return 1;
+    }
+
+    if (options->cutoff > 0 && (*selection2 == NULL || *whole || *reference)) {
+        fprintf(stderr, "Cutoff (--cutoff) can only be used for distances between atoms of two selections.\n");
+        return 1;
+    }
+
+    int n_reductions = options->minimum + (options->contacts > 0) + (options->top > 0);
+    if (n_reductions > 0 && (*selection2 == NULL || *whole || *reference)) {
+        fprintf(stderr, "Options --min, --contacts and --top can only be used for distances between atoms of two selections.\n");
+        return 1;
+    }
+
+    if (n_reductions > 1) {
+        fprintf(stderr, "Only one of the options --min, --contacts and --top can be used.\n");
+        return 1;
+    }
+
+    if (options->triangle && (*selection2 == NULL || *whole || *reference)) {
+        fprintf(stderr, "Option --triangle can only be used for distances between atoms of two identical selections.\n");
+        return 1;
+    }
+
+    if (options->contacts > 0 && options->cutoff > 0) {
+        fprintf(stderr, "Options --contacts and --cutoff cannot be combined. The contact radius is used as the cutoff.\n");
+        return 1;
+    }
+
+    if (options->top > 0 && *timewise) {
+        fprintf(stderr, "Option --top cannot be combined with the timewise option (-t).\n");
+        return 1;
+    }
+
+    if (options->top > 0 && npy_is_npy(*output_file)) {
+        fprintf(stderr, "Binary output is not supported for the closest pairs of atoms (--top).\n");
+        return 1;
+    }
+
+    if (options->cutoff > 0 && !options->minimum && npy_is_npy(*output_file)) {
+        fprintf(stderr, "Binary output is not supported for distances calculated with a cutoff (--cutoff).\n");
+        return 1;
+    }
+
+    if (options->stats && (*timewise || *xtc_file == NULL)) {
+        fprintf(stderr, "Option --stats can only be used for properties averaged over a trajectory (requires -f, not -t).\n");
+        return 1;
+    }
+
+    if (options->hist_density && options->hist_width <= 0) {
+        fprintf(stderr, "Option --density can only be used together with option --hist.\n");
+        return 1;
+    }
+
+    if (options->hist_width > 0 && (*timewise || options->top > 0 || options->stats || npy_is_npy(*output_file))) {
+        fprintf(stderr, "Option --hist cannot be combined with the timewise option (-t), --top, --stats or binary output.\n");
+        return 1;
+    }
+
+    if (options->stats && ((options->cutoff > 0 && !options->minimum) || options->top > 0)) {
+        fprintf(stderr, "Option --stats cannot be combined with --cutoff (unless used with --min) or --top.\n");
+        return 1;
+    }
+
+    if (options->memory > 0 && (*selection2 == NULL || *whole || *reference || *timewise || options->minimum || options->contacts > 0 ||
+        options->cutoff > 0 || options->stats || options->hist_width > 0)) {
+        fprintf(stderr, "Option --memory can only be used for averaged distances between atoms of two selections (not with -t, --cutoff, --min, --contacts, --stats or --hist).\n");
+        return 1;
+    }
+
+    // a followed trajectory is only read once
+    if (options->memory > 0 && window->follow > 0) {
+        fprintf(stderr, "Option --follow cannot be combined with --memory.\n");
+        return 1;
+    }
+
+    // partial results are sums that can be merged
+    if (window->shard > 0 && (*job_file != NULL || *timewise || options->memory > 0)) {
+        fprintf(stderr, "Options --shard and --part cannot be combined with --jobs, the timewise option (-t) or --memory.\n");
+        return 1;
+    }
+
+    // only sums of averaged analyses are saved; slices of shards change with appended frames
+    if (*checkpoint_file != NULL && (*timewise || options->memory > 0 || (window->shard > 0 && !window->parts))) {
+        fprintf(stderr, "Option --checkpoint cannot be combined with the timewise option (-t), --memory or --shard.\n");
+        return 1;
+    }
+
+    if (options->group != group_none && *whole) {
+        fprintf(stderr, "Option --group cannot be combined with the whole option (-w).\n");
+        return 1;
+    }
+
+    if (options->dynamic.type != dynamic_none && *selection2 != NULL && (*whole || !*reference)) {
+        fprintf(stderr, "Option --dynamic can only be used for positions, the center of a selection (-w) or distances to a reference (-r).\n");
+        return 1;
+    }
+
+    // atoms of the dynamic selection are averaged over different numbers of frames
+    if (options->dynamic.type != dynamic_none && (options->stats || options->hist_width > 0 || window->shard > 0 || *checkpoint_file != NULL)) {
+        fprintf(stderr, "Option --dynamic cannot be combined with --stats, --hist, --shard, --part or --checkpoint.\n");
+        return 1;
+    }
+
+    if (!gro_specified || (!selection1_specified && *job_file == NULL && *snapshot_file == NULL)) {
         fprintf(stderr, "Gro file and at least one selection must always be supplied.\n");
         return 1;
     }
@@ -126,9 +493,10 @@ int get_arguments(
 void print_usage(const char *program_name)
 {
     printf("Usage: %s -c GRO_FILE -s SELECTION1 [OPTION]...\n", program_name);
+    printf("       %s merge [-c GRO_FILE] [-n NDX_FILE] [-o OUTPUT_FILE] PARTIAL_FILE...\n", program_name);
     printf("\nOPTIONS\n");
     printf("-h               print this message and exit\n");
-    printf("-c STRING        gro file to read\n");
+    printf("-c STRING        gro file or snapshot to read\n");
     printf("-f STRING        xtc file to read (optional)\n");
     printf("-n STRING        ndx file to read (optional, default: index.ndx)\n");
     printf("-s/-a STRING     selection of atoms\n");
@@ -138,9 +506,58 @@ void print_usage(const char *program_name)
     printf("-t               calculate properties in time (optional)\n");
     printf("-w               calculate center of selection(s) (optional)\n");
     printf("-r               treat the selection -b as a reference point (optional)\n");
+    printf("-j INTEGER       number of threads analyzing the trajectory (default: 1)\n");
+    printf("--begin FLOAT    time of the first frame to analyze in ps (default: 0)\n");
+    printf("--end FLOAT      time of the last frame to analyze in ps (default: last frame)\n");
+    printf("--dt FLOAT       only analyze frames with time divisible by dt in ps (default: all frames)\n");
+    printf("--stride INTEGER only analyze every n-th frame of the time window (default: 1)\n");
+    printf("--follow FLOAT   keep analyzing frames appended to the xtc file until none arrives for FLOAT s (optional)\n");
+    printf("--mmap           read the xtc file through a memory map with read-ahead (optional)\n");
+    printf("--shard STRING   only analyze the I-th of N slices of the frames and write partial results; I/N (optional)\n");
+    printf("--part STRING    analyze the xtc file as the I-th of N parts of the trajectory and write partial results; I/N (optional)\n");
+    printf("--checkpoint STRING  save the analysis into this file and continue from it in later runs (optional)\n");
+    printf("--checkpoint-interval FLOAT  time between saving the checkpoint in s (default: 300)\n");
+    printf("--cutoff FLOAT   only calculate distances between atoms closer than cutoff in nm (optional)\n");
+    printf("--min            calculate minimum distance between the atoms of the selections (optional)\n");
+    printf("--contacts FLOAT calculate number of atom pairs closer than the contact radius in nm (optional)\n");
+    printf("--top INTEGER    only write this number of the closest pairs of atoms (optional)\n");
+    printf("--triangle       only use pairs i < j for identical selections (optional)\n");
+    printf("--stats STRING   also write std, min, max and/or err of the averages (optional, e.g. std,err or all)\n");
+    printf("--hist STRING    write histogram of the values instead of averages; MIN,MAX,WIDTH (optional)\n");
+    printf("--density        write the histogram as a probability density (optional)\n");
+    printf("--group STRING   analyze centers of residues (resid), residue names (resname) or ndx groups (ndx) (optional)\n");
+    printf("--dynamic STRING select atoms of selection 1 in every frame; 'within DIST of QUERY', 'z > VALUE' or 'z < VALUE' (optional)\n");
+    printf("--memory STRING  memory budget of the averaged distances between all pairs of atoms (optional, e.g. 4G)\n");
+    printf("--jobs STRING    file with analyses to perform in a single pass through the trajectory (optional)\n");
+    printf("--profile        report time spent decoding, calculating and writing (optional)\n");
+    printf("--profile-json STRING  also write the report as JSON into this file (optional)\n");
+    printf("--cache STRING   directory caching the resolved selections for later runs (optional)\n");
+    printf("--snapshot STRING  write binary snapshot of the gro and ndx file into this file and exit (optional)\n");
     printf("\n");
 }
 
+/*! @brief Returns 1, if the analysis writes its results into the output file. Else returns 0. */
+static int writes_output_file(const int timewise, const int whole, const analysis_options_t *options)
+{
+    return (!whole && !options->minimum && options->contacts <= 0) || timewise || options->hist_width > 0;
+}
+
+/*! @brief Prints parameters of the trajectory reading shared by all analyses. */
+static void print_run_arguments(const int n_threads, const frame_window_t *window, const profile_t *profile, const char *cache_dir, const checkpoint_t *checkpoint)
+{
+    if (cache_dir != NULL) printf(">>> cache:           %s\n", cache_dir);
+    if (profile != NULL) printf(">>> profile:         %s\n", profile->json_file != NULL ? profile->json_file : "yes");
+    if (n_threads > 1) printf(">>> threads:         %d\n", n_threads);
+    if (window->begin > 0) printf(">>> begin:           %.1f ps\n", window->begin);
+    if (window->end >= 0) printf(">>> end:             %.1f ps\n", window->end);
+    if (window->dt > 0) printf(">>> dt:              %.1f ps\n", window->dt);
+    if (window->stride > 1) printf(">>> stride:          %d\n", window->stride);
+    if (window->follow > 0) printf(">>> follow:          %.1f s\n", window->follow);
+    if (window->mmap) printf(">>> mmap:            yes\n");
+    if (window->shard > 0) printf(">>> %-17s%d/%d\n", window->parts ? "part:" : "shard:", window->shard, window->n_shards);
+    if (checkpoint != NULL) printf(">>> checkpoint:      %s (every %g s)\n", checkpoint->filename, checkpoint->interval);
+}
+
 /*
  * Prints parameters that the program will use.
  */
@@ -154,13 +571,19 @@ void print_arguments(
         const int timewise,
         const int whole,
         const int reference,
-        const dimensionality_t dim)
+        const dimensionality_t dim,
+        const int n_threads,
+        const frame_window_t *window,
+        const analysis_options_t *options,
+        const profile_t *profile,
+        const char *cache_dir,
+        const checkpoint_t *checkpoint)
 {
     printf("\nParameters for PosDist calculation:\n");
     printf(">>> gro file:        %s\n", gro_file);
     if (xtc_file != NULL) printf(">>> xtc file:        %s\n", xtc_file);
     printf(">>> ndx file:        %s\n", ndx_file);
-    if (!whole || timewise) printf(">>> output file:     %s\n", output_file);
+    if (writes_output_file(timewise, whole, options)) printf(">>> output file:     %s\n", output_file);
     printf(">>> selection 1:     %s\n", selection1);
     if (selection2 != NULL) printf(">>> selection 2:     %s\n", selection2);
     
@@ -201,592 +624,356 @@ void print_arguments(
         else printf(">>> reference:       no\n");
     }
     
+    print_run_arguments(n_threads, window, profile, cache_dir, checkpoint);
+    if (options->cutoff > 0) printf(">>> cutoff:          %.3f nm\n", options->cutoff);
+    if (options->minimum) printf(">>> minimum:         yes\n");
+    if (options->contacts > 0) printf(">>> contacts:        %.3f nm\n", options->contacts);
+    if (options->top > 0) printf(">>> top:             %zu\n", options->top);
+    if (options->triangle) printf(">>> triangle:        yes\n");
+    if (options->stats) {
+        printf(">>> stats:          ");
+        if (options->stats & stats_std) printf(" std");
+        if (options->stats & stats_min) printf(" min");
+        if (options->stats & stats_max) printf(" max");
+        if (options->stats & stats_err) printf(" err");
+        printf("\n");
+    }
+    if (options->hist_width > 0) printf(">>> histogram:       %.3f to %.3f (bin width: %.3f)\n", options->hist_min, options->hist_max, options->hist_width);
+    if (options->hist_density) printf(">>> density:         yes\n");
+    if (options->group != group_none) printf(">>> group:           %s\n", groups_name(options->group));
+    if (options->dynamic.type != dynamic_none) {
+        char condition[256] = "";
+        dynamic_describe(&options->dynamic, condition, sizeof(condition));
+        printf(">>> dynamic:         %s\n", condition);
+    }
+    if (options->memory > 0) printf(">>> memory:          %.3f MB\n", options->memory / 1048576.0);
 
     printf("\n");
 }
 
-/*! @brief Unpacks dimensionality. Returns 0, if successful, else returns 1. */
-static int unpack_dimensionality(const dimensionality_t dim, int *x, int *y, int *z)
+/*! @brief Prints parameters of writing the snapshot. */
+static void print_snapshot_arguments(const char *gro_file, const char *ndx_file, const char *snapshot_file)
 {
-    switch (dim) {
-    case dimensionality_xyz:
-        *x = 1; *y = 1; *z = 1;
-        break;
-    case dimensionality_xy:
-        *x = 1; *y = 1;
-        break;
-    case dimensionality_xz:
-        *x = 1; *z = 1;
-        break;
-    case dimensionality_yz:
-        *y = 1; *z = 1;
-        break;
-    case dimensionality_x:
-        *x = 1;
-        break;
-    case dimensionality_y:
-        *y = 1;
-        break;
-    case dimensionality_z:
-        *z = 1;
-        break;
-    default:
-        fprintf(stderr, "Internal unpack_dimensionality() error. Unknown dimensionality. This should never happen.\n");
-        return 1;
-    }
-
-    return 0;
+    printf("\nParameters for PosDist calculation:\n");
+    printf(">>> gro file:        %s\n", gro_file);
+    printf(">>> ndx file:        %s\n", ndx_file);
+    printf(">>> snapshot:        %s\n", snapshot_file);
 }
 
-int calc_position(
-        system_t *system, 
-        const char *xtc_file, 
-        const atom_selection_t *selection, 
-        const char *selection_query, 
-        const int timewise, 
-        const int whole, 
-        const dimensionality_t dim,
-        const char *output_file)
+/*
+ * Parses the options of a single line of the job file.
+ * Gro, xtc and ndx files are shared by all analyses and are taken from the command line.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+static int parse_job(char *program, const job_t *job, char *gro_file, char *xtc_file, char *ndx_file, job_analysis_t *analysis)
 {
-    int x = 0, y = 0, z = 0;
-    if (unpack_dimensionality(dim, &x, &y, &z) != 0) return 1;
-
-    // if no xtc file is supplied, analyze the current state of the system
-    if (xtc_file == NULL) {
-        if (whole) {
-            vec_t center = {0.0};
-            center_of_geometry(selection, center, system->box);
-
-            printf("Center of geometry of selection '%s': ", selection_query);
-            if (x) printf("x = %.3f    ", center[0]);
-            if (y) printf("y = %.3f    ", center[1]);
-            if (z) printf("z = %.3f    ", center[2]);
-            printf("\n");
-        }
-
-        else {
-            // open output file
-            FILE *output = fopen(output_file, "w");
-            if (output == NULL) {
-                fprintf(stderr, "Could not open output file '%s'\n", output_file);
-                return 1;
-            }
-
-            fprintf(output, "Positions of atoms of selection '%s'.\n", selection_query);
-            for (size_t i = 0; i < selection->n_atoms; ++i) {
-                atom_t *atom = selection->atoms[i];
-                fprintf(output, "Atom %s (id: %d) of residue %s (resid: %d):    ", atom->atom_name, atom->atom_number, atom->residue_name, atom->residue_number);
-                if (x) fprintf(output, "x = %.3f    ", atom->position[0]);
-                if (y) fprintf(output, "y = %.3f    ", atom->position[1]);
-                if (z) fprintf(output, "z = %.3f    ", atom->position[2]);
-                fprintf(output, "\n");
-            }
-
-            printf("Output file '%s' has been written.\n", output_file);
-            fclose(output);
-        }
-    // if an xtc file is provided
-    } else {
-        // open and validate an xtc file
-        XDRFILE *xtc = xdrfile_open(xtc_file, "r");
-        if (xtc == NULL) {
-            fprintf(stderr, "File %s could not be read as an xtc file.\n", xtc_file);
-            return 1;
-        }
-
-        if (!validate_xtc(xtc_file, (int) system->n_atoms)) {
-            fprintf(stderr, "Number of atoms in %s does not match the gro file.\n", xtc_file);
-            xdrfile_close(xtc);
-            return 1;
-        }
-
-        // calculate the center of geometry
-        if (whole) {
-
-            FILE *output = NULL;
-            if (timewise) {
-                output = fopen(output_file, "w");
-                if (output == NULL) {
-                    fprintf(stderr, "Could not open output file '%s'\n", output_file);
-                    xdrfile_close(xtc);
-                    return 1;
-                }
-
-                fprintf(output, "Center of geometry of selection '%s' in time. \n", selection_query);
-            }
-
-            vec_t center = {0.0};
-            vec_t av_center = {0.0};
-            size_t n_steps = 0;
-
-            while (read_xtc_step(xtc, system) == 0) {
-                // print info about the progress of reading and writing
-                if ((int) system->time % PROGRESS_FREQ == 0) {
-                    printf("Step: %d. Time: %.0f ps\r", system->step, system->time);
-                    fflush(stdout);
-                }
-
-                center_of_geometry(selection, center, system->box);
-
-                if (timewise) {
-                    fprintf(output, "t = %f    ", system->time);
-                    if (x) fprintf(output, "x = %.3f    ", center[0]);
-                    if (y) fprintf(output, "y = %.3f    ", center[1]);
-                    if (z) fprintf(output, "z = %.3f    ", center[2]);
-                    fprintf(output, "\n");
-                } else {
-                    av_center[0] += center[0];
-                    av_center[1] += center[1];
-                    av_center[2] += center[2];
-                }
-
-                ++n_steps;
-            }
-
-            if (timewise) {
-                fclose(output);
-            } else {
-                printf("\nAverage center of geometry of selection '%s': ", selection_query);
-                if (x) printf("x = %.3f    ", av_center[0] / n_steps);
-                if (y) printf("y = %.3f    ", av_center[1] / n_steps);
-                if (z) printf("z = %.3f    ", av_center[2] / n_steps);
-                printf("\n");
-            }
-        
-        // calculate position of each atom
-        } else {
-            FILE *output = fopen(output_file, "w");
-            if (output == NULL) {
-                fprintf(stderr, "Could not open output file '%s'\n", output_file);
-                xdrfile_close(xtc);
-                return 1;
-            }
-
-            if (timewise) fprintf(output, "Positions of atoms of selection '%s' in time. \n", selection_query);
-            else fprintf(output, "Average positions of atoms of selection '%s'. \n", selection_query);
-
-            vec_t *av_pos = calloc(selection->n_atoms, 3 * sizeof(float));
-            size_t n_steps = 0;
-
-            while (read_xtc_step(xtc, system) == 0) {
-                // print info about the progress of reading and writing
-                if ((int) system->time % PROGRESS_FREQ == 0) {
-                    printf("Step: %d. Time: %.0f ps\r", system->step, system->time);
-                    fflush(stdout);
-                }
-
-                if (timewise) fprintf(output, "t = %f\n", system->time);
-
-                for (size_t i = 0; i < selection->n_atoms; ++i) {
-                    atom_t *atom = selection->atoms[i];
-                    if (timewise) {
-                        fprintf(output, "Atom %s (id: %d) of residue %s (resid: %d):    ", atom->atom_name, atom->atom_number, atom->residue_name, atom->residue_number);
-                        if (x) fprintf(output, "x = %.3f    ", atom->position[0]);
-                        if (y) fprintf(output, "y = %.3f    ", atom->position[1]);
-                        if (z) fprintf(output, "z = %.3f    ", atom->position[2]);
-                        fprintf(output, "\n");
-                    } else {
-                        av_pos[i][0] += atom->position[0];
-                        av_pos[i][1] += atom->position[1];
-                        av_pos[i][2] += atom->position[2];
-                    }
-                }
-
-                ++n_steps;
-            } 
-
-            if (!timewise) {
-                for (size_t i = 0; i < selection->n_atoms; ++i) {
-                    atom_t *atom = selection->atoms[i];
-                    fprintf(output, "Atom %s (id: %d) of residue %s (resid: %d):    ", atom->atom_name, atom->atom_number, atom->residue_name, atom->residue_number);
-                    if (x) fprintf(output, "x = %.3f    ", av_pos[i][0] / n_steps);
-                    if (y) fprintf(output, "y = %.3f    ", av_pos[i][1] / n_steps);
-                    if (z) fprintf(output, "z = %.3f    ", av_pos[i][2] / n_steps);
-                    fprintf(output, "\n");
-                }
-            }
+    char **argv = malloc((job->argc + 8) * sizeof(char *));
+    if (argv == NULL) {
+        fprintf(stderr, "Could not allocate memory for the job file.\n");
+        return 1;
+    }
 
-            free(av_pos);
-            fclose(output);
-        }
+    char gro_option[] = "-c", xtc_option[] = "-f", ndx_option[] = "-n";
+    int argc = 0;
+    argv[argc++] = program;
+    argv[argc++] = gro_option;
+    argv[argc++] = gro_file;
+    if (xtc_file != NULL) {
+        argv[argc++] = xtc_option;
+        argv[argc++] = xtc_file;
+    }
+    argv[argc++] = ndx_option;
+    argv[argc++] = ndx_file;
+    for (int i = 0; i < job->argc; ++i) argv[argc++] = job->argv[i];
+    argv[argc] = NULL;
+
+    char *job_gro = NULL, *job_xtc = NULL, *job_ndx = NULL, *job_jobs = NULL, *job_profile_json = NULL, *job_cache = NULL, *job_snapshot = NULL, *job_checkpoint = NULL;
+    int n_threads = 1, job_profile = 0;
+    float checkpoint_interval = 0.0f;
+    frame_window_t window = FRAME_WINDOW_ALL;
+
+    memset(analysis, 0, sizeof(job_analysis_t));
+    analysis->output_file = "posdist.dat";
+    analysis->dim = dimensionality_xyz;
+    analysis->options = ANALYSIS_OPTIONS_DEFAULT;
+
+    // restart the option parser (GNU getopt is reinitialized by setting optind to zero)
+    optind = 0;
+    int status = get_arguments(argc, argv, &job_gro, &job_xtc, &job_ndx, &analysis->output_file, &analysis->dim,
+            &analysis->selection1_query, &analysis->selection2_query, &analysis->timewise, &analysis->whole,
+            &analysis->reference, &n_threads, &window, &analysis->options, &job_jobs, &job_profile, &job_profile_json, &job_cache, &job_snapshot, &job_checkpoint, &checkpoint_interval);
+
+    if (status == 0 && (job_gro != gro_file || job_xtc != xtc_file || job_ndx != ndx_file ||
+        n_threads != 1 || !frame_window_is_all(&window) || window.follow > 0 || window.mmap || window.shard > 0 || job_jobs != NULL || job_profile || job_cache != NULL || job_snapshot != NULL ||
+        job_checkpoint != NULL || checkpoint_interval > 0)) {
+        fprintf(stderr, "Options -c, -f, -n, -j, --begin, --end, --dt, --stride, --follow, --mmap, --shard, --part, --checkpoint, --checkpoint-interval, --jobs, --profile, --profile-json, --cache and --snapshot can only be used on the command line.\n");
+        status = 1;
+    }
 
-        xdrfile_close(xtc);
+    if (status != 0) fprintf(stderr, "Could not understand analysis on line %zu of the job file: %s\n", job->line, job->text);
 
-    }
-    
-    return 0;
+    free(argv);
+    return status;
 }
 
-/*! @brief Unpacks dimensionality. Returns 0, if successful, else returns 1. */
-static int unpack_dimensionality_string(const dimensionality_t dim, char *string)
+/*! @brief Prints parameters of the analyses of the job file. */
+static void print_job_arguments(
+        const char *gro_file,
+        const char *xtc_file,
+        const char *ndx_file,
+        const char *job_file,
+        const job_list_t *jobs,
+        const int n_threads,
+        const frame_window_t *window,
+        const profile_t *profile,
+        const char *cache_dir,
+        const checkpoint_t *checkpoint)
 {
-    switch (dim) {
-    case dimensionality_xyz:
-        strncpy(string, "xyz", 4);
-        break;
-    case dimensionality_xy:
-        strncpy(string, "xy", 3);
-        break;
-    case dimensionality_xz:
-        strncpy(string, "xz", 3);
-        break;
-    case dimensionality_yz: 
-        strncpy(string, "yz", 3);
-        break;
-    case dimensionality_x:
-        strncpy(string, "x", 2);
-        break;
-    case dimensionality_y:
-        strncpy(string, "y", 2);
-        break;
-    case dimensionality_z:
-        strncpy(string, "z", 2);
-        break;
-    default:
-        fprintf(stderr, "Internal unpack_dimensionality_string() error. Unknown dimensionality. This should never happen.\n");
-        return 1;
+    printf("\nParameters for PosDist calculation:\n");
+    printf(">>> gro file:        %s\n", gro_file);
+    if (xtc_file != NULL) printf(">>> xtc file:        %s\n", xtc_file);
+    printf(">>> ndx file:        %s\n", ndx_file);
+    printf(">>> job file:        %s\n", job_file);
+    print_run_arguments(n_threads, window, profile, cache_dir, checkpoint);
+    for (size_t i = 0; i < jobs->n_jobs; ++i) {
+        char label[32] = "";
+        snprintf(label, sizeof(label), "analysis %zu:", i + 1);
+        printf(">>> %-17s%s\n", label, jobs->jobs[i].text);
     }
 
-    return 0;
+    printf("\n");
 }
 
-int calc_distance(
-        system_t *system,
-        const char *xtc_file,
-        const atom_selection_t *selection1,
-        const atom_selection_t *selection2,
-        const char *selection1_query,
-        const char *selection2_query,
-        const int timewise,
-        const int whole,
-        const int reference,
-        const dimensionality_t dim,
-        const char *output_file)
+/*! @brief Checks that no two analyses write into the same output file. Returns zero, if successful, else returns non-zero. */
+static int check_job_outputs(const job_analysis_t *analyses, const size_t n_analyses)
 {
-    char dimensions[4] = "";
-    if (unpack_dimensionality_string(dim, dimensions) != 0) return 1;
-
-    // if no xtc file is supplied, analyze the current state of the system
-    if (xtc_file == NULL) {
-        if (whole) {
-            vec_t center1 = {0.0};
-            vec_t center2 = {0.0};
-            center_of_geometry(selection1, center1, system->box);
-            center_of_geometry(selection2, center2, system->box);
-            
-            printf("%s-distance between the centers of selections '%s' and '%s': %.3f\n", dimensions, selection1_query, selection2_query, 
-                    calc_distance_dim(center1, center2, dim, system->box, 1));
-        } else {
-            // open output file
-            FILE *output = fopen(output_file, "w");
-            if (output == NULL) {
-                fprintf(stderr, "Could not open output file '%s'\n", output_file);
-                return 1;
-            }
-
-            if (reference) {
-                vec_t center2 = {0.0};
-                center_of_geometry(selection2, center2, system->box);
-
-                fprintf(output, "%s-distances between the atoms of selection '%s' and center of selection '%s'.\n", dimensions, selection1_query, selection2_query);
-                for (size_t i = 0; i < selection1->n_atoms; ++i) {
-                    atom_t *atom = selection1->atoms[i];
-                    fprintf(output, "Atom %s (id: %d) of residue %s (resid: %d):    %.3f\n", atom->atom_name, atom->atom_number, atom->residue_name, atom->residue_number,
-                            calc_distance_dim(atom->position, center2, dim, system->box, 1));
-                }
-
-            } else {
-
-                fprintf(output, "%s-distances between the atoms of selections '%s' and '%s'.\n", dimensions, selection1_query, selection2_query);
-                for (size_t i = 0; i < selection1->n_atoms; ++i) {
-                    atom_t *atom1 = selection1->atoms[i];
-                    fprintf(output, "Atom %s (id: %d) of residue %s (resid: %d):\n", atom1->atom_name, atom1->atom_number, atom1->residue_name, atom1->residue_number);
-                    for (size_t j = 0; j < selection2->n_atoms; ++j) {
-                        atom_t *atom2 = selection2->atoms[j];
-                        fprintf(output, ">>> Atom %s (id: %d) of residue %s (resid: %d):   %.3f\n", atom2->atom_name, atom2->atom_number, atom2->residue_name, atom2->residue_number,
-                                calc_distance_dim(atom1->position, atom2->position, dim, system->box, 1));
-                    }
-                }
-
-            }
+    for (size_t i = 0; i < n_analyses; ++i) {
+        if (!writes_output_file(analyses[i].timewise, analyses[i].whole, &analyses[i].options)) continue;
 
-            fclose(output);
-        }
-     // if an xtc file is provided
-    } else {
-        // open and validate an xtc file
-        XDRFILE *xtc = xdrfile_open(xtc_file, "r");
-        if (xtc == NULL) {
-            fprintf(stderr, "File %s could not be read as an xtc file.\n", xtc_file);
-            return 1;
-        }
-
-        if (!validate_xtc(xtc_file, (int) system->n_atoms)) {
-            fprintf(stderr, "Number of atoms in %s does not match the gro file.\n", xtc_file);
-            xdrfile_close(xtc);
-            return 1;
-        }
+        for (size_t j = i + 1; j < n_analyses; ++j) {
+            if (!writes_output_file(analyses[j].timewise, analyses[j].whole, &analyses[j].options)) continue;
 
-        // open output file, if necessary
-        FILE *output = NULL;
-        if (!whole || timewise) {
-            output = fopen(output_file, "w");
-            if (output == NULL) {
-                fprintf(stderr, "Could not open output file '%s'\n", output_file);
-                xdrfile_close(xtc);
+            if (strcmp(analyses[i].output_file, analyses[j].output_file) == 0) {
+                fprintf(stderr, "Analyses %zu and %zu of the job file write into the same output file '%s'.\n",
+                        i + 1, j + 1, analyses[i].output_file);
                 return 1;
             }
         }
+    }
 
-        // calculate the distance between the centers of geometry
-        if (whole) {
-            float av_dist = 0.0;
-            size_t n_steps = 0;
-
-            if (timewise) {
-                fprintf(output, "%s-distances between the centers of selections '%s' and '%s' in time.\n", dimensions, selection1_query, selection2_query);
-            }
-
-            while (read_xtc_step(xtc, system) == 0) {
-                // print info about the progress of reading and writing
-                if ((int) system->time % PROGRESS_FREQ == 0) {
-                    printf("Step: %d. Time: %.0f ps\r", system->step, system->time);
-                    fflush(stdout);
-                }
-
-                vec_t center1 = {0.0};
-                vec_t center2 = {0.0};
-
-                center_of_geometry(selection1, center1, system->box);
-                center_of_geometry(selection2, center2, system->box);
-
-                float distance = calc_distance_dim(center1, center2, dim, system->box, 1);
-                
-                if (timewise) {
-                    fprintf(output, "t = %f    d = %f\n", system->time, distance);
-                } else {
-                    av_dist += distance;
-                    ++n_steps;
-                }
-            }
-
-            if (!timewise) {
-                printf("Average %s-distance between the centers of selections '%s' and '%s': %.3f\n", dimensions, selection1_query, selection2_query, av_dist / n_steps);
-            }
-        }
-
-        // calculate distances between the atoms of selection1 and center of selection2
-        else if (reference) {
-            float *av_dist = NULL; 
-            if (!timewise) av_dist = calloc(selection1->n_atoms, sizeof(float));
-            size_t n_steps = 0;
-
-            if (timewise) {
-                fprintf(output, "%s-distances between the atoms of selection '%s' and center of selection '%s' in time.\n", dimensions, selection1_query, selection2_query);
-            } else {
-                fprintf(output, "Average %s-distances between the atoms of selection '%s' and center of selection '%s'.\n", dimensions, selection1_query, selection2_query);
-            }
-
-            while (read_xtc_step(xtc, system) == 0) {
-                // print info about the progress of reading and writing
-                if ((int) system->time % PROGRESS_FREQ == 0) {
-                    printf("Step: %d. Time: %.0f ps\r", system->step, system->time);
-                    fflush(stdout);
-                }
-
-                if (timewise) fprintf(output, "t = %f\n", system->time);
-
-                vec_t center2 = {0.0};
-
-                center_of_geometry(selection2, center2, system->box);
-
-                for (size_t i = 0; i < selection1->n_atoms; ++i) {
-                    atom_t *atom = selection1->atoms[i];
-
-                    float distance = calc_distance_dim(atom->position, center2, dim, system->box, 1);
-
-                    if (timewise) {
-                        fprintf(output, "Atom %s (id: %d) of residue %s (resid: %d):    %.3f\n", atom->atom_name, 
-                                atom->atom_number, atom->residue_name, atom->residue_number, distance);
-                    } else {
-                        av_dist[i] += distance;
-                    }
-                }
+    return 0;
+}
 
-                ++n_steps;
-            }
+/*
+ * Reads the job file and performs all its analyses. Groups of the ndx file replace
+ * the groups of a snapshot only if the ndx file was supplied explicitly ('ndx_specified').
+ * Returns zero, if successful. Else returns non-zero.
+ */
+static int run_jobs(
+        char *program,
+        char *gro_file,
+        char *xtc_file,
+        char *ndx_file,
+        const int ndx_specified,
+        const char *job_file,
+        const int n_threads,
+        const frame_window_t *window,
+        profile_t *profile,
+        const char *cache_dir,
+        checkpoint_t *checkpoint)
+{
+    job_list_t *jobs = jobs_read(job_file);
+    if (jobs == NULL) return 1;
 
-            if (!timewise) {
-                for (size_t i = 0; i < selection1->n_atoms; ++i) {
-                    atom_t *atom = selection1->atoms[i];
+    job_analysis_t *analyses = calloc(jobs->n_jobs, sizeof(job_analysis_t));
+    if (analyses == NULL) {
+        fprintf(stderr, "Could not allocate memory for the analyses.\n");
+        jobs_destroy(jobs);
+        return 1;
+    }
 
-                    fprintf(output, "Atom %s (id: %d) of residue %s (resid: %d):    %.3f\n", atom->atom_name, 
-                                atom->atom_number, atom->residue_name, atom->residue_number, av_dist[i] / n_steps);
-                }
-            }
-            
-            free(av_dist);
+    int status = 0;
+    for (size_t i = 0; i < jobs->n_jobs && status == 0; ++i) {
+        status = parse_job(program, &jobs->jobs[i], gro_file, xtc_file, ndx_file, &analyses[i]);
 
+        // a followed trajectory is only read once
+        if (status == 0 && window->follow > 0 && analyses[i].options.memory > 0) {
+            fprintf(stderr, "Option --follow cannot be combined with --memory.\n");
+            status = 1;
         }
 
-        // calculates distances between the individual atoms of selection1 and individual atoms of selection2
-        else {
-
-            float *av_dist = NULL; 
-            if (!timewise) av_dist = calloc(selection1->n_atoms * selection2->n_atoms, sizeof(float));
-            size_t n_steps = 0;
-
-            if (timewise) {
-                fprintf(output, "%s-distances between the atoms of selections '%s' and '%s' in time.\n", dimensions, selection1_query, selection2_query);
-            } else {
-                fprintf(output, "Average %s-distances between the atoms of selections '%s' and '%s'.\n", dimensions, selection1_query, selection2_query);
-            }
-
-            while (read_xtc_step(xtc, system) == 0) {
-                // print info about the progress of reading and writing
-                if ((int) system->time % PROGRESS_FREQ == 0) {
-                    printf("Step: %d. Time: %.0f ps\r", system->step, system->time);
-                    fflush(stdout);
-                }
-
-                if (timewise) fprintf(output, "t = %f\n", system->time);
-
-                for (size_t i = 0; i < selection1->n_atoms; ++i) {
-                    atom_t *atom1 = selection1->atoms[i];
-                    if (timewise) {
-                        fprintf(output, "Atom %s (id: %d) of residue %s (resid: %d):\n", atom1->atom_name, 
-                                atom1->atom_number, atom1->residue_name, atom1->residue_number);
-                    }
-                    
-                    for (size_t j = 0; j < selection2->n_atoms; ++j) {
-                        atom_t *atom2 = selection2->atoms[j];
-
-                        float distance = calc_distance_dim(atom1->position, atom2->position, dim, system->box, 1);
-
-                        if (timewise) {
-                            fprintf(output, ">>> Atom %s (id: %d) of residue %s (resid: %d):   %.3f\n", atom2->atom_name, 
-                                atom2->atom_number, atom2->residue_name, atom2->residue_number, distance);
-                        } else {
-                            av_dist[i * selection2->n_atoms + j] += distance;
-                        }
-                    }
-
-                }
-
-                ++n_steps;
-
-            }
-
-            if (!timewise) {
-                for (size_t i = 0; i < selection1->n_atoms; ++i) {
-                    atom_t *atom1 = selection1->atoms[i];
-                    fprintf(output, "Atom %s (id: %d) of residue %s (resid: %d):\n", atom1->atom_name, 
-                            atom1->atom_number, atom1->residue_name, atom1->residue_number);
+        // only sums of averaged analyses are saved
+        if (status == 0 && checkpoint != NULL && (analyses[i].timewise || analyses[i].options.memory > 0 || analyses[i].options.dynamic.type != dynamic_none)) {
+            fprintf(stderr, "Option --checkpoint cannot be combined with the timewise option (-t), --memory or --dynamic (line %zu of the job file).\n", jobs->jobs[i].line);
+            status = 1;
+        }
+    }
 
-                    for (size_t j = 0; j < selection2->n_atoms; ++j) {
-                        atom_t *atom2 = selection2->atoms[j];
-                        fprintf(output, ">>> Atom %s (id: %d) of residue %s (resid: %d):   %.3f\n", atom2->atom_name, 
-                                atom2->atom_number, atom2->residue_name, atom2->residue_number, av_dist[i * selection2->n_atoms + j] / n_steps);
-                    }
-                }
-            }            
+    if (status == 0) status = check_job_outputs(analyses, jobs->n_jobs);
 
-            free(av_dist);
+    if (status == 0) {
+        print_job_arguments(gro_file, xtc_file, ndx_file, job_file, jobs, n_threads, window, profile, cache_dir, checkpoint);
+        status = calc_jobs(gro_file, xtc_file, ndx_file, ndx_specified, analyses, jobs->n_jobs, n_threads, window, profile, cache_dir, checkpoint);
+    }
 
+    free(analyses);
+    jobs_destroy(jobs);
+    return status;
+}
 
-        }
+/*
+ * Prints the profile of a successful calculation and releases the profile.
+ * Returns 'status' or non-zero, if the JSON report could not be written.
+ */
+static int report_profile(profile_t *profile, int status)
+{
+    if (profile == NULL) return status;
 
-        if (!whole || timewise) fclose(output);
-        xdrfile_close(xtc);
-    
+    if (status == 0) {
+        profile_print(profile, stdout);
+        if (profile->json_file != NULL && profile_write_json(profile) != 0) status = 1;
     }
 
-    return 0;
+    profile_destroy(profile);
+    return status;
 }
 
-int main(int argc, char **argv)
+/*
+ * Performs the analysis specified by the command line.
+ * If 'merging' is not NULL, the partial results of the shards are merged instead of reading the trajectory.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+static int run_analysis(int argc, char **argv, const sharding_t *merging)
 {
     // get arguments
     char *gro_file = NULL;
     char *xtc_file = NULL;
-    char *ndx_file = "index.ndx";
-    char *output_file = "posdist.dat";
-    char *selection1_query = NULL;
-    char *selection2_query = NULL;
-    int timewise = 0;
-    int whole = 0;
-    int reference = 0;
-    dimensionality_t dim = dimensionality_xyz;
-
-    if (get_arguments(argc, argv, &gro_file, &xtc_file, &ndx_file, &output_file, &dim, &selection1_query, &selection2_query, &timewise, &whole, &reference) != 0) {
+    char *ndx_file = NULL;
+    int n_threads = 1;
+    frame_window_t window = FRAME_WINDOW_ALL;
+
+    job_analysis_t analysis;
+    memset(&analysis, 0, sizeof(job_analysis_t));
+    analysis.output_file = "posdist.dat";
+    analysis.dim = dimensionality_xyz;
+    analysis.options = ANALYSIS_OPTIONS_DEFAULT;
+
+    char *job_file = NULL;
+    int profiling = 0;
+    char *profile_json = NULL;
+    char *cache_dir = NULL;
+    char *snapshot_file = NULL;
+    char *checkpoint_file = NULL;
+    float checkpoint_interval = 300.0f;
+
+    if (get_arguments(argc, argv, &gro_file, &xtc_file, &ndx_file, &analysis.output_file, &analysis.dim, &analysis.selection1_query, &analysis.selection2_query,
+                &analysis.timewise, &analysis.whole, &analysis.reference, &n_threads, &window, &analysis.options, &job_file, &profiling, &profile_json, &cache_dir,
+                &snapshot_file, &checkpoint_file, &checkpoint_interval) != 0) {
         print_usage(argv[0]);
         return 1;
     }
 
-    print_arguments(gro_file, xtc_file, ndx_file, output_file, selection1_query, selection2_query, timewise, whole, reference, dim);
-
-    // read gro file
-    system_t *system = load_gro(gro_file);
-    if (system == NULL) return 1;
+    // groups of a snapshot are only replaced by an ndx file supplied explicitly
+    const int ndx_specified = ndx_file != NULL;
+    if (!ndx_specified) ndx_file = "index.ndx";
 
-    // try reading ndx file (ignore if this fails)
-    dict_t *ndx_groups = read_ndx(ndx_file, system);
+    // only write the snapshot
+    if (snapshot_file != NULL) {
+        print_snapshot_arguments(gro_file, ndx_file, snapshot_file);
+        return calc_snapshot(gro_file, ndx_file, snapshot_file);
+    }
 
-    // select all atoms
-    atom_selection_t *all = select_system(system);
+    // a shard only saves partial results and stores its command line next to them
+    sharding_t shard_run = { .argc = argc - 1, .argv = argv + 1, .partials = NULL, .n_partials = 0 };
+    const sharding_t *sharding = merging;
+    if (window.shard > 0) {
+        sharding = &shard_run;
+        analysis.options.partial = 1;
+    }
 
-    // select selection1
-    atom_selection_t *selection1 = smart_select(all, selection1_query, ndx_groups);
-    if (selection1 == NULL || selection1->n_atoms == 0) {
-        fprintf(stderr, "No atoms ('%s') found.\n", selection1_query);
+    profile_t *profile = NULL;
+    if (profiling) {
+        profile = profile_create(profile_json);
+        if (profile == NULL) {
+            fprintf(stderr, "Could not allocate memory for the profile.\n");
+            return 1;
+        }
+    }
 
-        dict_destroy(ndx_groups);
-        free(all);
-        free(system);
-        free(selection1);
-        return 1;
+    // the inputs are fingerprinted before the analysis, so that a checkpoint of different inputs is never used
+    checkpoint_t checkpoint_state;
+    checkpoint_t *checkpoint = NULL;
+    if (checkpoint_file != NULL) {
+        if (checkpoint_init(&checkpoint_state, checkpoint_file, checkpoint_interval, gro_file, ndx_file) != 0) return report_profile(profile, 1);
+        checkpoint = &checkpoint_state;
     }
 
-    // if query for selection2 is supplied, select selection2 and calculate distances
-    if (selection2_query != NULL) {
-        atom_selection_t *selection2 = smart_select(all, selection2_query, ndx_groups);
-        if (selection2 == NULL || selection2->n_atoms == 0) {
-            fprintf(stderr, "No atoms ('%s') found.\n", selection2_query);
+    // perform all analyses of the job file
+    if (job_file != NULL) return report_profile(profile, run_jobs(argv[0], gro_file, xtc_file, ndx_file, ndx_specified, job_file, n_threads, &window, profile, cache_dir, checkpoint));
 
-            dict_destroy(ndx_groups);
-            free(all);
-            free(system);
-            free(selection1);
-            free(selection2);
-            return 1;
-        }
+    print_arguments(gro_file, xtc_file, ndx_file, analysis.output_file, analysis.selection1_query, analysis.selection2_query, analysis.timewise,
+            analysis.whole, analysis.reference, analysis.dim, n_threads, &window, &analysis.options, profile, cache_dir, checkpoint);
 
-        if (calc_distance(system, xtc_file, selection1, selection2, selection1_query, selection2_query, timewise, whole, reference, dim, output_file) != 0) {
-            dict_destroy(ndx_groups);
-            free(all);
-            free(system);
-            free(selection1);
-            free(selection2);
-            return 1;
-        }
+    return report_profile(profile, calc_analysis(gro_file, xtc_file, ndx_file, ndx_specified, &analysis, n_threads, &window, profile, cache_dir, sharding, checkpoint));
+}
 
-        free(selection2);
-    // calculate position of selection1
-    } else {
-        if (calc_position(system, xtc_file, selection1, selection1_query, timewise, whole, dim, output_file) != 0) {
-            dict_destroy(ndx_groups);
-            free(all);
-            free(system);
-            free(selection1);
+/*
+ * Merges partial results of the shards of an analysis: posdist merge [-c GRO_FILE] [-n NDX_FILE] [-o OUTPUT_FILE] PARTIAL_FILE...
+ * The analysis is recreated from the command line stored in the partial files; options -c, -n and -o replace the stored files.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+static int merge_shards(int argc, char **argv)
+{
+    char *gro_file = NULL, *ndx_file = NULL, *output_file = NULL;
+
+    // options of the merge follow the word 'merge' which takes the place of the program name
+    optind = 0;
+    int opt = 0;
+    while ((opt = getopt(argc - 1, argv + 1, "c:n:o:h")) != -1) {
+        switch (opt) {
+        case 'c':
+            gro_file = optarg;
+            break;
+        case 'n':
+            ndx_file = optarg;
+            break;
+        case 'o':
+            output_file = optarg;
+            break;
+        default:
+            print_usage(argv[0]);
             return 1;
         }
     }
 
-    printf("\n");
+    if (optind >= argc - 1) {
+        fprintf(stderr, "No partial files to merge were supplied.\n");
+        print_usage(argv[0]);
+        return 1;
+    }
 
-    dict_destroy(ndx_groups);
-    free(all);
-    free(system);
-    free(selection1);
-    return 0;
-}
\ No newline at end of file
+    merge_t *merge = merge_open(argv[0], argv + 1 + optind, (size_t) (argc - 1 - optind), gro_file, ndx_file, output_file);
+    if (merge == NULL) return 1;
+
+    printf("\nMerging partial results:\n");
+    for (size_t i = 0; i < merge->sharding.n_partials; ++i) {
+        const partial_t *partial = merge->sharding.partials[i];
+        char label[32] = "";
+        snprintf(label, sizeof(label), "%s %d/%d:", partial->parts ? "part" : "shard", partial->shard, partial->n_shards);
+        printf(">>> %-17s%s\n", label, partial->filename);
+    }
+
+    optind = 0;
+    int status = run_analysis(merge->argc, merge->argv, &merge->sharding);
+
+    merge_close(merge);
+    return status;
+}
+
+int main(int argc, char **argv)
+{
+    // merge partial results of a sharded analysis
+    if (argc > 1 && strcmp(argv[1], "merge") == 0) return merge_shards(argc, argv);
+
+    return run_analysis(argc, argv, NULL);
+}
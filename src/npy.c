@@ -0,0 +1,127 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdlib.h>
+#include <string.h>
+#include "npy.h"
+
+// total size of the header; the header is padded, so that the final shape always fits
+#define NPY_HEADER_SIZE 128
+
+static const char NPY_EXTENSION[] = ".npy";
+
+/*! @brief Returns 1, if the machine is little-endian. Else returns 0. */
+static int little_endian(void)
+{
+    const uint16_t probe = 1;
+    return *(const unsigned char *) &probe == 1;
+}
+
+/*! @brief Writes the header describing the array at the start of the file. Returns zero, if successful, else returns non-zero. */
+static int write_header(npy_file_t *npy)
+{
+    char dict[NPY_HEADER_SIZE] = {0};
+    const char *descr = npy->type == npy_float32 ? "<f4" : "<i4";
+
+    int len = 0;
+    if (npy->n_columns == 0) {
+        len = snprintf(dict, sizeof(dict), "{'descr': '%s', 'fortran_order': False, 'shape': (%zu,), }", descr, npy->n_items);
+    } else {
+        len = snprintf(dict, sizeof(dict), "{'descr': '%s', 'fortran_order': False, 'shape': (%zu, %zu), }",
+                descr, npy->n_items / npy->n_columns, npy->n_columns);
+    }
+
+    const int dict_size = NPY_HEADER_SIZE - 10;
+    if (len < 0 || len >= dict_size) return 1;
+
+    // pad the header with spaces and terminate it with a newline
+    memset(dict + len, ' ', dict_size - len);
+    dict[dict_size - 1] = '\n';
+
+    unsigned char preamble[10] = {0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0, dict_size & 0xff, dict_size >> 8};
+
+    if (fseek(npy->file, 0, SEEK_SET) != 0) return 1;
+    if (fwrite(preamble, 1, 10, npy->file) != 10) return 1;
+    if (fwrite(dict, 1, dict_size, npy->file) != (size_t) dict_size) return 1;
+
+    return 0;
+}
+
+npy_file_t *npy_open(const char *filename, const npy_type_t type, const size_t n_columns)
+{
+    npy_file_t *npy = calloc(1, sizeof(npy_file_t));
+    if (npy == NULL) return NULL;
+
+    npy->file = fopen(filename, "wb");
+    if (npy->file == NULL) {
+        free(npy);
+        return NULL;
+    }
+
+    npy->type = type;
+    npy->n_columns = n_columns;
+
+    if (write_header(npy) != 0) {
+        fclose(npy->file);
+        free(npy);
+        return NULL;
+    }
+
+    return npy;
+}
+
+int npy_write(npy_file_t *npy, const void *values, const size_t n_values)
+{
+    if (little_endian()) {
+        if (fwrite(values, 4, n_values, npy->file) != n_values) return 1;
+    } else {
+        const unsigned char *bytes = (const unsigned char *) values;
+        for (size_t i = 0; i < n_values; ++i) {
+            unsigned char swapped[4] = { bytes[4 * i + 3], bytes[4 * i + 2], bytes[4 * i + 1], bytes[4 * i] };
+            if (fwrite(swapped, 1, 4, npy->file) != 4) return 1;
+        }
+    }
+
+    npy->n_items += n_values;
+    return 0;
+}
+
+int npy_flush(npy_file_t *npy)
+{
+    if (write_header(npy) != 0) return 1;
+    if (fseek(npy->file, 0, SEEK_END) != 0) return 1;
+
+    return fflush(npy->file) != 0;
+}
+
+int npy_close(npy_file_t *npy)
+{
+    if (npy == NULL) return 0;
+
+    int status = write_header(npy);
+    if (fclose(npy->file) != 0) status = 1;
+    free(npy);
+
+    return status;
+}
+
+int npy_is_npy(const char *filename)
+{
+    size_t len = strlen(filename);
+    size_t ext_len = strlen(NPY_EXTENSION);
+
+    return len > ext_len && strcmp(filename + len - ext_len, NPY_EXTENSION) == 0;
+}
+
+char *npy_companion(const char *filename, const char *suffix)
+{
+    size_t stem_len = strlen(filename) - strlen(NPY_EXTENSION);
+
+    char *companion = malloc(stem_len + strlen(suffix) + 2 * strlen(NPY_EXTENSION) + 1);
+    if (companion == NULL) return NULL;
+
+    memcpy(companion, filename, stem_len);
+    sprintf(companion + stem_len, ".%s%s", suffix, NPY_EXTENSION);
+
+    return companion;
+}
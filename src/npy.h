@@ -0,0 +1,59 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef NPY_H
+#define NPY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Writer of NumPy .npy files (format version 1.0).
+ *
+ * Values are appended to the file as they are calculated and the shape
+ * in the header is updated once the file is closed, so the number of rows
+ * does not have to be known in advance. The data can be memory-mapped
+ * directly, e.g. using numpy.load(filename, mmap_mode='r').
+ */
+
+typedef enum npy_type {
+    npy_float32,
+    npy_int32
+} npy_type_t;
+
+typedef struct npy_file {
+    FILE *file;
+    npy_type_t type;
+    size_t n_columns;       // zero for one-dimensional arrays
+    size_t n_items;         // number of values written
+} npy_file_t;
+
+/*
+ * Creates a new .npy file containing an array with 'n_columns' columns.
+ * If 'n_columns' is zero, the array is one-dimensional.
+ * Returns NULL, if the file could not be created.
+ */
+npy_file_t *npy_open(const char *filename, const npy_type_t type, const size_t n_columns);
+
+/*! @brief Appends 'n_values' values to the array. Returns zero, if successful, else returns non-zero. */
+int npy_write(npy_file_t *npy, const void *values, const size_t n_values);
+
+/*
+ * Writes the current shape of the array and flushes the file, so that the values written so far can be loaded
+ * while further values are appended. Returns zero, if successful, else returns non-zero.
+ */
+int npy_flush(npy_file_t *npy);
+
+/*! @brief Writes the final shape of the array and closes the file. Returns zero, if successful, else returns non-zero. */
+int npy_close(npy_file_t *npy);
+
+/*! @brief Returns 1, if the filename has the .npy extension. Else returns 0. */
+int npy_is_npy(const char *filename);
+
+/*
+ * Returns name of a companion file of 'filename', replacing the '.npy' extension with '.SUFFIX.npy'.
+ * Returned string must be freed by the caller.
+ */
+char *npy_companion(const char *filename, const char *suffix);
+
+#endif /* NPY_H */
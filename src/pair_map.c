@@ -0,0 +1,157 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "pair_map.h"
+
+// initial number of buckets
+static const size_t INITIAL_CAPACITY = 1024;
+
+/*! @brief Returns hash of the pair index. */
+static size_t pair_hash(const size_t pair)
+{
+    // 64-bit finalizer of MurmurHash3
+    uint64_t h = pair;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return (size_t) h;
+}
+
+/*! @brief Allocates buckets of the map. Returns zero, if successful, else returns non-zero. */
+static int pair_map_allocate(pair_map_t *map, const size_t capacity)
+{
+    map->keys = calloc(capacity, sizeof(size_t));
+    map->sums = calloc(capacity, sizeof(double));
+    map->counts = calloc(capacity, sizeof(size_t));
+    map->capacity = capacity;
+    map->n_pairs = 0;
+
+    return map->keys == NULL || map->sums == NULL || map->counts == NULL;
+}
+
+pair_map_t *pair_map_create(void)
+{
+    pair_map_t *map = calloc(1, sizeof(pair_map_t));
+    if (map == NULL) return NULL;
+
+    if (pair_map_allocate(map, INITIAL_CAPACITY) != 0) {
+        pair_map_destroy(map);
+        return NULL;
+    }
+
+    return map;
+}
+
+/*! @brief Returns the bucket of the pair or the empty bucket where the pair belongs. */
+static size_t pair_map_bucket(const pair_map_t *map, const size_t pair)
+{
+    size_t mask = map->capacity - 1;
+    size_t bucket = pair_hash(pair) & mask;
+    while (map->keys[bucket] != 0 && map->keys[bucket] != pair + 1) bucket = (bucket + 1) & mask;
+    return bucket;
+}
+
+/*! @brief Doubles the number of buckets. Returns zero, if successful, else returns non-zero. */
+static int pair_map_grow(pair_map_t *map)
+{
+    pair_map_t old = *map;
+    if (pair_map_allocate(map, 2 * old.capacity) != 0) {
+        free(map->keys);
+        free(map->sums);
+        free(map->counts);
+        *map = old;
+        return 1;
+    }
+
+    for (size_t i = 0; i < old.capacity; ++i) {
+        if (old.keys[i] == 0) continue;
+
+        size_t bucket = pair_map_bucket(map, old.keys[i] - 1);
+        map->keys[bucket] = old.keys[i];
+        map->sums[bucket] = old.sums[i];
+        map->counts[bucket] = old.counts[i];
+        ++map->n_pairs;
+    }
+
+    free(old.keys);
+    free(old.sums);
+    free(old.counts);
+    return 0;
+}
+
+/*! @brief Returns bucket of the pair, inserting the pair, if it is not stored yet. Returns 'capacity', if memory could not be allocated. */
+static size_t pair_map_insert(pair_map_t *map, const size_t pair)
+{
+    // keep the load factor below 0.5
+    if (2 * (map->n_pairs + 1) > map->capacity && pair_map_grow(map) != 0) return map->capacity;
+
+    size_t bucket = pair_map_bucket(map, pair);
+    if (map->keys[bucket] == 0) {
+        map->keys[bucket] = pair + 1;
+        ++map->n_pairs;
+    }
+
+    return bucket;
+}
+
+int pair_map_add(pair_map_t *map, const size_t pair, const float value)
+{
+    size_t bucket = pair_map_insert(map, pair);
+    if (bucket == map->capacity) return 1;
+
+    map->sums[bucket] += value;
+    ++map->counts[bucket];
+    return 0;
+}
+
+int pair_map_merge(pair_map_t *map, const size_t pair, const double sum, const size_t count)
+{
+    size_t bucket = pair_map_insert(map, pair);
+    if (bucket == map->capacity) return 1;
+
+    map->sums[bucket] += sum;
+    map->counts[bucket] += count;
+    return 0;
+}
+
+size_t pair_map_find(const pair_map_t *map, const size_t pair)
+{
+    size_t bucket = pair_map_bucket(map, pair);
+    return map->keys[bucket] == 0 ? map->capacity : bucket;
+}
+
+/*! @brief Compares two pair indices. */
+static int compare_pairs(const void *a, const void *b)
+{
+    size_t pair1 = *(const size_t *) a;
+    size_t pair2 = *(const size_t *) b;
+    return (pair1 > pair2) - (pair1 < pair2);
+}
+
+size_t *pair_map_pairs(const pair_map_t *map)
+{
+    size_t *pairs = malloc((map->n_pairs + 1) * sizeof(size_t));
+    if (pairs == NULL) return NULL;
+
+    size_t n = 0;
+    for (size_t i = 0; i < map->capacity; ++i) {
+        if (map->keys[i] != 0) pairs[n++] = map->keys[i] - 1;
+    }
+
+    qsort(pairs, n, sizeof(size_t), compare_pairs);
+    return pairs;
+}
+
+void pair_map_destroy(pair_map_t *map)
+{
+    if (map == NULL) return;
+
+    free(map->keys);
+    free(map->sums);
+    free(map->counts);
+    free(map);
+}
@@ -0,0 +1,42 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef PAIR_MAP_H
+#define PAIR_MAP_H
+
+#include <stddef.h>
+
+/*
+ * Sparse accumulator of values calculated for pairs of atoms.
+ * Pairs are identified by their index (i * n_atoms2 + j) and stored in an open-addressing hash table.
+ */
+typedef struct pair_map {
+    size_t capacity;        // number of buckets (power of two)
+    size_t n_pairs;         // number of stored pairs
+    size_t *keys;           // index of the pair + 1; zero marks an empty bucket
+    double *sums;           // sum of the values added for the pair
+    size_t *counts;         // number of values added for the pair
+} pair_map_t;
+
+/*! @brief Creates an empty pair map. Returns NULL, if memory could not be allocated. */
+pair_map_t *pair_map_create(void);
+
+/*! @brief Adds value to the sum of the pair. Returns zero, if successful, else returns non-zero. */
+int pair_map_add(pair_map_t *map, const size_t pair, const float value);
+
+/*! @brief Adds sum of 'count' values (e.g. accumulated by another process) to the pair. Returns zero, if successful, else returns non-zero. */
+int pair_map_merge(pair_map_t *map, const size_t pair, const double sum, const size_t count);
+
+/*! @brief Returns bucket of the pair or 'capacity', if the pair is not stored in the map. */
+size_t pair_map_find(const pair_map_t *map, const size_t pair);
+
+/*
+ * Returns indices of all stored pairs in ascending order.
+ * The returned array has 'n_pairs' items and must be freed by the caller. Returns NULL, if memory could not be allocated.
+ */
+size_t *pair_map_pairs(const pair_map_t *map);
+
+/*! @brief Releases memory allocated for the pair map. */
+void pair_map_destroy(pair_map_t *map);
+
+#endif /* PAIR_MAP_H */
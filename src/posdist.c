@@ -0,0 +1,342 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdlib.h>
+#include <string.h>
+#include "posdist.h"
+#include "calc.h"
+
+/*! @brief Analysis registered in the session. */
+typedef struct session_analysis {
+    analysis_t analysis;
+    char *query1;
+    char *query2;
+    atom_selection_t *selection1;
+    atom_selection_t *selection2;
+    frame_values_t values;
+    float *own_values;              // values allocated by frame_values_init (replaced by 'buffer', if set)
+    float *buffer;                  // buffer of the caller; NULL = own values
+    posdist_callback_t callback;
+    void *data;
+} session_analysis_t;
+
+struct posdist {
+    system_t *system;
+    ndx_index_t *ndx;               // groups of the snapshot (NULL, if the system was read from a gro file)
+    dict_t *ndx_groups;
+    atom_selection_t *all;
+    trajectory_t *trajectory;
+    session_analysis_t *analyses;
+    size_t n_analyses;
+    int started;                    // the first frame has been read, no analysis can be added
+    posdist_frame_t frame;
+    size_t n_read;
+};
+
+/*! @brief Copies the string. Returns NULL, if memory could not be allocated. */
+static char *copy_string(const char *string)
+{
+    size_t length = strlen(string) + 1;
+    char *copy = malloc(length);
+    if (copy != NULL) memcpy(copy, string, length);
+    return copy;
+}
+
+/*! @brief Converts the dimension flags into dimensionality. */
+static dimensionality_t flags_dimensionality(const int flags)
+{
+    int x = (flags & POSDIST_X) != 0, y = (flags & POSDIST_Y) != 0, z = (flags & POSDIST_Z) != 0;
+
+    if (x + y + z == 0 || x + y + z == 3) return dimensionality_xyz;
+    if (x + y == 2) return dimensionality_xy;
+    if (x + z == 2) return dimensionality_xz;
+    if (y + z == 2) return dimensionality_yz;
+    if (x) return dimensionality_x;
+    if (y) return dimensionality_y;
+    return dimensionality_z;
+}
+
+/*! @brief Returns the analysis with the given number. Returns NULL, if there is no such analysis. */
+static session_analysis_t *get_analysis(const posdist_t *session, const int analysis)
+{
+    if (session == NULL || analysis < 0 || (size_t) analysis >= session->n_analyses) {
+        fprintf(stderr, "Analysis %d does not exist.\n", analysis);
+        return NULL;
+    }
+
+    return &session->analyses[analysis];
+}
+
+posdist_t *posdist_open(const char *gro_file, const char *ndx_file)
+{
+    posdist_t *session = calloc(1, sizeof(posdist_t));
+    if (session == NULL) {
+        fprintf(stderr, "Could not allocate memory for the session.\n");
+        return NULL;
+    }
+
+    session->system = load_system(gro_file, ndx_file, &session->ndx);
+    if (session->system == NULL) {
+        posdist_close(session);
+        return NULL;
+    }
+
+    // the ndx file is optional
+    if (session->ndx != NULL || ndx_file != NULL) session->ndx_groups = load_ndx_groups(ndx_file, session->system, session->ndx);
+
+    session->all = select_system(session->system);
+    if (session->all == NULL) {
+        fprintf(stderr, "Could not allocate memory for the session.\n");
+        posdist_close(session);
+        return NULL;
+    }
+
+    return session;
+}
+
+int posdist_open_trajectory(posdist_t *session, const char *xtc_file)
+{
+    frame_window_t window = FRAME_WINDOW_ALL;
+    trajectory_t *trajectory = trajectory_open(xtc_file, session->system, &window);
+    if (trajectory == NULL) return 1;
+
+    trajectory_close(session->trajectory);
+    session->trajectory = trajectory;
+
+    // atoms following the last selected atom are never decompressed
+    if (session->started) {
+        size_t n_needed = 0;
+        for (size_t a = 0; a < session->n_analyses; ++a) {
+            size_t extent = analyses_extent(&session->analyses[a].analysis, 1, session->system);
+            if (extent > n_needed) n_needed = extent;
+        }
+        xtc_limit_atoms(trajectory->xtc, n_needed);
+    }
+
+    return 0;
+}
+
+/*! @brief Selects atoms of the query. Returns NULL, if no atoms were selected. */
+static atom_selection_t *session_select(posdist_t *session, char *query)
+{
+    atom_selection_t *selection = smart_select(session->all, query, session->ndx_groups);
+    if (selection == NULL || selection->n_atoms == 0) {
+        fprintf(stderr, "No atoms ('%s') found.\n", query);
+        free(selection);
+        return NULL;
+    }
+
+    return selection;
+}
+
+/*! @brief Adds analysis of the selections to the session. Returns the number of the analysis or -1, if it could not be added. */
+static int add_analysis(
+        posdist_t *session,
+        const analysis_type_t type,
+        const char *query1,
+        const char *query2,
+        const int flags,
+        const analysis_options_t *options)
+{
+    if (session->started) {
+        fprintf(stderr, "Analyses must be added before the first frame is read.\n");
+        return -1;
+    }
+
+    session_analysis_t *analyses = realloc(session->analyses, (session->n_analyses + 1) * sizeof(session_analysis_t));
+    if (analyses == NULL) {
+        fprintf(stderr, "Could not allocate memory for the analysis.\n");
+        return -1;
+    }
+    session->analyses = analyses;
+
+    session_analysis_t *added = &analyses[session->n_analyses];
+    memset(added, 0, sizeof(session_analysis_t));
+
+    added->query1 = copy_string(query1);
+    added->query2 = query2 != NULL ? copy_string(query2) : NULL;
+    if (added->query1 == NULL || (query2 != NULL && added->query2 == NULL)) {
+        fprintf(stderr, "Could not allocate memory for the analysis.\n");
+        free(added->query1);
+        free(added->query2);
+        return -1;
+    }
+
+    int status = (added->selection1 = session_select(session, added->query1)) == NULL;
+    if (status == 0 && query2 != NULL) status = (added->selection2 = session_select(session, added->query2)) == NULL;
+
+    // values are only calculated for every frame, nothing is written out
+    if (status == 0) status = analysis_init(&added->analysis, type, added->selection1, added->selection2,
+            added->query1, added->query2, 1, flags_dimensionality(flags), NULL, options);
+
+    if (status != 0) {
+        free(added->selection1);
+        free(added->selection2);
+        free(added->query1);
+        free(added->query2);
+        return -1;
+    }
+
+    return (int) session->n_analyses++;
+}
+
+int posdist_add_positions(posdist_t *session, const char *selection, int flags)
+{
+    return add_analysis(session, flags & POSDIST_WHOLE ? analysis_center : analysis_positions, selection, NULL, flags, NULL);
+}
+
+int posdist_add_distances(posdist_t *session, const char *selection1, const char *selection2, int flags)
+{
+    const int whole = (flags & POSDIST_WHOLE) != 0, reference = (flags & POSDIST_REFERENCE) != 0;
+
+    analysis_options_t options = ANALYSIS_OPTIONS_DEFAULT;
+    options.minimum = (flags & POSDIST_MINIMUM) != 0;
+    if (whole + reference + options.minimum > 1) {
+        fprintf(stderr, "Only one of the flags POSDIST_WHOLE, POSDIST_REFERENCE and POSDIST_MINIMUM can be used.\n");
+        return -1;
+    }
+
+    return add_analysis(session, distance_type(whole, reference, &options), selection1, selection2, flags, &options);
+}
+
+int posdist_add_contacts(posdist_t *session, const char *selection1, const char *selection2, float radius, int flags)
+{
+    if (radius <= 0.0f || (flags & (POSDIST_WHOLE | POSDIST_REFERENCE | POSDIST_MINIMUM))) {
+        fprintf(stderr, "Contacts require a positive contact radius and cannot be combined with POSDIST_WHOLE, POSDIST_REFERENCE or POSDIST_MINIMUM.\n");
+        return -1;
+    }
+
+    analysis_options_t options = ANALYSIS_OPTIONS_DEFAULT;
+    options.contacts = radius;
+    return add_analysis(session, analysis_contacts, selection1, selection2, flags, &options);
+}
+
+size_t posdist_n_values(const posdist_t *session, int analysis)
+{
+    const session_analysis_t *registered = get_analysis(session, analysis);
+    return registered != NULL ? registered->analysis.n_values : 0;
+}
+
+int posdist_set_buffer(posdist_t *session, int analysis, float *buffer)
+{
+    session_analysis_t *registered = get_analysis(session, analysis);
+    if (registered == NULL) return 1;
+
+    registered->buffer = buffer;
+    if (session->started) registered->values.values = buffer != NULL ? buffer : registered->own_values;
+    return 0;
+}
+
+int posdist_set_callback(posdist_t *session, int analysis, posdist_callback_t callback, void *data)
+{
+    session_analysis_t *registered = get_analysis(session, analysis);
+    if (registered == NULL) return 1;
+
+    registered->callback = callback;
+    registered->data = data;
+    return 0;
+}
+
+/*! @brief Allocates values of all analyses before the first frame is read. Returns zero, if successful, else returns non-zero. */
+static int session_start(posdist_t *session)
+{
+    size_t n_needed = 0;
+    for (size_t a = 0; a < session->n_analyses; ++a) {
+        session_analysis_t *registered = &session->analyses[a];
+        int status = frame_values_init(&registered->values, &registered->analysis);
+        registered->own_values = registered->values.values;
+
+        if (status != 0) {
+            fprintf(stderr, "Could not allocate memory for the analysis.\n");
+            for (size_t b = 0; b <= a; ++b) {
+                session->analyses[b].values.values = session->analyses[b].own_values;
+                frame_values_destroy(&session->analyses[b].values);
+            }
+            return 1;
+        }
+
+        // values are calculated directly into the buffer of the caller
+        if (registered->buffer != NULL) registered->values.values = registered->buffer;
+
+        size_t extent = analyses_extent(&registered->analysis, 1, session->system);
+        if (extent > n_needed) n_needed = extent;
+    }
+
+    // atoms following the last selected atom are never decompressed
+    xtc_limit_atoms(session->trajectory->xtc, n_needed);
+    session->started = 1;
+    return 0;
+}
+
+int posdist_next_frame(posdist_t *session)
+{
+    if (session->trajectory == NULL) {
+        fprintf(stderr, "No trajectory has been opened.\n");
+        return -1;
+    }
+
+    if (!session->started && session_start(session) != 0) return -1;
+
+    system_t *system = session->system;
+    if (trajectory_read_frame(session->trajectory, system) != 0) return 1;
+
+    posdist_frame_t *frame = &session->frame;
+    frame->index = session->n_read++;
+    frame->step = system->step;
+    frame->time = system->time;
+    memcpy(frame->box, system->box, sizeof(frame->box));
+
+    for (size_t a = 0; a < session->n_analyses; ++a) {
+        session_analysis_t *registered = &session->analyses[a];
+        analysis_t *analysis = &registered->analysis;
+
+        if (analysis_frame(analysis, analysis->source1, analysis->source2, system, NULL, &registered->values) != 0) return -1;
+
+        if (registered->callback != NULL &&
+            registered->callback((int) a, frame, registered->values.values, analysis->n_values, registered->data) != 0) return -1;
+    }
+
+    return 0;
+}
+
+const posdist_frame_t *posdist_frame(const posdist_t *session)
+{
+    return session->n_read > 0 ? &session->frame : NULL;
+}
+
+int posdist_run(posdist_t *session)
+{
+    int status = 0;
+    while ((status = posdist_next_frame(session)) == 0);
+
+    return status < 0;
+}
+
+void posdist_close(posdist_t *session)
+{
+    if (session == NULL) return;
+
+    for (size_t a = 0; a < session->n_analyses; ++a) {
+        session_analysis_t *registered = &session->analyses[a];
+
+        // the buffer of the caller is never released
+        if (session->started) {
+            registered->values.values = registered->own_values;
+            frame_values_destroy(&registered->values);
+        }
+
+        analysis_destroy(&registered->analysis);
+        free(registered->selection1);
+        free(registered->selection2);
+        free(registered->query1);
+        free(registered->query2);
+    }
+
+    free(session->analyses);
+    trajectory_close(session->trajectory);
+    dict_destroy(session->ndx_groups);
+    ndx_index_destroy(session->ndx);
+    free(session->all);
+    free(session->system);
+    free(session);
+}
@@ -0,0 +1,115 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef POSDIST_H
+#define POSDIST_H
+
+#include <stddef.h>
+
+/*
+ * C API of posdist (libposdist) for programs analyzing trajectories without running posdist as a subprocess.
+ *
+ * A session reads the system (gro file or snapshot) and the ndx file once, registers any number of analyses
+ * and then reads the frames of an xtc file one by one. Every frame, the values of all analyses are calculated
+ * and either written directly into buffers provided by the caller or passed to callbacks. The session writes
+ * no files and prints nothing to the standard output; errors are reported to the standard error output.
+ *
+ * Build the library using 'make lib' and link it together with groan:
+ *   gcc program.c -I/path/to/posdist/src -L/path/to/posdist -lposdist -L$GROAN -lgroan -lm -lz -pthread
+ *
+ * Values calculated by the analyses for every frame:
+ *   positions of atoms             x, y and z of every atom of the selection (3 values per atom)
+ *   center of a selection          x, y and z of the center of geometry (3 values)
+ *   distances between atoms        distance of every pair of atoms, pair (i, j) at index i * N2 + j;
+ *                                  for two identical selections, only pairs i < j in the order (0, 1), (0, 2), ..., (1, 2), ...
+ *   distance to a reference        distance of every atom of selection 1 to the center of selection 2 (1 value per atom)
+ *   distance between centers,
+ *   minimum distance, contacts     a single value
+ */
+
+/*! @brief Session analyzing a single system and trajectory. */
+typedef struct posdist posdist_t;
+
+/*! @brief Flags of the analyses. */
+enum posdist_flags {
+    POSDIST_X = 1,              // dimensions of the distances; no dimension = all dimensions (xyz)
+    POSDIST_Y = 2,
+    POSDIST_Z = 4,
+    POSDIST_WHOLE = 8,          // center of the selection or distance between the centers of the selections
+    POSDIST_REFERENCE = 16,     // distances between the atoms of selection 1 and the center of selection 2
+    POSDIST_MINIMUM = 32        // minimum distance between the atoms of the selections
+};
+
+/*! @brief Trajectory frame currently analyzed by the session. */
+typedef struct posdist_frame {
+    size_t index;               // number of frames read before this frame by the session
+    int step;
+    float time;                 // ps
+    float box[9];               // nm
+} posdist_frame_t;
+
+/*
+ * Called for every frame with the values of the analysis. 'values' are only valid during the call.
+ * Return zero to continue. Returning non-zero stops posdist_run (and posdist_next_frame reports an error).
+ */
+typedef int (*posdist_callback_t)(int analysis, const posdist_frame_t *frame, const float *values, size_t n_values, void *data);
+
+/*
+ * Opens session analyzing the system of the gro file (or snapshot). Atoms are selected using the groups
+ * of the ndx file (optional, may be NULL) or, if no ndx file is supplied, of the snapshot. Returns NULL, if the system could not be read.
+ */
+posdist_t *posdist_open(const char *gro_file, const char *ndx_file);
+
+/*! @brief Opens the xtc file whose frames are analyzed. Returns zero, if successful, else returns non-zero. */
+int posdist_open_trajectory(posdist_t *session, const char *xtc_file);
+
+/*
+ * Adds analysis of the positions of the atoms of the selection (or of its center with POSDIST_WHOLE).
+ * Analyses must be added before the first frame is read.
+ * Returns the number of the analysis (from 0) or -1, if the analysis could not be added.
+ */
+int posdist_add_positions(posdist_t *session, const char *selection, int flags);
+
+/*
+ * Adds analysis of the distances between the atoms of two selections (see the flags).
+ * Analyses must be added before the first frame is read.
+ * Returns the number of the analysis (from 0) or -1, if the analysis could not be added.
+ */
+int posdist_add_distances(posdist_t *session, const char *selection1, const char *selection2, int flags);
+
+/*
+ * Adds analysis counting the pairs of atoms of two selections closer than 'radius' (nm).
+ * Analyses must be added before the first frame is read.
+ * Returns the number of the analysis (from 0) or -1, if the analysis could not be added.
+ */
+int posdist_add_contacts(posdist_t *session, const char *selection1, const char *selection2, float radius, int flags);
+
+/*! @brief Returns the number of values calculated by the analysis for every frame. Returns zero for an unknown analysis. */
+size_t posdist_n_values(const posdist_t *session, int analysis);
+
+/*
+ * Calculates the values of the analysis directly into 'buffer' of posdist_n_values floats, which must stay valid
+ * until it is replaced or the session is closed. NULL restores the internal buffer.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int posdist_set_buffer(posdist_t *session, int analysis, float *buffer);
+
+/*! @brief Calls 'callback' with the values of the analysis for every frame. NULL removes the callback. Returns zero, if successful, else returns non-zero. */
+int posdist_set_callback(posdist_t *session, int analysis, posdist_callback_t callback, void *data);
+
+/*
+ * Reads the next frame of the trajectory and calculates the values of all analyses.
+ * Returns zero, if a frame was analyzed. Returns 1 at the end of the trajectory. Returns -1 on error.
+ */
+int posdist_next_frame(posdist_t *session);
+
+/*! @brief Returns the frame analyzed last. Returns NULL, if no frame has been analyzed. */
+const posdist_frame_t *posdist_frame(const posdist_t *session);
+
+/*! @brief Analyzes all remaining frames of the trajectory. Returns zero, if successful, else returns non-zero. */
+int posdist_run(posdist_t *session);
+
+/*! @brief Closes the session and releases all memory. */
+void posdist_close(posdist_t *session);
+
+#endif /* POSDIST_H */
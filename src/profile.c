@@ -0,0 +1,204 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "profile.h"
+
+// initial number of frames that can be recorded
+static const size_t INITIAL_FRAMES = 1024;
+
+static const char *PHASE_NAMES[PROFILE_N_PHASES] = { "decode", "compute", "output" };
+
+/*! @brief Summary of the durations of a single phase. */
+typedef struct phase_summary {
+    double total;
+    double mean;
+    double p50, p90, p99, max;
+} phase_summary_t;
+
+double profile_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+profile_t *profile_create(const char *json_file)
+{
+    profile_t *profile = calloc(1, sizeof(profile_t));
+    if (profile == NULL) return NULL;
+
+    profile->json_file = json_file;
+    profile->n_threads = 1;
+    profile->start = profile_now();
+    return profile;
+}
+
+int profile_add_frame(profile_t *profile, const double times[PROFILE_N_PHASES])
+{
+    if (profile->n_frames == profile->capacity) {
+        size_t capacity = profile->capacity == 0 ? INITIAL_FRAMES : 2 * profile->capacity;
+        for (int p = 0; p < PROFILE_N_PHASES; ++p) {
+            double *resized = realloc(profile->times[p], capacity * sizeof(double));
+            if (resized == NULL) return 1;
+            profile->times[p] = resized;
+        }
+        profile->capacity = capacity;
+    }
+
+    for (int p = 0; p < PROFILE_N_PHASES; ++p) profile->times[p][profile->n_frames] = times[p];
+    ++profile->n_frames;
+    return 0;
+}
+
+/*! @brief Compares two doubles. */
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/*! @brief Returns the percentile of sorted values (nearest rank). */
+static double percentile(const double *sorted, const size_t n_values, const double fraction)
+{
+    if (n_values == 0) return 0.0;
+
+    size_t rank = (size_t) (fraction * n_values + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > n_values) rank = n_values;
+    return sorted[rank - 1];
+}
+
+/*! @brief Summarizes durations of the phase. */
+static phase_summary_t summarize(const profile_t *profile, const profile_phase_t phase)
+{
+    phase_summary_t summary = {0};
+    if (profile->n_frames == 0) return summary;
+
+    double *sorted = malloc(profile->n_frames * sizeof(double));
+    if (sorted == NULL) return summary;
+
+    memcpy(sorted, profile->times[phase], profile->n_frames * sizeof(double));
+    qsort(sorted, profile->n_frames, sizeof(double), compare_doubles);
+
+    for (size_t i = 0; i < profile->n_frames; ++i) summary.total += sorted[i];
+    summary.mean = summary.total / profile->n_frames;
+    summary.p50 = percentile(sorted, profile->n_frames, 0.50);
+    summary.p90 = percentile(sorted, profile->n_frames, 0.90);
+    summary.p99 = percentile(sorted, profile->n_frames, 0.99);
+    summary.max = sorted[profile->n_frames - 1];
+
+    free(sorted);
+    return summary;
+}
+
+/*! @brief Returns peak resident memory of the process in MB. */
+static double peak_memory(void)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+
+    // ru_maxrss is in kilobytes on Linux
+    return usage.ru_maxrss / 1024.0;
+}
+
+/*! @brief Returns time spent processing the trajectory. */
+static double trajectory_time(const profile_t *profile)
+{
+    return profile->trajectory_end > profile->trajectory_start ? profile->trajectory_end - profile->trajectory_start : 0.0;
+}
+
+/*! @brief Returns 'amount' per second of the trajectory processing (zero, if no time was spent). */
+static double per_second(const profile_t *profile, const double amount)
+{
+    double time = trajectory_time(profile);
+    return time > 0.0 ? amount / time : 0.0;
+}
+
+/*! @brief Returns the number of bytes written per second of the trajectory processing and writing of the results. */
+static double output_rate(const profile_t *profile)
+{
+    double time = trajectory_time(profile) + profile->finish;
+    return time > 0.0 ? profile->bytes_written / time : 0.0;
+}
+
+void profile_print(const profile_t *profile, FILE *stream)
+{
+    double wall = profile_now() - profile->start;
+    double trajectory = trajectory_time(profile);
+    double setup = profile->trajectory_start > 0.0 ? profile->trajectory_start - profile->start : 0.0;
+
+    fprintf(stream, "Profile of the calculation:\n");
+    fprintf(stream, ">>> wall time:       %.3f s (setup: %.3f s, trajectory: %.3f s, finish: %.3f s)\n",
+            wall, setup, trajectory, profile->finish);
+    fprintf(stream, ">>> frames:          %zu (%.1f frames/s, %.3e atoms/s)\n", profile->n_frames,
+            per_second(profile, profile->n_frames), per_second(profile, (double) profile->n_frames * profile->n_atoms));
+    fprintf(stream, ">>> output:          %.3f MB (%.2f MB/s)\n", profile->bytes_written / 1e6, output_rate(profile) / 1e6);
+    fprintf(stream, ">>> peak memory:     %.1f MB\n", peak_memory());
+
+    if (profile->n_frames == 0) return;
+
+    fprintf(stream, ">>> %-10s %12s %12s %12s %12s %12s %12s\n", "phase", "total (s)", "mean (ms)", "p50 (ms)", "p90 (ms)", "p99 (ms)", "max (ms)");
+    for (int p = 0; p < PROFILE_N_PHASES; ++p) {
+        phase_summary_t summary = summarize(profile, p);
+        fprintf(stream, ">>> %-10s %12.3f %12.3f %12.3f %12.3f %12.3f %12.3f\n", PHASE_NAMES[p], summary.total,
+                1e3 * summary.mean, 1e3 * summary.p50, 1e3 * summary.p90, 1e3 * summary.p99, 1e3 * summary.max);
+    }
+
+    if (profile->n_threads > 1) {
+        fprintf(stream, "Phases of different frames overlap when using multiple threads (%d).\n", profile->n_threads);
+    }
+}
+
+int profile_write_json(const profile_t *profile)
+{
+    FILE *file = fopen(profile->json_file, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open profile file '%s'\n", profile->json_file);
+        return 1;
+    }
+
+    double wall = profile_now() - profile->start;
+    double setup = profile->trajectory_start > 0.0 ? profile->trajectory_start - profile->start : 0.0;
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"wall_s\": %.6f,\n", wall);
+    fprintf(file, "  \"setup_s\": %.6f,\n", setup);
+    fprintf(file, "  \"trajectory_s\": %.6f,\n", trajectory_time(profile));
+    fprintf(file, "  \"finish_s\": %.6f,\n", profile->finish);
+    fprintf(file, "  \"threads\": %d,\n", profile->n_threads);
+    fprintf(file, "  \"frames\": %zu,\n", profile->n_frames);
+    fprintf(file, "  \"atoms_per_frame\": %zu,\n", profile->n_atoms);
+    fprintf(file, "  \"frames_per_s\": %.3f,\n", per_second(profile, profile->n_frames));
+    fprintf(file, "  \"atoms_per_s\": %.1f,\n", per_second(profile, (double) profile->n_frames * profile->n_atoms));
+    fprintf(file, "  \"bytes_written\": %llu,\n", (unsigned long long) profile->bytes_written);
+    fprintf(file, "  \"bytes_per_s\": %.1f,\n", output_rate(profile));
+    fprintf(file, "  \"peak_rss_mb\": %.3f,\n", peak_memory());
+    fprintf(file, "  \"phases\": {\n");
+    for (int p = 0; p < PROFILE_N_PHASES; ++p) {
+        phase_summary_t summary = summarize(profile, p);
+        fprintf(file, "    \"%s\": {\"total_s\": %.6f, \"mean_s\": %.9f, \"p50_s\": %.9f, \"p90_s\": %.9f, \"p99_s\": %.9f, \"max_s\": %.9f}%s\n",
+                PHASE_NAMES[p], summary.total, summary.mean, summary.p50, summary.p90, summary.p99, summary.max,
+                p + 1 < PROFILE_N_PHASES ? "," : "");
+    }
+    fprintf(file, "  }\n");
+    fprintf(file, "}\n");
+
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Could not write profile file '%s'\n", profile->json_file);
+        return 1;
+    }
+
+    return 0;
+}
+
+void profile_destroy(profile_t *profile)
+{
+    if (profile == NULL) return;
+
+    for (int p = 0; p < PROFILE_N_PHASES; ++p) free(profile->times[p]);
+    free(profile);
+}
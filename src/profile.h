@@ -0,0 +1,57 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*! @brief Phases of the processing of a single trajectory frame. */
+typedef enum profile_phase {
+    profile_decode,             // reading and decompressing the frame
+    profile_compute,            // calculating the values of all analyses
+    profile_output,             // writing out or accumulating the values
+    PROFILE_N_PHASES
+} profile_phase_t;
+
+/*
+ * Timing of a posdist run (option --profile).
+ *
+ * The duration of every phase is measured for every frame using a monotonic clock.
+ * With multiple threads, the phases of different frames overlap, so the sums of
+ * the phases may be larger than the time spent reading the trajectory.
+ */
+typedef struct profile {
+    const char *json_file;      // the report is also written into this file as JSON; NULL = no JSON
+    int n_threads;
+    double start;               // time when the profiling started
+    double trajectory_start;    // time when reading of the trajectory started
+    double trajectory_end;      // time when all frames were processed
+    double finish;              // time spent writing the results after the trajectory
+    size_t n_atoms;             // number of atoms decompressed in every frame
+    uint64_t bytes_written;     // total size of the output files
+    size_t n_frames;
+    size_t capacity;
+    double *times[PROFILE_N_PHASES];    // duration of every phase for every frame (s)
+} profile_t;
+
+/*! @brief Returns the current time of the monotonic clock in seconds. */
+double profile_now(void);
+
+/*! @brief Starts profiling. Returns NULL, if memory could not be allocated. */
+profile_t *profile_create(const char *json_file);
+
+/*! @brief Records durations of the phases of a single frame. Returns zero, if successful, else returns non-zero. */
+int profile_add_frame(profile_t *profile, const double times[PROFILE_N_PHASES]);
+
+/*! @brief Prints the report into the stream. */
+void profile_print(const profile_t *profile, FILE *stream);
+
+/*! @brief Writes the report as JSON into the json file of the profile. Returns zero, if successful, else returns non-zero. */
+int profile_write_json(const profile_t *profile);
+
+/*! @brief Releases memory allocated for the profile. */
+void profile_destroy(profile_t *profile);
+
+#endif /* PROFILE_H */
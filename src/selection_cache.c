@@ -0,0 +1,205 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "selection_cache.h"
+#include "hash.h"
+
+// identifies posdist selection cache files
+static const char CACHE_MAGIC[4] = {'P', 'D', 'S', 'C'};
+
+// version of the cache file format
+static const int32_t CACHE_VERSION = 1;
+
+// extension of the cache files
+static const char CACHE_EXTENSION[] = ".psel";
+
+/*! @brief Header of the cache file. Followed by the query and the indices of the selected atoms. */
+typedef struct cache_file_header {
+    char magic[4];
+    int32_t version;
+    uint64_t gro_hash;
+    uint64_t ndx_hash;
+    uint64_t n_system_atoms;
+    uint64_t query_length;
+    uint64_t n_atoms;
+} cache_file_header_t;
+
+selection_cache_t *selection_cache_open(const char *directory, const char *gro_file, const char *ndx_file)
+{
+    selection_cache_t *cache = calloc(1, sizeof(selection_cache_t));
+    if (cache == NULL) return NULL;
+
+    cache->directory = malloc(strlen(directory) + 1);
+    if (cache->directory == NULL) {
+        free(cache);
+        return NULL;
+    }
+    strcpy(cache->directory, directory);
+
+    if (hash_file(gro_file, &cache->gro_hash) != 0) {
+        fprintf(stderr, "Could not read gro file %s.\n", gro_file);
+        selection_cache_close(cache);
+        return NULL;
+    }
+
+    // a missing ndx file is valid and selections using it simply fail
+    if (hash_file(ndx_file, &cache->ndx_hash) != 0) cache->ndx_hash = 0;
+
+    // entries are written into the directory once the queries are resolved
+    if (mkdir(directory, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Warning. Could not create selection cache directory '%s'. Selections will not be cached.\n", directory);
+    }
+
+    return cache;
+}
+
+/*! @brief Returns the path to the cache file of the query. Must be freed by the caller. */
+static char *entry_path(const selection_cache_t *cache, const char *query)
+{
+    uint64_t key = hash_bytes(HASH_INIT, &cache->gro_hash, sizeof(uint64_t));
+    key = hash_bytes(key, &cache->ndx_hash, sizeof(uint64_t));
+    key = hash_bytes(key, query, strlen(query));
+
+    size_t length = strlen(cache->directory) + 32 + sizeof(CACHE_EXTENSION);
+    char *path = malloc(length);
+    if (path == NULL) return NULL;
+
+    snprintf(path, length, "%s/%016" PRIx64 "%s", cache->directory, key, CACHE_EXTENSION);
+    return path;
+}
+
+/*! @brief Loads selection from the cache. Returns NULL, if the entry does not exist or is not valid. */
+static atom_selection_t *entry_load(const selection_cache_t *cache, system_t *system, const char *query)
+{
+    char *path = entry_path(cache, query);
+    if (path == NULL) return NULL;
+
+    FILE *file = fopen(path, "rb");
+    free(path);
+    if (file == NULL) return NULL;
+
+    const size_t query_length = strlen(query);
+    cache_file_header_t header = {0};
+    if (fread(&header, sizeof(cache_file_header_t), 1, file) != 1 ||
+        memcmp(header.magic, CACHE_MAGIC, 4) != 0 ||
+        header.version != CACHE_VERSION ||
+        header.gro_hash != cache->gro_hash ||
+        header.ndx_hash != cache->ndx_hash ||
+        header.n_system_atoms != system->n_atoms ||
+        header.query_length != query_length ||
+        header.n_atoms > system->n_atoms) {
+        fclose(file);
+        return NULL;
+    }
+
+    // the query is stored to rule out collisions of the hashes
+    char *stored = malloc(query_length + 1);
+    uint32_t *indices = malloc((header.n_atoms > 0 ? header.n_atoms : 1) * sizeof(uint32_t));
+    atom_selection_t *selection = malloc(sizeof(atom_selection_t) + header.n_atoms * sizeof(atom_t *));
+
+    int valid = stored != NULL && indices != NULL && selection != NULL &&
+                fread(stored, 1, query_length, file) == query_length && memcmp(stored, query, query_length) == 0 &&
+                fread(indices, sizeof(uint32_t), header.n_atoms, file) == header.n_atoms;
+    fclose(file);
+
+    for (size_t i = 0; valid && i < header.n_atoms; ++i) {
+        if (indices[i] >= system->n_atoms) valid = 0;
+        else selection->atoms[i] = &system->atoms[indices[i]];
+    }
+
+    free(stored);
+    free(indices);
+
+    if (!valid) {
+        free(selection);
+        return NULL;
+    }
+
+    selection->n_atoms = header.n_atoms;
+    return selection;
+}
+
+/*! @brief Stores selection in the cache. Returns zero, if successful, else returns non-zero. */
+static int entry_save(const selection_cache_t *cache, const system_t *system, const char *query, const atom_selection_t *selection)
+{
+    if (system->n_atoms > UINT32_MAX) return 1;
+
+    char *path = entry_path(cache, query);
+    if (path == NULL) return 1;
+
+    // the entry is written under a temporary name and renamed, once complete
+    size_t length = strlen(path) + 8;
+    char *temporary = malloc(length);
+    uint32_t *indices = malloc((selection->n_atoms > 0 ? selection->n_atoms : 1) * sizeof(uint32_t));
+    if (temporary == NULL || indices == NULL) {
+        free(path);
+        free(temporary);
+        free(indices);
+        return 1;
+    }
+    snprintf(temporary, length, "%s.XXXXXX", path);
+
+    for (size_t i = 0; i < selection->n_atoms; ++i) indices[i] = (uint32_t) (selection->atoms[i] - system->atoms);
+
+    cache_file_header_t header = {0};
+    memcpy(header.magic, CACHE_MAGIC, 4);
+    header.version = CACHE_VERSION;
+    header.gro_hash = cache->gro_hash;
+    header.ndx_hash = cache->ndx_hash;
+    header.n_system_atoms = system->n_atoms;
+    header.query_length = strlen(query);
+    header.n_atoms = selection->n_atoms;
+
+    int status = 1;
+    int fd = mkstemp(temporary);
+    FILE *file = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (file != NULL) {
+        status = fwrite(&header, sizeof(cache_file_header_t), 1, file) != 1 ||
+                 fwrite(query, 1, header.query_length, file) != header.query_length ||
+                 fwrite(indices, sizeof(uint32_t), selection->n_atoms, file) != selection->n_atoms;
+        if (fclose(file) != 0) status = 1;
+    } else if (fd >= 0) {
+        close(fd);
+    }
+
+    if (status == 0 && rename(temporary, path) != 0) status = 1;
+    if (status != 0 && fd >= 0) unlink(temporary);
+
+    free(path);
+    free(temporary);
+    free(indices);
+    return status;
+}
+
+atom_selection_t *selection_cache_select(
+        selection_cache_t *cache,
+        system_t *system,
+        atom_selection_t *all,
+        char *query,
+        dict_t *ndx_groups)
+{
+    if (cache == NULL) return smart_select(all, query, ndx_groups);
+
+    atom_selection_t *selection = entry_load(cache, system, query);
+    if (selection != NULL) return selection;
+
+    selection = smart_select(all, query, ndx_groups);
+
+    // failed queries are not cached, so that their errors are reported every time
+    if (selection != NULL && selection->n_atoms > 0) entry_save(cache, system, query, selection);
+    return selection;
+}
+
+void selection_cache_close(selection_cache_t *cache)
+{
+    if (cache == NULL) return;
+
+    free(cache->directory);
+    free(cache);
+}
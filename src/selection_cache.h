@@ -0,0 +1,47 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef SELECTION_CACHE_H
+#define SELECTION_CACHE_H
+
+#include <stdint.h>
+#include <groan.h>
+
+/*
+ * Cache of resolved selections stored in a directory and shared by later runs.
+ *
+ * Every entry contains the indices of the atoms selected by a single query and is identified
+ * by the hashes of the contents of the gro file and the ndx file together with the query.
+ * Changing either file therefore changes the identity of the entry, so outdated entries are never used.
+ * Entries are written into temporary files that are renamed once complete, so concurrent runs
+ * sharing the directory never read a partial entry. Failing to read or write the cache is not an error.
+ */
+typedef struct selection_cache {
+    char *directory;
+    uint64_t gro_hash;
+    uint64_t ndx_hash;          // zero, if the ndx file does not exist
+} selection_cache_t;
+
+/*
+ * Opens cache in 'directory', which is created if it does not exist, for the given gro and ndx files.
+ * Returns NULL, if the gro file could not be read or memory could not be allocated.
+ */
+selection_cache_t *selection_cache_open(const char *directory, const char *gro_file, const char *ndx_file);
+
+/*
+ * Selects atoms of the system matching the query. The selection is loaded from the cache, if possible.
+ * Otherwise, the query is resolved using smart_select and the result is stored in the cache.
+ * If 'cache' is NULL, this is equivalent to smart_select.
+ * Returns NULL, if the selection could not be created.
+ */
+atom_selection_t *selection_cache_select(
+        selection_cache_t *cache,
+        system_t *system,
+        atom_selection_t *all,
+        char *query,
+        dict_t *ndx_groups);
+
+/*! @brief Releases memory allocated for the cache. */
+void selection_cache_close(selection_cache_t *cache);
+
+#endif /* SELECTION_CACHE_H */
@@ -0,0 +1,341 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "shard.h"
+
+// identifies posdist partial files
+static const char PARTIAL_MAGIC[4] = {'P', 'D', 'P', 'T'};
+
+// version of the partial file format
+static const int32_t PARTIAL_VERSION = 4;
+
+/*
+ * Header of the partial file. Followed by:
+ *   null-terminated xtc file and 'argc' null-terminated arguments of the command line (args_size bytes)
+ *   accumulated values of the analysis (see analysis_save)
+ */
+typedef struct partial_header {
+    char magic[4];
+    int32_t version;
+    int32_t shard;
+    int32_t n_shards;
+    int32_t parts;
+    int32_t argc;
+    uint64_t args_size;
+} partial_header_t;
+
+int shard_parse(const char *string, int *shard, int *n_shards)
+{
+    char end = 0;
+    if (sscanf(string, "%d/%d%c", shard, n_shards, &end) != 2) return 1;
+    return *n_shards < 1 || *shard < 1 || *shard > *n_shards;
+}
+
+char *shard_filename(const char *output_file, const frame_window_t *window)
+{
+    size_t size = strlen(output_file) + 64;
+    char *filename = malloc(size);
+    if (filename == NULL) return NULL;
+
+    snprintf(filename, size, "%s.part-%d-of-%d", output_file, window->shard, window->n_shards);
+    return filename;
+}
+
+/*
+ * Returns number of arguments starting at argv[i] that are not stored in the partial file:
+ * options --shard, --part, --checkpoint and --checkpoint-interval (also abbreviated) with their values and the xtc file (-f).
+ * Returns zero, if the argument is stored.
+ */
+static int skipped_arguments(const int argc, char **argv, const int i)
+{
+    const char *arg = argv[i];
+
+    if (strncmp(arg, "--", 2) == 0) {
+        size_t length = strcspn(arg + 2, "=");
+        if (length < 2 || (strncmp(arg + 2, "shard", length) != 0 && strncmp(arg + 2, "part", length) != 0 &&
+            strncmp(arg + 2, "checkpoint-interval", length) != 0)) return 0;
+        return arg[2 + length] == '=' || i + 1 >= argc ? 1 : 2;
+    }
+
+    if (strncmp(arg, "-f", 2) == 0) return arg[2] != '\0' || i + 1 >= argc ? 1 : 2;
+
+    return 0;
+}
+
+int shard_write(const char *filename, const char *xtc_file, const frame_window_t *window, const sharding_t *sharding, const analysis_t *analysis)
+{
+    partial_header_t header = {0};
+    memcpy(header.magic, PARTIAL_MAGIC, 4);
+    header.version = PARTIAL_VERSION;
+    header.shard = window->shard;
+    header.n_shards = window->n_shards;
+    header.parts = window->parts;
+    header.args_size = strlen(xtc_file) + 1;
+
+    for (int i = 0; i < sharding->argc; ++i) {
+        int skipped = skipped_arguments(sharding->argc, sharding->argv, i);
+        if (skipped > 0) {
+            i += skipped - 1;
+            continue;
+        }
+
+        ++header.argc;
+        header.args_size += strlen(sharding->argv[i]) + 1;
+    }
+
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open file %s for writing.\n", filename);
+        return 1;
+    }
+
+    int status = fwrite(&header, sizeof(partial_header_t), 1, file) != 1 ||
+                 fwrite(xtc_file, 1, strlen(xtc_file) + 1, file) != strlen(xtc_file) + 1;
+
+    for (int i = 0; status == 0 && i < sharding->argc; ++i) {
+        int skipped = skipped_arguments(sharding->argc, sharding->argv, i);
+        if (skipped > 0) {
+            i += skipped - 1;
+            continue;
+        }
+
+        status = fwrite(sharding->argv[i], 1, strlen(sharding->argv[i]) + 1, file) != strlen(sharding->argv[i]) + 1;
+    }
+
+    if (status == 0) status = analysis_save(analysis, file);
+
+    if (fclose(file) != 0) status = 1;
+    if (status != 0) fprintf(stderr, "Could not write partial results into file %s.\n", filename);
+
+    return status;
+}
+
+partial_t *partial_open(const char *filename)
+{
+    partial_t *partial = calloc(1, sizeof(partial_t));
+    if (partial == NULL) {
+        fprintf(stderr, "Could not allocate memory for the partial file.\n");
+        return NULL;
+    }
+
+    partial->filename = filename;
+    partial->file = fopen(filename, "rb");
+    if (partial->file == NULL) {
+        fprintf(stderr, "Could not read partial file %s.\n", filename);
+        partial_close(partial);
+        return NULL;
+    }
+
+    partial_header_t header;
+    if (fread(&header, sizeof(partial_header_t), 1, partial->file) != 1 || memcmp(header.magic, PARTIAL_MAGIC, 4) != 0) {
+        fprintf(stderr, "File %s is not a partial file of posdist.\n", filename);
+        partial_close(partial);
+        return NULL;
+    }
+
+    if (header.version != PARTIAL_VERSION) {
+        fprintf(stderr, "Partial file %s was written by an incompatible version of posdist.\n", filename);
+        partial_close(partial);
+        return NULL;
+    }
+
+    // the arguments are checked against the size of the header before they are allocated
+    if (header.n_shards < 1 || header.shard < 1 || header.shard > header.n_shards || header.argc < 0 ||
+        header.args_size > (1 << 20) || (uint64_t) header.argc >= header.args_size) {
+        fprintf(stderr, "Partial file %s is not valid.\n", filename);
+        partial_close(partial);
+        return NULL;
+    }
+
+    partial->shard = header.shard;
+    partial->n_shards = header.n_shards;
+    partial->parts = header.parts;
+    partial->args = malloc((size_t) header.args_size);
+    partial->argv = calloc((size_t) header.argc + 1, sizeof(char *));
+    if (partial->args == NULL || partial->argv == NULL) {
+        fprintf(stderr, "Could not allocate memory for the partial file.\n");
+        partial_close(partial);
+        return NULL;
+    }
+
+    if (fread(partial->args, 1, (size_t) header.args_size, partial->file) != header.args_size ||
+        partial->args[header.args_size - 1] != '\0') {
+        fprintf(stderr, "Partial file %s is not valid.\n", filename);
+        partial_close(partial);
+        return NULL;
+    }
+
+    // split the arguments
+    char *arg = partial->args;
+    const char *end = partial->args + header.args_size;
+    partial->xtc_file = arg;
+    arg += strlen(arg) + 1;
+    for (; partial->argc < header.argc && arg < end; ++partial->argc) {
+        partial->argv[partial->argc] = arg;
+        arg += strlen(arg) + 1;
+    }
+
+    if (partial->argc != header.argc || arg != end) {
+        fprintf(stderr, "Partial file %s is not valid.\n", filename);
+        partial_close(partial);
+        return NULL;
+    }
+
+    return partial;
+}
+
+void partial_close(partial_t *partial)
+{
+    if (partial == NULL) return;
+
+    if (partial->file != NULL) fclose(partial->file);
+    free(partial->args);
+    free(partial->argv);
+    free(partial);
+}
+
+/*! @brief Compares partial files by their shards. */
+static int compare_partials(const void *a, const void *b)
+{
+    const partial_t *partial1 = *(partial_t * const *) a;
+    const partial_t *partial2 = *(partial_t * const *) b;
+    return (partial1->shard > partial2->shard) - (partial1->shard < partial2->shard);
+}
+
+/*! @brief Returns 1, if both partial files were written by the same command line. Else returns 0. */
+static int same_command(const partial_t *partial1, const partial_t *partial2)
+{
+    if (partial1->argc != partial2->argc) return 0;
+
+    for (int i = 0; i < partial1->argc; ++i) {
+        if (strcmp(partial1->argv[i], partial2->argv[i]) != 0) return 0;
+    }
+
+    return 1;
+}
+
+int partials_check(partial_t **partials, const size_t n_partials)
+{
+    qsort(partials, n_partials, sizeof(partial_t *), compare_partials);
+
+    const partial_t *first = partials[0];
+    for (size_t i = 0; i < n_partials; ++i) {
+        const partial_t *partial = partials[i];
+
+        if (partial->n_shards != first->n_shards || partial->parts != first->parts) {
+            fprintf(stderr, "Partial files %s and %s belong to differently sharded trajectories.\n", first->filename, partial->filename);
+            return 1;
+        }
+
+        if (i > 0 && partial->shard == partials[i - 1]->shard) {
+            fprintf(stderr, "Partial files %s and %s contain the same shard %d/%d.\n",
+                    partials[i - 1]->filename, partial->filename, partial->shard, partial->n_shards);
+            return 1;
+        }
+
+        if (!same_command(first, partial) || (!partial->parts && strcmp(first->xtc_file, partial->xtc_file) != 0)) {
+            fprintf(stderr, "Partial files %s and %s were written by different analyses.\n", first->filename, partial->filename);
+            return 1;
+        }
+    }
+
+    // shards are unique and ordered, so all of them are present, if their number matches
+    if (n_partials != (size_t) first->n_shards) {
+        for (size_t i = 0; i < n_partials; ++i) {
+            if (partials[i]->shard == (int) i + 1) continue;
+            fprintf(stderr, "Partial file of shard %zu/%d is missing.\n", i + 1, first->n_shards);
+            return 1;
+        }
+
+        fprintf(stderr, "Partial file of shard %zu/%d is missing.\n", n_partials + 1, first->n_shards);
+        return 1;
+    }
+
+    return 0;
+}
+
+int partials_merge(partial_t **partials, const size_t n_partials, analysis_t *analysis)
+{
+    for (size_t i = 0; i < n_partials; ++i) {
+        if (analysis_merge(analysis, partials[i]->file) != 0 || fgetc(partials[i]->file) != EOF) {
+            fprintf(stderr, "Could not merge partial file %s. It is not valid or does not match the analysis.\n", partials[i]->filename);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// options appended to the stored command line of the merged analysis
+static char XTC_OPTION[] = "-f";
+static char GRO_OPTION[] = "-c";
+static char NDX_OPTION[] = "-n";
+static char OUTPUT_OPTION[] = "-o";
+
+/*! @brief Appends option and its value to the command line, if the value is not NULL. */
+static void append_option(char **argv, int *argc, char *option, char *value)
+{
+    if (value == NULL) return;
+    argv[(*argc)++] = option;
+    argv[(*argc)++] = value;
+}
+
+merge_t *merge_open(char *program, char **filenames, const size_t n_files, char *gro_file, char *ndx_file, char *output_file)
+{
+    merge_t *merge = calloc(1, sizeof(merge_t));
+    partial_t **partials = calloc(n_files, sizeof(partial_t *));
+    if (merge == NULL || partials == NULL) {
+        fprintf(stderr, "Could not allocate memory for the partial files.\n");
+        free(merge);
+        free(partials);
+        return NULL;
+    }
+
+    merge->sharding.partials = partials;
+    merge->sharding.n_partials = n_files;
+
+    int status = 0;
+    for (size_t i = 0; i < n_files && status == 0; ++i) {
+        partials[i] = partial_open(filenames[i]);
+        if (partials[i] == NULL) status = 1;
+    }
+
+    if (status == 0) status = partials_check(partials, n_files);
+
+    // command line of the analysis followed by the replaced files
+    if (status == 0) {
+        merge->argv = malloc((partials[0]->argc + 9) * sizeof(char *));
+        if (merge->argv == NULL) {
+            fprintf(stderr, "Could not allocate memory for the partial files.\n");
+            status = 1;
+        }
+    }
+
+    if (status != 0) {
+        merge_close(merge);
+        return NULL;
+    }
+
+    merge->argv[merge->argc++] = program;
+    for (int i = 0; i < partials[0]->argc; ++i) merge->argv[merge->argc++] = partials[0]->argv[i];
+    append_option(merge->argv, &merge->argc, XTC_OPTION, partials[0]->xtc_file);
+    append_option(merge->argv, &merge->argc, GRO_OPTION, gro_file);
+    append_option(merge->argv, &merge->argc, NDX_OPTION, ndx_file);
+    append_option(merge->argv, &merge->argc, OUTPUT_OPTION, output_file);
+    merge->argv[merge->argc] = NULL;
+
+    return merge;
+}
+
+void merge_close(merge_t *merge)
+{
+    if (merge == NULL) return;
+
+    for (size_t i = 0; i < merge->sharding.n_partials; ++i) partial_close(merge->sharding.partials[i]);
+    free(merge->sharding.partials);
+    free(merge->argv);
+    free(merge);
+}
@@ -0,0 +1,93 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <stdio.h>
+#include "analysis.h"
+#include "trajectory.h"
+
+/*
+ * Sharded analysis of a trajectory.
+ *
+ * A shard run (options --shard and --part) analyzes only a part of the trajectory and saves
+ * the accumulated values into a partial file instead of writing the output. The partial file
+ * also stores the command line of the run, so 'posdist merge' can recreate the analysis,
+ * merge the partial files of all shards and write the output of the whole trajectory.
+ */
+
+/*! @brief Partial file written by a single shard. */
+typedef struct partial {
+    const char *filename;
+    FILE *file;                 // positioned at the saved accumulators (see analysis_save)
+    int shard;
+    int n_shards;
+    int parts;                  // see frame_window_t
+    char *xtc_file;
+    int argc;                   // command line of the analysis without the program name, the xtc file and the options of sharding
+    char **argv;
+    char *args;                 // storage of the arguments
+} partial_t;
+
+/*! @brief Command line or partial files of a sharded analysis. */
+typedef struct sharding {
+    int argc;                   // command line of the shard run without the program name (stored in the partial file)
+    char **argv;
+    partial_t **partials;       // partial files of all shards ordered by the shard (only when merging)
+    size_t n_partials;
+} sharding_t;
+
+/*
+ * Parses shard of the trajectory in the format 'I/N'.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int shard_parse(const char *string, int *shard, int *n_shards);
+
+/*! @brief Returns name of the partial file of the shard (OUTPUT.part-I-of-N). Must be freed by the caller. Returns NULL, if memory could not be allocated. */
+char *shard_filename(const char *output_file, const frame_window_t *window);
+
+/*
+ * Writes the partial file of the shard: the shard, the xtc file, the command line of the run
+ * with the options of sharding removed and the accumulated values of the analysis.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int shard_write(const char *filename, const char *xtc_file, const frame_window_t *window, const sharding_t *sharding, const analysis_t *analysis);
+
+/*! @brief Opens partial file and reads its command line. Returns NULL, if the file could not be read. */
+partial_t *partial_open(const char *filename);
+
+/*! @brief Closes the partial file and releases all memory. */
+void partial_close(partial_t *partial);
+
+/*
+ * Orders partial files by their shards and checks that they contain every shard of the same analysis exactly once.
+ * The command lines of the shards must be identical; separate xtc files (--part) may differ in the xtc file.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int partials_check(partial_t **partials, const size_t n_partials);
+
+/*
+ * Merges accumulated values of all partial files into the analysis (see analysis_merge).
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int partials_merge(partial_t **partials, const size_t n_partials, analysis_t *analysis);
+
+/*! @brief Partial files of all shards of an analysis together with the command line recreating the analysis. */
+typedef struct merge {
+    sharding_t sharding;        // partial files of all shards ordered by the shard
+    int argc;                   // program name, command line stored in the partial files, the xtc file and the replaced files
+    char **argv;
+} merge_t;
+
+/*
+ * Opens the partial files, checks that they contain every shard of the same analysis and recreates its command line.
+ * The gro, ndx and output files, if not NULL, replace the files of the stored command line.
+ * Returns NULL, if the partial files could not be opened or do not belong together.
+ */
+merge_t *merge_open(char *program, char **filenames, const size_t n_files, char *gro_file, char *ndx_file, char *output_file);
+
+/*! @brief Closes all partial files and releases all memory. */
+void merge_close(merge_t *merge);
+
+#endif /* SHARD_H */
@@ -0,0 +1,239 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "snapshot.h"
+
+// identifies posdist snapshot files
+static const char SNAPSHOT_MAGIC[4] = {'P', 'D', 'S', 'N'};
+
+// version of the snapshot file format
+static const int32_t SNAPSHOT_VERSION = 1;
+
+/*
+ * Header of the snapshot file. Followed by:
+ *   memory image of the system (system_size + n_atoms * atom_size bytes)
+ *   uint64 start of every ndx group and the end of the last group (n_groups + 1 values; only if n_groups > 0)
+ *   uint64 indices of the atoms of the ndx groups (n_group_atoms values)
+ *   null-terminated names of the ndx groups (names_size bytes)
+ */
+typedef struct snapshot_header {
+    char magic[4];
+    int32_t version;
+    uint64_t system_size;       // size of system_t without the atoms
+    uint64_t atom_size;         // size of atom_t
+    uint64_t n_atoms;
+    uint64_t n_groups;
+    uint64_t n_group_atoms;
+    uint64_t names_size;
+} snapshot_header_t;
+
+int snapshot_detect(const char *filename)
+{
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) return 0;
+
+    char magic[4] = {0};
+    int detected = fread(magic, 1, 4, file) == 4 && memcmp(magic, SNAPSHOT_MAGIC, 4) == 0;
+    fclose(file);
+    return detected;
+}
+
+int snapshot_write(const char *filename, const system_t *system, const ndx_index_t *ndx)
+{
+    snapshot_header_t header = {0};
+    memcpy(header.magic, SNAPSHOT_MAGIC, 4);
+    header.version = SNAPSHOT_VERSION;
+    header.system_size = sizeof(system_t);
+    header.atom_size = sizeof(atom_t);
+    header.n_atoms = system->n_atoms;
+
+    if (ndx != NULL) {
+        header.n_groups = ndx->n_groups;
+        header.n_group_atoms = ndx->start[ndx->n_groups];
+        for (size_t g = 0; g < ndx->n_groups; ++g) header.names_size += strlen(ndx->names[g]) + 1;
+    }
+
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open file %s for writing.\n", filename);
+        return 1;
+    }
+
+    // atoms contain no pointers, so the system is written as a single block
+    int status = fwrite(&header, sizeof(snapshot_header_t), 1, file) != 1 ||
+                 fwrite(system, sizeof(system_t) + system->n_atoms * sizeof(atom_t), 1, file) != 1;
+
+    for (size_t g = 0; status == 0 && g <= header.n_groups && header.n_groups > 0; ++g) {
+        uint64_t start = ndx->start[g];
+        status = fwrite(&start, sizeof(uint64_t), 1, file) != 1;
+    }
+
+    for (size_t i = 0; status == 0 && i < header.n_group_atoms; ++i) {
+        uint64_t index = (uint64_t) (ndx->atoms[i] - system->atoms);
+        status = fwrite(&index, sizeof(uint64_t), 1, file) != 1;
+    }
+
+    for (size_t g = 0; status == 0 && g < header.n_groups; ++g) {
+        status = fwrite(ndx->names[g], 1, strlen(ndx->names[g]) + 1, file) != strlen(ndx->names[g]) + 1;
+    }
+
+    if (fclose(file) != 0) status = 1;
+    if (status != 0) fprintf(stderr, "Could not write snapshot into file %s.\n", filename);
+
+    return status;
+}
+
+/*
+ * Reads ndx groups stored in the snapshot ('data' points to the start of the groups).
+ * Returns NULL, if the groups are not valid or memory could not be allocated.
+ */
+static ndx_index_t *groups_load(const snapshot_header_t *header, const char *data, system_t *system)
+{
+    ndx_index_t *ndx = calloc(1, sizeof(ndx_index_t));
+    if (ndx == NULL) return NULL;
+
+    ndx->names = calloc(header->n_groups, sizeof(char *));
+    ndx->start = malloc((header->n_groups + 1) * sizeof(size_t));
+    ndx->atoms = malloc((header->n_group_atoms > 0 ? header->n_group_atoms : 1) * sizeof(atom_t *));
+    if (ndx->names == NULL || ndx->start == NULL || ndx->atoms == NULL) {
+        ndx_index_destroy(ndx);
+        return NULL;
+    }
+
+    int valid = 1;
+
+    for (size_t g = 0; g <= header->n_groups; ++g) {
+        uint64_t start = 0;
+        memcpy(&start, data, sizeof(uint64_t));
+        data += sizeof(uint64_t);
+
+        if (start > header->n_group_atoms || (g > 0 && start < ndx->start[g - 1])) valid = 0;
+        ndx->start[g] = (size_t) start;
+    }
+    if (ndx->start[0] != 0 || ndx->start[header->n_groups] != header->n_group_atoms) valid = 0;
+
+    for (size_t i = 0; valid && i < header->n_group_atoms; ++i) {
+        uint64_t index = 0;
+        memcpy(&index, data, sizeof(uint64_t));
+        data += sizeof(uint64_t);
+
+        if (index >= system->n_atoms) valid = 0;
+        else ndx->atoms[i] = &system->atoms[index];
+    }
+    if (!valid) {
+        ndx_index_destroy(ndx);
+        return NULL;
+    }
+
+    // groups are only counted once their names are allocated, so that ndx_index_destroy can release them
+    const char *names_end = data + header->names_size;
+    for (size_t g = 0; g < header->n_groups; ++g) {
+        const char *end = memchr(data, '\0', (size_t) (names_end - data));
+        if (end == NULL || (ndx->names[g] = malloc((size_t) (end - data) + 1)) == NULL) {
+            ndx_index_destroy(ndx);
+            return NULL;
+        }
+        memcpy(ndx->names[g], data, (size_t) (end - data) + 1);
+        ndx->n_groups = g + 1;
+        data = end + 1;
+    }
+
+    return ndx;
+}
+
+system_t *snapshot_load(const char *filename, ndx_index_t **ndx)
+{
+    *ndx = NULL;
+
+    int fd = open(filename, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Could not read snapshot %s.\n", filename);
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+
+    const size_t file_size = (size_t) info.st_size;
+    if (file_size < sizeof(snapshot_header_t)) {
+        fprintf(stderr, "Snapshot %s is not valid.\n", filename);
+        close(fd);
+        return NULL;
+    }
+
+    char *map = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Could not read snapshot %s.\n", filename);
+        return NULL;
+    }
+    posix_madvise(map, file_size, POSIX_MADV_SEQUENTIAL);
+
+    snapshot_header_t header;
+    memcpy(&header, map, sizeof(snapshot_header_t));
+
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, 4) != 0 || header.version != SNAPSHOT_VERSION ||
+        header.system_size != sizeof(system_t) || header.atom_size != sizeof(atom_t)) {
+        fprintf(stderr, "Snapshot %s was written by an incompatible version of posdist.\n", filename);
+        munmap(map, file_size);
+        return NULL;
+    }
+
+    // sizes are checked against the size of the file before they are multiplied
+    size_t remaining = file_size - sizeof(snapshot_header_t);
+    int valid = remaining >= sizeof(system_t) && header.n_atoms <= (remaining - sizeof(system_t)) / sizeof(atom_t);
+    size_t system_size = 0;
+    if (valid) {
+        system_size = sizeof(system_t) + (size_t) header.n_atoms * sizeof(atom_t);
+        remaining -= system_size;
+    }
+
+    if (valid && header.n_groups > 0) {
+        valid = header.n_groups < remaining / sizeof(uint64_t) &&
+                header.n_group_atoms <= remaining / sizeof(uint64_t) - header.n_groups - 1 &&
+                header.names_size <= remaining &&
+                (header.n_groups + 1 + header.n_group_atoms) * sizeof(uint64_t) + header.names_size == remaining;
+    } else if (valid) {
+        valid = header.n_group_atoms == 0 && header.names_size == 0 && remaining == 0;
+    }
+
+    if (!valid) {
+        fprintf(stderr, "Snapshot %s is not valid.\n", filename);
+        munmap(map, file_size);
+        return NULL;
+    }
+
+    system_t *system = malloc(system_size);
+    if (system == NULL) {
+        fprintf(stderr, "Could not allocate memory for the system.\n");
+        munmap(map, file_size);
+        return NULL;
+    }
+    memcpy(system, map + sizeof(snapshot_header_t), system_size);
+
+    if (system->n_atoms != header.n_atoms) {
+        fprintf(stderr, "Snapshot %s is not valid.\n", filename);
+        free(system);
+        munmap(map, file_size);
+        return NULL;
+    }
+
+    if (header.n_groups > 0) {
+        *ndx = groups_load(&header, map + sizeof(snapshot_header_t) + system_size, system);
+        if (*ndx == NULL) {
+            fprintf(stderr, "Could not read ndx groups of snapshot %s.\n", filename);
+            free(system);
+            munmap(map, file_size);
+            return NULL;
+        }
+    }
+
+    munmap(map, file_size);
+    return system;
+}
@@ -0,0 +1,38 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <groan.h>
+#include "groups.h"
+
+/*
+ * Binary snapshot of a system and of the groups of its ndx file.
+ *
+ * The snapshot stores the memory image of the system (atoms with their names, residues,
+ * positions and velocities, and the simulation box) followed by the ndx groups as atom indices.
+ * Loading a snapshot maps the file into memory and copies the system in a single block,
+ * which is much faster than parsing the gro and ndx files.
+ *
+ * The memory image depends on the layout of the structures of the groan library,
+ * so snapshots are only loaded if they were written with the same layout.
+ */
+
+/*! @brief Returns 1, if the file is a snapshot. Else returns 0. */
+int snapshot_detect(const char *filename);
+
+/*
+ * Writes snapshot of the system into a file. 'ndx' may be NULL, if the system has no ndx groups.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int snapshot_write(const char *filename, const system_t *system, const ndx_index_t *ndx);
+
+/*
+ * Loads system from a snapshot. If the snapshot contains ndx groups, they are stored in 'ndx'
+ * (must be released using ndx_index_destroy), else 'ndx' is set to NULL.
+ * Returns NULL, if the snapshot could not be loaded.
+ */
+system_t *snapshot_load(const char *filename, ndx_index_t **ndx);
+
+#endif /* SNAPSHOT_H */
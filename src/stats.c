@@ -0,0 +1,279 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "stats.h"
+
+// smallest number of blocks of a level used to estimate the statistical error
+static const size_t STATS_MIN_BLOCKS = 16;
+
+stats_t *stats_create(const size_t n_values)
+{
+    stats_t *stats = calloc(1, sizeof(stats_t));
+    if (stats == NULL) return NULL;
+
+    stats->n_values = n_values;
+    stats->mean = calloc(n_values, sizeof(double));
+    stats->m2 = calloc(n_values, sizeof(double));
+    stats->min = calloc(n_values, sizeof(float));
+    stats->max = calloc(n_values, sizeof(float));
+    stats->scratch = calloc(n_values, sizeof(double));
+
+    if (stats->mean == NULL || stats->m2 == NULL || stats->min == NULL || stats->max == NULL || stats->scratch == NULL) {
+        stats_destroy(stats);
+        return NULL;
+    }
+
+    return stats;
+}
+
+/*! @brief Adds a new empty level of block averaging. Returns zero, if successful, else returns non-zero. */
+static int stats_add_level(stats_t *stats)
+{
+    stats_level_t *levels = realloc(stats->levels, (stats->n_levels + 1) * sizeof(stats_level_t));
+    if (levels == NULL) return 1;
+    stats->levels = levels;
+
+    stats_level_t *level = &stats->levels[stats->n_levels];
+    memset(level, 0, sizeof(stats_level_t));
+    ++stats->n_levels;
+
+    level->pending = calloc(stats->n_values, sizeof(double));
+    level->mean = calloc(stats->n_values, sizeof(double));
+    level->m2 = calloc(stats->n_values, sizeof(double));
+
+    return level->pending == NULL || level->mean == NULL || level->m2 == NULL;
+}
+
+/*! @brief Adds block averages to the level and merges complete pairs of blocks into the next level. */
+static int stats_add_block(stats_t *stats, const size_t index, double *values)
+{
+    if (index == stats->n_levels && stats_add_level(stats) != 0) return 1;
+
+    stats_level_t *level = &stats->levels[index];
+    ++level->n_blocks;
+    for (size_t i = 0; i < stats->n_values; ++i) {
+        double delta = values[i] - level->mean[i];
+        level->mean[i] += delta / level->n_blocks;
+        level->m2[i] += delta * (values[i] - level->mean[i]);
+    }
+
+    if (!level->has_pending) {
+        memcpy(level->pending, values, stats->n_values * sizeof(double));
+        level->has_pending = 1;
+        return 0;
+    }
+
+    for (size_t i = 0; i < stats->n_values; ++i) level->pending[i] = (level->pending[i] + values[i]) / 2;
+    level->has_pending = 0;
+
+    return stats_add_block(stats, index + 1, level->pending);
+}
+
+int stats_add(stats_t *stats, const float *values)
+{
+    ++stats->n_samples;
+
+    for (size_t i = 0; i < stats->n_values; ++i) {
+        double value = values[i];
+        double delta = value - stats->mean[i];
+        stats->mean[i] += delta / stats->n_samples;
+        stats->m2[i] += delta * (value - stats->mean[i]);
+
+        if (stats->n_samples == 1 || values[i] < stats->min[i]) stats->min[i] = values[i];
+        if (stats->n_samples == 1 || values[i] > stats->max[i]) stats->max[i] = values[i];
+
+        stats->scratch[i] = value;
+    }
+
+    return stats_add_block(stats, 0, stats->scratch);
+}
+
+/*! @brief Adds mean and sum of squared deviations of 'n2' values to those of 'n1' values (Chan et al., 1979). */
+static void combine_moments(double *mean, double *m2, const size_t n1, const double mean2, const double m2_2, const size_t n2)
+{
+    const double n = (double) n1 + (double) n2;
+    double delta = mean2 - *mean;
+    *mean += delta * n2 / n;
+    *m2 += m2_2 + delta * delta * n1 * n2 / n;
+}
+
+/*! @brief Adds blocks of the level of other statistics to the level (see stats_merge). */
+static void merge_level(stats_level_t *level, const stats_level_t *other, const size_t n_values)
+{
+    if (other->n_blocks > 0) {
+        for (size_t i = 0; i < n_values; ++i) {
+            combine_moments(&level->mean[i], &level->m2[i], level->n_blocks, other->mean[i], other->m2[i], other->n_blocks);
+        }
+        level->n_blocks += other->n_blocks;
+    }
+
+    // only the incomplete block at the end of the merged samples can be completed by further samples
+    level->has_pending = other->has_pending;
+    if (other->has_pending) memcpy(level->pending, other->pending, n_values * sizeof(double));
+}
+
+int stats_merge(stats_t *stats, const stats_t *other)
+{
+    if (other->n_values != stats->n_values) return 1;
+    if (other->n_samples == 0) return 0;
+
+    for (size_t i = 0; i < stats->n_values; ++i) {
+        combine_moments(&stats->mean[i], &stats->m2[i], stats->n_samples, other->mean[i], other->m2[i], other->n_samples);
+
+        if (stats->n_samples == 0 || other->min[i] < stats->min[i]) stats->min[i] = other->min[i];
+        if (stats->n_samples == 0 || other->max[i] > stats->max[i]) stats->max[i] = other->max[i];
+    }
+
+    while (stats->n_levels < other->n_levels) {
+        if (stats_add_level(stats) != 0) return 1;
+    }
+
+    for (size_t l = 0; l < other->n_levels; ++l) merge_level(&stats->levels[l], &other->levels[l], stats->n_values);
+
+    stats->n_samples += other->n_samples;
+    return 0;
+}
+
+/*! @brief Writes 'n' doubles. Returns zero, if successful, else returns non-zero. */
+static int write_doubles(FILE *file, const double *values, const size_t n)
+{
+    return fwrite(values, sizeof(double), n, file) != n;
+}
+
+/*! @brief Reads 'n' doubles. Returns zero, if successful, else returns non-zero. */
+static int read_doubles(FILE *file, double *values, const size_t n)
+{
+    return fread(values, sizeof(double), n, file) != n;
+}
+
+int stats_write(const stats_t *stats, FILE *file)
+{
+    const size_t n = stats->n_values;
+    const uint64_t header[3] = { stats->n_values, stats->n_samples, stats->n_levels };
+    if (fwrite(header, sizeof(uint64_t), 3, file) != 3 ||
+        write_doubles(file, stats->mean, n) != 0 || write_doubles(file, stats->m2, n) != 0 ||
+        fwrite(stats->min, sizeof(float), n, file) != n || fwrite(stats->max, sizeof(float), n, file) != n) return 1;
+
+    for (size_t l = 0; l < stats->n_levels; ++l) {
+        const stats_level_t *level = &stats->levels[l];
+        const uint64_t state[2] = { level->n_blocks, (uint64_t) level->has_pending };
+        if (fwrite(state, sizeof(uint64_t), 2, file) != 2 ||
+            write_doubles(file, level->pending, n) != 0 || write_doubles(file, level->mean, n) != 0 ||
+            write_doubles(file, level->m2, n) != 0) return 1;
+    }
+
+    return 0;
+}
+
+stats_t *stats_read(FILE *file, const size_t n_values)
+{
+    uint64_t header[3] = {0};
+    if (fread(header, sizeof(uint64_t), 3, file) != 3 || header[0] != n_values) return NULL;
+
+    stats_t *stats = stats_create(n_values);
+    if (stats == NULL) return NULL;
+
+    const size_t n = n_values;
+    stats->n_samples = (size_t) header[1];
+    int status = read_doubles(file, stats->mean, n) != 0 || read_doubles(file, stats->m2, n) != 0 ||
+                 fread(stats->min, sizeof(float), n, file) != n || fread(stats->max, sizeof(float), n, file) != n;
+
+    // a level contains at least one block, so there are never more levels than bits of the number of samples
+    if (header[2] > 8 * sizeof(size_t)) status = 1;
+
+    for (size_t l = 0; status == 0 && l < header[2]; ++l) {
+        uint64_t state[2] = {0};
+        status = fread(state, sizeof(uint64_t), 2, file) != 2 || stats_add_level(stats) != 0;
+        if (status != 0) break;
+
+        stats_level_t *level = &stats->levels[l];
+        level->n_blocks = (size_t) state[0];
+        level->has_pending = state[1] != 0;
+        status = read_doubles(file, level->pending, n) != 0 || read_doubles(file, level->mean, n) != 0 ||
+                 read_doubles(file, level->m2, n) != 0;
+    }
+
+    if (status != 0) {
+        stats_destroy(stats);
+        return NULL;
+    }
+
+    return stats;
+}
+
+double stats_deviation(const stats_t *stats, const size_t index)
+{
+    if (stats->n_samples < 2) return 0.0;
+    return sqrt(stats->m2[index] / (stats->n_samples - 1));
+}
+
+/*! @brief Returns standard error of the mean calculated from the blocks of the level. */
+static double level_error(const stats_level_t *level, const size_t index)
+{
+    if (level->n_blocks < 2) return 0.0;
+
+    // variance of the block averages divided by the number of blocks
+    double n = (double) level->n_blocks;
+    double variance = level->m2[index] / (n * (n - 1));
+    return variance > 0.0 ? sqrt(variance) : 0.0;
+}
+
+double stats_error(const stats_t *stats, const size_t index)
+{
+    if (stats->n_levels == 0) return 0.0;
+
+    double error = level_error(&stats->levels[0], index);
+    for (size_t l = 1; l < stats->n_levels; ++l) {
+        if (stats->levels[l].n_blocks < STATS_MIN_BLOCKS) break;
+
+        double level = level_error(&stats->levels[l], index);
+        if (level > error) error = level;
+    }
+
+    return error;
+}
+
+void stats_destroy(stats_t *stats)
+{
+    if (stats == NULL) return;
+
+    for (size_t l = 0; l < stats->n_levels; ++l) {
+        free(stats->levels[l].pending);
+        free(stats->levels[l].mean);
+        free(stats->levels[l].m2);
+    }
+
+    free(stats->levels);
+    free(stats->mean);
+    free(stats->m2);
+    free(stats->min);
+    free(stats->max);
+    free(stats->scratch);
+    free(stats);
+}
+
+int stats_parse(const char *string, int *columns)
+{
+    *columns = 0;
+
+    const char *start = string;
+    while (1) {
+        size_t length = strcspn(start, ",");
+
+        if (length == 3 && strncmp(start, "std", 3) == 0) *columns |= stats_std;
+        else if (length == 3 && strncmp(start, "min", 3) == 0) *columns |= stats_min;
+        else if (length == 3 && strncmp(start, "max", 3) == 0) *columns |= stats_max;
+        else if (length == 3 && strncmp(start, "err", 3) == 0) *columns |= stats_err;
+        else if (length == 3 && strncmp(start, "all", 3) == 0) *columns |= stats_std | stats_min | stats_max | stats_err;
+        else return 1;
+
+        if (start[length] == '\0') break;
+        start += length + 1;
+    }
+
+    return 0;
+}
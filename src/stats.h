@@ -0,0 +1,92 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/*! @brief Statistics that can be written out next to the averages. */
+typedef enum stats_column {
+    stats_std = 1,              // standard deviation of the values
+    stats_min = 2,              // minimal value
+    stats_max = 4,              // maximal value
+    stats_err = 8               // statistical error of the average estimated by block averaging
+} stats_column_t;
+
+/*! @brief Level of the hierarchical block averaging. Blocks of the level 'l' contain 2^l frames. */
+typedef struct stats_level {
+    size_t n_blocks;            // number of complete blocks
+    int has_pending;            // the first block of an incomplete pair is stored in 'pending'
+    double *pending;
+    double *mean;               // mean of the block averages
+    double *m2;                 // sum of squared deviations of the block averages from their mean
+} stats_level_t;
+
+/*
+ * Single-pass statistics of 'n_values' quantities.
+ *
+ * Mean and variance are calculated using the Welford algorithm. The statistical error of the mean
+ * is estimated by block averaging (Flyvbjerg & Petersen, 1989): pairs of neighbouring blocks are
+ * merged into blocks of the next level, so only O(log frames) numbers are stored per quantity.
+ * The variance of the block averages of every level is also calculated using the Welford algorithm.
+ */
+typedef struct stats {
+    size_t n_values;
+    size_t n_samples;
+    double *mean;
+    double *m2;                 // sum of squared deviations from the mean
+    float *min;
+    float *max;
+    double *scratch;            // values of the current sample converted to double
+    size_t n_levels;
+    stats_level_t *levels;
+} stats_t;
+
+/*! @brief Creates statistics for 'n_values' quantities. Returns NULL, if memory could not be allocated. */
+stats_t *stats_create(const size_t n_values);
+
+/*! @brief Adds a sample of all quantities. Returns zero, if successful, else returns non-zero. */
+int stats_add(stats_t *stats, const float *values);
+
+/*
+ * Adds statistics of other samples of the same quantities (e.g. calculated by another process).
+ * Means and variances (also of the block averages of every level) are combined using the parallel algorithm of Chan et al. (1979).
+ * 'other' must contain the samples following the samples of 'stats'. The blocks of 'other' start at its first sample,
+ * so they are not aligned with the blocks of a single calculation; the incomplete block of every level of 'stats'
+ * cannot be completed and only the incomplete blocks of 'other' are kept. The statistical error of merged statistics
+ * may therefore differ slightly from the error of a single calculation.
+ * Returns zero, if successful, else returns non-zero.
+ */
+int stats_merge(stats_t *stats, const stats_t *other);
+
+/*! @brief Writes the complete state of the statistics (including block averages) into a binary file. Returns zero, if successful, else returns non-zero. */
+int stats_write(const stats_t *stats, FILE *file);
+
+/*
+ * Reads statistics of 'n_values' quantities written by stats_write.
+ * Returns NULL, if the statistics could not be read or were written for a different number of quantities.
+ */
+stats_t *stats_read(FILE *file, const size_t n_values);
+
+/*! @brief Returns sample standard deviation of the quantity. */
+double stats_deviation(const stats_t *stats, const size_t index);
+
+/*
+ * Returns statistical error of the mean of the quantity.
+ * The error is the largest standard error of the mean over the block levels containing
+ * at least STATS_MIN_BLOCKS blocks (or over the first level, if the trajectory is too short).
+ */
+double stats_error(const stats_t *stats, const size_t index);
+
+/*! @brief Releases memory allocated for the statistics. */
+void stats_destroy(stats_t *stats);
+
+/*
+ * Parses comma-separated list of statistics (std, min, max, err or all) into a bit mask of stats_column_t.
+ * Returns zero, if successful, else returns non-zero.
+ */
+int stats_parse(const char *string, int *columns);
+
+#endif /* STATS_H */
@@ -0,0 +1,183 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "text.h"
+
+// initial size of the buffer
+static const size_t TEXT_INITIAL_CAPACITY = 4096;
+
+// values with larger magnitude are formatted using snprintf
+static const float FIXED_LIMIT = 1e9f;
+
+// largest number of decimal places supported by text_append_fixed
+#define FIXED_MAX_DECIMALS 9
+
+static const uint64_t POWERS_OF_TEN[FIXED_MAX_DECIMALS + 1] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL };
+
+void text_init(text_buffer_t *buffer)
+{
+    memset(buffer, 0, sizeof(text_buffer_t));
+}
+
+/*! @brief Makes sure that 'length' more characters fit into the buffer. Returns zero, if successful, else returns non-zero. */
+static int text_reserve(text_buffer_t *buffer, const size_t length)
+{
+    if (buffer->failed) return 1;
+    if (buffer->length + length <= buffer->capacity) return 0;
+
+    size_t capacity = buffer->capacity > 0 ? buffer->capacity : TEXT_INITIAL_CAPACITY;
+    while (capacity < buffer->length + length) capacity *= 2;
+
+    char *data = realloc(buffer->data, capacity);
+    if (data == NULL) {
+        buffer->failed = 1;
+        return 1;
+    }
+
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+void text_append(text_buffer_t *buffer, const char *string, const size_t length)
+{
+    if (text_reserve(buffer, length) != 0) return;
+
+    memcpy(buffer->data + buffer->length, string, length);
+    buffer->length += length;
+}
+
+void text_append_string(text_buffer_t *buffer, const char *string)
+{
+    text_append(buffer, string, strlen(string));
+}
+
+/*! @brief Writes decimal digits of the value into 'digits' (backwards from its end). Returns the number of digits. */
+static size_t write_digits(uint64_t value, char *end)
+{
+    size_t n_digits = 0;
+    do {
+        *--end = (char) ('0' + value % 10);
+        value /= 10;
+        ++n_digits;
+    } while (value != 0);
+
+    return n_digits;
+}
+
+void text_append_fixed(text_buffer_t *buffer, const float value, const int decimals)
+{
+    if (!isfinite(value) || fabsf(value) >= FIXED_LIMIT || decimals < 0 || decimals > FIXED_MAX_DECIMALS) {
+        char formatted[64];
+        int length = snprintf(formatted, sizeof(formatted), "%.*f", decimals, value);
+        if (length > 0) text_append(buffer, formatted, (size_t) length < sizeof(formatted) ? (size_t) length : sizeof(formatted) - 1);
+        return;
+    }
+
+    // |value| = mantissa * 2^-shift with an integer mantissa of 24 bits
+    int exponent = 0;
+    uint64_t mantissa = (uint64_t) ldexpf(frexpf(fabsf(value), &exponent), 24);
+    int shift = 24 - exponent;
+
+    // scaled = |value| * 10^decimals rounded to the nearest integer, ties to even (as done by printf)
+    uint64_t scaled = 0;
+    if (shift <= 0) {
+        scaled = (mantissa << -shift) * POWERS_OF_TEN[decimals];
+    } else if (shift < 64) {
+        uint64_t product = mantissa * POWERS_OF_TEN[decimals];
+        uint64_t remainder = product & ((1ULL << shift) - 1);
+        uint64_t half = 1ULL << (shift - 1);
+        scaled = product >> shift;
+        if (remainder > half || (remainder == half && (scaled & 1))) ++scaled;
+    }
+    // else: the product is smaller than 2^54, so the value rounds to zero
+
+    char formatted[32];
+    char *end = formatted + sizeof(formatted);
+    char *start = end;
+
+    uint64_t integer = scaled / POWERS_OF_TEN[decimals];
+    uint64_t fraction = scaled % POWERS_OF_TEN[decimals];
+
+    if (decimals > 0) {
+        size_t n_digits = write_digits(fraction, start);
+        start -= n_digits;
+        while (n_digits++ < (size_t) decimals) *--start = '0';
+        *--start = '.';
+    }
+
+    start -= write_digits(integer, start);
+    if (signbit(value)) *--start = '-';
+
+    text_append(buffer, start, end - start);
+}
+
+void text_append_size(text_buffer_t *buffer, const size_t value)
+{
+    char formatted[32];
+    char *end = formatted + sizeof(formatted);
+    size_t n_digits = write_digits(value, end);
+    text_append(buffer, end - n_digits, n_digits);
+}
+
+void text_append_label(text_buffer_t *buffer, const text_labels_t *labels, const size_t index)
+{
+    text_append(buffer, labels->data + labels->offsets[index], labels->offsets[index + 1] - labels->offsets[index]);
+}
+
+void text_flush(text_buffer_t *buffer, FILE *file)
+{
+    if (buffer->length > 0) fwrite(buffer->data, 1, buffer->length, file);
+    buffer->length = 0;
+}
+
+void text_destroy(text_buffer_t *buffer)
+{
+    free(buffer->data);
+    text_init(buffer);
+}
+
+int text_labels_create(text_labels_t *labels, const atom_selection_t *selection)
+{
+    memset(labels, 0, sizeof(text_labels_t));
+
+    labels->offsets = malloc((selection->n_atoms + 1) * sizeof(size_t));
+    if (labels->offsets == NULL) return 1;
+
+    text_buffer_t buffer;
+    text_init(&buffer);
+
+    for (size_t i = 0; i < selection->n_atoms; ++i) {
+        const atom_t *atom = selection->atoms[i];
+        char label[256];
+        int length = snprintf(label, sizeof(label), "Atom %s (id: %d) of residue %s (resid: %d):",
+                atom->atom_name, atom->atom_number, atom->residue_name, atom->residue_number);
+        if (length < 0 || (size_t) length >= sizeof(label)) buffer.failed = 1;
+
+        labels->offsets[i] = buffer.length;
+        text_append(&buffer, label, (size_t) length);
+    }
+    labels->offsets[selection->n_atoms] = buffer.length;
+
+    if (buffer.failed) {
+        text_destroy(&buffer);
+        text_labels_destroy(labels);
+        return 1;
+    }
+
+    labels->n_labels = selection->n_atoms;
+    labels->data = buffer.data;
+    return 0;
+}
+
+void text_labels_destroy(text_labels_t *labels)
+{
+    free(labels->data);
+    free(labels->offsets);
+    memset(labels, 0, sizeof(text_labels_t));
+}
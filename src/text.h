@@ -0,0 +1,65 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <groan.h>
+
+/*
+ * Growable buffer collecting the text output of a single frame.
+ * Once memory could not be allocated, 'failed' is set and the buffer ignores all further text.
+ */
+typedef struct text_buffer {
+    char *data;
+    size_t length;
+    size_t capacity;
+    int failed;
+} text_buffer_t;
+
+/*
+ * Labels 'Atom NAME (id: ID) of residue RESNAME (resid: RESID):' of all atoms of a selection,
+ * formatted once and copied into the output of every frame.
+ */
+typedef struct text_labels {
+    size_t n_labels;
+    char *data;
+    size_t *offsets;        // label i occupies data[offsets[i]] to data[offsets[i + 1]]
+} text_labels_t;
+
+/*! @brief Prepares an empty buffer. */
+void text_init(text_buffer_t *buffer);
+
+/*! @brief Appends 'length' characters to the buffer. */
+void text_append(text_buffer_t *buffer, const char *string, const size_t length);
+
+/*! @brief Appends null-terminated string to the buffer. */
+void text_append_string(text_buffer_t *buffer, const char *string);
+
+/*
+ * Appends value formatted with a fixed number of decimal places (at most 9).
+ * The result is identical to printf("%.<decimals>f", value).
+ */
+void text_append_fixed(text_buffer_t *buffer, const float value, const int decimals);
+
+/*! @brief Appends unsigned integer to the buffer. */
+void text_append_size(text_buffer_t *buffer, const size_t value);
+
+/*! @brief Appends label of the atom with the given index in the selection. */
+void text_append_label(text_buffer_t *buffer, const text_labels_t *labels, const size_t index);
+
+/*! @brief Writes content of the buffer into the file and empties the buffer. */
+void text_flush(text_buffer_t *buffer, FILE *file);
+
+/*! @brief Releases memory allocated for the buffer. */
+void text_destroy(text_buffer_t *buffer);
+
+/*! @brief Formats labels of all atoms of the selection. Returns zero, if successful, else returns non-zero. */
+int text_labels_create(text_labels_t *labels, const atom_selection_t *selection);
+
+/*! @brief Releases memory allocated for the labels. */
+void text_labels_destroy(text_labels_t *labels);
+
+#endif /* TEXT_H */
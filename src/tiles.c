@@ -0,0 +1,208 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "tiles.h"
+
+// number of averages converted to float and written into the spill file at once
+static const size_t SPILL_CHUNK = 1 << 16;
+
+tiles_t *tiles_create(const size_t n_rows, const size_t n_columns, const int triangle)
+{
+    tiles_t *tiles = calloc(1, sizeof(tiles_t));
+    if (tiles == NULL) return NULL;
+
+    tiles->n_rows = n_rows;
+    tiles->row_start = malloc((n_rows + 1) * sizeof(size_t));
+    if (tiles->row_start == NULL) {
+        free(tiles);
+        return NULL;
+    }
+
+    tiles->row_start[0] = 0;
+    for (size_t i = 0; i < n_rows; ++i) {
+        size_t length = triangle ? n_columns - i - 1 : n_columns;
+        tiles->row_start[i + 1] = tiles->row_start[i] + length;
+    }
+
+    return tiles;
+}
+
+int tiles_plan(tiles_t *tiles, const size_t budget, const size_t value_size)
+{
+    free(tiles->tile_start);
+    tiles->tile_start = malloc((tiles->n_rows + 1) * sizeof(size_t));
+    if (tiles->tile_start == NULL) return 1;
+
+    const size_t capacity = budget / value_size;
+    tiles->n_tiles = 0;
+    tiles->max_values = 0;
+    tiles->tile_start[0] = 0;
+
+    size_t first = 0;
+    for (size_t i = 0; i < tiles->n_rows; ++i) {
+        if (tiles->row_start[i + 1] - tiles->row_start[i] > capacity) return 1;
+
+        // start a new tile, if the row does not fit into the current one
+        if (tiles->row_start[i + 1] - tiles->row_start[first] > capacity) {
+            tiles->tile_start[++tiles->n_tiles] = i;
+            first = i;
+        }
+
+        size_t n_values = tiles->row_start[i + 1] - tiles->row_start[first];
+        if (n_values > tiles->max_values) tiles->max_values = n_values;
+    }
+    tiles->tile_start[++tiles->n_tiles] = tiles->n_rows;
+
+    tiles->tile = 0;
+    free(tiles->sum);
+    tiles->sum = calloc(tiles->max_values > 0 ? tiles->max_values : 1, sizeof(double));
+    return tiles->sum == NULL;
+}
+
+void tiles_add(tiles_t *tiles, const float *values)
+{
+    const size_t n_values = tiles_size(tiles);
+    double *sum = tiles->sum;
+
+    for (size_t i = 0; i < n_values; ++i) sum[i] += values[i];
+}
+
+/*! @brief Creates an unlinked temporary file in TMPDIR. Returns NULL, if the file could not be created. */
+static FILE *spill_open(void)
+{
+    const char *directory = getenv("TMPDIR");
+    if (directory == NULL || directory[0] == '\0') directory = "/tmp";
+
+    size_t length = strlen(directory) + 32;
+    char *name = malloc(length);
+    if (name == NULL) return NULL;
+    snprintf(name, length, "%s/posdist_tiles_XXXXXX", directory);
+
+    int fd = mkstemp(name);
+    if (fd < 0) {
+        fprintf(stderr, "Could not create temporary file in '%s'.\n", directory);
+        free(name);
+        return NULL;
+    }
+
+    // the file is removed once it is closed
+    unlink(name);
+    free(name);
+
+    FILE *file = fdopen(fd, "w+b");
+    if (file == NULL) close(fd);
+    return file;
+}
+
+/*! @brief Appends averages of the current tile to the spill file. Returns zero, if successful, else returns non-zero. */
+static int spill_tile(tiles_t *tiles, const size_t n_samples)
+{
+    if (tiles->spill == NULL) tiles->spill = spill_open();
+    if (tiles->spill == NULL) return 1;
+
+    float *chunk = malloc(SPILL_CHUNK * sizeof(float));
+    if (chunk == NULL) return 1;
+
+    int status = 0;
+    const size_t n_values = tiles_size(tiles);
+    for (size_t start = 0; start < n_values && status == 0; start += SPILL_CHUNK) {
+        size_t n = n_values - start < SPILL_CHUNK ? n_values - start : SPILL_CHUNK;
+        for (size_t i = 0; i < n; ++i) chunk[i] = (float) (tiles->sum[start + i] / n_samples);
+        if (fwrite(chunk, sizeof(float), n, tiles->spill) != n) status = 1;
+    }
+
+    free(chunk);
+    return status;
+}
+
+/*! @brief Maps averages of all values from the spill file. Returns zero, if successful, else returns non-zero. */
+static int map_spill(tiles_t *tiles)
+{
+    if (fflush(tiles->spill) != 0) return 1;
+
+    size_t size = tiles->row_start[tiles->n_rows] * sizeof(float);
+    void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fileno(tiles->spill), 0);
+    if (data == MAP_FAILED) return 1;
+
+    tiles->averages = (float *) data;
+    tiles->mapped = size;
+    return 0;
+}
+
+int tiles_next(tiles_t *tiles, const size_t n_samples, int *more)
+{
+    *more = 0;
+    const size_t n_values = tiles_size(tiles);
+
+    // a single tile is kept in memory
+    if (tiles->n_tiles == 1) {
+        tiles->averages = malloc((n_values > 0 ? n_values : 1) * sizeof(float));
+        if (tiles->averages == NULL) return 1;
+
+        for (size_t i = 0; i < n_values; ++i) tiles->averages[i] = (float) (tiles->sum[i] / n_samples);
+        free(tiles->sum);
+        tiles->sum = NULL;
+        return 0;
+    }
+
+    if (spill_tile(tiles, n_samples) != 0) {
+        fprintf(stderr, "Could not write averages into the temporary file.\n");
+        return 1;
+    }
+
+    if (tiles->tile + 1 < tiles->n_tiles) {
+        ++tiles->tile;
+        memset(tiles->sum, 0, tiles_size(tiles) * sizeof(double));
+        *more = 1;
+        return 0;
+    }
+
+    free(tiles->sum);
+    tiles->sum = NULL;
+
+    if (map_spill(tiles) != 0) {
+        fprintf(stderr, "Could not map averages from the temporary file.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+void tiles_destroy(tiles_t *tiles)
+{
+    if (tiles == NULL) return;
+
+    if (tiles->mapped > 0) munmap(tiles->averages, tiles->mapped);
+    else free(tiles->averages);
+
+    if (tiles->spill != NULL) fclose(tiles->spill);
+    free(tiles->sum);
+    free(tiles->tile_start);
+    free(tiles->row_start);
+    free(tiles);
+}
+
+int tiles_parse_size(const char *string, size_t *size)
+{
+    double value = 0.0;
+    char suffix = '\0', extra = '\0';
+    int n = sscanf(string, "%lf%c%c", &value, &suffix, &extra);
+    if (n < 1 || n > 2 || value <= 0.0) return 1;
+
+    const char *suffixes = "KMGT";
+    double multiplier = 1.0;
+    if (n == 2) {
+        const char *found = suffix != '\0' ? strchr(suffixes, toupper((unsigned char) suffix)) : NULL;
+        if (found == NULL) return 1;
+        for (const char *s = suffixes; s <= found; ++s) multiplier *= 1024.0;
+    }
+
+    if (value * multiplier < 1.0 || value * multiplier >= 1.8e19) return 1;
+    *size = (size_t) (value * multiplier);
+    return 0;
+}
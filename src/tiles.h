@@ -0,0 +1,94 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef TILES_H
+#define TILES_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+ * Memory-bounded accumulator of averages of values calculated for pairs of atoms.
+ *
+ * Values are stored row by row, every row containing the pairs of a single atom of selection 1
+ * (either all atoms of selection 2 or, for the upper triangle of identical selections, the following atoms).
+ * Consecutive rows are grouped into tiles fitting into the memory budget. Sums of the current tile
+ * are accumulated in double precision during a single pass through the trajectory; once the pass
+ * is finished, averages of the tile are appended to a temporary spill file and the next tile is
+ * accumulated during the following pass. If all rows fit into a single tile, nothing is spilled.
+ *
+ * The spill file is created in the directory specified by the environment variable TMPDIR (default: /tmp).
+ */
+typedef struct tiles {
+    size_t n_rows;
+    size_t *row_start;      // index of the first value of every row; row_start[n_rows] is the number of all values
+    size_t n_tiles;
+    size_t *tile_start;     // first row of every tile; tile_start[n_tiles] is 'n_rows'
+    size_t max_values;      // number of values of the largest tile
+    size_t tile;            // index of the tile that is being accumulated
+    double *sum;            // sums of the values of the current tile
+    FILE *spill;            // averages of the finished tiles (only if there is more than one tile)
+    float *averages;        // averages of all values (once all tiles are finished)
+    size_t mapped;          // size of 'averages' mapped from the spill file; zero, if 'averages' is allocated
+} tiles_t;
+
+/*
+ * Creates accumulator for 'n_rows' rows of 'n_columns' values each.
+ * If 'triangle' is non-zero, row i only contains columns j > i (n_rows must be equal to n_columns).
+ * Returns NULL, if memory could not be allocated.
+ */
+tiles_t *tiles_create(const size_t n_rows, const size_t n_columns, const int triangle);
+
+/*
+ * Groups the rows into tiles, so that every tile requires at most 'budget' bytes,
+ * each value of a tile requiring 'value_size' bytes. Allocates sums of the first tile.
+ * Returns zero, if successful. Returns non-zero, if a single row does not fit into the budget
+ * or memory could not be allocated.
+ */
+int tiles_plan(tiles_t *tiles, const size_t budget, const size_t value_size);
+
+/*! @brief Returns the first row of the current tile. */
+static inline size_t tiles_first_row(const tiles_t *tiles)
+{
+    return tiles->tile_start[tiles->tile];
+}
+
+/*! @brief Returns the row following the last row of the current tile. */
+static inline size_t tiles_end_row(const tiles_t *tiles)
+{
+    return tiles->tile_start[tiles->tile + 1];
+}
+
+/*! @brief Returns index of the first value of the current tile. */
+static inline size_t tiles_offset(const tiles_t *tiles)
+{
+    return tiles->row_start[tiles_first_row(tiles)];
+}
+
+/*! @brief Returns the number of values of the current tile. */
+static inline size_t tiles_size(const tiles_t *tiles)
+{
+    return tiles->row_start[tiles_end_row(tiles)] - tiles_offset(tiles);
+}
+
+/*! @brief Adds values of the current tile calculated for a single frame to the sums. */
+void tiles_add(tiles_t *tiles, const float *values);
+
+/*
+ * Finishes the current tile, whose values were added 'n_samples' times, and moves to the next tile.
+ * Sets 'more' to 1, if there is another tile to accumulate. Else sets 'more' to 0 and makes
+ * averages of all values available in 'averages'.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int tiles_next(tiles_t *tiles, const size_t n_samples, int *more);
+
+/*! @brief Releases memory and removes the spill file. */
+void tiles_destroy(tiles_t *tiles);
+
+/*
+ * Parses memory size, e.g. '512M' or '4G' (suffixes K, M, G and T denote powers of 1024; no suffix = bytes).
+ * Returns zero, if successful, else returns non-zero.
+ */
+int tiles_parse_size(const char *string, size_t *size);
+
+#endif /* TILES_H */
@@ -0,0 +1,735 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <pthread.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include "trajectory.h"
+
+// frequency of printing during the calculation
+static const int PROGRESS_FREQ = 10000;
+
+// number of frame buffers per worker thread
+static const size_t SLOTS_PER_THREAD = 2;
+
+// absolute tolerance (ps) used when checking that the time of a frame is divisible by dt
+static const double DT_TOLERANCE = 1e-3;
+
+// interval between checks of a followed trajectory for new frames (ns)
+static const long FOLLOW_POLL_NS = 250000000L;
+
+// set by the signal handler, once following of the trajectory shall stop
+static volatile sig_atomic_t follow_interrupted = 0;
+
+int frame_window_is_all(const frame_window_t *window)
+{
+    return window->begin <= 0.0f && window->end < 0.0f && window->dt <= 0.0f && window->stride <= 1 &&
+           (window->shard == 0 || window->parts);
+}
+
+/*! @brief Returns 1, if 'time' is a multiple of 'dt'. Else returns 0. */
+static int time_divisible(const float time, const float dt)
+{
+    double multiple = round((double) time / dt) * dt;
+    return fabs(time - multiple) < DT_TOLERANCE;
+}
+
+/*! @brief Selects frames of the index that belong to the window. Returns zero, if successful, else returns non-zero. */
+static int select_frames(trajectory_t *trajectory, const frame_window_t *window)
+{
+    const xtc_index_t *index = trajectory->index;
+
+    trajectory->frames = malloc(index->n_frames * sizeof(size_t));
+    if (trajectory->frames == NULL) return 1;
+
+    size_t n_matching = 0;
+    for (size_t i = xtc_index_find(index, window->begin); i < index->n_frames; ++i) {
+        float time = index->frames[i].time;
+        if (window->end >= 0.0f && time > window->end) break;
+        if (window->dt > 0.0f && !time_divisible(time, window->dt)) continue;
+
+        if (window->stride <= 1 || n_matching % window->stride == 0) {
+            trajectory->frames[trajectory->n_frames++] = i;
+        }
+        ++n_matching;
+    }
+
+    // a shard only keeps its slice of the selected frames
+    if (window->shard > 0 && !window->parts) {
+        size_t first = trajectory->n_frames * (window->shard - 1) / window->n_shards;
+        size_t last = trajectory->n_frames * window->shard / window->n_shards;
+        memmove(trajectory->frames, trajectory->frames + first, (last - first) * sizeof(size_t));
+        trajectory->n_frames = last - first;
+    }
+
+    return 0;
+}
+
+trajectory_t *trajectory_open(const char *xtc_file, const system_t *system, const frame_window_t *window)
+{
+    xtc_file_t *xtc = xtc_open(xtc_file);
+    if (xtc == NULL) {
+        fprintf(stderr, "File %s could not be read as an xtc file.\n", xtc_file);
+        return NULL;
+    }
+
+    if (window->mmap && xtc_map(xtc) != 0) {
+        fprintf(stderr, "File %s could not be mapped into memory.\n", xtc_file);
+        xtc_close(xtc);
+        return NULL;
+    }
+
+    if ((size_t) xtc->n_atoms != system->n_atoms) {
+        fprintf(stderr, "Number of atoms in %s does not match the gro file.\n", xtc_file);
+        xtc_close(xtc);
+        return NULL;
+    }
+
+    trajectory_t *trajectory = calloc(1, sizeof(trajectory_t));
+    if (trajectory == NULL) {
+        xtc_close(xtc);
+        return NULL;
+    }
+
+    trajectory->xtc = xtc;
+    if (frame_window_is_all(window)) {
+        trajectory->follow = window->follow;
+        return trajectory;
+    }
+
+    trajectory->index = xtc_index_get(xtc);
+    if (trajectory->index == NULL) {
+        fprintf(stderr, "Could not index frames of %s.\n", xtc_file);
+        trajectory_close(trajectory);
+        return NULL;
+    }
+
+    if (select_frames(trajectory, window) != 0) {
+        fprintf(stderr, "Could not allocate memory for the frame window.\n");
+        trajectory_close(trajectory);
+        return NULL;
+    }
+
+    return trajectory;
+}
+
+int trajectory_read_frame(trajectory_t *trajectory, system_t *system)
+{
+    if (trajectory->index == NULL) {
+        // incomplete frames are never read, the reader stays at the start of the frame
+        if (xtc_read_frame(trajectory->xtc, system) != 0) return 1;
+        trajectory->idle_since = 0.0;
+        return 0;
+    }
+
+    if (trajectory->next >= trajectory->n_frames) return 1;
+
+    const xtc_frame_t *frame = &trajectory->index->frames[trajectory->frames[trajectory->next++]];
+    if (trajectory->xtc->offset != frame->offset && xtc_seek(trajectory->xtc, frame->offset) != 0) return 1;
+
+    return xtc_read_frame(trajectory->xtc, system);
+}
+
+/*
+ * Moves the trajectory to the first frame starting at or after 'offset'. Frames of the window preceding it are skipped.
+ * Returns zero, if successful. Else returns non-zero.
+ */
+static int trajectory_resume(trajectory_t *trajectory, const off_t offset)
+{
+    if (trajectory->index == NULL) return xtc_seek(trajectory->xtc, offset);
+
+    while (trajectory->next < trajectory->n_frames && trajectory->index->frames[trajectory->frames[trajectory->next]].offset < offset) {
+        ++trajectory->next;
+    }
+
+    return 0;
+}
+
+/*! @brief Moves the trajectory back to the first frame of the window. Returns zero, if successful, else returns non-zero. */
+static int trajectory_rewind(trajectory_t *trajectory)
+{
+    trajectory->next = 0;
+    if (trajectory->index != NULL) return 0;
+
+    return xtc_seek(trajectory->xtc, 0);
+}
+
+/*! @brief Stops following the trajectory. */
+static void follow_interrupt(int signal)
+{
+    (void) signal;
+    follow_interrupted = 1;
+}
+
+/*
+ * Waits for new frames appended to the followed trajectory.
+ * Returns zero, if reading of the next frame shall be attempted again.
+ * Returns non-zero, if the trajectory is not followed, no frame has arrived for the follow time
+ * or following has been interrupted.
+ */
+static int trajectory_wait(trajectory_t *trajectory)
+{
+    if (trajectory->follow <= 0.0f || follow_interrupted) return 1;
+
+    double now = profile_now();
+    if (trajectory->idle_since <= 0.0) trajectory->idle_since = now;
+    if (now - trajectory->idle_since >= trajectory->follow) return 1;
+
+    struct timespec poll = { .tv_sec = 0, .tv_nsec = FOLLOW_POLL_NS };
+    nanosleep(&poll, NULL);
+
+    return follow_interrupted;
+}
+
+void trajectory_close(trajectory_t *trajectory)
+{
+    if (trajectory == NULL) return;
+
+    xtc_close(trajectory->xtc);
+    xtc_index_destroy(trajectory->index);
+    free(trajectory->frames);
+    free(trajectory);
+}
+
+/*! @brief Returns size (MB) of the trajectory read since the start of the analysis, if the reader has read 'n_read' bytes. */
+static double read_size(const trajectory_t *trajectory, const off_t n_read)
+{
+    return (n_read - trajectory->read_first) / (1024.0 * 1024.0);
+}
+
+/*
+ * Prints info about the progress of reading and writing. 'n_read' is the number of bytes
+ * read by the reader once the frame was read; the throughput is only printed if requested.
+ */
+static void print_progress(const trajectory_t *trajectory, const system_t *system, const off_t n_read)
+{
+    if ((int) system->time % PROGRESS_FREQ != 0) return;
+
+    if (trajectory->report_rate) {
+        double elapsed = profile_now() - trajectory->read_start;
+        double size = read_size(trajectory, n_read);
+        printf("Step: %d. Time: %.0f ps. Read: %.1f MB (%.1f MB/s)\r", system->step, system->time, size, elapsed > 0.0 ? size / elapsed : 0.0);
+    } else {
+        printf("Step: %d. Time: %.0f ps\r", system->step, system->time);
+    }
+    fflush(stdout);
+}
+
+/*! @brief Returns time elapsed since 'mark' and moves 'mark' to the current time. */
+static double lap(double *mark)
+{
+    double now = profile_now();
+    double elapsed = now - *mark;
+    *mark = now;
+    return elapsed;
+}
+
+/*! @brief Records durations of the phases of a frame. Returns zero, if successful, else returns non-zero. */
+static int record_frame(profile_t *profile, const double times[PROFILE_N_PHASES])
+{
+    if (profile_add_frame(profile, times) == 0) return 0;
+
+    fprintf(stderr, "Could not allocate memory for the profile.\n");
+    return 1;
+}
+
+/*! @brief Flushes the timewise output of all analyses. Returns zero, if successful, else returns non-zero. */
+static int analyses_flush(analysis_t *analyses, const size_t n_analyses)
+{
+    int status = 0;
+    for (size_t a = 0; a < n_analyses; ++a) status |= analysis_flush(&analyses[a]);
+
+    if (status != 0) fprintf(stderr, "Could not write the output.\n");
+    return status;
+}
+
+/*! @brief Reads and analyses the trajectory frame by frame in a single thread. */
+static int trajectory_run_serial(
+        trajectory_t *trajectory,
+        system_t *system,
+        analysis_t *analyses,
+        const size_t n_analyses,
+        profile_t *profile)
+{
+    int status = 0;
+
+    frame_values_t *values = calloc(n_analyses, sizeof(frame_values_t));
+    if (values == NULL) status = 1;
+    for (size_t a = 0; a < n_analyses && status == 0; ++a) {
+        status = frame_values_init(&values[a], &analyses[a]);
+    }
+
+    if (status != 0) fprintf(stderr, "Could not allocate memory for the analysis.\n");
+
+    double mark = profile != NULL ? profile_now() : 0.0;
+    while (status == 0) {
+        if (trajectory_read_frame(trajectory, system) != 0) {
+            // the output of a followed trajectory is up to date while waiting for new frames
+            if (trajectory->follow > 0.0f) status = analyses_flush(analyses, n_analyses);
+            if (status != 0 || trajectory_wait(trajectory) != 0) break;
+
+            if (profile != NULL) mark = profile_now();
+            continue;
+        }
+
+        double times[PROFILE_N_PHASES] = {0.0};
+        if (profile != NULL) times[profile_decode] = lap(&mark);
+
+        print_progress(trajectory, system, trajectory->xtc->n_read);
+
+        for (size_t a = 0; a < n_analyses && status == 0; ++a) {
+            analysis_t *analysis = &analyses[a];
+            text_buffer_t *text = analysis_writes_text(analysis) ? &values[a].text : NULL;
+            status = analysis_frame(analysis, analysis->source1, analysis->source2, system, text, &values[a]);
+            if (profile != NULL) times[profile_compute] += lap(&mark);
+
+            if (status == 0 && text != NULL) text_flush(text, analysis->output);
+            if (status == 0) status = analysis_collect(analysis, system, &values[a]);
+            if (profile != NULL) times[profile_output] += lap(&mark);
+        }
+
+        if (trajectory->checkpoint != NULL && status == 0) {
+            status = checkpoint_frame(trajectory->checkpoint, trajectory->xtc->offset, system->time, trajectory->xtc->filename, analyses, n_analyses, system);
+        }
+
+        if (profile != NULL && status == 0) status = record_frame(profile, times);
+    }
+
+    if (values != NULL) {
+        for (size_t a = 0; a < n_analyses; ++a) frame_values_destroy(&values[a]);
+    }
+    free(values);
+
+    return status;
+}
+
+/*
+ * Threaded trajectory processing.
+ *
+ * Frame i is always stored in slot i % n_slots. The reader thread decodes frames
+ * into free slots in trajectory order, worker threads analyse the read frames in
+ * any order and the collector (the calling thread) writes the output and updates
+ * the averages strictly in trajectory order, releasing the slots for the reader.
+ */
+
+typedef enum slot_state {
+    slot_free,
+    slot_read,
+    slot_analysed
+} slot_state_t;
+
+typedef struct frame_slot {
+    system_t *system;                   // private copy of the system the frame is decoded into
+    atom_selection_t **selections;      // selections of all analyses pointing into the private system
+    frame_values_t *values;             // values (and formatted timewise output) calculated by the analyses
+    size_t frame;
+    off_t end;                          // byte offset of the end of the frame in the xtc file
+    off_t n_read;                       // bytes read by the reader once the frame was read (see print_progress)
+    double times[PROFILE_N_PHASES];     // durations of the phases of the frame (only when profiling)
+    int status;                         // non-zero, if any analysis of the frame failed
+    slot_state_t state;
+} frame_slot_t;
+
+typedef struct pipeline {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    trajectory_t *trajectory;
+    analysis_t *analyses;
+    size_t n_analyses;
+    profile_t *profile;     // NULL, if not profiling
+    frame_slot_t *slots;
+    size_t n_slots;
+    size_t n_read;          // number of frames decoded by the reader
+    size_t n_claimed;       // number of frames claimed by the workers
+    int finished;           // the reader has reached the end of the trajectory
+    int stalled;            // the reader is waiting for new frames of the followed trajectory
+    int closing;            // the threads shall stop without reading or analysing further frames
+} pipeline_t;
+
+/*! @brief Creates a copy of selection pointing to the atoms of 'target' instead of 'source'. */
+static atom_selection_t *selection_rebase(const atom_selection_t *selection, const system_t *source, system_t *target)
+{
+    if (selection == NULL) return NULL;
+
+    atom_selection_t *rebased = malloc(sizeof(atom_selection_t) + selection->n_atoms * sizeof(atom_t *));
+    if (rebased == NULL) return NULL;
+
+    rebased->n_atoms = selection->n_atoms;
+    for (size_t i = 0; i < selection->n_atoms; ++i) {
+        rebased->atoms[i] = &target->atoms[selection->atoms[i] - source->atoms];
+    }
+
+    return rebased;
+}
+
+/*! @brief Releases memory owned by the frame slot. */
+static void slot_destroy(frame_slot_t *slot, const size_t n_analyses)
+{
+    if (slot->selections != NULL) {
+        for (size_t i = 0; i < 2 * n_analyses; ++i) free(slot->selections[i]);
+    }
+    if (slot->values != NULL) {
+        for (size_t a = 0; a < n_analyses; ++a) frame_values_destroy(&slot->values[a]);
+    }
+
+    free(slot->selections);
+    free(slot->values);
+    free(slot->system);
+}
+
+/*! @brief Allocates frame slot for the given system and analyses. Returns zero, if successful, else returns non-zero. */
+static int slot_init(frame_slot_t *slot, const system_t *system, const analysis_t *analyses, const size_t n_analyses)
+{
+    memset(slot, 0, sizeof(frame_slot_t));
+
+    size_t system_size = sizeof(system_t) + system->n_atoms * sizeof(atom_t);
+    slot->system = malloc(system_size);
+    slot->selections = calloc(2 * n_analyses, sizeof(atom_selection_t *));
+    slot->values = calloc(n_analyses, sizeof(frame_values_t));
+
+    if (slot->system == NULL || slot->selections == NULL || slot->values == NULL) return 1;
+
+    memcpy(slot->system, system, system_size);
+
+    for (size_t a = 0; a < n_analyses; ++a) {
+        slot->selections[2 * a] = selection_rebase(analyses[a].source1, system, slot->system);
+        slot->selections[2 * a + 1] = selection_rebase(analyses[a].source2, system, slot->system);
+
+        if (slot->selections[2 * a] == NULL) return 1;
+        if (frame_values_init(&slot->values[a], &analyses[a]) != 0) return 1;
+        if (analyses[a].source2 != NULL && slot->selections[2 * a + 1] == NULL) return 1;
+    }
+
+    return 0;
+}
+
+/*! @brief Decodes frames of the trajectory into free slots. */
+static void *reader_thread(void *arg)
+{
+    pipeline_t *pipeline = (pipeline_t *) arg;
+
+    for (size_t frame = 0; ; ++frame) {
+        frame_slot_t *slot = &pipeline->slots[frame % pipeline->n_slots];
+
+        pthread_mutex_lock(&pipeline->lock);
+        while (slot->state != slot_free && !pipeline->closing) pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+        int closing = pipeline->closing;
+        pthread_mutex_unlock(&pipeline->lock);
+
+        if (closing) return NULL;
+
+        double start = pipeline->profile != NULL ? profile_now() : 0.0;
+        int status = trajectory_read_frame(pipeline->trajectory, slot->system);
+
+        // the collector flushes the output while the reader waits for new frames of a followed trajectory
+        while (status != 0 && pipeline->trajectory->follow > 0.0f) {
+            pthread_mutex_lock(&pipeline->lock);
+            pipeline->stalled = 1;
+            closing = pipeline->closing;
+            pthread_cond_broadcast(&pipeline->changed);
+            pthread_mutex_unlock(&pipeline->lock);
+
+            if (closing || trajectory_wait(pipeline->trajectory) != 0) break;
+
+            if (pipeline->profile != NULL) start = profile_now();
+            status = trajectory_read_frame(pipeline->trajectory, slot->system);
+        }
+        if (pipeline->profile != NULL) slot->times[profile_decode] = profile_now() - start;
+
+        pthread_mutex_lock(&pipeline->lock);
+        pipeline->stalled = 0;
+        if (status != 0) {
+            pipeline->finished = 1;
+        } else {
+            slot->frame = frame;
+            slot->end = pipeline->trajectory->xtc->offset;
+            slot->n_read = pipeline->trajectory->xtc->n_read;
+            slot->state = slot_read;
+            ++pipeline->n_read;
+        }
+        pthread_cond_broadcast(&pipeline->changed);
+        pthread_mutex_unlock(&pipeline->lock);
+
+        if (status != 0) return NULL;
+    }
+}
+
+/*! @brief Analyses frames that have been read by the reader thread. */
+static void *worker_thread(void *arg)
+{
+    pipeline_t *pipeline = (pipeline_t *) arg;
+
+    while (1) {
+        pthread_mutex_lock(&pipeline->lock);
+        while (pipeline->n_claimed >= pipeline->n_read && !pipeline->finished && !pipeline->closing) {
+            pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+        }
+
+        if (pipeline->closing || pipeline->n_claimed >= pipeline->n_read) {
+            pthread_mutex_unlock(&pipeline->lock);
+            return NULL;
+        }
+
+        frame_slot_t *slot = &pipeline->slots[pipeline->n_claimed % pipeline->n_slots];
+        ++pipeline->n_claimed;
+        pthread_mutex_unlock(&pipeline->lock);
+
+        double start = pipeline->profile != NULL ? profile_now() : 0.0;
+        slot->status = 0;
+        for (size_t a = 0; a < pipeline->n_analyses; ++a) {
+            analysis_t *analysis = &pipeline->analyses[a];
+
+            text_buffer_t *text = analysis_writes_text(analysis) ? &slot->values[a].text : NULL;
+            slot->status |= analysis_frame(analysis, slot->selections[2 * a], slot->selections[2 * a + 1], slot->system, text, &slot->values[a]);
+        }
+        if (pipeline->profile != NULL) slot->times[profile_compute] = profile_now() - start;
+
+        pthread_mutex_lock(&pipeline->lock);
+        slot->state = slot_analysed;
+        pthread_cond_broadcast(&pipeline->changed);
+        pthread_mutex_unlock(&pipeline->lock);
+    }
+}
+
+/*! @brief Reads and analyses the trajectory using a reader thread and 'n_threads' worker threads. */
+static int trajectory_run_threaded(
+        trajectory_t *trajectory,
+        system_t *system,
+        analysis_t *analyses,
+        const size_t n_analyses,
+        const int n_threads,
+        profile_t *profile)
+{
+    pipeline_t pipeline = { .trajectory = trajectory, .analyses = analyses, .n_analyses = n_analyses, .profile = profile };
+    pipeline.n_slots = SLOTS_PER_THREAD * n_threads;
+    pipeline.slots = calloc(pipeline.n_slots, sizeof(frame_slot_t));
+    if (pipeline.slots == NULL) {
+        fprintf(stderr, "Could not allocate memory for frame buffers.\n");
+        return 1;
+    }
+
+    for (size_t i = 0; i < pipeline.n_slots; ++i) {
+        if (slot_init(&pipeline.slots[i], system, analyses, n_analyses) != 0) {
+            fprintf(stderr, "Could not allocate memory for frame buffers.\n");
+            for (size_t j = 0; j <= i; ++j) slot_destroy(&pipeline.slots[j], n_analyses);
+            free(pipeline.slots);
+            return 1;
+        }
+    }
+
+    pthread_mutex_init(&pipeline.lock, NULL);
+    pthread_cond_init(&pipeline.changed, NULL);
+
+    pthread_t reader;
+    pthread_t *workers = malloc(n_threads * sizeof(pthread_t));
+    int reader_started = workers != NULL && pthread_create(&reader, NULL, reader_thread, &pipeline) == 0;
+    int n_started = 0;
+    while (reader_started && n_started < n_threads && pthread_create(&workers[n_started], NULL, worker_thread, &pipeline) == 0) ++n_started;
+
+    // the threads that have started are stopped and nothing is collected
+    int status = 0;
+    if (n_started < n_threads) {
+        fprintf(stderr, "Could not start the threads analyzing the trajectory.\n");
+        status = 1;
+
+        pthread_mutex_lock(&pipeline.lock);
+        pipeline.closing = 1;
+        pthread_cond_broadcast(&pipeline.changed);
+        pthread_mutex_unlock(&pipeline.lock);
+    }
+
+    // collect the analysed frames in trajectory order;
+    // after a failure, the remaining frames are consumed without being collected
+    for (size_t frame = 0; !pipeline.closing; ++frame) {
+        frame_slot_t *slot = &pipeline.slots[frame % pipeline.n_slots];
+        int flushed = 0;
+
+        pthread_mutex_lock(&pipeline.lock);
+        while (!(slot->state == slot_analysed && slot->frame == frame) &&
+               !(pipeline.finished && frame >= pipeline.n_read)) {
+            // the output of a followed trajectory is up to date while waiting for new frames
+            if (pipeline.stalled && !flushed && status == 0) {
+                pthread_mutex_unlock(&pipeline.lock);
+                status = analyses_flush(analyses, n_analyses);
+                flushed = 1;
+                pthread_mutex_lock(&pipeline.lock);
+                continue;
+            }
+            pthread_cond_wait(&pipeline.changed, &pipeline.lock);
+        }
+        int done = pipeline.finished && frame >= pipeline.n_read;
+        pthread_mutex_unlock(&pipeline.lock);
+
+        if (done) break;
+
+        print_progress(trajectory, slot->system, slot->n_read);
+
+        double start = profile != NULL ? profile_now() : 0.0;
+        status |= slot->status;
+        for (size_t a = 0; a < n_analyses; ++a) {
+            analysis_t *analysis = &analyses[a];
+            text_buffer_t *text = &slot->values[a].text;
+            if (status == 0 && analysis_writes_text(analysis)) text_flush(text, analysis->output);
+            text->length = 0;
+
+            if (status == 0) status = analysis_collect(analysis, slot->system, &slot->values[a]);
+        }
+
+        if (trajectory->checkpoint != NULL && status == 0) {
+            status = checkpoint_frame(trajectory->checkpoint, slot->end, slot->system->time, trajectory->xtc->filename, analyses, n_analyses, system);
+        }
+
+        if (profile != NULL && status == 0) {
+            slot->times[profile_output] = profile_now() - start;
+            status = record_frame(profile, slot->times);
+        }
+
+        pthread_mutex_lock(&pipeline.lock);
+        slot->state = slot_free;
+        pthread_cond_broadcast(&pipeline.changed);
+        pthread_mutex_unlock(&pipeline.lock);
+    }
+
+    if (reader_started) pthread_join(reader, NULL);
+    for (int i = 0; i < n_started; ++i) pthread_join(workers[i], NULL);
+    free(workers);
+
+    pthread_cond_destroy(&pipeline.changed);
+    pthread_mutex_destroy(&pipeline.lock);
+
+    for (size_t i = 0; i < pipeline.n_slots; ++i) slot_destroy(&pipeline.slots[i], n_analyses);
+    free(pipeline.slots);
+
+    return status;
+}
+
+/*! @brief Returns the number of leading atoms of the system containing all atoms of the selection. */
+static size_t selection_extent(const atom_selection_t *selection, const system_t *system)
+{
+    if (selection == NULL) return 0;
+
+    size_t extent = 0;
+    for (size_t i = 0; i < selection->n_atoms; ++i) {
+        size_t index = selection->atoms[i] - system->atoms;
+        if (index + 1 > extent) extent = index + 1;
+    }
+
+    return extent;
+}
+
+size_t analyses_extent(const analysis_t *analyses, const size_t n_analyses, const system_t *system)
+{
+    size_t n_needed = 0;
+    for (size_t a = 0; a < n_analyses; ++a) {
+        if (analyses[a].idle) continue;
+
+        size_t extent1 = selection_extent(analyses[a].source1, system);
+        size_t extent2 = selection_extent(analyses[a].source2, system);
+        size_t extent3 = dynamic_extent(&analyses[a].options.dynamic);
+        if (extent1 > n_needed) n_needed = extent1;
+        if (extent2 > n_needed) n_needed = extent2;
+        if (extent3 > n_needed) n_needed = extent3;
+    }
+
+    return n_needed;
+}
+
+int trajectory_run(
+        trajectory_t *trajectory,
+        system_t *system,
+        analysis_t *analyses,
+        const size_t n_analyses,
+        const int n_threads,
+        profile_t *profile)
+{
+    const size_t n_buffers = n_threads > 1 ? SLOTS_PER_THREAD * n_threads : 1;
+    for (size_t a = 0; a < n_analyses; ++a) {
+        if (analysis_plan(&analyses[a], n_buffers) != 0) return 1;
+    }
+
+    // continue the analyses saved in the checkpoint
+    if (trajectory->checkpoint != NULL) {
+        int resumed = 0;
+        if (checkpoint_restore(trajectory->checkpoint, trajectory->xtc->filename, analyses, n_analyses, system, &resumed) != 0) return 1;
+
+        if (resumed) {
+            const checkpoint_t *checkpoint = trajectory->checkpoint;
+            if (trajectory_resume(trajectory, checkpoint->offset) != 0) {
+                fprintf(stderr, "Could not continue reading the trajectory from the checkpoint.\n");
+                return 1;
+            }
+
+            printf("Resuming from checkpoint '%s' (%zu frames analyzed up to %.0f ps).\n",
+                    checkpoint->filename, n_analyses > 0 ? analyses[0].n_steps : 0, checkpoint->time);
+        }
+    }
+
+    // atoms following the last selected atom are never decompressed
+    size_t n_needed = analyses_extent(analyses, n_analyses, system);
+    xtc_limit_atoms(trajectory->xtc, n_needed);
+
+    // an interrupted followed trajectory is finished as if the reader reached its end
+    struct sigaction interrupt = {0}, previous_int = {0}, previous_term = {0};
+    if (trajectory->follow > 0.0f) {
+        follow_interrupted = 0;
+        interrupt.sa_handler = follow_interrupt;
+        sigemptyset(&interrupt.sa_mask);
+        sigaction(SIGINT, &interrupt, &previous_int);
+        sigaction(SIGTERM, &interrupt, &previous_term);
+    }
+
+    if (profile != NULL) {
+        profile->n_threads = n_threads > 1 ? n_threads : 1;
+        profile->n_atoms = n_needed > 0 ? n_needed : system->n_atoms;
+        profile->trajectory_start = profile_now();
+    }
+
+    trajectory->report_rate = trajectory->xtc->mapped || profile != NULL;
+    trajectory->read_start = profile_now();
+    trajectory->read_first = trajectory->xtc->n_read;
+
+    int status = 0, repeat = 1;
+    for (int pass = 1; status == 0 && repeat; ++pass) {
+        if (pass > 1) {
+            printf("\nPass %d through the trajectory.\n", pass);
+            xtc_limit_atoms(trajectory->xtc, analyses_extent(analyses, n_analyses, system));
+            if (trajectory_rewind(trajectory) != 0) {
+                fprintf(stderr, "Could not read the trajectory again.\n");
+                status = 1;
+                break;
+            }
+        }
+
+        if (n_threads <= 1) status = trajectory_run_serial(trajectory, system, analyses, n_analyses, profile);
+        else status = trajectory_run_threaded(trajectory, system, analyses, n_analyses, n_threads, profile);
+
+        // analyses accumulating their pairs in tiles may need further passes
+        repeat = 0;
+        for (size_t a = 0; a < n_analyses && status == 0; ++a) {
+            int more = 0;
+            status = analysis_end_pass(&analyses[a], &more);
+            repeat |= more;
+        }
+    }
+
+    if (trajectory->checkpoint != NULL && status == 0) {
+        status = checkpoint_save(trajectory->checkpoint, trajectory->xtc->filename, analyses, n_analyses, system);
+    }
+
+    if (trajectory->follow > 0.0f) {
+        sigaction(SIGINT, &previous_int, NULL);
+        sigaction(SIGTERM, &previous_term, NULL);
+        if (status == 0) printf("\n%s Finishing the analysis.\n", follow_interrupted ? "Following of the trajectory was interrupted." : "No new frames of the trajectory arrived.");
+    }
+
+    // throughput of the reader is only reported when it is of interest, so the output stays reproducible
+    if (status == 0 && trajectory->report_rate) {
+        double elapsed = profile_now() - trajectory->read_start;
+        double size = read_size(trajectory, trajectory->xtc->n_read);
+        printf("\nRead %.1f MB of the trajectory in %.3f s (%.1f MB/s).\n", size, elapsed, elapsed > 0.0 ? size / elapsed : 0.0);
+    }
+
+    if (profile != NULL) profile->trajectory_end = profile_now();
+    return status;
+}
@@ -0,0 +1,107 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <groan.h>
+#include "analysis.h"
+#include "xtc.h"
+#include "xtc_index.h"
+#include "profile.h"
+#include "checkpoint.h"
+
+/*! @brief Frames of the trajectory that shall be analyzed. */
+typedef struct frame_window {
+    float begin;        // time of the first frame to analyze (ps)
+    float end;          // time of the last frame to analyze (ps); negative = until the end of the trajectory
+    float dt;           // only analyze frames with time divisible by dt (ps); zero = all frames
+    int stride;         // only analyze every stride-th frame
+    float follow;       // keep reading frames appended to the trajectory until none arrives for this time (s); zero = stop at the end
+    int shard;          // number of the shard of the trajectory analyzed by this run (from 1); zero = not sharded
+    int n_shards;       // number of shards; unless 'parts' is set, the shards are contiguous slices of the frames of the window
+    int parts;          // the shards are separate xtc files and every file is analyzed whole
+    int mmap;           // read the xtc file through a memory map (see xtc_map)
+} frame_window_t;
+
+/*! @brief Frame window selecting all frames of the trajectory. */
+#define FRAME_WINDOW_ALL ((frame_window_t) { .begin = 0.0f, .end = -1.0f, .dt = 0.0f, .stride = 1, .follow = 0.0f, \
+        .shard = 0, .n_shards = 0, .parts = 0, .mmap = 0 })
+
+/*! @brief Trajectory opened for analysis. */
+typedef struct trajectory {
+    xtc_file_t *xtc;
+    xtc_index_t *index;     // NULL, if all frames are read sequentially
+    size_t *frames;         // indices of the frames to analyze (only used with index)
+    size_t n_frames;
+    size_t next;            // position of the next frame in 'frames'
+    float follow;           // see frame_window_t; only used if all frames are read sequentially
+    double idle_since;      // time at which the reader reached the end of the followed trajectory; zero = not waiting
+    checkpoint_t *checkpoint;   // NULL, if the analyses are not checkpointed
+    int report_rate;        // the progress includes the throughput of the reader (memory-mapped or profiled trajectory)
+    double read_start;      // time at which the analysis of the trajectory started (see profile_now)
+    off_t read_first;       // bytes read by the reader before the analysis started
+} trajectory_t;
+
+/*! @brief Returns 1, if the window selects all frames of the trajectory (regardless of following it). Else returns 0. */
+int frame_window_is_all(const frame_window_t *window);
+
+/*
+ * Opens an xtc file for analysis and checks that it matches the system.
+ * If the window does not select all frames, the frames are located using the xtc index
+ * and the frames outside of the window are never read.
+ *
+ * Returns NULL, if the trajectory could not be opened.
+ */
+trajectory_t *trajectory_open(const char *xtc_file, const system_t *system, const frame_window_t *window);
+
+/*
+ * Reads the next frame of the window into the system.
+ * Returns zero, if successful. Returns non-zero, if there are no more frames to read at the moment.
+ * An incomplete frame at the end of the file is not read; it is read once it has been written completely.
+ */
+int trajectory_read_frame(trajectory_t *trajectory, system_t *system);
+
+/*! @brief Closes the trajectory and releases all memory. */
+void trajectory_close(trajectory_t *trajectory);
+
+/*! @brief Returns the number of leading atoms of the system containing all atoms used by the analyses that are not idle (see xtc_limit_atoms). */
+size_t analyses_extent(const analysis_t *analyses, const size_t n_analyses, const system_t *system);
+
+/*
+ * Reads all frames of the trajectory and performs the provided analyses for each of them.
+ *
+ * If 'n_threads' is larger than 1, frames are decoded by a dedicated reader thread,
+ * analysed by 'n_threads' worker threads and collected in the order in which they are
+ * stored in the trajectory. Output is identical to the output of the serial calculation.
+ *
+ * Only the atoms up to the last atom selected by any of the analyses are decompressed;
+ * positions of the following atoms are not updated.
+ *
+ * If 'profile' is not NULL, durations of decoding, calculation and output are recorded for every frame.
+ * If the xtc file is mapped (see xtc_map) or the calculation is profiled, the amount of data read
+ * from the trajectory and the rate at which it was read are reported once all frames have been read.
+ *
+ * If the trajectory is followed (see frame_window_t), the end of the file is checked for new complete frames
+ * until no frame arrives for the follow time or the program is interrupted (SIGINT, SIGTERM); in both cases,
+ * the analyses are finished normally. While waiting for new frames, the timewise output is flushed (see analysis_flush).
+ *
+ * Analyses that accumulate pairs of atoms in tiles (see analysis_plan) may require several passes
+ * through the trajectory; only the analyses that need another pass are performed in the following passes.
+ * Once finished, all analyses ignore further frames (see analysis_end_pass).
+ *
+ * If the trajectory has a checkpoint, the analyses are first restored from it (see checkpoint_restore)
+ * and only the frames following the last frame analyzed by the previous run are read. The checkpoint
+ * is saved periodically while the frames are collected and once all frames have been analyzed.
+ *
+ * Returns zero, if successful. Else returns non-zero.
+ */
+int trajectory_run(
+        trajectory_t *trajectory,
+        system_t *system,
+        analysis_t *analyses,
+        const size_t n_analyses,
+        const int n_threads,
+        profile_t *profile);
+
+#endif /* TRAJECTORY_H */
@@ -0,0 +1,566 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "xtc.h"
+
+/*
+ * The decompression routines are adapted from the xdrfile library
+ * (Copyright (c) 2009-2014, Erik Lindahl & David van der Spoel, BSD license),
+ * so that the decoded coordinates are identical to those provided by read_xtc_step.
+ */
+
+// magic number identifying xtc frames
+static const int XTC_MAGIC = 1995;
+
+// size of the frame header preceding the compressed coordinates
+#define XTC_HEADER_SIZE 92
+
+// size of the frame header preceding uncompressed coordinates (9 or fewer atoms)
+#define XTC_SMALL_HEADER_SIZE 56
+
+// the bit reader may look past the end of the compressed coordinates before it detects corrupted data
+#define XTC_PADDING 128
+
+// size of the window of a mapped file; the same amount of the following data is read ahead
+#define XTC_MAP_WINDOW (32 << 20)
+
+// largest number of bits encoding a single atom: full coordinates (3 x 32 bits) and the run flag and length (1 + 5 bits)
+#define XTC_MAX_ATOM_BITS 102
+
+// largest number of atoms decoded in a single step of the decompression (a run of 10 small atoms and the preceding atom)
+#define XTC_MAX_STEP_ATOMS 11
+
+static const int MAGICINTS[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 10, 12, 16, 20, 25, 32, 40, 50, 64,
+    80, 101, 128, 161, 203, 256, 322, 406, 512, 645, 812, 1024, 1290,
+    1625, 2048, 2580, 3250, 4096, 5060, 6501, 8192, 10321, 13003,
+    16384, 20642, 26007, 32768, 41285, 52015, 65536, 82570, 104031,
+    131072, 165140, 208063, 262144, 330280, 416127, 524287, 660561,
+    832255, 1048576, 1321122, 1664510, 2097152, 2642245, 3329021,
+    4194304, 5284491, 6658042, 8388607, 10568983, 13316085, 16777216 };
+
+static const int FIRSTIDX = 9;
+static const int LASTIDX = sizeof(MAGICINTS) / sizeof(*MAGICINTS);
+
+/*! @brief Converts 4 big-endian bytes to an integer. */
+static int32_t decode_int(const unsigned char *bytes)
+{
+    return (int32_t) (((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16) | ((uint32_t) bytes[2] << 8) | (uint32_t) bytes[3]);
+}
+
+/*! @brief Converts 4 big-endian bytes to a float. */
+static float decode_float(const unsigned char *bytes)
+{
+    int32_t integer = decode_int(bytes);
+    float value = 0.0;
+    memcpy(&value, &integer, sizeof(float));
+    return value;
+}
+
+/*! @brief Returns the number of bits needed to store 'size'. */
+static int sizeofint(const int size)
+{
+    unsigned int num = 1;
+    int num_of_bits = 0;
+
+    while (size >= (int) num && num_of_bits < 32) {
+        num_of_bits++;
+        num <<= 1;
+    }
+
+    return num_of_bits;
+}
+
+/*! @brief Returns the number of bits needed to store three integers smaller than 'sizes'. */
+static int sizeofints(const unsigned int sizes[3])
+{
+    unsigned int bytes[32] = {0};
+    unsigned int num_of_bytes = 1, bytecnt = 0, tmp = 0;
+    int num_of_bits = 0;
+    bytes[0] = 1;
+
+    for (int i = 0; i < 3; ++i) {
+        tmp = 0;
+        for (bytecnt = 0; bytecnt < num_of_bytes; ++bytecnt) {
+            tmp = bytes[bytecnt] * sizes[i] + tmp;
+            bytes[bytecnt] = tmp & 0xff;
+            tmp >>= 8;
+        }
+        while (tmp != 0) {
+            bytes[bytecnt++] = tmp & 0xff;
+            tmp >>= 8;
+        }
+        num_of_bytes = bytecnt;
+    }
+
+    unsigned int num = 1;
+    num_of_bytes--;
+    while (bytes[num_of_bytes] >= num) {
+        num_of_bits++;
+        num *= 2;
+    }
+
+    return num_of_bits + num_of_bytes * 8;
+}
+
+/*! @brief State of reading of the compressed bit stream. */
+typedef struct bitstream {
+    const unsigned char *data;
+    size_t count;
+    unsigned int lastbits;
+    unsigned int lastbyte;
+} bitstream_t;
+
+/*! @brief Reads 'nbits' bits from the bit stream. */
+static int receivebits(bitstream_t *stream, int nbits)
+{
+    int mask = (1 << nbits) - 1;
+    int num = 0;
+
+    while (nbits >= 8) {
+        stream->lastbyte = (stream->lastbyte << 8) | stream->data[stream->count++];
+        num |= (stream->lastbyte >> stream->lastbits) << (nbits - 8);
+        nbits -= 8;
+    }
+
+    if (nbits > 0) {
+        if ((int) stream->lastbits < nbits) {
+            stream->lastbits += 8;
+            stream->lastbyte = (stream->lastbyte << 8) | stream->data[stream->count++];
+        }
+        stream->lastbits -= nbits;
+        num |= (stream->lastbyte >> stream->lastbits) & ((1 << nbits) - 1);
+    }
+
+    return num & mask;
+}
+
+/*! @brief Reads three integers packed into 'num_of_bits' bits from the bit stream. */
+static void receiveints(bitstream_t *stream, int num_of_bits, const unsigned int sizes[3], int nums[3])
+{
+    int bytes[32] = {0};
+    int num_of_bytes = 0;
+
+    while (num_of_bits > 8) {
+        bytes[num_of_bytes++] = receivebits(stream, 8);
+        num_of_bits -= 8;
+    }
+    if (num_of_bits > 0) bytes[num_of_bytes++] = receivebits(stream, num_of_bits);
+
+    for (int i = 2; i > 0; --i) {
+        unsigned int num = 0;
+        for (int j = num_of_bytes - 1; j >= 0; --j) {
+            num = (num << 8) | bytes[j];
+            unsigned int p = num / sizes[i];
+            bytes[j] = p;
+            num = num - p * sizes[i];
+        }
+        nums[i] = num;
+    }
+
+    nums[0] = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
+}
+
+/*! @brief Stores decoded integer coordinates of atom with 'index' into the system. */
+static inline void store_atom(system_t *system, const size_t index, const int coords[3], const float inv_precision)
+{
+    system->atoms[index].position[0] = coords[0] * inv_precision;
+    system->atoms[index].position[1] = coords[1] * inv_precision;
+    system->atoms[index].position[2] = coords[2] * inv_precision;
+}
+
+/*
+ * Decompresses coordinates of the first 'n_decoded' (or slightly more) of the 'n_atoms' atoms into the system.
+ * 'header' points to the precision, minint, maxint and smallidx fields of the frame,
+ * 'data' points to 'n_bytes' bytes of the compressed coordinates.
+ * Returns zero, if successful, else returns non-zero.
+ */
+static int decompress_coordinates(
+        system_t *system,
+        const int n_atoms,
+        const int n_decoded,
+        const unsigned char *header,
+        const unsigned char *data,
+        const size_t n_bytes)
+{
+    float precision = decode_float(header);
+    int minint[3], maxint[3];
+    unsigned int sizeint[3], bitsizeint[3] = {0}, sizesmall[3];
+    int bitsize = 0;
+
+    for (int i = 0; i < 3; ++i) {
+        minint[i] = decode_int(header + 4 + 4 * i);
+        maxint[i] = decode_int(header + 16 + 4 * i);
+        sizeint[i] = maxint[i] - minint[i] + 1;
+    }
+
+    // check if one of the sizes is too big to be multiplied
+    if ((sizeint[0] | sizeint[1] | sizeint[2]) > 0xffffff) {
+        for (int i = 0; i < 3; ++i) bitsizeint[i] = sizeofint(sizeint[i]);
+        bitsize = 0;
+    } else {
+        bitsize = sizeofints(sizeint);
+    }
+
+    int smallidx = decode_int(header + 28);
+    if (smallidx < FIRSTIDX || smallidx >= LASTIDX) return 1;
+
+    int smaller = MAGICINTS[FIRSTIDX > smallidx - 1 ? FIRSTIDX : smallidx - 1] / 2;
+    int smallnum = MAGICINTS[smallidx] / 2;
+    sizesmall[0] = sizesmall[1] = sizesmall[2] = MAGICINTS[smallidx];
+
+    bitstream_t stream = { .data = data };
+    float inv_precision = 1.0 / precision;
+
+    int thiscoord[3] = {0}, prevcoord[3] = {0};
+    int i = 0, run = 0;
+    while (i < n_decoded) {
+        // a single iteration never reads more than XTC_PADDING bytes, so this catches corrupted data in time
+        if (stream.count > n_bytes) return 1;
+
+        if (bitsize == 0) {
+            thiscoord[0] = receivebits(&stream, bitsizeint[0]);
+            thiscoord[1] = receivebits(&stream, bitsizeint[1]);
+            thiscoord[2] = receivebits(&stream, bitsizeint[2]);
+        } else {
+            receiveints(&stream, bitsize, sizeint, thiscoord);
+        }
+
+        for (int d = 0; d < 3; ++d) {
+            thiscoord[d] += minint[d];
+            prevcoord[d] = thiscoord[d];
+        }
+
+        int is_smaller = 0;
+        if (receivebits(&stream, 1) == 1) {
+            run = receivebits(&stream, 5);
+            is_smaller = run % 3;
+            run -= is_smaller;
+            is_smaller--;
+        }
+
+        if (run > 0) {
+            if (i + run / 3 >= n_atoms) return 1;
+
+            for (int k = 0; k < run; k += 3) {
+                receiveints(&stream, smallidx, sizesmall, thiscoord);
+                for (int d = 0; d < 3; ++d) thiscoord[d] += prevcoord[d] - smallnum;
+
+                if (k == 0) {
+                    // interchange first with second atom for better compression of water molecules
+                    for (int d = 0; d < 3; ++d) {
+                        int tmp = thiscoord[d];
+                        thiscoord[d] = prevcoord[d];
+                        prevcoord[d] = tmp;
+                    }
+                    store_atom(system, i++, prevcoord, inv_precision);
+                } else {
+                    for (int d = 0; d < 3; ++d) prevcoord[d] = thiscoord[d];
+                }
+                store_atom(system, i++, thiscoord, inv_precision);
+            }
+        } else {
+            store_atom(system, i++, thiscoord, inv_precision);
+        }
+
+        smallidx += is_smaller;
+        if (smallidx < FIRSTIDX || smallidx >= LASTIDX) return 1;
+
+        if (is_smaller < 0) {
+            smallnum = smaller;
+            if (smallidx > FIRSTIDX) smaller = MAGICINTS[smallidx - 1] / 2;
+            else smaller = 0;
+        } else if (is_smaller > 0) {
+            smaller = smallnum;
+            smallnum = MAGICINTS[smallidx] / 2;
+        }
+        sizesmall[0] = sizesmall[1] = sizesmall[2] = MAGICINTS[smallidx];
+    }
+
+    return 0;
+}
+
+/*
+ * Returns 1, if the file contains all bytes up to 'end'. Else returns 0.
+ * The size of the file is only checked again if the last known size is not sufficient,
+ * so that frames appended to the file are noticed.
+ */
+static int file_contains(xtc_file_t *xtc, const off_t end)
+{
+    if (end <= xtc->size) return 1;
+
+    struct stat info;
+    if (fstat(fileno(xtc->file), &info) != 0) return 0;
+    xtc->size = info.st_size;
+
+    return end <= xtc->size;
+}
+
+/*! @brief Releases the mapped window of the file. */
+static void unmap_window(xtc_file_t *xtc)
+{
+    if (xtc->map != NULL) munmap((void *) xtc->map, xtc->map_size);
+    xtc->map = NULL;
+    xtc->map_offset = 0;
+    xtc->map_size = 0;
+}
+
+/*
+ * Returns pointer to 'n' bytes of the mapped file starting at 'offset'.
+ * If the bytes are not in the current window, a new window starting at them is mapped.
+ * Returns NULL, if the file does not contain the bytes or they could not be mapped.
+ */
+static const unsigned char *map_bytes(xtc_file_t *xtc, const off_t offset, const size_t n)
+{
+    off_t end = offset + (off_t) n;
+    if (xtc->map != NULL && offset >= xtc->map_offset && end <= xtc->map_offset + (off_t) xtc->map_size) {
+        return xtc->map + (offset - xtc->map_offset);
+    }
+
+    if (!file_contains(xtc, end)) return NULL;
+    unmap_window(xtc);
+
+    // the window must start at a page boundary and never reaches past the end of the file
+    off_t page = sysconf(_SC_PAGESIZE);
+    off_t start = offset - offset % page;
+    off_t size = end - start > XTC_MAP_WINDOW ? end - start : XTC_MAP_WINDOW;
+    if (start + size > xtc->size) size = xtc->size - start;
+
+    void *map = mmap(NULL, (size_t) size, PROT_READ, MAP_SHARED, fileno(xtc->file), start);
+    if (map == MAP_FAILED) return NULL;
+
+    // pages of the window are read ahead as they are accessed, the following window is read in the background
+    posix_madvise(map, (size_t) size, POSIX_MADV_SEQUENTIAL);
+    posix_fadvise(fileno(xtc->file), start + size, XTC_MAP_WINDOW, POSIX_FADV_WILLNEED);
+
+    xtc->map = map;
+    xtc->map_offset = start;
+    xtc->map_size = (size_t) size;
+    return xtc->map + (offset - start);
+}
+
+/*! @brief Reads the next 'n' bytes of the file into 'buffer'. Returns zero, if successful, else returns non-zero. */
+static int read_bytes(xtc_file_t *xtc, unsigned char *buffer, const size_t n)
+{
+    if (!xtc->mapped) return fread(buffer, 1, n, xtc->file) != n;
+
+    const unsigned char *bytes = map_bytes(xtc, xtc->position, n);
+    if (bytes == NULL) return 1;
+
+    memcpy(buffer, bytes, n);
+    xtc->position += n;
+    return 0;
+}
+
+/*
+ * Provides the next 'n' bytes of the file followed by XTC_PADDING readable bytes and moves past the 'n' bytes.
+ * Mapped files are decoded directly from the map; only the bytes at the end of the file are copied into
+ * the buffer of the reader, which also holds the bytes read using stdio. The padding of the buffer is zeroed.
+ * Returns NULL, if the bytes could not be read.
+ */
+static const unsigned char *read_payload(xtc_file_t *xtc, const size_t n)
+{
+    if (xtc->mapped && file_contains(xtc, xtc->position + (off_t) (n + XTC_PADDING))) {
+        const unsigned char *bytes = map_bytes(xtc, xtc->position, n + XTC_PADDING);
+        if (bytes != NULL) xtc->position += n;
+        return bytes;
+    }
+
+    if (n + XTC_PADDING > xtc->capacity) {
+        unsigned char *data = realloc(xtc->data, n + XTC_PADDING);
+        if (data == NULL) return NULL;
+        xtc->data = data;
+        xtc->capacity = n + XTC_PADDING;
+    }
+
+    if (read_bytes(xtc, xtc->data, n) != 0) return NULL;
+    memset(xtc->data + n, 0, XTC_PADDING);
+    return xtc->data;
+}
+
+/*! @brief Moves the read position to 'offset' without changing the offset of the next frame. Returns zero, if successful, else returns non-zero. */
+static int move_to(xtc_file_t *xtc, const off_t offset)
+{
+    if (!xtc->mapped) return fseeko(xtc->file, offset, SEEK_SET) != 0;
+
+    xtc->position = offset;
+    return 0;
+}
+
+/*
+ * Reads the fixed-size part of the frame header into 'buffer' and parses it.
+ * 'buffer' must be able to hold XTC_HEADER_SIZE bytes.
+ * Returns zero, if successful, else returns non-zero.
+ */
+static int read_header(xtc_file_t *xtc, xtc_header_t *header, unsigned char *buffer)
+{
+    if (read_bytes(xtc, buffer, XTC_SMALL_HEADER_SIZE) != 0) return 1;
+    if (decode_int(buffer) != XTC_MAGIC) return 1;
+
+    header->offset = xtc->offset;
+    header->n_atoms = decode_int(buffer + 4);
+    header->step = decode_int(buffer + 8);
+    header->time = decode_float(buffer + 12);
+    for (int i = 0; i < 9; ++i) header->box[i / 3][i % 3] = decode_float(buffer + 16 + 4 * i);
+
+    // number of atoms is repeated before the coordinates
+    if (header->n_atoms <= 0 || decode_int(buffer + 52) != header->n_atoms) return 1;
+
+    if (header->n_atoms <= 9) {
+        header->size = XTC_SMALL_HEADER_SIZE + 12 * header->n_atoms;
+        return 0;
+    }
+
+    if (read_bytes(xtc, buffer + XTC_SMALL_HEADER_SIZE, XTC_HEADER_SIZE - XTC_SMALL_HEADER_SIZE) != 0) return 1;
+
+    int n_bytes = decode_int(buffer + 88);
+    if (n_bytes < 0) return 1;
+
+    // compressed coordinates are padded to a multiple of 4 bytes
+    header->size = XTC_HEADER_SIZE + ((n_bytes + 3) & ~3);
+    return 0;
+}
+
+xtc_file_t *xtc_open(const char *filename)
+{
+    xtc_file_t *xtc = calloc(1, sizeof(xtc_file_t));
+    if (xtc == NULL) return NULL;
+
+    xtc->file = fopen(filename, "rb");
+    if (xtc->file == NULL) {
+        free(xtc);
+        return NULL;
+    }
+
+    xtc->filename = strdup(filename);
+
+    xtc_header_t header = {0};
+    unsigned char buffer[XTC_HEADER_SIZE];
+    if (read_header(xtc, &header, buffer) != 0 || xtc_seek(xtc, 0) != 0) {
+        xtc_close(xtc);
+        return NULL;
+    }
+
+    xtc->n_atoms = header.n_atoms;
+    return xtc;
+}
+
+void xtc_close(xtc_file_t *xtc)
+{
+    if (xtc == NULL) return;
+
+    unmap_window(xtc);
+    if (xtc->file != NULL) fclose(xtc->file);
+    free(xtc->filename);
+    free(xtc->data);
+    free(xtc);
+}
+
+int xtc_map(xtc_file_t *xtc)
+{
+    xtc->mapped = 1;
+    xtc->position = xtc->offset;
+
+    // the first window is mapped immediately, so that a file that cannot be mapped is reported
+    if (map_bytes(xtc, xtc->offset, 1) != NULL) return 0;
+
+    xtc->mapped = 0;
+    return 1;
+}
+
+int xtc_seek(xtc_file_t *xtc, const off_t offset)
+{
+    if (move_to(xtc, offset) != 0) return 1;
+    xtc->offset = offset;
+    return 0;
+}
+
+int xtc_skip_frame(xtc_file_t *xtc, xtc_header_t *header)
+{
+    unsigned char buffer[XTC_HEADER_SIZE];
+    if (read_header(xtc, header, buffer) != 0) {
+        xtc_seek(xtc, xtc->offset);
+        return 1;
+    }
+
+    // make sure that the frame has been written completely
+    if (!file_contains(xtc, header->offset + header->size)) {
+        xtc_seek(xtc, xtc->offset);
+        return 1;
+    }
+
+    return xtc_seek(xtc, header->offset + header->size);
+}
+
+void xtc_limit_atoms(xtc_file_t *xtc, const size_t n_atoms)
+{
+    xtc->n_decoded = n_atoms < (size_t) xtc->n_atoms ? n_atoms : 0;
+}
+
+int xtc_read_frame(xtc_file_t *xtc, system_t *system)
+{
+    xtc_header_t header = {0};
+    unsigned char buffer[XTC_HEADER_SIZE];
+    if (read_header(xtc, &header, buffer) != 0) {
+        xtc_seek(xtc, xtc->offset);
+        return 1;
+    }
+
+    if ((size_t) header.n_atoms != system->n_atoms) {
+        xtc_seek(xtc, xtc->offset);
+        return 1;
+    }
+
+    size_t payload = header.size - (header.n_atoms <= 9 ? XTC_SMALL_HEADER_SIZE : XTC_HEADER_SIZE);
+    size_t n_bytes = header.n_atoms <= 9 ? payload : (size_t) decode_int(buffer + 88);
+    int n_decoded = header.n_atoms;
+
+    // only read the part of the compressed coordinates that can encode the needed atoms
+    if (xtc->n_decoded > 0 && header.n_atoms > 9) {
+        // the frame must still have been written completely
+        if (!file_contains(xtc, header.offset + header.size)) {
+            xtc_seek(xtc, xtc->offset);
+            return 1;
+        }
+
+        n_decoded = (int) xtc->n_decoded;
+        size_t needed = ((size_t) (n_decoded + XTC_MAX_STEP_ATOMS) * XTC_MAX_ATOM_BITS + 7) / 8;
+        if (needed < n_bytes) n_bytes = needed;
+        if (n_bytes < payload) payload = n_bytes;
+    }
+
+    const unsigned char *data = read_payload(xtc, payload);
+    if (data == NULL) {
+        xtc_seek(xtc, xtc->offset);
+        return 1;
+    }
+
+    if (header.n_atoms <= 9) {
+        for (int i = 0; i < header.n_atoms; ++i) {
+            for (int d = 0; d < 3; ++d) system->atoms[i].position[d] = decode_float(data + 12 * i + 4 * d);
+        }
+    } else if (decompress_coordinates(system, header.n_atoms, n_decoded, buffer + XTC_SMALL_HEADER_SIZE, data, n_bytes) != 0) {
+        xtc_seek(xtc, xtc->offset);
+        return 1;
+    }
+
+    // skip the compressed coordinates of the remaining atoms
+    if (n_decoded < header.n_atoms && move_to(xtc, header.offset + header.size) != 0) {
+        xtc_seek(xtc, xtc->offset);
+        return 1;
+    }
+
+    system->step = header.step;
+    system->time = header.time;
+    system->box[0] = header.box[0][0];
+    system->box[1] = header.box[1][1];
+    system->box[2] = header.box[2][2];
+
+    xtc->offset = header.offset + header.size;
+    xtc->n_read += header.size;
+    return 0;
+}
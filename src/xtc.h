@@ -0,0 +1,88 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef XTC_H
+#define XTC_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <groan.h>
+
+/*
+ * Minimal xtc reader used by posdist.
+ *
+ * Unlike read_xtc_step, it knows the byte offset of every frame and is able to step over
+ * a frame by reading just its header, without decompressing the coordinates.
+ * Coordinates are stored in the order of the atoms, so the reader can also stop
+ * decompressing a frame after the last atom that is needed (see xtc_limit_atoms).
+ *
+ * The file is read using stdio by default. A mapped file (see xtc_map) is read through a window
+ * of the file mapped into memory and the compressed coordinates are decoded directly from it.
+ */
+
+/*! @brief Header of a single xtc frame. */
+typedef struct xtc_header {
+    int n_atoms;
+    int step;
+    float time;
+    float box[3][3];
+    off_t offset;           // byte offset of the frame in the file
+    off_t size;             // size of the whole frame in bytes
+} xtc_header_t;
+
+typedef struct xtc_file {
+    FILE *file;
+    char *filename;
+    int n_atoms;
+    off_t offset;           // byte offset of the next frame
+    off_t size;             // last known size of the file
+    unsigned char *data;    // buffer for the compressed coordinates
+    size_t capacity;
+    size_t n_decoded;       // only the first 'n_decoded' atoms of every frame are decompressed; zero = all atoms
+    off_t n_read;           // total size of the frames read by xtc_read_frame (bytes)
+    int mapped;             // the file is read through the memory map (see xtc_map)
+    const unsigned char *map;   // mapped window of the file; NULL = nothing mapped
+    off_t map_offset;       // byte offset of the window in the file
+    size_t map_size;
+    off_t position;         // byte offset of the next byte read from the mapped file
+} xtc_file_t;
+
+/*
+ * Opens an xtc file and reads the number of atoms from the first frame.
+ * Returns NULL, if the file could not be opened or does not contain a valid xtc frame.
+ */
+xtc_file_t *xtc_open(const char *filename);
+
+/*! @brief Closes the xtc file and releases all memory. */
+void xtc_close(xtc_file_t *xtc);
+
+/*
+ * Reads the file through a memory map from now on. Windows of the file are mapped one after another
+ * with sequential access advice and the following window is read ahead while the current one is decoded.
+ * Returns zero, if successful, else returns non-zero.
+ */
+int xtc_map(xtc_file_t *xtc);
+
+/*! @brief Moves the reader to the frame starting at 'offset'. Returns zero, if successful, else returns non-zero. */
+int xtc_seek(xtc_file_t *xtc, const off_t offset);
+
+/*
+ * Reads header of the next frame and moves to the frame following it, without decompressing the coordinates.
+ * Returns zero, if successful. Returns non-zero at the end of the file or if the frame is incomplete or invalid.
+ */
+int xtc_skip_frame(xtc_file_t *xtc, xtc_header_t *header);
+
+/*
+ * Only decompresses coordinates of the first 'n_atoms' atoms of the following frames.
+ * Coordinates of the remaining atoms of the system are left unchanged (a few atoms following
+ * the limit may still be updated). Zero or a number larger than the number of atoms means all atoms.
+ */
+void xtc_limit_atoms(xtc_file_t *xtc, const size_t n_atoms);
+
+/*
+ * Reads the next frame into the system (coordinates, box, step and time).
+ * Returns zero, if successful. Returns non-zero at the end of the file or if the frame is incomplete or invalid.
+ */
+int xtc_read_frame(xtc_file_t *xtc, system_t *system);
+
+#endif /* XTC_H */
@@ -0,0 +1,241 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include "xtc_index.h"
+
+// identifies posdist index files
+static const char INDEX_MAGIC[4] = {'P', 'D', 'X', 'I'};
+
+// version of the index file format
+static const int32_t INDEX_VERSION = 1;
+
+// extension of the index files
+static const char INDEX_EXTENSION[] = ".pdx";
+
+/*! @brief Header of the index file. */
+typedef struct index_file_header {
+    char magic[4];
+    int32_t version;
+    int32_t n_atoms;
+    int32_t reserved;
+    int64_t xtc_size;
+    int64_t xtc_mtime;
+    int64_t end;
+    uint64_t n_frames;
+} index_file_header_t;
+
+/*! @brief Adds frame to the index. Returns zero, if successful, else returns non-zero. */
+static int index_add(xtc_index_t *index, const xtc_header_t *header)
+{
+    if (index->n_frames >= index->capacity) {
+        size_t capacity = index->capacity == 0 ? 1024 : 2 * index->capacity;
+        xtc_frame_t *frames = realloc(index->frames, capacity * sizeof(xtc_frame_t));
+        if (frames == NULL) return 1;
+
+        index->frames = frames;
+        index->capacity = capacity;
+    }
+
+    index->frames[index->n_frames].offset = header->offset;
+    index->frames[index->n_frames].step = header->step;
+    index->frames[index->n_frames].time = header->time;
+    ++index->n_frames;
+
+    index->end = header->offset + header->size;
+    return 0;
+}
+
+size_t xtc_index_update(xtc_index_t *index, xtc_file_t *xtc)
+{
+    off_t original = xtc->offset;
+    if (xtc_seek(xtc, index->end) != 0) return 0;
+
+    size_t n_added = 0;
+    xtc_header_t header = {0};
+    while (xtc_skip_frame(xtc, &header) == 0) {
+        if (header.n_atoms != xtc->n_atoms || index_add(index, &header) != 0) break;
+        ++n_added;
+    }
+
+    xtc_seek(xtc, original);
+    return n_added;
+}
+
+/*! @brief Returns the path to the index file. Must be freed by the caller. */
+static char *index_path(const char *xtc_file)
+{
+    char *path = malloc(strlen(xtc_file) + sizeof(INDEX_EXTENSION));
+    if (path == NULL) return NULL;
+
+    strcpy(path, xtc_file);
+    strcat(path, INDEX_EXTENSION);
+    return path;
+}
+
+/*
+ * Checks that the first and the last indexed frames are still present in the xtc file.
+ * Returns 1, if they are, else returns 0.
+ */
+static int index_matches(const xtc_index_t *index, xtc_file_t *xtc)
+{
+    if (index->n_frames == 0) return 0;
+
+    const xtc_frame_t *check[2] = { &index->frames[0], &index->frames[index->n_frames - 1] };
+    xtc_header_t header = {0};
+
+    for (int i = 0; i < 2; ++i) {
+        if (xtc_seek(xtc, check[i]->offset) != 0 || xtc_skip_frame(xtc, &header) != 0) return 0;
+        if (header.step != check[i]->step || header.time != check[i]->time) return 0;
+    }
+
+    return 1;
+}
+
+/*! @brief Loads index from the index file. Returns NULL, if the file does not exist or is not valid. */
+static xtc_index_t *index_load(xtc_file_t *xtc, const struct stat *info)
+{
+    char *path = index_path(xtc->filename);
+    if (path == NULL) return NULL;
+
+    FILE *file = fopen(path, "rb");
+    free(path);
+    if (file == NULL) return NULL;
+
+    index_file_header_t header = {0};
+    if (fread(&header, sizeof(index_file_header_t), 1, file) != 1 ||
+        memcmp(header.magic, INDEX_MAGIC, 4) != 0 ||
+        header.version != INDEX_VERSION ||
+        header.n_atoms != xtc->n_atoms ||
+        header.xtc_size > info->st_size ||
+        (header.xtc_size == info->st_size && header.xtc_mtime != (int64_t) info->st_mtime)) {
+        fclose(file);
+        return NULL;
+    }
+
+    xtc_index_t *index = calloc(1, sizeof(xtc_index_t));
+    if (index == NULL) {
+        fclose(file);
+        return NULL;
+    }
+
+    index->n_frames = header.n_frames;
+    index->capacity = header.n_frames;
+    index->end = header.end;
+    index->frames = malloc(header.n_frames * sizeof(xtc_frame_t));
+
+    if (index->frames == NULL || fread(index->frames, sizeof(xtc_frame_t), header.n_frames, file) != header.n_frames) {
+        fclose(file);
+        xtc_index_destroy(index);
+        return NULL;
+    }
+
+    fclose(file);
+
+    off_t original = xtc->offset;
+    int valid = index_matches(index, xtc);
+    xtc_seek(xtc, original);
+
+    if (!valid) {
+        xtc_index_destroy(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+/*
+ * Writes index into the index file. Returns zero, if successful, else returns non-zero.
+ * The index is written under a temporary name and renamed, once complete, so interrupted or
+ * concurrent runs never leave a truncated or mixed index file behind.
+ */
+static int index_save(const xtc_index_t *index, const xtc_file_t *xtc, const struct stat *info)
+{
+    char *path = index_path(xtc->filename);
+    if (path == NULL) return 1;
+
+    size_t length = strlen(path) + 8;
+    char *temporary = malloc(length);
+    if (temporary == NULL) {
+        free(path);
+        return 1;
+    }
+    snprintf(temporary, length, "%s.XXXXXX", path);
+
+    index_file_header_t header = {0};
+    memcpy(header.magic, INDEX_MAGIC, 4);
+    header.version = INDEX_VERSION;
+    header.n_atoms = xtc->n_atoms;
+    header.xtc_size = info->st_size;
+    header.xtc_mtime = info->st_mtime;
+    header.end = index->end;
+    header.n_frames = index->n_frames;
+
+    int status = 1;
+    int fd = mkstemp(temporary);
+
+    // mkstemp creates files readable only by the owner, but the index may be shared like the xtc file
+    if (fd >= 0) fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    FILE *file = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (file != NULL) {
+        status = fwrite(&header, sizeof(index_file_header_t), 1, file) != 1 ||
+                 fwrite(index->frames, sizeof(xtc_frame_t), index->n_frames, file) != index->n_frames;
+        if (fclose(file) != 0) status = 1;
+    } else if (fd >= 0) {
+        close(fd);
+    }
+
+    if (status == 0 && rename(temporary, path) != 0) status = 1;
+    if (status != 0 && fd >= 0) unlink(temporary);
+
+    free(path);
+    free(temporary);
+    return status;
+}
+
+xtc_index_t *xtc_index_get(xtc_file_t *xtc)
+{
+    struct stat info;
+    if (stat(xtc->filename, &info) != 0) return NULL;
+
+    xtc_index_t *index = index_load(xtc, &info);
+    int modified = 0;
+
+    if (index == NULL) {
+        index = calloc(1, sizeof(xtc_index_t));
+        if (index == NULL) return NULL;
+        modified = 1;
+    }
+
+    // add frames that are not yet indexed
+    if (index->end < info.st_size && xtc_index_update(index, xtc) > 0) modified = 1;
+
+    if (index->n_frames == 0) {
+        xtc_index_destroy(index);
+        return NULL;
+    }
+
+    if (modified) index_save(index, xtc, &info);
+    return index;
+}
+
+size_t xtc_index_find(const xtc_index_t *index, const float time)
+{
+    size_t low = 0, high = index->n_frames;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (index->frames[mid].time < time) low = mid + 1;
+        else high = mid;
+    }
+
+    return low;
+}
+
+void xtc_index_destroy(xtc_index_t *index)
+{
+    if (index == NULL) return;
+
+    free(index->frames);
+    free(index);
+}
@@ -0,0 +1,49 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+#ifndef XTC_INDEX_H
+#define XTC_INDEX_H
+
+#include "xtc.h"
+
+/*! @brief Position and time of a single frame of an xtc file. */
+typedef struct xtc_frame {
+    off_t offset;
+    int step;
+    float time;
+} xtc_frame_t;
+
+/*
+ * Offsets of all complete frames of an xtc file.
+ * The index is stored next to the xtc file (as 'XTC_FILE.pdx') and reused by later runs.
+ */
+typedef struct xtc_index {
+    size_t n_frames;
+    size_t capacity;
+    xtc_frame_t *frames;
+    off_t end;              // byte offset following the last indexed frame
+} xtc_index_t;
+
+/*
+ * Returns index of the xtc file. A stored index is reused if it is still valid
+ * and extended if frames have been appended to the file since it was written.
+ * Otherwise, the index is created by reading the headers of all frames and saved.
+ * Failing to save the index is not an error.
+ *
+ * Returns NULL, if the index could not be created.
+ */
+xtc_index_t *xtc_index_get(xtc_file_t *xtc);
+
+/*
+ * Adds frames appended to the xtc file since the index has been created or last updated.
+ * Returns the number of added frames.
+ */
+size_t xtc_index_update(xtc_index_t *index, xtc_file_t *xtc);
+
+/*! @brief Returns the index of the first frame with time equal to or larger than 'time'. */
+size_t xtc_index_find(const xtc_index_t *index, const float time);
+
+/*! @brief Releases memory allocated for the index. */
+void xtc_index_destroy(xtc_index_t *index);
+
+#endif /* XTC_INDEX_H */
@@ -0,0 +1,172 @@
+// Released under MIT License.
+// Copyright (c) 2022 Ladislav Bartos
+
+/*
+ * Test of the C API of posdist (libposdist).
+ *
+ * Analyzes the positions of the atoms of a selection and the distances between the atoms of two selections
+ * using the API and compares the values written into the buffers of the program with the timewise output
+ * of posdist (option -t) for the same analyses. Returns zero, if all frames and values match.
+ *
+ * Usage: api_test GRO XTC NDX SELECTION POSITIONS_OUTPUT SELECTION1 SELECTION2 DISTANCES_OUTPUT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../src/posdist.h"
+
+// values in the text output are written with three decimal places
+static const float TOLERANCE = 0.0006f;
+
+/*! @brief Timewise text output of posdist read frame by frame. */
+typedef struct text_output {
+    FILE *file;
+    char line[1024];
+    int pending;                // 'line' contains the time of the next frame
+} text_output_t;
+
+/*! @brief Appends the values of the line to 'values'. Returns zero, if successful, else returns non-zero. */
+static int parse_line(const char *line, float *values, size_t n_values, size_t *n_read)
+{
+    // distances: ">>> Atom ... (resid: 27):   4.086"
+    if (strncmp(line, ">>> ", 4) == 0) {
+        const char *colon = strrchr(line, ':');
+        if (*n_read >= n_values || sscanf(colon + 1, "%f", &values[*n_read]) != 1) return 1;
+        ++*n_read;
+        return 0;
+    }
+
+    // positions: "Atom ... (resid: 1):    x = 4.500    y = 4.720    z = 7.330"
+    for (const char *equal = strstr(line, "= "); equal != NULL; equal = strstr(equal + 2, "= ")) {
+        if (*n_read >= n_values || sscanf(equal + 2, "%f", &values[*n_read]) != 1) return 1;
+        ++*n_read;
+    }
+
+    return 0;
+}
+
+/*
+ * Reads the time and the values of the next frame of the output. Returns zero, if successful.
+ * Returns 1 at the end of the output. Returns -1, if the frame does not contain 'n_values' values.
+ */
+static int read_frame(text_output_t *output, float *time, float *values, size_t n_values)
+{
+    while (!output->pending) {
+        if (fgets(output->line, sizeof(output->line), output->file) == NULL) return 1;
+        output->pending = strncmp(output->line, "t = ", 4) == 0;
+    }
+
+    output->pending = 0;
+    if (sscanf(output->line, "t = %f", time) != 1) return -1;
+
+    size_t n_read = 0;
+    while (fgets(output->line, sizeof(output->line), output->file) != NULL) {
+        if (strncmp(output->line, "t = ", 4) == 0) {
+            output->pending = 1;
+            break;
+        }
+
+        if (parse_line(output->line, values, n_values, &n_read) != 0) return -1;
+    }
+
+    return n_read == n_values ? 0 : -1;
+}
+
+/*! @brief Compares the values of the analysis with the next frame of the output. Returns zero, if they match. */
+static int compare_frame(text_output_t *output, const char *path, const posdist_frame_t *frame, const float *values, float *expected, size_t n_values)
+{
+    float time = 0.0f;
+    if (read_frame(output, &time, expected, n_values) != 0) {
+        fprintf(stderr, "Frame at %f ps of '%s' does not contain %zu values.\n", frame->time, path, n_values);
+        return 1;
+    }
+
+    if (fabsf(time - frame->time) > TOLERANCE) {
+        fprintf(stderr, "Time of frame %zu is %f ps but '%s' contains %f ps.\n", frame->index, frame->time, path, time);
+        return 1;
+    }
+
+    for (size_t i = 0; i < n_values; ++i) {
+        if (fabsf(values[i] - expected[i]) > TOLERANCE) {
+            fprintf(stderr, "Value %zu of frame at %f ps is %f but '%s' contains %.3f.\n", i, frame->time, values[i], path, expected[i]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Analyzes the trajectory using the session and compares every frame with the outputs.
+ * Returns zero, if all frames match, else returns non-zero.
+ */
+static int compare_trajectory(posdist_t *session, int position_analysis, int distance_analysis,
+        text_output_t *positions_output, const char *positions_path, text_output_t *distances_output, const char *distances_path)
+{
+    size_t n_positions = posdist_n_values(session, position_analysis);
+    size_t n_distances = posdist_n_values(session, distance_analysis);
+    float *positions = malloc(n_positions * sizeof(float));
+    float *distances = malloc(n_distances * sizeof(float));
+    float *expected = malloc((n_positions > n_distances ? n_positions : n_distances) * sizeof(float));
+
+    int status = positions == NULL || distances == NULL || expected == NULL ||
+        posdist_set_buffer(session, position_analysis, positions) != 0 || posdist_set_buffer(session, distance_analysis, distances) != 0;
+
+    size_t n_frames = 0;
+    int next = 0;
+    while (status == 0 && (next = posdist_next_frame(session)) == 0) {
+        const posdist_frame_t *frame = posdist_frame(session);
+        status = compare_frame(positions_output, positions_path, frame, positions, expected, n_positions) != 0 ||
+            compare_frame(distances_output, distances_path, frame, distances, expected, n_distances) != 0;
+        ++n_frames;
+    }
+
+    if (status == 0 && next < 0) status = 1;
+
+    // the outputs must not contain any further frame
+    float time = 0.0f;
+    if (status == 0 && (read_frame(positions_output, &time, expected, n_positions) != 1 || read_frame(distances_output, &time, expected, n_distances) != 1)) {
+        fprintf(stderr, "Outputs of posdist contain more frames than the %zu frames read using the API.\n", n_frames);
+        status = 1;
+    }
+
+    if (status == 0) printf("%zu frames with %zu positions and %zu distances match the outputs of posdist.\n", n_frames, n_positions, n_distances);
+
+    // the buffers of the program must not be used after they are released
+    posdist_set_buffer(session, position_analysis, NULL);
+    posdist_set_buffer(session, distance_analysis, NULL);
+    free(positions);
+    free(distances);
+    free(expected);
+    return status;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 9) {
+        fprintf(stderr, "Usage: %s GRO XTC NDX SELECTION POSITIONS_OUTPUT SELECTION1 SELECTION2 DISTANCES_OUTPUT\n", argv[0]);
+        return 1;
+    }
+
+    text_output_t positions_output = { .file = fopen(argv[5], "r"), .pending = 0 };
+    text_output_t distances_output = { .file = fopen(argv[8], "r"), .pending = 0 };
+    posdist_t *session = posdist_open(argv[1], argv[3]);
+
+    int status = 1;
+    if (positions_output.file == NULL || distances_output.file == NULL) {
+        fprintf(stderr, "Could not open the outputs of posdist.\n");
+    } else if (session != NULL && posdist_open_trajectory(session, argv[2]) == 0) {
+        int position_analysis = posdist_add_positions(session, argv[4], 0);
+        int distance_analysis = posdist_add_distances(session, argv[6], argv[7], 0);
+        if (position_analysis >= 0 && distance_analysis >= 0) {
+            status = compare_trajectory(session, position_analysis, distance_analysis, &positions_output, argv[5], &distances_output, argv[8]);
+        }
+    }
+
+    if (positions_output.file != NULL) fclose(positions_output.file);
+    if (distances_output.file != NULL) fclose(distances_output.file);
+    if (session != NULL) posdist_close(session);
+    return status;
+}